@@ -273,6 +273,21 @@ ssize_t UDPSocket::send(const void *buf, size_t len)
     return _IORET64 ::sendto(so, (const char *)buf, _IOLEN64 len, MSG_NOSIGNAL, addr, alen);
 }
 
+int UDPSocket::send(ucommon::Socket::datagram_t *list, unsigned count)
+{
+    struct sockaddr *addr = peer;
+    socklen_t alen = peer.getLength();
+    if(isConnected())
+        addr = NULL;
+
+    for(unsigned pos = 0; addr && pos < count; ++pos) {
+        if(!list[pos].address.ss_family)
+            memcpy(&list[pos].address, addr, alen);
+    }
+
+    return ucommon::Socket::sendbatch(so, list, count);
+}
+
 ssize_t UDPSocket::receive(void *buf, size_t len, bool reply)
 {
     struct sockaddr *addr = peer;
@@ -436,7 +451,7 @@ void UDPSocket::setPeer(const char *name)
 {
     struct addrinfo *list = ucommon::Socket::query(name, NULL, SOCK_DGRAM, IPPROTO_UDP);
     peer = ucommon::Socket::address(list);
-    freeaddrinfo(list);
+    ucommon::Socket::release(list);
 }
 
 void UDPSocket::connect(const char *service)
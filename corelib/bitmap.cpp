@@ -19,22 +19,207 @@
 #include <ucommon/export.h>
 #include <ucommon/bitmap.h>
 #include <stdlib.h>
+#include <string.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define BITMAP_X86_KERNELS
+#include <immintrin.h>
+#endif
+#endif
+
+#include "cpu.h"
+
 namespace ucommon {
 
+const size_t bitmap::npos = (size_t)(-1);
+
+#define BITMAP_AND  0
+#define BITMAP_OR   1
+#define BITMAP_XOR  2
+
+static inline unsigned lowbit(uint64_t bits)
+{
+#ifdef  __GNUC__
+    return (unsigned)__builtin_ctzll(bits);
+#else
+    unsigned pos = 0;
+    while(!(bits & 1)) {
+        bits >>= 1;
+        ++pos;
+    }
+    return pos;
+#endif
+}
+
+static size_t popcount(const uint64_t *words, size_t count)
+{
+    size_t total = 0;
+
+    while(count--) {
+        uint64_t bits = *(words++);
+        bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        total += (size_t)((bits * 0x0101010101010101ull) >> 56);
+    }
+    return total;
+}
+
+static size_t skip(const uint64_t *words, size_t pos, size_t end, uint64_t pattern)
+{
+    while(pos < end && words[pos] == pattern)
+        ++pos;
+    return pos;
+}
+
+static void merge(uint64_t *target, const uint64_t *source, size_t count, int op)
+{
+    size_t pos;
+
+    switch(op) {
+    case BITMAP_AND:
+        for(pos = 0; pos < count; ++pos)
+            target[pos] &= source[pos];
+        break;
+    case BITMAP_OR:
+        for(pos = 0; pos < count; ++pos)
+            target[pos] |= source[pos];
+        break;
+    default:
+        for(pos = 0; pos < count; ++pos)
+            target[pos] ^= source[pos];
+    }
+}
+
+/*
+ * Word kernels for x86, selected on first use.  Popcnt is not part of the
+ * base x86_64 instruction set, and avx2 covers four words per compare.
+ */
+#ifdef  BITMAP_X86_KERNELS
+
+__attribute__((target("popcnt")))
+static size_t popcount_popcnt(const uint64_t *words, size_t count)
+{
+    size_t total = 0;
+
+    while(count--)
+        total += (size_t)__builtin_popcountll(*(words++));
+    return total;
+}
+
+__attribute__((target("avx2")))
+static size_t skip_avx2(const uint64_t *words, size_t pos, size_t end, uint64_t pattern)
+{
+    __m256i match = _mm256_set1_epi64x((long long)pattern);
+
+    while(pos + 8 <= end) {
+        __m256i low = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(words + pos)), match);
+        __m256i high = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(words + pos + 4)), match);
+        if(_mm256_movemask_epi8(_mm256_and_si256(low, high)) != -1)
+            break;
+        pos += 8;
+    }
+    return skip(words, pos, end, pattern);
+}
+
+__attribute__((target("avx2")))
+static void merge_avx2(uint64_t *target, const uint64_t *source, size_t count, int op)
+{
+    size_t pos = 0;
+
+    while(pos + 4 <= count) {
+        __m256i left = _mm256_loadu_si256((const __m256i *)(target + pos));
+        __m256i right = _mm256_loadu_si256((const __m256i *)(source + pos));
+        switch(op) {
+        case BITMAP_AND:
+            left = _mm256_and_si256(left, right);
+            break;
+        case BITMAP_OR:
+            left = _mm256_or_si256(left, right);
+            break;
+        default:
+            left = _mm256_xor_si256(left, right);
+        }
+        _mm256_storeu_si256((__m256i *)(target + pos), left);
+        pos += 4;
+    }
+    merge(target + pos, source + pos, count - pos, op);
+}
+
+#endif
+
+#define KERNEL_UNKNOWN  0
+#define KERNEL_PORTABLE 1
+#define KERNEL_POPCNT   2
+#define KERNEL_AVX2     4
+
+static volatile unsigned kernels = KERNEL_UNKNOWN;
+
+static unsigned select_kernels(void)
+{
+    unsigned found = KERNEL_PORTABLE;
+
+#ifdef  BITMAP_X86_KERNELS
+    unsigned features = cpu_features();
+
+    if(features & CPU_POPCNT)
+        found |= KERNEL_POPCNT;
+    if(features & CPU_AVX2)
+        found |= KERNEL_AVX2;
+#endif
+
+    kernels = found;
+    return found;
+}
+
+static inline unsigned kernel(void)
+{
+    unsigned current = kernels;
+
+    if(current == KERNEL_UNKNOWN)
+        return select_kernels();
+    return current;
+}
+
+static size_t popcount_words(const uint64_t *words, size_t count)
+{
+#ifdef  BITMAP_X86_KERNELS
+    if(kernel() & KERNEL_POPCNT)
+        return popcount_popcnt(words, count);
+#endif
+    return popcount(words, count);
+}
+
+static size_t skip_words(const uint64_t *words, size_t pos, size_t end, uint64_t pattern)
+{
+#ifdef  BITMAP_X86_KERNELS
+    if(kernel() & KERNEL_AVX2)
+        return skip_avx2(words, pos, end, pattern);
+#endif
+    return skip(words, pos, end, pattern);
+}
+
+static void merge_words(uint64_t *target, const uint64_t *source, size_t count, int op)
+{
+#ifdef  BITMAP_X86_KERNELS
+    if(kernel() & KERNEL_AVX2) {
+        merge_avx2(target, source, count, op);
+        return;
+    }
+#endif
+    merge(target, source, count, op);
+}
+
 bitmap::bitmap(size_t count)
 {
-    size_t mem = count / 8;
     size = count;
     bus = BMALLOC;
 
-    if(count % 8)
-        ++mem;
-
-    addr.a = ::malloc(mem);
+    addr.a = ::malloc(((count + 63) / 64) * sizeof(uint64_t));
     clear();
 }
 
@@ -43,6 +228,7 @@ bitmap::bitmap(void *ptr, size_t count, bus_t access)
     assert(ptr != NULL);
     assert(access >= BMIN && access <= BMAX);
     addr.a = ptr;
+    size = count;
     bus = access;
 }
 
@@ -56,6 +242,7 @@ bitmap::~bitmap()
 unsigned bitmap::memsize(void) const
 {
     switch(bus) {
+    case BMALLOC:
     case B64:
         return 64;
     case B32:
@@ -81,6 +268,7 @@ void bitmap::set(size_t offset, bool bit)
         return;
 
     switch(bus) {
+    case BMALLOC:
     case B64:
         b64 = ((uint64_t)(1))<<rem;
         if(bit)
@@ -89,7 +277,7 @@ void bitmap::set(size_t offset, bool bit)
             addr.d[pos] &= ~b64;
         break;
     case B32:
-        b32 = 1<<rem;
+        b32 = ((uint32_t)(1))<<rem;
         if(bit)
             addr.l[pos] |= b32;
         else
@@ -123,42 +311,245 @@ bool bitmap::get(size_t offset) const
 
     switch(bus) {
 #if !defined(_MSC_VER) || _MSC_VER >= 1400
+    case BMALLOC:
     case B64:
-        return (addr.d[pos] & 1ll<<rem) > 0;
+        return (addr.d[pos] & ((uint64_t)(1))<<rem) != 0;
 #endif
     case B32:
-        return (addr.l[pos] & 1l<<rem) > 0;
+        return (addr.l[pos] & ((uint32_t)(1))<<rem) != 0;
     case B16:
-        return (addr.w[pos] & 1<<rem) > 0;
+        return (addr.w[pos] & 1<<rem) != 0;
     default:
-        return (addr.b[pos] & 1<<rem) > 0;
+        return (addr.b[pos] & 1<<rem) != 0;
     }
 }
 
 void bitmap::clear(void)
 {
     unsigned bs = memsize();
+    size_t words = (size + bs - 1) / bs;
+    size_t pos;
 
-    if(size % bs)
-        ++size;
+    if(bus == BMALLOC) {
+        memset(addr.a, 0, words * sizeof(uint64_t));
+        return;
+    }
 
-    while(size--) {
+    for(pos = 0; pos < words; ++pos) {
         switch(bus) {
 #if !defined(_MSC_VER) || _MSC_VER >= 1400
         case B64:
-            *(addr.d++) = 0ll;
+            addr.d[pos] = 0ll;
             break;
 #endif
         case B32:
-            *(addr.l++) = 0l;
+            addr.l[pos] = 0l;
+            break;
+        case B16:
+            addr.w[pos] = 0;
+            break;
+        default:
+            addr.b[pos] = 0;
+        }
+    }
+}
+
+uint64_t bitmap::valid(size_t chunk) const
+{
+    size_t first = chunk * 64;
+
+    if(first >= size)
+        return 0;
+    if(size - first >= 64)
+        return ~((uint64_t)0);
+    return (((uint64_t)1) << (size - first)) - 1;
+}
+
+uint64_t bitmap::load(size_t chunk) const
+{
+    unsigned bs = memsize();
+    size_t words = (size + bs - 1) / bs;
+    size_t pos = chunk * (64 / bs);
+    uint64_t bits = 0;
+    unsigned shift;
+
+    if(direct())
+        return pos < words ? addr.d[pos] : 0;
+
+    for(shift = 0; shift < 64 && pos < words; shift += bs, ++pos) {
+        switch(bus) {
+        case B32:
+            bits |= ((uint64_t)addr.l[pos]) << shift;
             break;
         case B16:
-            *(addr.w++) = 0;
+            bits |= ((uint64_t)addr.w[pos]) << shift;
+            break;
+        default:
+            bits |= ((uint64_t)addr.b[pos]) << shift;
+        }
+    }
+    return bits;
+}
+
+void bitmap::save(size_t chunk, uint64_t bits, uint64_t mask)
+{
+    unsigned bs = memsize();
+    size_t words = (size + bs - 1) / bs;
+    size_t pos = chunk * (64 / bs);
+    uint64_t wmask = (bs == 64) ? ~((uint64_t)0) : ((((uint64_t)1) << bs) - 1);
+    unsigned shift;
+
+    if(direct()) {
+        if(pos < words)
+            addr.d[pos] = (addr.d[pos] & ~mask) | (bits & mask);
+        return;
+    }
+
+    for(shift = 0; shift < 64 && pos < words; shift += bs, ++pos) {
+        uint64_t change = (mask >> shift) & wmask;
+        uint64_t value = (bits >> shift) & change;
+        if(!change)
+            continue;
+        switch(bus) {
+        case B32:
+            addr.l[pos] = (uint32_t)((addr.l[pos] & ~change) | value);
+            break;
+        case B16:
+            addr.w[pos] = (uint16_t)((addr.w[pos] & ~change) | value);
+            break;
+        default:
+            addr.b[pos] = (uint8_t)((addr.b[pos] & ~change) | value);
+        }
+    }
+}
+
+void bitmap::set(size_t offset, size_t count, bool value)
+{
+    uint64_t fill = value ? ~((uint64_t)0) : 0;
+    size_t last, chunk, end;
+
+    if(offset >= size || !count)
+        return;
+
+    if(count > size - offset)
+        count = size - offset;
+
+    last = offset + count - 1;
+    chunk = offset / 64;
+    end = last / 64;
+
+    if(chunk == end) {
+        uint64_t mask = (~((uint64_t)0) << (offset % 64)) & (~((uint64_t)0) >> (63 - last % 64));
+        save(chunk, fill, mask);
+        return;
+    }
+
+    save(chunk, fill, ~((uint64_t)0) << (offset % 64));
+    if(direct()) {
+        memset(addr.d + chunk + 1, value ? 0xff : 0, (end - chunk - 1) * sizeof(uint64_t));
+        chunk = end - 1;
+    }
+    while(++chunk < end)
+        save(chunk, fill, ~((uint64_t)0));
+    save(end, fill, ~((uint64_t)0) >> (63 - last % 64));
+}
+
+size_t bitmap::scan(size_t offset, bool value) const
+{
+    uint64_t flip = value ? 0 : ~((uint64_t)0);
+    size_t chunks = (size + 63) / 64;
+    size_t chunk = offset / 64;
+    uint64_t bits;
+
+    if(offset >= size)
+        return npos;
+
+    bits = (load(chunk) ^ flip) & (~((uint64_t)0) << (offset % 64));
+    while(!bits) {
+        if(++chunk >= chunks)
+            return npos;
+        if(direct()) {
+            chunk = skip_words(addr.d, chunk, chunks, flip);
+            if(chunk >= chunks)
+                return npos;
+        }
+        bits = load(chunk) ^ flip;
+    }
+
+    offset = chunk * 64 + lowbit(bits);
+    if(offset >= size)
+        return npos;
+    return offset;
+}
+
+size_t bitmap::count(void) const
+{
+    size_t chunks = (size + 63) / 64;
+    size_t total = 0;
+    size_t chunk = 0;
+    uint64_t tail;
+
+    if(!chunks)
+        return 0;
+
+    if(direct()) {
+        total = popcount_words(addr.d, chunks - 1);
+        chunk = chunks - 1;
+    }
+
+    while(chunk < chunks) {
+        tail = load(chunk) & valid(chunk);
+        total += popcount(&tail, 1);
+        ++chunk;
+    }
+    return total;
+}
+
+void bitmap::merge(const bitmap& source, int op)
+{
+    size_t chunks = (size + 63) / 64;
+    size_t common = (source.size < size ? source.size : size) / 64;
+    size_t chunk = 0;
+
+    if(direct() && source.direct() && common) {
+        merge_words(addr.d, source.addr.d, common, op);
+        chunk = common;
+    }
+
+    while(chunk < chunks) {
+        uint64_t left = load(chunk);
+        uint64_t right = source.load(chunk) & source.valid(chunk);
+        switch(op) {
+        case BITMAP_AND:
+            left &= right;
+            break;
+        case BITMAP_OR:
+            left |= right;
             break;
         default:
-            *(addr.b++) = 0;
+            left ^= right;
         }
+        save(chunk, left, valid(chunk));
+        ++chunk;
     }
 }
 
+bitmap& bitmap::operator&=(const bitmap& source)
+{
+    merge(source, BITMAP_AND);
+    return *this;
+}
+
+bitmap& bitmap::operator|=(const bitmap& source)
+{
+    merge(source, BITMAP_OR);
+    return *this;
+}
+
+bitmap& bitmap::operator^=(const bitmap& source)
+{
+    merge(source, BITMAP_XOR);
+    return *this;
+}
+
 } // namespace ucommon
@@ -0,0 +1,83 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+
+/*
+ * Processor features the x86 kernels of the library are chosen by.  This
+ * is shared by the core and secure libraries, so it is inline here rather
+ * than exported.  Callers probe once and keep the kernels they select.
+ */
+
+#ifndef _UCOMMON_CPU_H_
+#define _UCOMMON_CPU_H_
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define CPU_X86_PROBE
+#include <cpuid.h>
+#endif
+#endif
+
+namespace ucommon {
+
+#define CPU_POPCNT  0x01
+#define CPU_SSSE3   0x02
+#define CPU_SSE41   0x04
+#define CPU_AVX2    0x08
+#define CPU_SHA     0x10
+
+__LOCAL inline unsigned cpu_features(void)
+{
+    unsigned found = 0;
+
+#ifdef  CPU_X86_PROBE
+    unsigned eax, ebx, ecx, edx;
+    unsigned max = __get_cpuid_max(0, NULL);
+    bool ymm = false;
+
+    if(max >= 1) {
+        __cpuid(1, eax, ebx, ecx, edx);
+        if(ecx & (1 << 23))
+            found |= CPU_POPCNT;
+        if(ecx & (1 << 9))
+            found |= CPU_SSSE3;
+        if(ecx & (1 << 19))
+            found |= CPU_SSE41;
+
+        // avx2 also needs the os to save ymm state
+        if(ecx & (1 << 27)) {
+            uint32_t xlo, xhi;
+            __asm__ volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+            ymm = (xlo & 0x06) == 0x06;
+        }
+    }
+
+    if(max >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if((ebx & (1 << 5)) && ymm)
+            found |= CPU_AVX2;
+        if(ebx & (1 << 29))
+            found |= CPU_SHA;
+    }
+#endif
+
+    return found;
+}
+
+} // namespace ucommon
+
+#endif
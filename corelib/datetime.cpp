@@ -44,38 +44,160 @@ const size_t Date::sz_string = 11;
 const size_t Time::sz_string = 9;
 const size_t DateTime::sz_string = 20;
 
-#ifdef  HAVE_LOCALTIME_R
+// the local time at the start of the most recently converted minute,
+// shared between threads under a sequence count.  Writers claim the
+// count with a cas and simply skip the update if another is active.
+#if defined(__ATOMIC_ACQUIRE)
+#define clock_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define clock_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define CLOCK_CACHE
+#elif defined(__GNUC__)
+#define clock_acquire() __sync_synchronize()
+#define clock_release() __sync_synchronize()
+#define CLOCK_CACHE
+#endif
 
-tm_t *DateTime::local(const time_t *now)
+static struct {
+    volatile unsigned sequence;
+    time_t base;
+    long offset;
+    tm_t local;
+} clockcache;
+
+#ifndef HAVE_LOCALTIME_R
+static mutex_t lockflag;
+#endif
+
+static time_t civil_days(long year, long month, long day)
 {
-    tm_t *result, *dt = new tm_t;
-    time_t tmp;
+    year -= (month <= 2);
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yoe = year - era * 400;
+    long doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (time_t)era * 146097 + doe - 719468;
+}
 
-    if(!now) {
-        now = &tmp;
-        time(&tmp);
-    }
+static long civil_offset(const tm_t *dt, time_t now)
+{
+    time_t local = civil_days(dt->tm_year + 1900l, dt->tm_mon + 1l, dt->tm_mday) * 86400l +
+        dt->tm_hour * 3600l + dt->tm_min * 60l + dt->tm_sec;
+    return (long)(local - now);
+}
+
+static bool cache_get(time_t now, tm_t *dt, long *offset)
+{
+#ifdef CLOCK_CACHE
+    unsigned seq = clockcache.sequence;
+    clock_acquire();
+    if(!seq || (seq & 1))
+        return false;
+
+    time_t base = clockcache.base;
+    long off = clockcache.offset;
+    *dt = clockcache.local;
+    clock_acquire();
+    if(clockcache.sequence != seq || now < base || now - base >= 60)
+        return false;
 
-    result = localtime_r(now, dt);
+    dt->tm_sec = (int)(now - base);
+    if(offset)
+        *offset = off;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void cache_put(time_t now, const tm_t *dt, long offset)
+{
+#ifdef CLOCK_CACHE
+    unsigned seq = clockcache.sequence;
+    if((seq & 1) || dt->tm_sec > 59 || !__sync_bool_compare_and_swap(&clockcache.sequence, seq, seq + 1))
+        return;
+
+    clockcache.base = now - dt->tm_sec;
+    clockcache.offset = offset;
+    clockcache.local = *dt;
+    clockcache.local.tm_sec = 0;
+    clock_release();
+    clockcache.sequence = seq + 2;
+#endif
+}
+
+static tm_t *convert(time_t now, tm_t *dt, long *offset)
+{
+    if(cache_get(now, dt, offset))
+        return dt;
+
+#ifdef  HAVE_LOCALTIME_R
+    if(!localtime_r(&now, dt))
+        return NULL;
+#else
+    lockflag.acquire();
+    tm_t *result = localtime(&now);
     if(result)
-        return result;
+        *dt = *result;
+    lockflag.release();
+    if(!result)
+        return NULL;
+#endif
+
+    long off = civil_offset(dt, now);
+    if(offset)
+        *offset = off;
+    cache_put(now, dt, off);
+    return dt;
+}
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_REALTIME_COARSE)
+time_t DateTime::now(void)
+{
+    struct timespec ts;
+
+    if(!clock_gettime(CLOCK_REALTIME_COARSE, &ts))
+        return ts.tv_sec;
+    return time(NULL);
+}
+#else
+time_t DateTime::now(void)
+{
+    return time(NULL);
+}
+#endif
+
+tm_t *DateTime::local(const time_t *now, tm_t *dt)
+{
+    return convert(now ? *now : DateTime::now(), dt, NULL);
+}
+
+long DateTime::offset(const time_t *now)
+{
+    tm_t dt;
+    long off = 0;
+
+    convert(now ? *now : DateTime::now(), &dt, &off);
+    return off;
+}
+
+#ifdef  HAVE_LOCALTIME_R
+
+tm_t *DateTime::local(const time_t *now)
+{
+    tm_t *dt = new tm_t;
+
+    if(local(now, dt))
+        return dt;
     delete dt;
     return NULL;
 }
 
 tm_t *DateTime::gmt(const time_t *now)
 {
-    tm_t *result, *dt = new tm_t;
-    time_t tmp;
+    tm_t *dt = new tm_t;
 
-    if(!now) {
-        now = &tmp;
-        time(&tmp);
-    }
-
-    result = gmtime_r(now, dt);
-    if(result)
-        return result;
+    if(gmt(now, dt))
+        return dt;
     delete dt;
     return NULL;
 }
@@ -87,7 +209,6 @@ void DateTime::release(tm_t *dt)
 }
 
 #else
-static mutex_t lockflag;
 
 tm_t *DateTime::local(const time_t *now)
 {
@@ -133,6 +254,53 @@ void DateTime::release(tm_t *dt)
 
 #endif
 
+tm_t *DateTime::gmt(const time_t *now, tm_t *dt)
+{
+    time_t tmp = now ? *now : DateTime::now();
+
+#ifdef  HAVE_GMTIME_R
+    return gmtime_r(&tmp, dt);
+#else
+    lockflag.acquire();
+    tm_t *result = gmtime(&tmp);
+    if(result)
+        *dt = *result;
+    lockflag.release();
+    return result ? dt : NULL;
+#endif
+}
+
+// julian day number to and from time_t, in local time
+static time_t julian_time(long julian, long seconds)
+{
+    time_t utc = (time_t)(julian - 2440588l) * 86400l + seconds;
+    time_t guess = utc - DateTime::offset(&utc);
+    return utc - DateTime::offset(&guess);
+}
+
+static void julian_civil(long julian, long& year, long& month, long& day)
+{
+// The following conversion algorithm is due to
+// Henry F. Fliegel and Thomas C. Van Flandern:
+
+    long i, j, k, l, n;
+
+    l = julian + 68569l;
+    n = 4l * l / 146097l;
+    l = l - (146097l * n + 3l) / 4l;
+    i = (long)((int64_t)4000 * (l + 1l) / 1461001l);
+    l = l - 1461l * i / 4l + 31l;
+    j = 80l * l / 2447l;
+    k = l - 2447l * j / 80l;
+    l = j / 11l;
+    j = j + 2l - 12l * l;
+    i = 100l * (n - 49l) + i + l;
+
+    year = i;
+    month = j;
+    day = k;
+}
+
 Date::Date()
 {
     set();
@@ -150,9 +318,12 @@ Date::Date(const tm_t *dt)
 
 Date::Date(const time_t tm)
 {
-    tm_t *dt = DateTime::local(&tm);
-    set(dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday);
-    DateTime::release(dt);
+    tm_t dt;
+
+    if(DateTime::local(&tm, &dt))
+        set(dt.tm_year + 1900, dt.tm_mon + 1, dt.tm_mday);
+    else
+        julian = 0x7fffffffl;
 }
 
 Date::Date(const char *str, size_t size)
@@ -166,15 +337,18 @@ Date::~Date()
 
 void Date::set()
 {
-    tm_t *dt = DateTime::local();
+    tm_t dt;
 
-    set(dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday);
-    DateTime::release(dt);
+    if(DateTime::local(NULL, &dt))
+        set(dt.tm_year + 1900, dt.tm_mon + 1, dt.tm_mday);
+    else
+        julian = 0x7fffffffl;
 }
 
 void Date::set(const char *str, size_t size)
 {
-    tm_t *dt = DateTime::local();
+    tm_t now;
+    tm_t *dt = DateTime::local(NULL, &now);
     int nyear = 0;
     const char *mstr = str;
     const char *dstr = str;
@@ -223,11 +397,9 @@ void Date::set(const char *str, size_t size)
     }
     else {
         julian = 0x7fffffffl;
-        DateTime::release(dt);
         return;
     }
 
-    DateTime::release(dt);
     ZNumber nmonth((char*)mstr, 2);
     ZNumber nday((char*)dstr, 2);
     set(nyear, nmonth(), nday());
@@ -251,43 +423,34 @@ bool Date::is_valid(void) const
 
 time_t Date::timeref(void) const
 {
-    char buf[11];
-    tm_t dt;
-    memset(&dt, 0, sizeof(tm_t));
-    put(buf);
-    Number nyear(buf, 4);
-    Number nmonth(buf + 5, 2);
-    Number nday(buf + 8, 2);
-
-    dt.tm_year = nyear() - 1900;
-    dt.tm_mon = nmonth() - 1;
-    dt.tm_mday = nday();
+    if(!is_valid())
+        return (time_t)-1;
 
-    return mktime(&dt); // to fill in day of week etc.
+    return julian_time(julian, 0);
 }
 
 int Date::year(void) const
 {
-    char buf[11];
-    put(buf);
-    Number num(buf, 4);
-    return num();
+    long nyear, nmonth, nday;
+
+    julian_civil(julian, nyear, nmonth, nday);
+    return (int)nyear;
 }
 
 unsigned Date::month(void) const
 {
-    char buf[11];
-    put(buf);
-    Number num(buf + 5, 2);
-    return num();
+    long nyear, nmonth, nday;
+
+    julian_civil(julian, nyear, nmonth, nday);
+    return (unsigned)nmonth;
 }
 
 unsigned Date::day(void) const
 {
-    char buf[11];
-    put(buf);
-    Number num(buf + 8, 2);
-    return num();
+    long nyear, nmonth, nday;
+
+    julian_civil(julian, nyear, nmonth, nday);
+    return (unsigned)nday;
 }
 
 unsigned Date::dow(void) const
@@ -307,9 +470,10 @@ String Date::operator()() const
 
 long Date::get(void) const
 {
-    char buf[11];
-    put(buf);
-    return atol(buf) * 10000 + atol(buf + 5) * 100 + atol(buf + 8);
+    long nyear, nmonth, nday;
+
+    julian_civil(julian, nyear, nmonth, nday);
+    return nyear * 10000l + nmonth * 100l + nday;
 }
 
 Date& Date::operator++()
@@ -408,8 +572,9 @@ Date& Date::operator=(const Date& date)
 
 const char *Date::put(char *buffer) const
 {
-// The following conversion algorithm is due to
-// Henry F. Fliegel and Thomas C. Van Flandern:
+    long y, m, d;
+
+    julian_civil(julian, y, m, d);
 
     ZNumber nyear(buffer, 4);
     buffer[4] = '-';
@@ -417,21 +582,9 @@ const char *Date::put(char *buffer) const
     buffer[7] = '-';
     ZNumber nday(buffer + 8, 2);
 
-    double i, j, k, l, n;
-
-    l = julian + 68569.0;
-    n = int( 4 * l / 146097.0);
-    l = l - int( (146097.0 * n + 3)/ 4 );
-    i = int( 4000.0 * (l+1)/1461001.0);
-    l = l - int(1461.0*i/4.0) + 31.0;
-    j = int( 80 * l/2447.0);
-    k = l - int( 2447.0 * j / 80.0);
-    l = int(j/11);
-    j = j+2-12*l;
-    i = 100*(n - 49) + i + l;
-    nyear = int(i);
-    nmonth = int(j);
-    nday = int(k);
+    nyear = y;
+    nmonth = m;
+    nday = d;
 
     buffer[10] = '\0';
     return buffer;
@@ -454,9 +607,12 @@ Time::Time(const tm_t *dt)
 
 Time::Time(const time_t tm)
 {
-    tm_t *dt = DateTime::local(&tm);
-    set(dt->tm_hour, dt->tm_min, dt->tm_sec);
-    DateTime::release(dt);
+    tm_t dt;
+
+    if(DateTime::local(&tm, &dt))
+        set(dt.tm_hour, dt.tm_min, dt.tm_sec);
+    else
+        seconds = -1;
 }
 
 Time::Time(const char *str, size_t size)
@@ -475,9 +631,12 @@ Time::~Time()
 
 void Time::set(void)
 {
-    tm_t *dt = DateTime::local();
-    set(dt->tm_hour, dt->tm_min, dt->tm_sec);
-    DateTime::release(dt);
+    tm_t dt;
+
+    if(DateTime::local(NULL, &dt))
+        set(dt.tm_hour, dt.tm_min, dt.tm_sec);
+    else
+        seconds = -1;
 }
 
 bool Time::is_valid(void) const
@@ -668,13 +827,9 @@ Time& Time::operator=(const Time& time)
     return *this;
 }
 
-DateTime::DateTime(const time_t tm)
-{
-    tm_t *dt = DateTime::local();
-    Date::set(dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday);
-    Time::set(dt->tm_hour, dt->tm_min, dt->tm_sec);
-    DateTime::release(dt);
-}
+DateTime::DateTime(const time_t tm) :
+Date(tm), Time(tm)
+{}
 
 DateTime::DateTime(const tm_t *dt) :
 Date(dt), Time(dt)
@@ -730,12 +885,10 @@ DateTime::DateTime(int year, unsigned month, unsigned day,
     Date(year, month, day), Time(hour, minute, second)
 {}
 
-DateTime::DateTime() : Date(), Time()
+DateTime::DateTime() :
+Date(0, 0, 0), Time(0, 0, 0)
 {
-    tm_t *dt = DateTime::local();
-    Time::set(dt->tm_hour, dt->tm_min, dt->tm_sec);
-    Date::set(dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday);
-    DateTime::release(dt);
+    set();
 }
 
 DateTime::~DateTime()
@@ -744,8 +897,16 @@ DateTime::~DateTime()
 
 void DateTime::set()
 {
-    Date::set();
-    Time::set();
+    tm_t dt;
+
+    if(local(NULL, &dt)) {
+        Date::set(dt.tm_year + 1900, dt.tm_mon + 1, dt.tm_mday);
+        Time::set(dt.tm_hour, dt.tm_min, dt.tm_sec);
+    }
+    else {
+        julian = 0x7fffffffl;
+        seconds = -1;
+    }
 }
 
 bool DateTime::is_valid(void) const
@@ -763,28 +924,10 @@ const char *DateTime::put(char *buf) const
 
 time_t DateTime::get(void) const
 {
-    char buf[11];
-    tm_t dt;
-    memset(&dt, 0, sizeof(dt));
-
-    Date::put(buf);
-    ZNumber nyear(buf, 4);
-    ZNumber nmonth(buf + 5, 2);
-    ZNumber nday(buf + 8, 2);
-    dt.tm_year = nyear() - 1900;
-    dt.tm_mon = nmonth() - 1;
-    dt.tm_mday = nday();
+    if(!is_valid())
+        return (time_t)-1;
 
-    Time::put(buf);
-    ZNumber nhour(buf, 2);
-    ZNumber nminute(buf + 2, 2);
-    ZNumber nsecond(buf + 4, 2);
-    dt.tm_hour = nhour();
-    dt.tm_min = nminute();
-    dt.tm_sec = nsecond();
-    dt.tm_isdst = -1;
-
-    return mktime(&dt);
+    return julian_time(julian, seconds);
 }
 
 DateTime& DateTime::operator=(const DateTime& datetime)
@@ -870,19 +1013,24 @@ bool DateTime::operator!() const
     return !(Date::is_valid() && Time::is_valid());
 }
 
+DateTime::operator bool() const
+{
+    return Date::is_valid() && Time::is_valid();
+}
+
 
 String DateTime::format(const char *text) const
 {
     char buffer[64];
     size_t last;
     time_t t;
-    tm_t *tbp;
+    tm_t dt;
     String retval;
 
     t = get();
-    tbp = local(&t);
-    last = ::strftime(buffer, 64, text, tbp);
-    release(tbp);
+    if(!local(&t, &dt))
+        return retval;
+    last = ::strftime(buffer, 64, text, &dt);
 
     buffer[last] = '\0';
     retval = buffer;
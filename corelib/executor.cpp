@@ -0,0 +1,725 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ucommon-config.h>
+#include <ucommon/export.h>
+#include <ucommon/linked.h>
+#include <ucommon/thread.h>
+#include <ucommon/timers.h>
+#include <ucommon/executor.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef  HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(__linux__) && defined(HAVE_DIRENT_H)
+#include <dirent.h>
+#endif
+#ifdef  HAVE_PTHREAD_SETAFFINITY_NP
+#include <sched.h>
+#endif
+
+namespace ucommon {
+
+#if defined(_MSWINDOWS_) && !defined(__GNUC__)
+#define sync_cas(p, o, v)   (InterlockedCompareExchange((LONG volatile *)(p), (LONG)(v), (LONG)(o)) == (LONG)(o))
+#define sync_add(p, v)      ((unsigned)InterlockedExchangeAdd((LONG volatile *)(p), (LONG)(v)))
+#define sync_load(p)        (MemoryBarrier(), *(p))
+#define sync_store(p, v)    (MemoryBarrier(), *(p) = (v))
+#define sync_fence()        MemoryBarrier()
+#elif defined(__ATOMIC_ACQUIRE)
+#define sync_cas(p, o, v)   __sync_bool_compare_and_swap(p, o, v)
+#define sync_add(p, v)      __sync_fetch_and_add(p, v)
+#define sync_load(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define sync_store(p, v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define sync_fence()        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define sync_cas(p, o, v)   __sync_bool_compare_and_swap(p, o, v)
+#define sync_add(p, v)      __sync_fetch_and_add(p, v)
+#define sync_load(p)        (__sync_synchronize(), *(p))
+#define sync_store(p, v)    (__sync_synchronize(), *(p) = (v))
+#define sync_fence()        __sync_synchronize()
+#endif
+
+// each worker deque is a fixed ring; a worker that fills its own ring runs
+// further spawned tasks directly instead.
+
+#define DEQUE_SIZE      1024
+#define DEQUE_MASK      (DEQUE_SIZE - 1)
+
+#define TASK_IDLE       0
+#define TASK_QUEUED     1
+#define TASK_DONE       2
+
+// The worker deque is the Chase-Lev work stealing deque.  Only the owning
+// worker pushes and takes at the bottom, while any worker may steal from
+// the top.  The owner and thieves only race for the last task, which is
+// settled by whoever advances top.
+
+class __LOCAL Executor::worker : public JoinableThread
+{
+public:
+    Executor *pool;
+    int cpu;
+    unsigned node;
+    unsigned seed;
+    volatile long top;
+    char pad[64];
+    volatile long bottom;
+    task *volatile ring[DEQUE_SIZE];
+
+    worker(Executor *executor, size_t stack);
+
+    ~worker() {join();}
+
+    bool push(task *job);
+    task *take(void);
+    task *steal(void);
+    unsigned random(void);
+    bool is_empty(void) const;
+    void run(void);
+};
+
+class __LOCAL Executor::splitter : public Executor::task
+{
+public:
+    Executor *pool;
+    range *body;
+    size_t first, last, grain;
+    volatile unsigned *pending;
+
+    splitter(Executor *executor, range *object, size_t from, size_t to, size_t size, volatile unsigned *count, bool release = true);
+
+    void run(void);
+    void completed(void);
+};
+
+class __LOCAL Executor::delayed : public TimerQueue::event
+{
+public:
+    Executor *pool;
+    task *job;
+    bool fired;
+
+    delayed(Executor *executor, task *object, timeout_t timeout);
+
+    void expired(void);
+};
+
+Executor::worker::worker(Executor *executor, size_t stack) :
+JoinableThread(stack)
+{
+    pool = executor;
+    cpu = -1;
+    node = 0;
+    seed = (unsigned)((size_t)this >> 4) | 1;
+    top = bottom = 0;
+}
+
+bool Executor::worker::push(task *job)
+{
+    long b = bottom;
+    long t = sync_load(&top);
+
+    if(b - t >= DEQUE_SIZE)
+        return false;
+
+    ring[b & DEQUE_MASK] = job;
+    sync_store(&bottom, b + 1);
+    return true;
+}
+
+Executor::task *Executor::worker::take(void)
+{
+    long b = bottom - 1;
+    long t;
+    task *job;
+
+    bottom = b;
+    sync_fence();
+    t = top;
+
+    if(t > b) {
+        bottom = b + 1;
+        return NULL;
+    }
+
+    job = ring[b & DEQUE_MASK];
+    if(t == b) {
+        if(!sync_cas(&top, t, t + 1))
+            job = NULL;
+        bottom = b + 1;
+    }
+    return job;
+}
+
+Executor::task *Executor::worker::steal(void)
+{
+    long t = sync_load(&top);
+    sync_fence();
+    long b = sync_load(&bottom);
+
+    if(t >= b)
+        return NULL;
+
+    task *job = ring[t & DEQUE_MASK];
+    if(!sync_cas(&top, t, t + 1))
+        return NULL;
+
+    return job;
+}
+
+unsigned Executor::worker::random(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+bool Executor::worker::is_empty(void) const
+{
+    return sync_load(&bottom) <= sync_load(&top);
+}
+
+void Executor::worker::run(void)
+{
+    map();
+
+#ifdef  HAVE_PTHREAD_SETAFFINITY_NP
+    if(cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    }
+#endif
+
+    for(;;) {
+        task *job = pool->acquire(this);
+        if(job) {
+            pool->execute(job);
+            pool->service();
+        }
+        else if(!pool->rest())
+            break;
+    }
+}
+
+Executor::splitter::splitter(Executor *executor, range *object, size_t from, size_t to, size_t size, volatile unsigned *count, bool release) :
+task(release)
+{
+    pool = executor;
+    body = object;
+    first = from;
+    last = to;
+    grain = size;
+    pending = count;
+}
+
+void Executor::splitter::run(void)
+{
+    // keep halving down to the grain, pushing each upper half where idle
+    // workers may steal it while we go on with the lower half.
+    while(last - first > grain) {
+        size_t mid = first + (last - first) / 2;
+        sync_add(pending, 1);
+        pool->submit(new splitter(pool, body, mid, last, grain, pending));
+        last = mid;
+    }
+    body->run(first, last);
+}
+
+void Executor::splitter::completed(void)
+{
+    sync_add(pending, (unsigned)-1);
+}
+
+Executor::delayed::delayed(Executor *executor, task *object, timeout_t timeout) :
+TimerQueue::event(timeout)
+{
+    pool = executor;
+    job = object;
+    fired = false;
+}
+
+void Executor::delayed::expired(void)
+{
+    fired = true;
+    job->state = TASK_IDLE;
+    pool->submit(job);
+}
+
+void Executor::timers::modify(void)
+{
+    guard.lock();
+}
+
+void Executor::timers::update(void)
+{
+    guard.release();
+    owner->retime();
+}
+
+Executor::task::task(bool autorelease)
+{
+    next = NULL;
+    owner = NULL;
+    state = TASK_IDLE;
+    release = autorelease;
+}
+
+Executor::task::~task()
+{
+    assert(state != TASK_QUEUED);
+}
+
+void Executor::task::completed(void)
+{
+}
+
+bool Executor::task::wait(timeout_t timeout)
+{
+    assert(!release);
+
+    if(sync_load(&state) != TASK_QUEUED)
+        return true;
+
+    return owner->until(&state, TASK_DONE, timeout);
+}
+
+bool Executor::task::is_done(void) const
+{
+    return sync_load(&state) == TASK_DONE;
+}
+
+bool Executor::task::is_pending(void) const
+{
+    return sync_load(&state) == TASK_QUEUED;
+}
+
+Executor::range::~range()
+{
+}
+
+Executor::Executor(unsigned size, placement_t place, size_t stack) :
+Conditional()
+{
+    unsigned cpu, online = cpus();
+    unsigned *order = NULL;
+
+    if(!size)
+        size = online;
+
+    count = size;
+    placement = place;
+    first = last = NULL;
+    injected = idle = waiters = outstanding = timing = 0;
+    stopping = false;
+    due = 0;
+    delays.owner = this;
+
+    // cpus in the order workers are placed on them; for numa placement
+    // this fills each node before moving to the next.
+    if(place != FLOATING) {
+        order = new unsigned[online];
+        for(cpu = 0; cpu < online; ++cpu)
+            order[cpu] = cpu;
+        if(place == NODES) {
+            unsigned *nodes = new unsigned[online];
+            for(cpu = 0; cpu < online; ++cpu)
+                nodes[cpu] = node(cpu);
+            for(unsigned pos = 1; pos < online; ++pos) {
+                unsigned value = order[pos], back = pos;
+                while(back && nodes[order[back - 1]] > nodes[value]) {
+                    order[back] = order[back - 1];
+                    --back;
+                }
+                order[back] = value;
+            }
+            delete[] nodes;
+        }
+    }
+
+    workers = new worker *[count];
+    for(unsigned pos = 0; pos < count; ++pos) {
+        workers[pos] = new worker(this, stack);
+        if(order) {
+            workers[pos]->cpu = order[pos % online];
+            if(place == NODES)
+                workers[pos]->node = node(workers[pos]->cpu);
+        }
+    }
+    delete[] order;
+
+    for(unsigned pos = 0; pos < count; ++pos)
+        workers[pos]->start();
+}
+
+Executor::~Executor()
+{
+    // drop delayed tasks that have not started yet
+    delays.guard.lock();
+    linked_pointer<delayed> dp = delays.begin();
+    while(dp) {
+        delayed *event = *dp;
+        dp.next();
+        if(!event->fired) {
+            event->job->state = TASK_IDLE;
+            if(event->job->release)
+                delete event->job;
+        }
+        delete event;
+    }
+    delays.guard.release();
+
+    until(&outstanding, 0, Timer::inf);
+
+    lock();
+    stopping = true;
+    broadcast();
+    unlock();
+
+    for(unsigned pos = 0; pos < count; ++pos)
+        delete workers[pos];
+
+    delete[] workers;
+}
+
+unsigned Executor::cpus(void)
+{
+#if defined(_MSWINDOWS_)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (unsigned)info.dwNumberOfProcessors;
+#elif defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if(online < 1)
+        return 1;
+    return (unsigned)online;
+#else
+    return 1;
+#endif
+}
+
+unsigned Executor::node(unsigned cpu)
+{
+    unsigned id = 0;
+
+#if defined(__linux__) && defined(HAVE_DIRENT_H)
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", cpu);
+    DIR *dir = opendir(path);
+    if(!dir)
+        return 0;
+
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(!strncmp(entry->d_name, "node", 4) && sscanf(entry->d_name + 4, "%u", &id) == 1)
+            break;
+        id = 0;
+    }
+    closedir(dir);
+#endif
+
+    return id;
+}
+
+Executor::worker *Executor::self(void) const
+{
+    Thread *current = Thread::get();
+
+    if(!current)
+        return NULL;
+
+    for(unsigned pos = 0; pos < count; ++pos) {
+        if(workers[pos] == current)
+            return workers[pos];
+    }
+    return NULL;
+}
+
+Executor::task *Executor::acquire(worker *thread)
+{
+    task *job = thread->take();
+
+    if(job)
+        return job;
+
+    if(sync_load(&injected)) {
+        lock();
+        job = first;
+        if(job) {
+            first = job->next;
+            if(!first)
+                last = NULL;
+            sync_add(&injected, (unsigned)-1);
+        }
+        unlock();
+        if(job)
+            return job;
+    }
+
+    // steal from workers on our own node first, then from any other
+    unsigned start = thread->random();
+    for(unsigned pass = 0; pass < 2; ++pass) {
+        for(unsigned pos = 0; pos < count; ++pos) {
+            worker *victim = workers[(start + pos) % count];
+            if(victim == thread || (victim->node == thread->node) != (pass == 0))
+                continue;
+            job = victim->steal();
+            if(job)
+                return job;
+        }
+    }
+    return NULL;
+}
+
+void Executor::execute(task *job)
+{
+    job->run();
+    job->completed();
+
+    if(job->release) {
+        job->state = TASK_DONE;
+        delete job;
+    }
+    else
+        sync_store(&job->state, (unsigned)TASK_DONE);
+
+    sync_add(&outstanding, (unsigned)-1);
+    notify();
+}
+
+void Executor::notify(void)
+{
+    sync_fence();
+    if(!sync_load(&waiters))
+        return;
+
+    finished.lock();
+    finished.broadcast();
+    finished.unlock();
+}
+
+void Executor::retime(void)
+{
+    // busy workers check the deadline between tasks
+    due = 1;
+
+    lock();
+    ++timing;
+    if(idle)
+        broadcast();
+    unlock();
+}
+
+timeout_t Executor::expire(void)
+{
+    timeout_t timeout;
+
+    if(!delays.begin())
+        return Timer::inf;
+
+    delays.guard.lock();
+    timeout = delays.TimerQueue::expire();
+    if(timeout == Timer::inf)
+        due = 0;
+    else
+        due = Timer::ticks() + (Timer::tick_t)timeout * 10000;
+
+    linked_pointer<delayed> dp = delays.begin();
+    while(dp) {
+        delayed *event = *dp;
+        dp.next();
+        if(event->fired)
+            delete event;
+    }
+    delays.guard.release();
+    return timeout;
+}
+
+// delayed tasks are started by workers between tasks once their deadline
+// passes, so they fire even while no worker is ever idle.
+
+void Executor::service(void)
+{
+    Timer::tick_t deadline = due;
+
+    if(deadline && Timer::ticks() >= deadline)
+        expire();
+}
+
+bool Executor::rest(void)
+{
+    unsigned timed = sync_load(&timing);
+    timeout_t timeout = expire();
+    bool active = true;
+
+    lock();
+    sync_add(&idle, 1);
+
+    if(stopping && !outstanding)
+        active = false;
+    else if(!injected && timing == timed) {
+        // a push to any deque after we became idle signals us
+        bool empty = true;
+        for(unsigned pos = 0; empty && pos < count; ++pos) {
+            if(!workers[pos]->is_empty())
+                empty = false;
+        }
+        if(empty && timeout == Timer::inf)
+            Conditional::wait();
+        else if(empty && timeout)
+            Conditional::wait(timeout);
+    }
+
+    sync_add(&idle, (unsigned)-1);
+    unlock();
+    return active;
+}
+
+bool Executor::until(volatile unsigned *word, unsigned value, timeout_t timeout)
+{
+    Timer::tick_t expires = 0;
+    struct timespec ts;
+    bool rtn = true;
+
+    if(sync_load(word) == value)
+        return true;
+
+    if(timeout != Timer::inf)
+        expires = Timer::ticks() + (Timer::tick_t)timeout * 10000;
+
+    // a worker that waits runs other tasks rather than blocking the pool
+    worker *thread = self();
+    if(thread) {
+        while(sync_load(word) != value) {
+            task *job = acquire(thread);
+            if(job) {
+                execute(job);
+                service();
+                continue;
+            }
+            if(expires && Timer::ticks() >= expires)
+                return false;
+            Thread::yield();
+        }
+        return true;
+    }
+
+    if(timeout != Timer::inf)
+        set(&ts, timeout);
+
+    finished.lock();
+    sync_add(&waiters, 1);
+    while(rtn && sync_load(word) != value) {
+        if(timeout == Timer::inf)
+            finished.wait();
+        else
+            rtn = finished.wait(&ts);
+    }
+    sync_add(&waiters, (unsigned)-1);
+    finished.unlock();
+    return sync_load(word) == value;
+}
+
+void Executor::submit(task *job)
+{
+    assert(job != NULL && !job->is_pending());
+
+    job->owner = this;
+    job->state = TASK_QUEUED;
+    sync_add(&outstanding, 1);
+
+    worker *thread = self();
+    if(thread) {
+        if(!thread->push(job)) {
+            execute(job);
+            return;
+        }
+        sync_fence();
+        if(sync_load(&idle)) {
+            lock();
+            signal();
+            unlock();
+        }
+        return;
+    }
+
+    job->next = NULL;
+    lock();
+    if(last)
+        last->next = job;
+    else
+        first = job;
+    last = job;
+    sync_add(&injected, 1);
+    if(idle)
+        signal();
+    unlock();
+}
+
+void Executor::schedule(task *job, timeout_t delay)
+{
+    assert(job != NULL && !job->is_pending());
+
+    if(!delay) {
+        submit(job);
+        return;
+    }
+
+    job->owner = this;
+    job->state = TASK_QUEUED;
+    delayed *event = new delayed(this, job, delay);
+    event->attach(&delays);
+}
+
+void Executor::parallel(range& body, size_t from, size_t to, size_t grain)
+{
+    volatile unsigned pending = 1;
+
+    if(from >= to)
+        return;
+
+    if(!grain)
+        grain = (to - from) / count;
+
+    if(!grain)
+        grain = 1;
+
+    // from a worker the range is split in place, and the worker helps with
+    // the parts until they are all done.
+    if(self()) {
+        splitter root(this, &body, from, to, grain, &pending, false);
+        root.run();
+        sync_add(&pending, (unsigned)-1);
+    }
+    else
+        submit(new splitter(this, &body, from, to, grain, &pending));
+
+    until(&pending, 0, Timer::inf);
+}
+
+bool Executor::wait(timeout_t timeout)
+{
+    assert(self() == NULL);
+
+    return until(&outstanding, 0, timeout);
+}
+
+} // namespace ucommon
@@ -0,0 +1,835 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ucommon-config.h>
+#include <ucommon/export.h>
+#include <ucommon/thread.h>
+#include <ucommon/socket.h>
+#include <ucommon/fiber.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef  HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_UCONTEXT_H) && defined(HAVE_SYS_EPOLL_H) && !defined(__PTH__) && !defined(_MSTHREADS_)
+#define FIBER_CONTEXT
+#include <ucontext.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS   MAP_ANON
+#endif
+#ifndef MAP_STACK
+#define MAP_STACK       0
+#endif
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL    0
+#endif
+
+namespace ucommon {
+
+#define FIBER_STACK     (32l * 1024l)
+#define FIBER_POOLED    1024
+#define FIBER_EVENTS    256
+
+#ifdef  FIBER_CONTEXT
+
+// A fiber context is the fiber's stack and saved registers.  While a fiber
+// is parked, it also holds what it waits for: a socket and epoll events,
+// and a deadline kept in the owning worker's timer heap.
+
+class __LOCAL Fiber::context
+{
+public:
+    typedef enum {RUNNING, YIELDED, PARKED, FINISHED} state_t;
+
+    ucontext_t registers;
+    caddr_t map;
+    size_t size;
+    Fiber *fiber;
+    context *next;
+    FiberScheduler::worker *owner;
+    state_t state;
+    int fd;
+    unsigned events, revents;
+    Timer::tick_t deadline;
+    unsigned heap;
+
+    static void entry(unsigned high, unsigned low);
+};
+
+class __LOCAL FiberScheduler::worker : public JoinableThread
+{
+public:
+    FiberScheduler *scheduler;
+    int poller, wakeup[2];
+    ucontext_t home;
+    Fiber::context *current, *first, *last, *pool;
+    Fiber::context **heap;
+    unsigned heaped, limit, pooled, fibers;
+    Fiber *inbox;
+    Mutex lock;
+    size_t mapped;
+
+    worker(FiberScheduler *owner);
+    ~worker();
+
+    void run(void);
+    void post(Fiber *fiber);
+    void ready(Fiber::context *ctx);
+    void resume(Fiber::context *ctx);
+    void park(Fiber::context *ctx);
+    Fiber::context *create(Fiber *fiber);
+    void recycle(Fiber::context *ctx);
+    void push(Fiber::context *ctx);
+    void pull(Fiber::context *ctx);
+    void swap(unsigned pos, unsigned with);
+    void sift(unsigned pos);
+    int timeout(void);
+    void expire(void);
+};
+
+static pthread_key_t fiber_key;
+static pthread_once_t fiber_once = PTHREAD_ONCE_INIT;
+static size_t fiber_page = 0;
+
+static void fiber_init(void)
+{
+    pthread_key_create(&fiber_key, NULL);
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+    fiber_page = (size_t)sysconf(_SC_PAGESIZE);
+#else
+    fiber_page = 4096;
+#endif
+}
+
+Fiber::context *Fiber::self(void)
+{
+    pthread_once(&fiber_once, fiber_init);
+    FiberScheduler::worker *thread = (FiberScheduler::worker *)pthread_getspecific(fiber_key);
+    if(!thread)
+        return NULL;
+    return thread->current;
+}
+
+// a fiber only parks on sockets that would block; a socket the caller has
+// made non-blocking keeps its own behavior.
+static bool fiber_blocked(socket_t so)
+{
+    if(errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+
+    int flags = fcntl(so, F_GETFL);
+    return flags != -1 && !(flags & O_NONBLOCK);
+}
+
+bool Fiber::park(Fiber::context *ctx, socket_t so, unsigned events, timeout_t timeout)
+{
+    ctx->fd = so;
+    ctx->events = events;
+    ctx->revents = 0;
+    ctx->deadline = 0;
+    if(timeout != Timer::inf)
+        ctx->deadline = Timer::ticks() + (Timer::tick_t)timeout * 10000 + 1;
+    ctx->state = context::PARKED;
+    swapcontext(&ctx->registers, &ctx->owner->home);
+    return ctx->revents != 0;
+}
+
+void Fiber::context::entry(unsigned high, unsigned low)
+{
+    context *ctx = (context *)(uintptr_t)(((uint64_t)high << 32) | (uint64_t)low);
+
+    ctx->fiber->run();
+    ctx->state = FINISHED;
+    swapcontext(&ctx->registers, &ctx->owner->home);
+}
+
+FiberScheduler::worker::worker(FiberScheduler *owner) :
+JoinableThread()
+{
+    scheduler = owner;
+    current = first = last = pool = NULL;
+    heap = NULL;
+    heaped = limit = pooled = fibers = 0;
+    inbox = NULL;
+    mapped = 0;
+
+    poller = epoll_create(FIBER_EVENTS);
+    if(pipe(wakeup)) {
+        wakeup[0] = wakeup[1] = -1;
+        return;
+    }
+
+    fcntl(wakeup[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeup[1], F_SETFL, O_NONBLOCK);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(poller, EPOLL_CTL_ADD, wakeup[0], &ev);
+}
+
+FiberScheduler::worker::~worker()
+{
+    join();
+
+    while(pool) {
+        Fiber::context *ctx = pool;
+        pool = ctx->next;
+        munmap(ctx->map, ctx->size);
+        delete ctx;
+    }
+
+    if(heap)
+        free(heap);
+
+    ::close(poller);
+    ::close(wakeup[0]);
+    ::close(wakeup[1]);
+}
+
+Fiber::context *FiberScheduler::worker::create(Fiber *fiber)
+{
+    size_t size = fiber->stack;
+    Fiber::context *ctx = NULL;
+
+    if(!size)
+        size = scheduler->stack;
+
+    size = (size + fiber_page - 1) & ~(fiber_page - 1);
+
+    if(pool && size == scheduler->stack) {
+        ctx = pool;
+        pool = ctx->next;
+        --pooled;
+    }
+    else {
+        // stacks grow down onto the guard page
+        caddr_t map = (caddr_t)mmap(NULL, size + fiber_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if(map == (caddr_t)MAP_FAILED)
+            return NULL;
+        mprotect(map, fiber_page, PROT_NONE);
+        ctx = new Fiber::context;
+        ctx->map = map;
+        ctx->size = size + fiber_page;
+        mapped += ctx->size;
+    }
+
+    uint64_t addr = (uint64_t)(uintptr_t)ctx;
+    getcontext(&ctx->registers);
+    ctx->registers.uc_stack.ss_sp = ctx->map + fiber_page;
+    ctx->registers.uc_stack.ss_size = ctx->size - fiber_page;
+    ctx->registers.uc_link = NULL;
+    makecontext(&ctx->registers, (void (*)(void))&Fiber::context::entry, 2, (unsigned)(addr >> 32), (unsigned)addr);
+
+    ctx->fiber = fiber;
+    ctx->owner = this;
+    ctx->next = NULL;
+    ctx->state = Fiber::context::RUNNING;
+    ctx->fd = -1;
+    ctx->heap = 0;
+    fiber->cp = ctx;
+    ++fibers;
+    return ctx;
+}
+
+void FiberScheduler::worker::recycle(Fiber::context *ctx)
+{
+    ctx->fiber->cp = NULL;
+    ctx->fiber = NULL;
+
+    if(pooled < FIBER_POOLED && ctx->size == scheduler->stack + fiber_page) {
+        ctx->next = pool;
+        pool = ctx;
+        ++pooled;
+        return;
+    }
+
+    mapped -= ctx->size;
+    munmap(ctx->map, ctx->size);
+    delete ctx;
+}
+
+void FiberScheduler::worker::swap(unsigned pos, unsigned with)
+{
+    Fiber::context *ctx = heap[pos];
+    heap[pos] = heap[with];
+    heap[with] = ctx;
+    heap[pos]->heap = pos + 1;
+    heap[with]->heap = with + 1;
+}
+
+void FiberScheduler::worker::sift(unsigned pos)
+{
+    while(pos && heap[pos]->deadline < heap[(pos - 1) / 2]->deadline) {
+        swap(pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+
+    for(;;) {
+        unsigned child = pos * 2 + 1, least = pos;
+        if(child < heaped && heap[child]->deadline < heap[least]->deadline)
+            least = child;
+        if(child + 1 < heaped && heap[child + 1]->deadline < heap[least]->deadline)
+            least = child + 1;
+        if(least == pos)
+            break;
+        swap(pos, least);
+        pos = least;
+    }
+}
+
+void FiberScheduler::worker::push(Fiber::context *ctx)
+{
+    if(heaped >= limit) {
+        limit = limit ? limit * 2 : 64;
+        heap = (Fiber::context **)realloc(heap, limit * sizeof(Fiber::context *));
+    }
+    heap[heaped] = ctx;
+    ctx->heap = ++heaped;
+    sift(heaped - 1);
+}
+
+void FiberScheduler::worker::pull(Fiber::context *ctx)
+{
+    unsigned pos = ctx->heap - 1;
+
+    ctx->heap = 0;
+    if(pos != --heaped) {
+        heap[pos] = heap[heaped];
+        heap[pos]->heap = pos + 1;
+        sift(pos);
+    }
+}
+
+int FiberScheduler::worker::timeout(void)
+{
+    if(first)
+        return 0;
+
+    if(!heaped)
+        return -1;
+
+    Timer::tick_t now = Timer::ticks();
+    if(heap[0]->deadline <= now)
+        return 0;
+
+    return (int)((heap[0]->deadline - now + 9999) / 10000);
+}
+
+void FiberScheduler::worker::expire(void)
+{
+    Timer::tick_t now = Timer::ticks();
+
+    while(heaped && heap[0]->deadline <= now) {
+        Fiber::context *ctx = heap[0];
+        pull(ctx);
+        if(ctx->fd != -1)
+            epoll_ctl(poller, EPOLL_CTL_DEL, ctx->fd, NULL);
+        ready(ctx);
+    }
+}
+
+void FiberScheduler::worker::ready(Fiber::context *ctx)
+{
+    ctx->next = NULL;
+    if(last)
+        last->next = ctx;
+    else
+        first = ctx;
+    last = ctx;
+}
+
+void FiberScheduler::worker::post(Fiber *fiber)
+{
+    char buf = 0;
+
+    lock.acquire();
+    fiber->next = inbox;
+    inbox = fiber;
+    lock.release();
+
+    if(::write(wakeup[1], &buf, 1) < 1 && errno != EAGAIN)
+        return;
+}
+
+void FiberScheduler::worker::park(Fiber::context *ctx)
+{
+    // the fiber is off its stack now, so it may be woken from here on
+    if(ctx->fd != -1) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = ctx->events | EPOLLONESHOT;
+        ev.data.ptr = ctx;
+        if(epoll_ctl(poller, EPOLL_CTL_MOD, ctx->fd, &ev) && (errno != ENOENT || epoll_ctl(poller, EPOLL_CTL_ADD, ctx->fd, &ev))) {
+            // not pollable, so treat as always ready
+            ctx->revents = ctx->events;
+            ready(ctx);
+            return;
+        }
+    }
+
+    if(ctx->deadline)
+        push(ctx);
+    else if(ctx->fd == -1)
+        ready(ctx);
+}
+
+void FiberScheduler::worker::resume(Fiber::context *ctx)
+{
+    current = ctx;
+    ctx->state = Fiber::context::RUNNING;
+    swapcontext(&home, &ctx->registers);
+    current = NULL;
+
+    switch(ctx->state) {
+    case Fiber::context::FINISHED: {
+        Fiber *fiber = ctx->fiber;
+        recycle(ctx);
+        --fibers;
+        fiber->exit();
+        scheduler->finished();
+        break;
+    }
+    case Fiber::context::YIELDED:
+        ready(ctx);
+        break;
+    case Fiber::context::PARKED:
+        park(ctx);
+        break;
+    default:
+        break;
+    }
+}
+
+void FiberScheduler::worker::run(void)
+{
+    struct epoll_event events[FIBER_EVENTS];
+    char buf[64];
+
+    pthread_once(&fiber_once, fiber_init);
+    pthread_setspecific(fiber_key, this);
+
+    for(;;) {
+        lock.acquire();
+        Fiber *fiber = inbox;
+        inbox = NULL;
+        lock.release();
+
+        while(fiber) {
+            Fiber *next = fiber->next;
+            Fiber::context *ctx = create(fiber);
+            if(ctx)
+                ready(ctx);
+            else {
+                fiber->exit();
+                scheduler->finished();
+            }
+            fiber = next;
+        }
+
+        // run the fibers ready now; those made ready meanwhile wait a turn
+        Fiber::context *ctx = first;
+        first = last = NULL;
+        while(ctx) {
+            Fiber::context *next = ctx->next;
+            resume(ctx);
+            ctx = next;
+        }
+
+        if(scheduler->stopping && !fibers && !inbox)
+            break;
+
+        int count = epoll_wait(poller, events, FIBER_EVENTS, timeout());
+        for(int pos = 0; pos < count; ++pos) {
+            ctx = (Fiber::context *)events[pos].data.ptr;
+            if(!ctx) {
+                while(::read(wakeup[0], buf, sizeof(buf)) > 0) {
+                }
+                continue;
+            }
+            if(ctx->heap)
+                pull(ctx);
+            ctx->revents = events[pos].events;
+            ready(ctx);
+        }
+        expire();
+    }
+}
+
+#else
+
+class __LOCAL FiberScheduler::worker
+{
+};
+
+#endif
+
+// without fiber contexts, each fiber runs as a thread of its own
+
+class __LOCAL FiberScheduler::runner : public DetachedThread
+{
+public:
+    Fiber *fiber;
+    FiberScheduler *scheduler;
+
+    runner(Fiber *object, FiberScheduler *owner) : DetachedThread()
+        {fiber = object; scheduler = owner;}
+
+    void run(void) {
+        fiber->run();
+        fiber->exit();
+        scheduler->finished();
+    }
+};
+
+Fiber::Fiber(size_t size)
+{
+    cp = NULL;
+    next = NULL;
+    stack = size;
+}
+
+Fiber::~Fiber()
+{
+}
+
+void Fiber::exit(void)
+{
+    delete this;
+}
+
+void Fiber::start(FiberScheduler *scheduler)
+{
+    scheduler->start(this);
+}
+
+Fiber *Fiber::get(void)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx)
+        return ctx->fiber;
+#endif
+    return NULL;
+}
+
+void Fiber::yield(void)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx) {
+        ctx->state = context::YIELDED;
+        swapcontext(&ctx->registers, &ctx->owner->home);
+        return;
+    }
+#endif
+    Thread::yield();
+}
+
+void Fiber::sleep(timeout_t timeout)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx) {
+        if(timeout == Timer::inf)
+            --timeout;
+        park(ctx, -1, 0, timeout);
+        return;
+    }
+#endif
+    Thread::sleep(timeout);
+}
+
+bool Fiber::wait(socket_t so, bool output, timeout_t timeout)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx) {
+        struct pollfd pfd;
+        pfd.fd = so;
+        pfd.events = output ? POLLOUT : POLLIN;
+        pfd.revents = 0;
+        if(::poll(&pfd, 1, 0) > 0)
+            return (pfd.revents & pfd.events) != 0;
+        if(!timeout)
+            return false;
+        return park(ctx, so, output ? EPOLLOUT : EPOLLIN, timeout);
+    }
+#endif
+    struct timeval tv;
+    struct timeval *tvp = NULL;
+    fd_set grp;
+
+    if(timeout != Timer::inf) {
+        tv.tv_usec = (timeout % 1000) * 1000;
+        tv.tv_sec = timeout / 1000;
+        tvp = &tv;
+    }
+
+    FD_ZERO(&grp);
+    FD_SET(so, &grp);
+    if(output)
+        return ::select((int)(so + 1), NULL, &grp, NULL, tvp) > 0;
+    return ::select((int)(so + 1), &grp, NULL, NULL, tvp) > 0;
+}
+
+ssize_t Fiber::recv(socket_t so, void *data, size_t size, int flags)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx && !(flags & MSG_DONTWAIT)) {
+        for(;;) {
+            ssize_t result = ::recv(so, (caddr_t)data, size, flags | MSG_DONTWAIT);
+            if(result > -1 || !fiber_blocked(so))
+                return result;
+            park(ctx, so, EPOLLIN, Timer::inf);
+        }
+    }
+#endif
+    return ::recv(so, (caddr_t)data, size, flags);
+}
+
+ssize_t Fiber::recvfrom(socket_t so, void *data, size_t size, int flags, struct sockaddr *addr, socklen_t *len)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx && !(flags & MSG_DONTWAIT)) {
+        for(;;) {
+            ssize_t result = ::recvfrom(so, (caddr_t)data, size, flags | MSG_DONTWAIT, addr, len);
+            if(result > -1 || !fiber_blocked(so))
+                return result;
+            park(ctx, so, EPOLLIN, Timer::inf);
+        }
+    }
+#endif
+    return ::recvfrom(so, (caddr_t)data, size, flags, addr, len);
+}
+
+ssize_t Fiber::send(socket_t so, const void *data, size_t size, int flags)
+{
+    return sendto(so, data, size, flags, NULL, 0);
+}
+
+ssize_t Fiber::sendto(socket_t so, const void *data, size_t size, int flags, const struct sockaddr *addr, socklen_t len)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx && !(flags & MSG_DONTWAIT)) {
+        // a blocking send completes in full, so partial sends continue
+        const char *cp = (const char *)data;
+        size_t sent = 0;
+        do {
+            ssize_t result = ::sendto(so, cp + sent, size - sent, flags | MSG_DONTWAIT, addr, len);
+            if(result > -1)
+                sent += result;
+            else if(fiber_blocked(so))
+                park(ctx, so, EPOLLOUT, Timer::inf);
+            else
+                return sent ? (ssize_t)sent : -1;
+        } while(sent < size);
+        return (ssize_t)sent;
+    }
+#endif
+    if(addr)
+        return ::sendto(so, (const char *)data, size, flags, addr, len);
+    return ::send(so, (const char *)data, size, flags);
+}
+
+socket_t Fiber::accept(socket_t so, struct sockaddr *addr, socklen_t *len)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    if(ctx) {
+        struct pollfd pfd;
+        pfd.fd = so;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        while(::poll(&pfd, 1, 0) < 1)
+            park(ctx, so, EPOLLIN, Timer::inf);
+    }
+#endif
+    return ::accept(so, addr, len);
+}
+
+int Fiber::connect(socket_t so, const struct sockaddr *addr, socklen_t len)
+{
+#ifdef  FIBER_CONTEXT
+    context *ctx = self();
+    int flags = -1;
+    if(ctx)
+        flags = fcntl(so, F_GETFL);
+    if(flags != -1 && !(flags & O_NONBLOCK)) {
+        // connect without blocking, then wait for the handshake
+        fcntl(so, F_SETFL, flags | O_NONBLOCK);
+        int result = ::connect(so, addr, len);
+        if(result && errno == EINPROGRESS) {
+            int error = 0;
+            socklen_t elen = sizeof(error);
+            park(ctx, so, EPOLLOUT, Timer::inf);
+            getsockopt(so, SOL_SOCKET, SO_ERROR, (char *)&error, &elen);
+            if(error) {
+                errno = error;
+                result = -1;
+            }
+            else
+                result = 0;
+        }
+        int saved = errno;
+        fcntl(so, F_SETFL, flags);
+        errno = saved;
+        return result;
+    }
+#endif
+    return ::connect(so, addr, len);
+}
+
+FiberScheduler::FiberScheduler(unsigned threads, size_t size) :
+Conditional()
+{
+    count = 0;
+    next = live = 0;
+    stopping = false;
+    workers = NULL;
+
+    if(!size)
+        size = FIBER_STACK;
+
+#ifdef  FIBER_CONTEXT
+    pthread_once(&fiber_once, fiber_init);
+    stack = (size + fiber_page - 1) & ~(fiber_page - 1);
+
+    if(!threads) {
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+#else
+        threads = 1;
+#endif
+    }
+
+    count = threads;
+    workers = new worker *[count];
+    for(unsigned pos = 0; pos < count; ++pos)
+        workers[pos] = new worker(this);
+    for(unsigned pos = 0; pos < count; ++pos)
+        workers[pos]->start();
+#else
+    stack = size;
+#endif
+}
+
+FiberScheduler::~FiberScheduler()
+{
+    wait();
+
+#ifdef  FIBER_CONTEXT
+    stopping = true;
+    for(unsigned pos = 0; pos < count; ++pos) {
+        char buf = 0;
+        if(::write(workers[pos]->wakeup[1], &buf, 1) < 1)
+            continue;
+    }
+    for(unsigned pos = 0; pos < count; ++pos)
+        delete workers[pos];
+    delete[] workers;
+#endif
+}
+
+void FiberScheduler::start(Fiber *fiber)
+{
+    assert(fiber != NULL);
+
+    lock();
+    ++live;
+    unlock();
+
+#ifdef  FIBER_CONTEXT
+    Fiber::context *ctx = Fiber::self();
+
+    // fibers started from a fiber stay on its thread
+    if(ctx && ctx->owner->scheduler == this) {
+        Fiber::context *created = ctx->owner->create(fiber);
+        if(created)
+            ctx->owner->ready(created);
+        else {
+            fiber->exit();
+            finished();
+        }
+        return;
+    }
+
+    unsigned pos;
+    lock();
+    pos = next++ % count;
+    unlock();
+    workers[pos]->post(fiber);
+#else
+    runner *thread = new runner(fiber, this);
+    thread->start();
+#endif
+}
+
+void FiberScheduler::finished(void)
+{
+    lock();
+    if(!--live)
+        broadcast();
+    unlock();
+}
+
+bool FiberScheduler::wait(timeout_t timeout)
+{
+    struct timespec ts;
+    bool rtn = true;
+
+    if(timeout != Timer::inf)
+        set(&ts, timeout);
+
+    lock();
+    while(rtn && live) {
+        if(timeout == Timer::inf)
+            Conditional::wait();
+        else
+            rtn = Conditional::wait(&ts);
+    }
+    rtn = !live;
+    unlock();
+    return rtn;
+}
+
+size_t FiberScheduler::mapped(void) const
+{
+    size_t total = 0;
+
+#ifdef  FIBER_CONTEXT
+    for(unsigned pos = 0; pos < count; ++pos)
+        total += workers[pos]->mapped;
+#endif
+
+    return total;
+}
+
+} // namespace ucommon
@@ -454,6 +454,25 @@ void fsys::release(fd_t fd)
     CloseHandle(fd);
 }
 
+ssize_t fsys::read(fd_t fd, void *buf, size_t len, off_t *offset)
+{
+    OVERLAPPED pos;
+    DWORD count;
+
+    if(!offset) {
+        if(!ReadFile(fd, (LPVOID) buf, (DWORD)len, &count, NULL))
+            return -1;
+        return count;
+    }
+
+    memset(&pos, 0, sizeof(pos));
+    pos.Offset = (DWORD)*offset;
+    if(!ReadFile(fd, (LPVOID) buf, (DWORD)len, &count, &pos))
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    *offset += count;
+    return count;
+}
+
 void dir::open(const char *path)
 {
     close();
@@ -855,6 +874,19 @@ void fsys::release(fd_t fd)
     ::close(fd);
 }
 
+ssize_t fsys::read(fd_t fd, void *buf, size_t len, off_t *offset)
+{
+    ssize_t rtn;
+
+    if(!offset)
+        return ::read(fd, buf, len);
+
+    rtn = ::pread(fd, buf, len, *offset);
+    if(rtn > 0)
+        *offset += rtn;
+    return rtn;
+}
+
 void fsys::open(const char *path, unsigned fmode, access_t access)
 {
     unsigned flags = 0;
@@ -1078,12 +1110,12 @@ int fsys::inherit(fd_t& fd, bool enable)
 {
     unsigned long flags;
     if(fd > -1) {
-        flags = fcntl(fd, F_GETFL);
+        flags = fcntl(fd, F_GETFD);
         if(enable)
             flags &= ~FD_CLOEXEC;
         else
             flags |= FD_CLOEXEC;
-        if(fcntl(fd, F_SETFL, flags))
+        if(fcntl(fd, F_SETFD, flags))
             return remapError();
     }
     return 0;
@@ -57,6 +57,23 @@
 #include <stdlib.h>
 #include <limits.h>
 
+#ifdef  HAVE_LINUX_FUTEX_H
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef  HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(HAVE_SHM_OPEN)
+#include <sys/vfs.h>
+#define HUGETLB_PATH    "/dev/hugepages"
+#define HUGETLB_MAGIC   0x958458f6
+#define HUGETLB_TAIL    (2 * sizeof(uint64_t))
+#endif
+
 #if _POSIX_PRIORITY_SCHEDULING > 0
 #include <sched.h>
 #endif
@@ -198,6 +215,21 @@ MappedMemory::MappedMemory(const char *fn, size_t len)
 
     size = len;
     erase = true;
+    options = LOCKED;
+    node = -1;
+    String::set(idname, sizeof(idname), fn);
+    create(fn, size);
+}
+
+MappedMemory::MappedMemory(const char *fn, size_t len, unsigned flags, int numa)
+{
+    assert(fn != NULL && *fn != 0);
+    assert(len > 0);
+
+    size = len;
+    erase = true;
+    options = flags;
+    node = numa;
     String::set(idname, sizeof(idname), fn);
     create(fn, size);
 }
@@ -205,6 +237,8 @@ MappedMemory::MappedMemory(const char *fn, size_t len)
 MappedMemory::MappedMemory(const char *fn)
 {
     erase = false;
+    options = LOCKED;
+    node = -1;
     assert(fn != NULL && *fn != 0);
     create(fn, 0);
 }
@@ -212,11 +246,46 @@ MappedMemory::MappedMemory(const char *fn)
 MappedMemory::MappedMemory()
 {
     erase = false;
+    options = LOCKED;
+    node = -1;
     size = 0;
     used = 0;
     map = NULL;
 }
 
+#ifndef _MSWINDOWS_
+
+// apply placement to a fresh mapping, before anything touches its pages
+static void place(caddr_t addr, size_t len, unsigned options, int node, bool prefaulted)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MADV_HUGEPAGE)
+    if(options & MappedMemory::HUGEPAGES)
+        madvise(addr, len, MADV_HUGEPAGE);
+#endif
+
+#if defined(HAVE_LINUX_MEMPOLICY_H) && defined(SYS_mbind)
+    if(node >= 0 && node < (int)(sizeof(unsigned long) * 8)) {
+        unsigned long mask = 1ul << node;
+        syscall(SYS_mbind, addr, len, MPOL_BIND, &mask, sizeof(mask) * 8, 0);
+    }
+#endif
+
+    if((options & MappedMemory::PREFAULT) && !prefaulted) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        volatile char touch;
+        for(size_t pos = 0; pos < len; pos += page)
+            touch = addr[pos];
+        (void)touch;
+    }
+
+#ifdef  HAVE_SYS_MMAN_H
+    if(options & MappedMemory::LOCKED)
+        mlock(addr, len);
+#endif
+}
+
+#endif
+
 #if defined(_MSWINDOWS_)
 
 void MappedMemory::create(const char *fn, size_t len)
@@ -258,7 +327,8 @@ void MappedMemory::create(const char *fn, size_t len)
     map = (caddr_t)MapViewOfFile(fd, FILE_MAP_ALL_ACCESS, 0, 0, len);
     if(map) {
         size = len;
-        VirtualLock(map, size);
+        if(options & LOCKED)
+            VirtualLock(map, size);
     }
     else
         fault();
@@ -310,7 +380,7 @@ void MappedMemory::create(const char *fn, size_t len)
 
     if(!use_mapping) {
         assert(len > 0);
-        map = (caddr_t)malloc(size);
+        map = (caddr_t)malloc(len);
         if(!map)
             fault();
         size = mapsize = len;
@@ -322,6 +392,61 @@ void MappedMemory::create(const char *fn, size_t len)
         fn = fbuf;
     }
 
+    fd = -1;
+    int mflags = MAP_SHARED;
+    size_t request = len;
+
+#ifdef  HUGETLB_PATH
+    // a hugetlbfs file takes precedence, so readers look there first.  Its
+    // size is rounded up to whole huge pages, so the size asked for is kept
+    // in a tail at the end of the file.
+    char hpath[96];
+    struct statfs hfs;
+    bool hugefile = false;
+    snprintf(hpath, sizeof(hpath), "%s%s", HUGETLB_PATH, fn);
+    if(!len)
+        fd = ::open(hpath, O_RDONLY);
+    else if((options & HUGEPAGES) && !statfs(HUGETLB_PATH, &hfs) && hfs.f_type == HUGETLB_MAGIC) {
+        size_t hsize = (size_t)hfs.f_bsize;
+        size_t hlen = ((len + INSERT_OFFSET + HUGETLB_TAIL + hsize - 1) / hsize) * hsize;
+        fd = ::open(hpath, O_RDWR | O_CREAT, 0664);
+        if(fd > -1 && !ftruncate(fd, hlen)) {
+            caddr_t hmap = (caddr_t)mmap(NULL, hlen, prot | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(hmap != (caddr_t)MAP_FAILED) {
+                munmap(hmap, hlen);
+                len = hlen - INSERT_OFFSET;
+            }
+            else {
+                // no huge pages reserved, fall back to shared memory
+                ::close(fd);
+                ::unlink(hpath);
+                fd = -1;
+            }
+        }
+        else if(fd > -1) {
+            ::close(fd);
+            ::unlink(hpath);
+            fd = -1;
+        }
+        if(fd > -1)
+            len += INSERT_OFFSET;
+    }
+    else {
+        // a file left from an earlier run would hide the new segment
+        ::unlink(hpath);
+    }
+
+    if(fd > -1) {
+        hugefile = true;
+        if(!len) {
+            fstat(fd, &ino);
+            len = ino.st_size;
+        }
+        else
+            prot |= PROT_WRITE;
+    }
+    else
+#endif
     if(len) {
         len += INSERT_OFFSET;
         prot |= PROT_WRITE;
@@ -344,14 +469,33 @@ void MappedMemory::create(const char *fn, size_t len)
     if(fd < 0)
         return;
 
+#ifdef  MAP_POPULATE
+    // the kernel prefaults faster, but only after numa policy is set
+    if((options & PREFAULT) && node < 0)
+        mflags |= MAP_POPULATE;
+#endif
 
-    map = (caddr_t)mmap(NULL, len, prot, MAP_SHARED, fd, 0);
+    map = (caddr_t)mmap(NULL, len, prot, mflags, fd, 0);
     if(!map)
         fault();
     ::close(fd);
     if(map != (caddr_t)MAP_FAILED) {
         size = mapsize = len;
-        mlock(map, mapsize);
+        // huge page rounding is not part of the segment we were asked for
+        if(request && request + INSERT_OFFSET < len)
+            size = request + INSERT_OFFSET;
+#ifdef  HUGETLB_PATH
+        if(hugefile && mapsize >= HUGETLB_TAIL + INSERT_OFFSET) {
+            uint64_t *tail = (uint64_t *)(map + mapsize - HUGETLB_TAIL);
+            if(prot & PROT_WRITE) {
+                tail[0] = HUGETLB_MAGIC;
+                tail[1] = request;
+            }
+            else if(tail[0] == HUGETLB_MAGIC && tail[1] + HUGETLB_TAIL + INSERT_OFFSET <= mapsize)
+                size = (size_t)tail[1] + INSERT_OFFSET;
+        }
+#endif
+        place(map, mapsize, options, node, (mflags != MAP_SHARED));
 #if INSERT_OFFSET > 0
         if(prot & PROT_WRITE) {
             size -= INSERT_OFFSET;
@@ -401,6 +545,12 @@ void MappedMemory::remove(const char *fn)
         fn = fbuf;
     }
 
+#ifdef  HUGETLB_PATH
+    char hpath[96];
+    snprintf(hpath, sizeof(hpath), "%s%s", HUGETLB_PATH, fn);
+    ::unlink(hpath);
+#endif
+
     shm_unlink(fn);
 }
 
@@ -445,6 +595,12 @@ void MappedMemory::create(const char *name, size_t len)
     if(len) {
         key = createipc(name, 'S');
 remake:
+        fd = -1;
+#ifdef  SHM_HUGETLB
+        if(options & HUGEPAGES)
+            fd = shmget(key, len, IPC_CREAT | IPC_EXCL | SHM_HUGETLB | 0664);
+        if(fd == -1)
+#endif
         fd = shmget(key, len, IPC_CREAT | IPC_EXCL | 0664);
         if(fd == -1 && errno == EEXIST) {
             fd = shmget(key, 0, 0);
@@ -470,8 +626,10 @@ remake:
     map = (caddr_t)shmat(fd, NULL, 0);
     if(!map)
         fault();
+    if(fd > -1 && map != (caddr_t)-1)
+        place(map, size, options & ~LOCKED, node, false);
 #ifdef  SHM_LOCK
-    if(fd > -1)
+    if(fd > -1 && (options & LOCKED))
         shmctl(fd, SHM_LOCK, NULL);
 #endif
 }
@@ -540,6 +698,326 @@ bool MappedMemory::copy(size_t offset, void *buffer, size_t bufsize) const
     return true;
 }
 
+// orders the stamp against the record copy; plain fences are enough as
+// there is only ever one writer per record.
+#if defined(__ATOMIC_ACQUIRE)
+#define stamp_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define stamp_release() __atomic_thread_fence(__ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+#define stamp_acquire() __sync_synchronize()
+#define stamp_release() __sync_synchronize()
+#elif defined(_MSWINDOWS_)
+#define stamp_acquire() MemoryBarrier()
+#define stamp_release() MemoryBarrier()
+#else
+#define stamp_acquire()
+#define stamp_release()
+#endif
+
+MappedStamp::MappedStamp()
+{
+    value = 0;
+}
+
+void MappedStamp::begin(void)
+{
+    value = value + 1;
+    stamp_release();
+}
+
+void MappedStamp::commit(void)
+{
+    stamp_release();
+    value = value + 1;
+}
+
+bool MappedStamp::copy(const void *source, void *target, size_t size, unsigned retries) const
+{
+    unsigned tries = 0;
+
+    for(;;) {
+        uint32_t current = value;
+        stamp_acquire();
+        if(!(current & 1)) {
+            memcpy(target, source, size);
+            stamp_acquire();
+            if(value == current)
+                return true;
+        }
+
+        if(++tries >= retries)
+            return false;
+
+        // writer may have been preempted mid-update
+        if(tries > 16)
+            Thread::yield();
+    }
+}
+
+// Ring control block, at the start of the segment and followed by the
+// message space.  Producers share the head line and the consumer owns the
+// tail line, so the two sides only meet when one of them waits.
+
+#define RING_MAGIC  0x72696e67
+#define RING_LINE   64
+#define RING_SKIP   0xffffffff
+#define RING_SPIN   200
+
+typedef struct {
+    uint32_t magic;
+    uint32_t mask;
+    char pad0[RING_LINE - 8];
+    volatile uint64_t head;
+    volatile uint32_t readable;
+    volatile uint32_t rwaiting;
+    char pad1[RING_LINE - 16];
+    volatile uint64_t tail;
+    volatile uint32_t writable;
+    volatile uint32_t wwaiting;
+    char pad2[RING_LINE - 16];
+} ring_control;
+
+// every message has an 8 byte header holding its length + 1, which is 0
+// until the message is committed.  The consumer zeroes what it frees.
+#define RING_HEADER 8
+#define ring_span(size) (RING_HEADER + (((size) + 7) & ~((size_t)7)))
+
+#if defined(__GNUC__)
+#define ring_cas(ptr, old, value) __sync_bool_compare_and_swap(ptr, old, value)
+#define ring_inc(ptr) __sync_fetch_and_add(ptr, 1)
+#define ring_dec(ptr) __sync_fetch_and_sub(ptr, 1)
+#define ring_fence() __sync_synchronize()
+#elif defined(_MSWINDOWS_)
+#define ring_cas(ptr, old, value) (InterlockedCompareExchange64((volatile LONGLONG *)(ptr), value, old) == (LONGLONG)(old))
+#define ring_inc(ptr) InterlockedIncrement((volatile LONG *)(ptr))
+#define ring_dec(ptr) InterlockedDecrement((volatile LONG *)(ptr))
+#define ring_fence() MemoryBarrier()
+#endif
+
+static inline volatile uint32_t *ring_word(caddr_t space, uint64_t pos)
+{
+    return (volatile uint32_t *)(space + pos);
+}
+
+static bool ring_wait(volatile uint32_t *addr, uint32_t value, Timer::tick_t deadline)
+{
+    Timer::tick_t now = 0;
+
+    if(deadline) {
+        now = Timer::ticks();
+        if(now >= deadline)
+            return false;
+    }
+
+#ifdef  HAVE_LINUX_FUTEX_H
+    struct timespec ts, *tsp = NULL;
+    if(deadline) {
+        Timer::tick_t remains = deadline - now;
+        ts.tv_sec = (time_t)(remains / 10000000l);
+        ts.tv_nsec = (long)((remains % 10000000l) * 100l);
+        tsp = &ts;
+    }
+    // shared, not private, futex since waiters are in other processes
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, tsp, NULL, 0);
+#else
+    if(*addr == value)
+        Thread::sleep(1);
+#endif
+    return true;
+}
+
+static void ring_wake(volatile uint32_t *addr, int count)
+{
+#ifdef  HAVE_LINUX_FUTEX_H
+    syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+#endif
+}
+
+static Timer::tick_t ring_deadline(timeout_t timeout)
+{
+    if(timeout == Timer::inf)
+        return 0;
+    return Timer::ticks() + (Timer::tick_t)timeout * 10000l + 1;
+}
+
+MappedRing::MappedRing(const char *name, size_t size) :
+MappedMemory()
+{
+    assert(name != NULL && *name != 0);
+    assert(size > 0);
+
+    capacity = 64;
+    while(capacity < size)
+        capacity <<= 1;
+
+    MappedMemory::remove(name);
+    erase = true;
+    String::set(idname, sizeof(idname), name);
+    MappedMemory::create(name, sizeof(ring_control) + capacity);
+    if(!MappedMemory::size) {
+        capacity = 0;
+        return;
+    }
+
+    ring_control *ring = (ring_control *)control();
+    memset(ring, 0, sizeof(ring_control) + capacity);
+    ring->mask = (uint32_t)(capacity - 1);
+    ring_fence();
+    ring->magic = RING_MAGIC;
+}
+
+MappedRing::MappedRing(const char *name) :
+MappedMemory()
+{
+    assert(name != NULL && *name != 0);
+
+    capacity = 0;
+
+    // find the size of the ring from a read-only look first
+    MappedMemory probe(name);
+    if(!probe || probe.len() < sizeof(ring_control))
+        return;
+
+    const ring_control *ring = (const ring_control *)probe.offset(0);
+    if(ring->magic != RING_MAGIC)
+        return;
+
+    size_t space = (size_t)ring->mask + 1;
+    probe.release();
+
+    MappedMemory::create(name, sizeof(ring_control) + space);
+    if(MappedMemory::size == sizeof(ring_control) + space)
+        capacity = space;
+}
+
+void *MappedRing::control(void) const
+{
+    return offset(0);
+}
+
+size_t MappedRing::limit(void) const
+{
+    // a message must fit twice so the wrap padding can never starve it
+    if(!capacity)
+        return 0;
+    return capacity / 2 - RING_HEADER;
+}
+
+bool MappedRing::put(const void *data, size_t len, timeout_t timeout)
+{
+    if(!capacity || !len || len > limit())
+        return false;
+
+    ring_control *ring = (ring_control *)control();
+    caddr_t space = (caddr_t)ring + sizeof(ring_control);
+    size_t need = ring_span(len);
+    Timer::tick_t deadline = 0;
+    uint64_t head, pos, total, fill;
+    unsigned spins = 0;
+
+    for(;;) {
+        head = ring->head;
+        pos = head & ring->mask;
+        fill = capacity - pos;
+        total = (need > fill) ? fill + need : need;
+
+        if(head + total - ring->tail <= capacity) {
+            if(ring_cas(&ring->head, head, head + total))
+                break;
+            continue;
+        }
+
+        if(++spins < RING_SPIN)
+            continue;
+
+        if(!deadline && timeout != Timer::inf)
+            deadline = ring_deadline(timeout);
+
+        ring_inc(&ring->wwaiting);
+        uint32_t seq = ring->writable;
+        bool waiting = (ring->head + total - ring->tail > capacity);
+        if(waiting && !ring_wait(&ring->writable, seq, deadline)) {
+            ring_dec(&ring->wwaiting);
+            return false;
+        }
+        ring_dec(&ring->wwaiting);
+    }
+
+    if(need > fill) {
+        *ring_word(space, pos) = RING_SKIP;
+        pos = 0;
+    }
+
+    memcpy(space + pos + RING_HEADER, data, len);
+    stamp_release();
+    *ring_word(space, pos) = (uint32_t)(len + 1);
+
+    ring_inc(&ring->readable);
+    if(ring->rwaiting)
+        ring_wake(&ring->readable, 1);
+    return true;
+}
+
+size_t MappedRing::get(void *data, size_t len, timeout_t timeout)
+{
+    if(!capacity)
+        return 0;
+
+    ring_control *ring = (ring_control *)control();
+    caddr_t space = (caddr_t)ring + sizeof(ring_control);
+    Timer::tick_t deadline = 0;
+    unsigned spins = 0;
+    uint64_t tail, pos;
+    uint32_t word;
+
+    for(;;) {
+        tail = ring->tail;
+        pos = tail & ring->mask;
+        word = *ring_word(space, pos);
+        stamp_acquire();
+
+        if(word == RING_SKIP) {
+            *ring_word(space, pos) = 0;
+            stamp_release();
+            ring->tail = tail + (capacity - pos);
+            continue;
+        }
+
+        if(word)
+            break;
+
+        if(++spins < RING_SPIN)
+            continue;
+
+        if(!deadline && timeout != Timer::inf)
+            deadline = ring_deadline(timeout);
+
+        ring->rwaiting = 1;
+        ring_fence();
+        uint32_t seq = ring->readable;
+        if(!*ring_word(space, pos) && !ring_wait(&ring->readable, seq, deadline)) {
+            ring->rwaiting = 0;
+            return 0;
+        }
+        ring->rwaiting = 0;
+    }
+
+    size_t size = word - 1;
+    size_t need = ring_span(size);
+    if(size > len)
+        size = len;
+
+    memcpy(data, space + pos + RING_HEADER, size);
+    memset(space + pos, 0, need);
+    stamp_release();
+    ring->tail = tail + need;
+
+    ring_inc(&ring->writable);
+    if(ring->wwaiting)
+        ring_wake(&ring->writable, INT_MAX);
+    return size;
+}
+
 void *MappedMemory::offset(size_t offset) const
 {
     if(offset >= size)
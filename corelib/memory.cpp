@@ -28,6 +28,9 @@
 #include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#ifdef  HAVE_SETLOCALE
+#include <locale.h>
+#endif
 
 namespace ucommon {
 
@@ -43,6 +46,92 @@ extern "C" {
     }
 }
 
+// strings are radix sorted a byte at a time.  The largest bucket is
+// sorted in place of recursion, so recursion is never deeper than the log
+// of the count, and small buckets are finished by insertion.
+
+#define RADIX_SMALL 24
+
+typedef StringPager::member *member_p;
+
+static inline unsigned radix_key(const member_p node, size_t depth)
+{
+    return (uint8_t)(node->get()[depth]);
+}
+
+static void insertion(member_p *list, size_t count, size_t depth)
+{
+    for(size_t pos = 1; pos < count; ++pos) {
+        member_p node = list[pos];
+        size_t ins = pos;
+        while(ins && strcmp(list[ins - 1]->get() + depth, node->get() + depth) > 0) {
+            list[ins] = list[ins - 1];
+            --ins;
+        }
+        list[ins] = node;
+    }
+}
+
+static void radix(member_p *list, member_p *temp, size_t count, size_t depth)
+{
+    size_t counts[256], offsets[256];
+    unsigned key, largest;
+
+    while(count >= RADIX_SMALL) {
+        memset(counts, 0, sizeof(counts));
+        for(size_t pos = 0; pos < count; ++pos)
+            ++counts[radix_key(list[pos], depth)];
+
+        key = radix_key(list[0], depth);
+        if(counts[key] == count) {
+            if(!key)
+                return;
+            ++depth;
+            continue;
+        }
+
+        size_t offset = 0;
+        largest = 0;
+        for(key = 0; key < 256; ++key) {
+            offsets[key] = offset;
+            offset += counts[key];
+            if(counts[key] > counts[largest])
+                largest = key;
+        }
+
+        for(size_t pos = 0; pos < count; ++pos)
+            temp[offsets[radix_key(list[pos], depth)]++] = list[pos];
+        memcpy(list, temp, count * sizeof(member_p));
+
+        // offsets are now the end of each bucket; bucket 0 is the strings
+        // that end here, which are equal.
+        for(key = 1; key < 256; ++key) {
+            if(key != largest && counts[key] > 1)
+                radix(list + offsets[key] - counts[key], temp, counts[key], depth + 1);
+        }
+
+        if(!largest)
+            return;
+
+        list += offsets[largest] - counts[largest];
+        count = counts[largest];
+        ++depth;
+    }
+    insertion(list, count, depth);
+}
+
+static bool bytewise(void)
+{
+#if defined(HAVE_STRCOLL) && defined(HAVE_SETLOCALE)
+    const char *locale = setlocale(LC_COLLATE, NULL);
+    return !locale || !strcmp(locale, "C") || !strcmp(locale, "POSIX");
+#elif defined(HAVE_STRCOLL)
+    return false;
+#else
+    return true;
+#endif
+}
+
 memalloc::memalloc(size_t ps)
 {
 #ifdef  HAVE_SYSCONF
@@ -427,9 +516,15 @@ unsigned StringPager::token(const char *text, const char *list, const char *quot
     const char *result;
     char *lastp = NULL;
 
-    if(!text || !*text)
+    if(!text || !*text || !list)
         return 0;
 
+    if(!quote && !end) {
+        Tokenizer tokens(list);
+        tokens.token(text, strlen(text));
+        return add(tokens);
+    }
+
     strdup_t tmp = strdup(text);
     while(NULL != (result = String::token(tmp, &lastp, list, quote, end))) {
         ++count;
@@ -669,7 +764,51 @@ void StringPager::add(char **list)
         add(cp);
 }
 
+unsigned StringPager::add(const Tokenizer& tokens)
+{
+    unsigned count = 0;
+
+    // short text shares one allocation with its member, leaving room for
+    // the page header.
+    size_t limit = memalloc::size() - sizeof(member) - 4 * sizeof(void *);
+
+    for(size_t pos = 0; pos < tokens.size(); ++pos) {
+        size_t size = tokens.length(pos);
+        caddr_t mem;
+        char *str;
+
+        if(size < limit) {
+            mem = (caddr_t)memalloc::_alloc(sizeof(member) + size + 1);
+            str = mem + sizeof(member);
+        }
+        else {
+            mem = (caddr_t)memalloc::_alloc(sizeof(member));
+            str = (char *)memalloc::_alloc(size + 1);
+        }
+
+        memcpy(str, tokens.at(pos), size);
+        str[size] = 0;
+
+        member *node;
+        if(members++) {
+            node = new(mem) member(str);
+            last->set(node);
+        }
+        else
+            node = new(mem) member(&root, str);
+        last = node;
+        ++count;
+    }
+    index = NULL;
+    return count;
+}
+
 void StringPager::sort(void)
+{
+    sort(true);
+}
+
+void StringPager::sort(bool collate)
 {
     if(!members)
         return;
@@ -683,7 +822,14 @@ void StringPager::sort(void)
         mp.next();
     }
 
-    qsort(static_cast<void *>(list), members, sizeof(member *), &ncompare);
+    if(collate && !bytewise())
+        qsort(static_cast<void *>(list), members, sizeof(member *), &ncompare);
+    else {
+        member **temp = new member*[members];
+        radix(list, temp, members, 0);
+        delete[] temp;
+    }
+
     root = NULL;
     while(pos)
         list[--pos]->enlist(&root);
@@ -737,23 +883,20 @@ void DirPager::operator=(const char *path)
 
 bool DirPager::load(const char *path)
 {
-    dir_t ds;
+    DirWalker::reader ds(path);
+    const char *name;
     char buffer[128];
 
-    if(!fsys::is_dir(path))
-        return false;
-
-    dir = dup(path);
-    ds.open(path);
     if(!ds)
         return false;
 
-    while(ds.read(buffer, sizeof(buffer)) > 0) {
+    dir = dup(path);
+    while((name = ds.next()) != NULL) {
+        String::set(buffer, sizeof(buffer), name);
         if(!filter(buffer, sizeof(buffer)))
             break;
     }
 
-    ds.close();
     sort();
     return true;
 }
@@ -19,19 +19,142 @@
 #include <ucommon/export.h>
 #include <ucommon/protocols.h>
 #include <ucommon/object.h>
+#include <ucommon/thread.h>
 #include <stdlib.h>
 #include <string.h>
 
 namespace ucommon {
 
+// The shared count keeps references in the upper bits and two state
+// flags in the low bits.  Merged means the shared count is the whole
+// count, and is how every unbiased object starts.  Queued means a biased
+// object has been handed back to its owner to merge.
+
+#define COUNT_MERGED    1u
+#define COUNT_QUEUED    2u
+#define COUNT_REF       4u
+
+static inline int refs(unsigned count)
+{
+    return (int)(count & ~3u) / 4;
+}
+
+#if defined(__ATOMIC_RELAXED)
+#define count_inc(p)    __atomic_fetch_add(p, COUNT_REF, __ATOMIC_RELAXED)
+#define count_dec(p)    __atomic_fetch_sub(p, COUNT_REF, __ATOMIC_ACQ_REL)
+#elif defined(__GNUC__)
+#define count_inc(p)    __sync_fetch_and_add(p, COUNT_REF)
+#define count_dec(p)    __sync_fetch_and_sub(p, COUNT_REF)
+#elif defined(_MSWINDOWS_)
+#define count_inc(p)    (unsigned)InterlockedExchangeAdd((LONG volatile *)(p), COUNT_REF)
+#define count_dec(p)    (unsigned)InterlockedExchangeAdd((LONG volatile *)(p), -(LONG)COUNT_REF)
+#else
+static unsigned count_add(volatile unsigned *p, unsigned change)
+{
+    unsigned prior;
+    Mutex::protect((void *)p);
+    prior = *p;
+    *p = prior + change;
+    Mutex::release((void *)p);
+    return prior;
+}
+
+#define count_inc(p)    count_add(p, COUNT_REF)
+#define count_dec(p)    count_add(p, 0u - COUNT_REF)
+#endif
+
+// Biased counting needs thread exit notification to merge what is left
+// with the owner, so it is only offered with native posix threads.
+
+#if defined(__ATOMIC_RELAXED) && !defined(_MSTHREADS_) && !defined(__PTH__)
+#define BIASED_COUNTING
+
+namespace {
+
+class owner_t
+{
+public:
+    CountedObject *volatile pending;
+    volatile unsigned objects;
+    volatile bool dead;
+    bool enabled;
+
+    owner_t() : pending(NULL), objects(1), dead(false), enabled(false) {}
+
+    inline void acquire(void)
+        {__atomic_fetch_add(&objects, 1, __ATOMIC_RELAXED);}
+
+    inline void release(void)
+        {if(__atomic_sub_fetch(&objects, 1, __ATOMIC_ACQ_REL) == 0) delete this;}
+};
+
+static pthread_key_t owners;
+static pthread_mutex_t owners_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool owners_keyed = false;
+
+} // namespace
+
+static inline bool keyed(void)
+{
+    return __atomic_load_n(&owners_keyed, __ATOMIC_ACQUIRE);
+}
+
+static inline owner_t *current(void)
+{
+    return (owner_t *)pthread_getspecific(owners);
+}
+
+static owner_t *attach(void (*exit)(void *))
+{
+    if(!keyed()) {
+        pthread_mutex_lock(&owners_lock);
+        if(!owners_keyed) {
+            pthread_key_create(&owners, exit);
+            __atomic_store_n(&owners_keyed, true, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&owners_lock);
+    }
+
+    owner_t *rec = current();
+    if(!rec) {
+        rec = new owner_t();
+        pthread_setspecific(owners, rec);
+    }
+    return rec;
+}
+
+#endif
+
 CountedObject::CountedObject()
 {
-    count = 0;
+    count = COUNT_MERGED;
+    local = 0;
+    owner = NULL;
+    deferred = NULL;
+
+#ifdef  BIASED_COUNTING
+    if(keyed()) {
+        owner_t *rec = current();
+        if(rec && rec->enabled)
+            bias();
+    }
+#endif
 }
 
 CountedObject::CountedObject(const ObjectProtocol &source)
 {
-    count = 0;
+    count = COUNT_MERGED;
+    local = 0;
+    owner = NULL;
+    deferred = NULL;
+
+#ifdef  BIASED_COUNTING
+    if(keyed()) {
+        owner_t *rec = current();
+        if(rec && rec->enabled)
+            bias();
+    }
+#endif
 }
 
 void CountedObject::dealloc(void)
@@ -39,20 +162,202 @@ void CountedObject::dealloc(void)
     delete this;
 }
 
+void CountedObject::reset(void)
+{
+    count = COUNT_MERGED;
+    local = 0;
+    owner = NULL;
+    deferred = NULL;
+}
+
 void CountedObject::retain(void)
 {
-    ++count;
+#ifdef  BIASED_COUNTING
+    if(owner && owner == current()) {
+        ++local;
+        return;
+    }
+#endif
+    count_inc(&count);
 }
 
 void CountedObject::release(void)
 {
-    if(count > 1) {
-        --count;
+#ifdef  BIASED_COUNTING
+    owner_t *rec = (owner_t *)owner;
+    if(rec && rec == current()) {
+        if(local > 1)
+            --local;
+        else
+            unbias();
+        if(rec->pending)
+            drain(rec);
         return;
     }
-    dealloc();
+
+    if(rec) {
+        unsigned prior = count, next;
+        do {
+            if(prior & COUNT_MERGED)
+                break;
+            next = prior - COUNT_REF;
+            if(refs(next) < 0)
+                next |= COUNT_QUEUED;
+        } while(!__atomic_compare_exchange_n(&count, &prior, next, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+        // still biased, so the owner holds the object for us; if we are
+        // the first to drive the shared count negative we hand it back.
+        if(!(prior & COUNT_MERGED)) {
+            if(!(prior & COUNT_QUEUED) && (next & COUNT_QUEUED))
+                defer(rec);
+            return;
+        }
+    }
+#endif
+
+    unsigned prior = count_dec(&count);
+    if(refs(prior) <= 1 && !(prior & COUNT_QUEUED))
+        dealloc();
+}
+
+#ifdef  BIASED_COUNTING
+
+void CountedObject::unbias(void)
+{
+    // the owner dropped its last local reference.  A queued object is
+    // left for drain, otherwise the shared count becomes the count.
+    owner_t *rec = (owner_t *)owner;
+    unsigned prior = count, next;
+    local = 0;
+    do {
+        if(prior & COUNT_QUEUED)
+            return;
+        next = prior | COUNT_MERGED;
+    } while(!__atomic_compare_exchange_n(&count, &prior, next, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    owner = NULL;
+    rec->release();
+    if(refs(next) <= 0)
+        dealloc();
+}
+
+void CountedObject::defer(void *owned)
+{
+    owner_t *rec = (owner_t *)owned;
+
+    // hold the owner record, which the owner might otherwise free once
+    // it merges us and exits.
+    rec->acquire();
+    deferred = rec->pending;
+    while(!__atomic_compare_exchange_n(&rec->pending, &deferred, this, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    if(__atomic_load_n(&rec->dead, __ATOMIC_SEQ_CST))
+        drain(rec);
+    rec->release();
+}
+
+void CountedObject::settle(void)
+{
+    // owner local references join the shared count, which is then final.
+    owner_t *rec = (owner_t *)owner;
+    __atomic_fetch_add(&count, local * COUNT_REF + COUNT_MERGED, __ATOMIC_ACQ_REL);
+    local = 0;
+    owner = NULL;
+    unsigned prior = __atomic_fetch_and(&count, ~COUNT_QUEUED, __ATOMIC_ACQ_REL);
+    rec->release();
+    if(refs(prior) <= 0)
+        dealloc();
+}
+
+void CountedObject::drain(void *owned)
+{
+    owner_t *rec = (owner_t *)owned;
+    CountedObject *list = __atomic_exchange_n(&rec->pending, (CountedObject *)NULL, __ATOMIC_SEQ_CST);
+
+    while(list) {
+        CountedObject *next = list->deferred;
+        list->deferred = NULL;
+        list->settle();
+        list = next;
+    }
 }
 
+void CountedObject::detach(void *owned)
+{
+    owner_t *rec = (owner_t *)owned;
+
+    // once dead, whoever hands an object back merges it themselves.
+    __atomic_store_n(&rec->dead, true, __ATOMIC_SEQ_CST);
+    drain(rec);
+    rec->release();
+}
+
+void CountedObject::bias(void)
+{
+    if(owner)
+        return;
+
+    owner_t *rec = attach(&detach);
+    local = (unsigned)refs(count);
+    count = 0;
+    rec->acquire();
+    owner = rec;
+}
+
+void CountedObject::biasing(bool enable)
+{
+    if(enable)
+        attach(&detach)->enabled = true;
+    else if(keyed() && current())
+        current()->enabled = false;
+}
+
+void CountedObject::merge(void)
+{
+    if(!keyed())
+        return;
+
+    owner_t *rec = current();
+    if(rec && rec->pending)
+        drain(rec);
+}
+
+#else
+
+void CountedObject::unbias(void)
+{
+}
+
+void CountedObject::defer(void *owned)
+{
+}
+
+void CountedObject::settle(void)
+{
+}
+
+void CountedObject::drain(void *owned)
+{
+}
+
+void CountedObject::detach(void *owned)
+{
+}
+
+void CountedObject::bias(void)
+{
+}
+
+void CountedObject::biasing(bool enable)
+{
+}
+
+void CountedObject::merge(void)
+{
+}
+
+#endif
+
 auto_object::auto_object(ObjectProtocol *o)
 {
     if(o)
@@ -119,12 +424,137 @@ void auto_object::operator=(ObjectProtocol *o)
     object = o;
 }
 
+// Sparse arrays are kept in pages of 64 slots, so each page has a single
+// population word.  A slot being constructed holds the busy marker until
+// its object is published.
+
+#define SPARSE_SHIFT    6
+#define SPARSE_PAGE     (1u << SPARSE_SHIFT)
+#define SPARSE_BUSY     ((ObjectProtocol *)(1))
+
+class __LOCAL SparseObjects::page
+{
+public:
+    ObjectProtocol *slots[SPARSE_PAGE];
+    uint64_t used;
+
+    inline page()
+        {memset(slots, 0, sizeof(slots)); used = 0;}
+};
+
+#if defined(__ATOMIC_ACQUIRE)
+#define sparse_load(p)          __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define sparse_store(p, v)      __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define sparse_cas(p, o, v)     __sync_bool_compare_and_swap(p, o, v)
+#define sparse_set(p, v)        __atomic_fetch_or(p, v, __ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+template<typename T>
+static inline T sparse_load(T *p)
+{
+    T value = *(volatile T *)p;
+    __sync_synchronize();
+    return value;
+}
+
+#define sparse_store(p, v)      do {__sync_synchronize(); *(p) = v;} while(0)
+#define sparse_cas(p, o, v)     __sync_bool_compare_and_swap(p, o, v)
+#define sparse_set(p, v)        __sync_fetch_and_or(p, v)
+#elif defined(_MSWINDOWS_)
+template<typename T>
+static inline T sparse_load(T *p)
+{
+    T value = *(volatile T *)p;
+    MemoryBarrier();
+    return value;
+}
+
+template<typename T>
+static inline bool sparse_cas(T **p, T *o, T *v)
+{
+    return InterlockedCompareExchangePointer((PVOID volatile *)p, v, o) == o;
+}
+
+#define sparse_store(p, v)      do {MemoryBarrier(); *(p) = v;} while(0)
+#define sparse_set(p, v)        InterlockedOr64((LONGLONG volatile *)(p), (LONGLONG)(v))
+#else
+template<typename T>
+static inline T sparse_load(T *p)
+{
+    Mutex::protect((void *)p);
+    T value = *p;
+    Mutex::release((void *)p);
+    return value;
+}
+
+template<typename T>
+static inline bool sparse_cas(T **p, T *o, T *v)
+{
+    bool result = false;
+    Mutex::protect((void *)p);
+    if(*p == o) {
+        *p = v;
+        result = true;
+    }
+    Mutex::release((void *)p);
+    return result;
+}
+
+template<typename T>
+static inline void sparse_store(T *p, T v)
+{
+    Mutex::protect((void *)p);
+    *p = v;
+    Mutex::release((void *)p);
+}
+
+static inline void sparse_set(uint64_t *p, uint64_t v)
+{
+    Mutex::protect((void *)p);
+    *p |= v;
+    Mutex::release((void *)p);
+}
+#endif
+
+static inline unsigned sparse_low(uint64_t bits)
+{
+#ifdef  __GNUC__
+    return (unsigned)__builtin_ctzll(bits);
+#else
+    unsigned pos = 0;
+    while(!(bits & 1)) {
+        bits >>= 1;
+        ++pos;
+    }
+    return pos;
+#endif
+}
+
+static inline unsigned sparse_count(uint64_t bits)
+{
+#ifdef  __GNUC__
+    return (unsigned)__builtin_popcountll(bits);
+#else
+    bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+    bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (unsigned)((bits * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+const unsigned SparseObjects::npos = (unsigned)(-1);
+
 SparseObjects::SparseObjects(unsigned m)
 {
     assert(m > 0);
     max = m;
-    vector = new ObjectProtocol *[m];
-    memset(vector, 0, sizeof(ObjectProtocol *) * m);
+
+    unsigned paging = (m + SPARSE_PAGE - 1) >> SPARSE_SHIFT;
+    pages = new page *[paging];
+    memset(pages, 0, sizeof(page *) * paging);
+
+    paging = (paging + 63) / 64;
+    present = new uint64_t[paging];
+    memset(present, 0, sizeof(uint64_t) * paging);
 }
 
 SparseObjects::~SparseObjects()
@@ -134,47 +564,142 @@ SparseObjects::~SparseObjects()
 
 void SparseObjects::purge(void)
 {
-    if(!vector)
+    if(!pages)
         return;
 
-    for(unsigned pos = 0; pos < max; ++ pos) {
-        if(vector[pos])
-            vector[pos]->release();
+    unsigned paging = (max + SPARSE_PAGE - 1) >> SPARSE_SHIFT;
+    for(unsigned index = 0; index < paging; ++index) {
+        page *pg = pages[index];
+        if(!pg)
+            continue;
+        for(unsigned slot = 0; slot < SPARSE_PAGE; ++slot) {
+            if(pg->slots[slot] && pg->slots[slot] != SPARSE_BUSY)
+                pg->slots[slot]->release();
+        }
+        delete pg;
     }
-    delete[] vector;
-    vector = NULL;
+    delete[] pages;
+    delete[] present;
+    pages = NULL;
+    present = NULL;
 }
 
-unsigned SparseObjects::count(void)
+unsigned SparseObjects::count(void) const
 {
     unsigned c = 0;
-    for(unsigned pos = 0; pos < max; ++pos) {
-        if(vector[pos])
-            ++c;
+
+    if(!pages)
+        return 0;
+
+    unsigned words = (((max + SPARSE_PAGE - 1) >> SPARSE_SHIFT) + 63) / 64;
+    for(unsigned word = 0; word < words; ++word) {
+        uint64_t bits = sparse_load(&present[word]);
+        while(bits) {
+            unsigned index = word * 64 + sparse_low(bits);
+            bits &= bits - 1;
+            c += sparse_count(sparse_load(&pages[index]->used));
+        }
     }
     return c;
 }
 
+unsigned SparseObjects::scan(unsigned offset) const
+{
+    if(!pages || offset >= max)
+        return npos;
+
+    unsigned words = (((max + SPARSE_PAGE - 1) >> SPARSE_SHIFT) + 63) / 64;
+    unsigned index = offset >> SPARSE_SHIFT;
+    unsigned word = index / 64;
+    uint64_t bits = sparse_load(&present[word]) & (~0ull << (index % 64));
+    uint64_t mask = ~0ull << (offset % SPARSE_PAGE);
+
+    for(;;) {
+        while(bits) {
+            index = word * 64 + sparse_low(bits);
+            bits &= bits - 1;
+            uint64_t used = sparse_load(&pages[index]->used);
+            if(index == (offset >> SPARSE_SHIFT))
+                used &= mask;
+            if(used)
+                return (index << SPARSE_SHIFT) + sparse_low(used);
+        }
+        if(++word >= words)
+            return npos;
+        bits = sparse_load(&present[word]);
+    }
+}
+
 ObjectProtocol *SparseObjects::invalid(void) const
 {
     return NULL;
 }
 
+SparseObjects::page *SparseObjects::fetch(unsigned pos)
+{
+    unsigned index = pos >> SPARSE_SHIFT;
+    page *pg = sparse_load(&pages[index]);
+
+    if(pg)
+        return pg;
+
+    // racing threads may each build a page; only one is published.
+    pg = new page;
+    if(sparse_cas(&pages[index], (page *)NULL, pg)) {
+        sparse_set(&present[index / 64], (uint64_t)1 << (index % 64));
+        return pg;
+    }
+    delete pg;
+    return sparse_load(&pages[index]);
+}
+
+ObjectProtocol *SparseObjects::find(unsigned pos) const
+{
+    if(!pages || pos >= max)
+        return NULL;
+
+    page *pg = sparse_load(&pages[pos >> SPARSE_SHIFT]);
+    if(!pg)
+        return NULL;
+
+    ObjectProtocol *obj = sparse_load(&pg->slots[pos % SPARSE_PAGE]);
+    if(obj == SPARSE_BUSY)
+        return NULL;
+    return obj;
+}
+
 ObjectProtocol *SparseObjects::get(unsigned pos)
 {
     ObjectProtocol *obj;
 
-    if(pos >= max)
+    if(!pages || pos >= max)
         return invalid();
 
-    if(!vector[pos]) {
-        obj = create();
-        if(!obj)
-            return invalid();
-        obj->retain();
-        vector[pos] = obj;
+    page *pg = fetch(pos);
+    ObjectProtocol **slot = &pg->slots[pos % SPARSE_PAGE];
+
+    for(;;) {
+        obj = sparse_load(slot);
+        if(obj && obj != SPARSE_BUSY)
+            return obj;
+
+        if(!obj && sparse_cas(slot, (ObjectProtocol *)NULL, SPARSE_BUSY))
+            break;
+
+        // another thread is creating the member; wait for it
+        if(obj == SPARSE_BUSY)
+            Thread::yield();
+    }
+
+    obj = create();
+    if(!obj) {
+        sparse_store(slot, (ObjectProtocol *)NULL);
+        return invalid();
     }
-    return vector[pos];
+    obj->retain();
+    sparse_store(slot, obj);
+    sparse_set(&pg->used, (uint64_t)1 << (pos % SPARSE_PAGE));
+    return obj;
 }
 
 } // namespace ucommon
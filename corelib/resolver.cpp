@@ -0,0 +1,717 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ucommon-config.h>
+#include <ucommon/export.h>
+#include <ucommon/linked.h>
+#include <ucommon/string.h>
+#include <ucommon/thread.h>
+#include <ucommon/timers.h>
+#include <ucommon/socket.h>
+#include <ucommon/executor.h>
+#include <ucommon/resolver.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#ifndef _MSWINDOWS_
+#include <arpa/inet.h>
+#endif
+
+#ifndef EAI_NONAME
+#define EAI_NONAME      -2
+#endif
+
+namespace ucommon {
+
+#define RESOLVER_INDEX      97
+#define RESOLVER_TTL        30000
+#define RESOLVER_NEGATIVE   5000
+#define RESOLVER_LIMIT      1024
+#define RESOLVER_THREADS    2
+
+#ifdef  HAVE_GETADDRINFO
+
+// A cached lookup is keyed by its hints, service and host name.  While the
+// first lookup of a name is pending, other lookups of it wait for its
+// result rather than query the system resolver themselves.
+
+class __LOCAL resolver_entry : public NamedObject
+{
+public:
+    struct addrinfo *list;
+    int error;
+    Timer::tick_t expires;
+    bool pending, refreshing;
+
+    resolver_entry(NamedObject **index, char *key) :
+    NamedObject(index, key, RESOLVER_INDEX)
+        {list = NULL; error = 0; expires = 0; pending = true; refreshing = false;}
+
+    ~resolver_entry()
+        {if(list) ::freeaddrinfo(list);}
+};
+
+class __LOCAL resolver_host : public NamedObject
+{
+public:
+    char *address;
+
+    resolver_host(NamedObject **index, char *name, const char *addr) :
+    NamedObject(index, name, RESOLVER_INDEX)
+        {address = strdup(addr);}
+
+    ~resolver_host()
+        {free(address);}
+};
+
+// Cache hits are answered with copies made here rather than by the system
+// getaddrinfo, and only glibc and the BSDs lay out their lists so that the
+// system freeaddrinfo could free ours.  Each copied node is recorded until
+// Resolver::release frees it; any other list goes to freeaddrinfo.
+
+class __LOCAL resolver_node
+{
+public:
+    struct addrinfo info;
+    resolver_node *next;
+    struct sockaddr_storage addr;
+};
+
+class __LOCAL resolver_cache : public Conditional
+{
+private:
+    NamedObject *entries[RESOLVER_INDEX];
+    NamedObject *names[RESOLVER_INDEX];
+    resolver_node *copies[RESOLVER_INDEX];
+    unsigned count;
+    Executor *pool;
+    Mutex copying;
+
+    void drop(resolver_entry *entry);
+    void sweep(Timer::tick_t now);
+    void refresh(const char *key, const char *host, const char *service, const struct addrinfo *hint);
+    struct addrinfo *copy(const struct addrinfo *list);
+    bool forget(struct addrinfo *node);
+
+public:
+    timeout_t ttl, negative;
+    unsigned limit;
+    bool only;
+    unsigned long hits, misses;
+
+    resolver_cache();
+    ~resolver_cache();
+
+    int lookup(const char *host, const char *service, const struct addrinfo *hint, struct addrinfo **result);
+    void update(const char *key, int error, struct addrinfo *list);
+    void assign(const char *host, const char *address);
+    void configure(timeout_t ttl, timeout_t negative, unsigned limit);
+    void flush(void);
+    void submit(Executor::task *task);
+    void release(struct addrinfo *list);
+};
+
+class __LOCAL resolver_refresh : public Executor::task
+{
+public:
+    char *key, *host, *service;
+    struct addrinfo hint;
+
+    resolver_refresh(const char *id, const char *name, const char *svc, const struct addrinfo *hp);
+    ~resolver_refresh();
+
+    void run(void);
+};
+
+static resolver_cache table;
+
+static void resolver_name(char *buf, size_t size, const char *host)
+{
+    String::set(buf, size, host);
+    String::lower(buf);
+}
+
+// address literals are parsed, never looked up, so they are not cached.
+
+static bool resolver_numeric(const char *host)
+{
+#ifdef  _MSWINDOWS_
+    struct sockaddr_storage saddr;
+    int slen = sizeof(saddr);
+
+    if(!WSAStringToAddress((LPSTR)host, AF_INET, NULL, (struct sockaddr *)&saddr, &slen))
+        return true;
+#ifdef  AF_INET6
+    slen = sizeof(saddr);
+    if(!WSAStringToAddress((LPSTR)host, AF_INET6, NULL, (struct sockaddr *)&saddr, &slen))
+        return true;
+#endif
+#else
+    unsigned char addr[16];
+
+    if(inet_pton(AF_INET, host, addr) > 0)
+        return true;
+#ifdef  AF_INET6
+    if(inet_pton(AF_INET6, host, addr) > 0)
+        return true;
+#endif
+#endif
+    return false;
+}
+
+resolver_refresh::resolver_refresh(const char *id, const char *name, const char *svc, const struct addrinfo *hp) :
+Executor::task(true)
+{
+    key = strdup(id);
+    host = strdup(name);
+    service = NULL;
+    if(svc)
+        service = strdup(svc);
+    memcpy(&hint, hp, sizeof(hint));
+}
+
+resolver_refresh::~resolver_refresh()
+{
+    free(key);
+    free(host);
+    if(service)
+        free(service);
+}
+
+void resolver_refresh::run(void)
+{
+    struct addrinfo *list = NULL;
+    int error = ::getaddrinfo(host, service, &hint, &list);
+    table.update(key, error, list);
+}
+
+resolver_cache::resolver_cache() :
+Conditional()
+{
+    memset(entries, 0, sizeof(entries));
+    memset(names, 0, sizeof(names));
+    memset(copies, 0, sizeof(copies));
+    count = 0;
+    pool = NULL;
+    ttl = RESOLVER_TTL;
+    negative = RESOLVER_NEGATIVE;
+    limit = RESOLVER_LIMIT;
+    only = false;
+    hits = misses = 0;
+}
+
+resolver_cache::~resolver_cache()
+{
+    if(pool)
+        delete pool;
+
+    flush();
+    for(unsigned pos = 0; pos < RESOLVER_INDEX; ++pos) {
+        while(names[pos]) {
+            resolver_host *node = static_cast<resolver_host *>(names[pos]);
+            names[pos] = node->getNext();
+            delete node;
+        }
+    }
+}
+
+void resolver_cache::submit(Executor::task *task)
+{
+    lock();
+    if(!pool)
+        pool = new Executor(RESOLVER_THREADS);
+    unlock();
+    pool->submit(task);
+}
+
+static unsigned resolver_slot(const void *node)
+{
+    return (unsigned)(((size_t)node / sizeof(resolver_node)) % RESOLVER_INDEX);
+}
+
+struct addrinfo *resolver_cache::copy(const struct addrinfo *list)
+{
+    struct addrinfo *first = NULL, *last = NULL;
+
+    copying.acquire();
+    while(list) {
+        resolver_node *node = (resolver_node *)malloc(sizeof(resolver_node));
+        unsigned slot = resolver_slot(node);
+
+        memcpy(&node->info, list, sizeof(struct addrinfo));
+        memcpy(&node->addr, list->ai_addr, list->ai_addrlen);
+        node->info.ai_addr = (struct sockaddr *)&node->addr;
+        if(list->ai_canonname)
+            node->info.ai_canonname = strdup(list->ai_canonname);
+        node->info.ai_next = NULL;
+        node->next = copies[slot];
+        copies[slot] = node;
+
+        if(last)
+            last->ai_next = &node->info;
+        else
+            first = &node->info;
+        last = &node->info;
+        list = list->ai_next;
+    }
+    copying.release();
+    return first;
+}
+
+// called with copying held; true if the node was one of our copies.
+
+bool resolver_cache::forget(struct addrinfo *node)
+{
+    resolver_node **prior = &copies[resolver_slot(node)];
+
+    while(*prior) {
+        if(&(*prior)->info == node) {
+            *prior = (*prior)->next;
+            return true;
+        }
+        prior = &(*prior)->next;
+    }
+    return false;
+}
+
+void resolver_cache::release(struct addrinfo *list)
+{
+    struct addrinfo *run = NULL, *last = NULL, *next;
+
+    // a list may join our copies with system lists, as Socket::address
+    // does, so runs of system nodes are cut out and freed by the system.
+    copying.acquire();
+    while(list) {
+        next = list->ai_next;
+        if(forget(list)) {
+            if(run) {
+                last->ai_next = NULL;
+                ::freeaddrinfo(run);
+                run = NULL;
+            }
+            if(list->ai_canonname)
+                free(list->ai_canonname);
+            free(list);
+        }
+        else {
+            if(!run)
+                run = list;
+            last = list;
+        }
+        list = next;
+    }
+    copying.release();
+
+    if(run)
+        ::freeaddrinfo(run);
+}
+
+void resolver_cache::drop(resolver_entry *entry)
+{
+    NamedObject::remove(entries, entry->getId(), RESOLVER_INDEX);
+    --count;
+    delete entry;
+}
+
+void resolver_cache::sweep(Timer::tick_t now)
+{
+    for(unsigned pos = 0; pos < RESOLVER_INDEX; ++pos) {
+        resolver_entry *node = static_cast<resolver_entry *>(entries[pos]);
+        while(node) {
+            resolver_entry *next = static_cast<resolver_entry *>(node->getNext());
+            if(!node->pending && node->expires <= now)
+                drop(node);
+            node = next;
+        }
+    }
+}
+
+void resolver_cache::flush(void)
+{
+    lock();
+    sweep(~((Timer::tick_t)0));
+    unlock();
+}
+
+void resolver_cache::configure(timeout_t timeout, timeout_t failed, unsigned max)
+{
+    lock();
+    ttl = timeout;
+    negative = failed;
+    limit = max;
+    sweep(~((Timer::tick_t)0));
+    unlock();
+}
+
+// called locked; names in active use are refreshed ahead of expiring so
+// that lookups keep being answered from the cache.
+
+void resolver_cache::refresh(const char *key, const char *host, const char *service, const struct addrinfo *hint)
+{
+    resolver_refresh *task = new resolver_refresh(key, host, service, hint);
+
+    if(!pool)
+        pool = new Executor(RESOLVER_THREADS);
+
+    pool->submit(task);
+}
+
+void resolver_cache::update(const char *key, int error, struct addrinfo *list)
+{
+    lock();
+    resolver_entry *entry = static_cast<resolver_entry *>(NamedObject::map(entries, key, RESOLVER_INDEX));
+    if(entry && !entry->pending && entry->refreshing) {
+        entry->refreshing = false;
+        // a failed refresh leaves the prior result until it expires
+        if(!error && list) {
+            if(entry->list)
+                ::freeaddrinfo(entry->list);
+            entry->list = list;
+            entry->error = 0;
+            entry->expires = Timer::ticks() + (Timer::tick_t)ttl * 10000;
+            list = NULL;
+        }
+    }
+    unlock();
+
+    if(list)
+        ::freeaddrinfo(list);
+}
+
+int resolver_cache::lookup(const char *host, const char *service, const struct addrinfo *hp, struct addrinfo **result)
+{
+    struct addrinfo hint, *list = NULL;
+    char name[256], key[320];
+    resolver_entry *entry = NULL;
+    Timer::tick_t now;
+    int error;
+
+    *result = NULL;
+    memset(&hint, 0, sizeof(hint));
+    if(hp) {
+        hint.ai_flags = hp->ai_flags;
+        hint.ai_family = hp->ai_family;
+        hint.ai_socktype = hp->ai_socktype;
+        hint.ai_protocol = hp->ai_protocol;
+    }
+
+    if(!host || !*host || (hint.ai_flags & AI_NUMERICHOST) || resolver_numeric(host))
+        return ::getaddrinfo(host, service, hp, result);
+
+    resolver_name(name, sizeof(name), host);
+
+    lock();
+    resolver_host *local = static_cast<resolver_host *>(NamedObject::map(names, name, RESOLVER_INDEX));
+    if(local) {
+        String::set(name, sizeof(name), local->address);
+        unlock();
+        hint.ai_flags |= AI_NUMERICHOST;
+        return ::getaddrinfo(name, service, &hint, result);
+    }
+
+    if(only) {
+        unlock();
+        return EAI_NONAME;
+    }
+
+    if(!ttl) {
+        unlock();
+        return ::getaddrinfo(host, service, hp, result);
+    }
+
+    snprintf(key, sizeof(key), "%d/%d/%d/%x/%s/%s", hint.ai_family, hint.ai_socktype,
+        hint.ai_protocol, hint.ai_flags, service ? service : "", name);
+
+    for(;;) {
+        entry = static_cast<resolver_entry *>(NamedObject::map(entries, key, RESOLVER_INDEX));
+        if(!entry)
+            break;
+
+        if(entry->pending) {
+            wait();
+            continue;
+        }
+
+        now = Timer::ticks();
+        if(entry->expires <= now) {
+            drop(entry);
+            entry = NULL;
+            break;
+        }
+
+        ++hits;
+        if(!entry->error && !entry->refreshing && (entry->expires - now) * 4 < (Timer::tick_t)ttl * 10000) {
+            entry->refreshing = true;
+            refresh(key, host, service, &hint);
+        }
+
+        error = entry->error;
+        if(!error)
+            *result = copy(entry->list);
+        unlock();
+        return error;
+    }
+
+    ++misses;
+    if(count >= limit)
+        sweep(Timer::ticks());
+
+    if(count < limit) {
+        entry = new resolver_entry(entries, strdup(key));
+        ++count;
+    }
+    unlock();
+
+    error = ::getaddrinfo(host, service, hp, &list);
+
+    if(!entry) {
+        *result = list;
+        return error;
+    }
+
+    lock();
+    entry->pending = false;
+    broadcast();
+    if(!error && list) {
+        entry->list = list;
+        entry->expires = Timer::ticks() + (Timer::tick_t)ttl * 10000;
+        *result = copy(list);
+    }
+    else if(negative) {
+        // failed lookups are cached briefly so a dead name does not stall
+        // every caller in turn
+        entry->error = error ? error : EAI_NONAME;
+        entry->expires = Timer::ticks() + (Timer::tick_t)negative * 10000;
+        if(list)
+            ::freeaddrinfo(list);
+    }
+    else {
+        drop(entry);
+        *result = list;
+    }
+    unlock();
+    return error;
+}
+
+void resolver_cache::assign(const char *host, const char *address)
+{
+    char name[256];
+
+    resolver_name(name, sizeof(name), host);
+
+    lock();
+    resolver_host *node = static_cast<resolver_host *>(NamedObject::remove(names, name, RESOLVER_INDEX));
+    if(node)
+        delete node;
+    if(address)
+        new resolver_host(names, strdup(name), address);
+    unlock();
+}
+
+int Resolver::query(const char *host, const char *service, const struct addrinfo *hint, struct addrinfo **result)
+{
+    return table.lookup(host, service, hint, result);
+}
+
+void Resolver::release(struct addrinfo *list)
+{
+    if(list)
+        table.release(list);
+}
+
+void Resolver::cache(timeout_t ttl, timeout_t negative, unsigned limit)
+{
+    table.configure(ttl, negative, limit);
+}
+
+void Resolver::flush(void)
+{
+    table.flush();
+}
+
+void Resolver::assign(const char *host, const char *address)
+{
+    assert(host != NULL && *host != 0);
+
+    table.assign(host, address);
+}
+
+void Resolver::local(bool enable)
+{
+    table.only = enable;
+}
+
+unsigned long Resolver::hits(void)
+{
+    return table.hits;
+}
+
+unsigned long Resolver::misses(void)
+{
+    return table.misses;
+}
+
+#else
+
+// without getaddrinfo the socket layer resolves names itself, and there
+// is no cache to control.
+
+class __LOCAL resolver_cache
+{
+public:
+    Executor *pool;
+    Mutex lock;
+
+    resolver_cache()
+        {pool = NULL;}
+
+    ~resolver_cache()
+        {if(pool) delete pool;}
+
+    void submit(Executor::task *task) {
+        lock.acquire();
+        if(!pool)
+            pool = new Executor(RESOLVER_THREADS);
+        lock.release();
+        pool->submit(task);
+    }
+};
+
+static resolver_cache table;
+
+int Resolver::query(const char *host, const char *service, const struct addrinfo *hint, struct addrinfo **result)
+{
+    *result = Socket::query(host, service, hint ? hint->ai_socktype : 0, hint ? hint->ai_protocol : 0);
+    if(!*result)
+        return EAI_NONAME;
+    return 0;
+}
+
+void Resolver::release(struct addrinfo *list)
+{
+    Socket::release(list);
+}
+
+void Resolver::cache(timeout_t ttl, timeout_t negative, unsigned limit)
+{
+}
+
+void Resolver::flush(void)
+{
+}
+
+void Resolver::assign(const char *host, const char *address)
+{
+}
+
+void Resolver::local(bool enable)
+{
+}
+
+unsigned long Resolver::hits(void)
+{
+    return 0;
+}
+
+unsigned long Resolver::misses(void)
+{
+    return 0;
+}
+
+#endif
+
+bool Resolver::hosts(const char *path)
+{
+    char buf[512];
+    FILE *fp = fopen(path, "r");
+
+    if(!fp)
+        return false;
+
+    while(fgets(buf, sizeof(buf), fp)) {
+        char *tokens = NULL;
+        const char *address = String::token(buf, &tokens, " \t\r\n", NULL, "#");
+        const char *name;
+
+        if(!address)
+            continue;
+
+        while(NULL != (name = String::token(buf, &tokens, " \t\r\n", NULL, "#")))
+            assign(name, address);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+void Resolver::resolve(request *req, const char *host, const char *service, int type, int protocol)
+{
+    assert(req != NULL);
+    assert(host != NULL && *host != 0);
+    assert(!req->is_pending());
+
+    if(req->list)
+        Socket::release(req->list);
+    req->list = NULL;
+    if(req->host)
+        free(req->host);
+    if(req->service)
+        free(req->service);
+
+    req->host = strdup(host);
+    req->service = NULL;
+    if(service)
+        req->service = strdup(service);
+    req->type = type;
+    req->protocol = protocol;
+
+    table.submit(req);
+}
+
+Resolver::request::request(bool release) :
+Executor::task(release)
+{
+    host = service = NULL;
+    type = SOCK_STREAM;
+    protocol = 0;
+    list = NULL;
+}
+
+Resolver::request::~request()
+{
+    if(list)
+        Socket::release(list);
+    if(host)
+        free(host);
+    if(service)
+        free(service);
+}
+
+void Resolver::request::run(void)
+{
+    list = Socket::query(host, service, type, protocol);
+}
+
+struct addrinfo *Resolver::request::take(void)
+{
+    struct addrinfo *result = list;
+    list = NULL;
+    return result;
+}
+
+} // namespace ucommon
@@ -46,6 +46,14 @@
 #ifdef  HAVE_TERMIO_H
 #include <termio.h>
 #endif
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP)
+#define USE_SPAWN
+#include <spawn.h>
+#ifdef  __APPLE__
+#include <crt_externs.h>
+#define environ (*_NSGetEnviron())
+#endif
+#endif
 #endif
 
 #ifdef  HAVE_SYS_RESOURCE_H
@@ -1697,10 +1705,130 @@ const char *shell::env(const char *id, const char *value)
     return value;
 }
 
+#ifdef  USE_SPAWN
+
+// children are launched with posix_spawn, which shares our memory until the
+// child execs rather than copying the page tables of a large process.  The
+// environment is merged in the parent as it cannot be changed in the child.
+
+static char **environment(char **envp)
+{
+    unsigned count = 0, added = 0, pos, index;
+
+    while(environ && environ[count])
+        ++count;
+    while(envp[added])
+        ++added;
+
+    char **env = (char **)malloc(sizeof(char *) * (count + added + 1));
+    if(!env)
+        return NULL;
+
+    for(pos = 0; pos < count; ++pos)
+        env[pos] = environ[pos];
+
+    for(pos = 0; pos < added; ++pos) {
+        const char *ep = strchr(envp[pos], '=');
+        if(!ep)
+            continue;
+        size_t len = (size_t)(ep - envp[pos]) + 1;
+        for(index = 0; index < count; ++index) {
+            if(!strncmp(env[index], envp[pos], len))
+                break;
+        }
+        env[index] = envp[pos];
+        if(index == count)
+            ++count;
+    }
+    env[count] = NULL;
+    return env;
+}
+
+static pid_t launch(const char *path, char **argv, char **envp, fd_t *stdio, bool detached, int *error)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t defaults;
+    short flags = POSIX_SPAWN_SETSIGDEF;
+    char **env = environ;
+    pid_t pid = -1;
+    int fd;
+
+    if(envp && *envp) {
+        env = environment(envp);
+        if(!env) {
+            *error = ENOMEM;
+            return -1;
+        }
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    // stdio is remapped and everything above it closed, as when forked
+    for(fd = 0; fd < 3; ++fd) {
+        if(stdio && stdio[fd] != INVALID_HANDLE_VALUE)
+            posix_spawn_file_actions_adddup2(&actions, stdio[fd], fd);
+        else if(detached)
+            posix_spawn_file_actions_addopen(&actions, fd, "/dev/null", O_RDWR, 0);
+    }
+    posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGCHLD);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGHUP);
+    sigaddset(&defaults, SIGABRT);
+    sigaddset(&defaults, SIGUSR1);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+
+    if(detached) {
+#ifdef  POSIX_SPAWN_SETSID
+        flags |= POSIX_SPAWN_SETSID;
+#else
+        flags |= POSIX_SPAWN_SETPGROUP;
+#endif
+    }
+#ifdef  POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    if(strchr(path, '/'))
+        *error = posix_spawn(&pid, path, &actions, &attr, argv, env);
+    else
+        *error = posix_spawnp(&pid, path, &actions, &attr, argv, env);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if(env != environ)
+        free(env);
+
+    if(*error)
+        return -1;
+    return pid;
+}
+
+#endif
+
 int shell::system(const char *cmd, const char **envp)
 {
     assert(cmd != NULL);
 
+#ifdef  USE_SPAWN
+    char *argv[] = {(char *)"sh", (char *)"-c", (char *)cmd, NULL};
+    int status, error;
+
+    pid_t pid = launch("/bin/sh", argv, (char **)envp, NULL, false, &error);
+    if(pid < 0)
+        return -1;
+
+    if(::waitpid(pid, &status, 0) != pid)
+        status = -1;
+    return status;
+#else
     char symname[129];
     const char *cp;
     char *ep;
@@ -1748,6 +1876,7 @@ int shell::system(const char *cmd, const char **envp)
     ::signal(SIGUSR1, SIG_DFL);
     ::execlp("/bin/sh", "sh", "-c", cmd, NULL);
     ::exit(-1);
+#endif
 }
 
 void shell::restart(void)
@@ -1927,6 +2056,12 @@ void shell::detach(mainproc_t entry)
 
 int shell::detach(const char *path, char **argv, char **envp, fd_t *stdio)
 {
+#ifdef  USE_SPAWN
+    int error;
+
+    launch(path, argv, envp, stdio, true, &error);
+    return error;
+#else
     char symname[129];
     const char *cp;
     char *ep;
@@ -2030,15 +2165,28 @@ int shell::detach(const char *path, char **argv, char **envp, fd_t *stdio)
     else
         execvp(path, argv);
     exit(-1);
+#endif
 }
 
 
 shell::pid_t shell::spawn(const char *path, char **argv, char **envp, fd_t *stdio)
 {
+#ifdef  USE_SPAWN
+    int error;
+
+    pid_t pid = launch(path, argv, envp, stdio, false, &error);
+    if(pid < 0) {
+        errno = error;
+        return INVALID_PID_VALUE;
+    }
+    return pid;
+#else
     char symname[129];
     const char *cp;
     char *ep;
-    int fd;
+    int fd, error;
+    int report[2];
+    ssize_t result;
 
     int max = sizeof(fd_set) * 8;
 #ifdef  RLIMIT_NOFILE
@@ -2048,12 +2196,35 @@ shell::pid_t shell::spawn(const char *path, char **argv, char **envp, fd_t *stdi
         max = rlim.rlim_max;
 #endif
 
+    // the child writes errno here if exec fails, and a successful exec
+    // closes it, so the parent can tell the two apart.
+    if(::pipe(report))
+        return INVALID_PID_VALUE;
+
+    ::fcntl(report[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(report[1], F_SETFD, FD_CLOEXEC);
+
     pid_t pid = fork();
-    if(pid < 0)
+    if(pid < 0) {
+        ::close(report[0]);
+        ::close(report[1]);
         return INVALID_PID_VALUE;
+    }
 
-    if(pid > 0)
-        return pid;
+    if(pid > 0) {
+        ::close(report[1]);
+        do {
+            result = ::read(report[0], &error, sizeof(error));
+        } while(result < 0 && errno == EINTR);
+        ::close(report[0]);
+
+        if(result != (ssize_t)sizeof(error))
+            return pid;
+
+        ::waitpid(pid, NULL, 0);
+        errno = error;
+        return INVALID_PID_VALUE;
+    }
 
     ::signal(SIGQUIT, SIG_DFL);
     ::signal(SIGINT, SIG_DFL);
@@ -2068,8 +2239,10 @@ shell::pid_t shell::spawn(const char *path, char **argv, char **envp, fd_t *stdi
             ::dup2(stdio[fd], fd);
     }
 
-    for(fd = 3; fd < max; ++fd)
-        ::close(fd);
+    for(fd = 3; fd < max; ++fd) {
+        if(fd != report[1])
+            ::close(fd);
+    }
 
     while(envp && *envp) {
         String::set(symname, sizeof(symname), *envp);
@@ -2087,7 +2260,12 @@ shell::pid_t shell::spawn(const char *path, char **argv, char **envp, fd_t *stdi
         execv(path, argv);
     else
         execvp(path, argv);
+    error = errno;
+    do {
+        result = ::write(report[1], &error, sizeof(error));
+    } while(result < 0 && errno == EINTR);
     exit(-1);
+#endif
 }
 
 int shell::wait(shell::pid_t pid)
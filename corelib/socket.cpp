@@ -20,12 +20,15 @@
 #include <ucommon/socket.h>
 #include <ucommon/string.h>
 #include <ucommon/thread.h>
+#include <ucommon/fiber.h>
+#include <ucommon/resolver.h>
 #include <ucommon/fsys.h>
 #ifndef _MSWINDOWS_
 #include <net/if.h>
 #include <sys/un.h>
 #include <sys/ioctl.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 #else
 #define HAVE_GETADDRINFO 1
 #endif
@@ -58,6 +61,42 @@
 #define IP_MTU 14
 #endif
 
+#ifdef  __linux__
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#include <linux/filter.h>
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+#include <linux/errqueue.h>
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+#ifdef  HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#endif
+
 #ifndef MSG_DONTWAIT
 #define MSG_DONTWAIT 0
 #endif
@@ -138,6 +177,20 @@ struct addrinfo {
 #define _getpeername_(so, addr, alen) ::getpeername(so, addr, alen)
 #define _bind_(so, addr, alen) ::bind(so, addr, alen)
 #define _listen_(so, count) ::listen(so, count)
+#elif !defined(_MSWINDOWS_)
+// calls that would block park the calling fiber rather than its thread
+#define _send_(so, buf, bytes, flag) Fiber::send(so, buf, bytes, flag)
+#define _recv_(so, buf, bytes, flag) Fiber::recv(so, buf, bytes, flag)
+#define _sendto_(so, buf, bytes, flag, to, tolen) Fiber::sendto(so, buf, bytes, flag, to, tolen)
+#define _recvfrom_(so, buf, bytes, flag, from, fromlen) Fiber::recvfrom(so, buf, bytes, flag, from, fromlen)
+#define _connect_(so, addr, addrlen) Fiber::connect(so, addr, addrlen)
+#define _accept_(so, addr, addrlen) Fiber::accept(so, addr, addrlen)
+#define _select_(cnt, rfd, wfd, efd, timeout) ::select(cnt, rfd, wfd, efd, timeout)
+#define _poll_(fds, cnt, timeout) ::poll(fds, cnt, timeout)
+#define _getsockname_(so, addr, alen) ::getsockname(so, addr, alen)
+#define _getpeername_(so, addr, alen) ::getpeername(so, addr, alen)
+#define _bind_(so, addr, alen) ::bind(so, addr, alen)
+#define _listen_(so, count) ::listen(so, count)
 #else
 #define _send_(so, buf, bytes, flag) ::send(so, buf, bytes, flag)
 #define _recv_(so, buf, bytes, flag) ::recv(so, buf, bytes, flag)
@@ -430,6 +483,15 @@ static int getaddrinfo(const char *hostname, const char *servname, const struct
 }
 #endif
 
+// host names are looked up through the resolver cache
+#ifdef  HAVE_GETADDRINFO
+#define _getaddrinfo_(host, svc, hint, res) Resolver::query(host, svc, hint, res)
+#define _freeaddrinfo_(list) Resolver::release(list)
+#else
+#define _getaddrinfo_(host, svc, hint, res) getaddrinfo(host, svc, hint, res)
+#define _freeaddrinfo_(list) freeaddrinfo(list)
+#endif
+
 #if defined(AF_UNIX) && !defined(_MSWINDOWS_)
 
 static socklen_t unixaddr(struct sockaddr_un *addr, const char *path)
@@ -961,7 +1023,7 @@ Socket::address::address(int family, const char *host, const char *svc)
     list = NULL;
     memset(&hint, 0, sizeof(hint));
     hint.ai_family = family;
-    getaddrinfo(host, svc, &hint, &list);
+    _getaddrinfo_(host, svc, &hint, &list);
 }
 
 Socket::address::address(const in_addr& address, in_port_t port) : list(NULL)
@@ -1018,7 +1080,7 @@ Socket::address::~address()
 void Socket::address::clear(void)
 {
     if(list) {
-        freeaddrinfo(list);
+        _freeaddrinfo_(list);
         list = NULL;
     }
 }
@@ -1026,7 +1088,7 @@ void Socket::address::clear(void)
 void Socket::release(struct addrinfo *list)
 {
     if(list)
-        freeaddrinfo(list);
+        _freeaddrinfo_(list);
 }
 
 struct ::addrinfo *Socket::query(const char *hp, const char *svc, int type, int protocol)
@@ -1098,7 +1160,7 @@ struct ::addrinfo *Socket::query(const char *hp, const char *svc, int type, int
 #endif
 
     struct addrinfo *result = NULL;
-    getaddrinfo(host, svc, &hint, &result);
+    _getaddrinfo_(host, svc, &hint, &result);
     return result;
 }
 
@@ -1189,7 +1251,7 @@ proc:
         hint.ai_flags |= AI_V4MAPPED;
 #endif
 
-    getaddrinfo(host, svc, &hint, &list);
+    _getaddrinfo_(host, svc, &hint, &list);
 }
 
 struct sockaddr *Socket::address::get(void) const
@@ -1277,7 +1339,7 @@ bool Socket::address::remove(const struct sockaddr *addr)
         prior->ai_next = node->ai_next;
 
     node->ai_next = NULL;
-    freeaddrinfo(node);
+    _freeaddrinfo_(node);
     return true;
 }
 
@@ -2019,6 +2081,589 @@ ssize_t Socket::sendto(socket_t so, const void *data, size_t dlen, int flags, co
     return _sendto_(so, (caddr_t)data, dlen, MSG_NOSIGNAL | flags, dest, slen);
 }
 
+// batches are sent and received in chunks of up to this many datagrams,
+// each with room for a receive time and a coalesced segment size.
+
+#define DATAGRAM_BATCH      64
+#define DATAGRAM_CONTROL    64
+
+#ifndef _MSWINDOWS_
+
+static void datagram_header(struct msghdr *msg, struct iovec *iov, char *control, Socket::datagram_t *dg)
+{
+    memset(msg, 0, sizeof(struct msghdr));
+    iov->iov_base = (caddr_t)dg->data;
+    iov->iov_len = dg->size;
+    msg->msg_name = (caddr_t)&dg->address;
+    msg->msg_namelen = sizeof(dg->address);
+    msg->msg_iov = iov;
+    msg->msg_iovlen = 1;
+    msg->msg_control = control;
+    msg->msg_controllen = DATAGRAM_CONTROL;
+}
+
+static void datagram_header(struct msghdr *msg, struct iovec *iov, const Socket::datagram_t *dg)
+{
+    memset(msg, 0, sizeof(struct msghdr));
+    iov->iov_base = (caddr_t)dg->data;
+    iov->iov_len = dg->length;
+    if(dg->address.ss_family) {
+        msg->msg_name = (caddr_t)&dg->address;
+        msg->msg_namelen = Socket::len((const struct sockaddr *)&dg->address);
+    }
+    msg->msg_iov = iov;
+    msg->msg_iovlen = 1;
+}
+
+static void datagram_received(struct msghdr *msg, Socket::datagram_t *dg, size_t len)
+{
+    struct cmsghdr *cmsg;
+
+    dg->length = len;
+    dg->segment = 0;
+    dg->stamp.tv_sec = 0;
+    dg->stamp.tv_nsec = 0;
+    if(!msg->msg_namelen)
+        dg->address.ss_family = 0;
+
+    for(cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+#if defined(SO_TIMESTAMPNS)
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            memcpy(&dg->stamp, CMSG_DATA(cmsg), sizeof(dg->stamp));
+#elif defined(SO_TIMESTAMP)
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            dg->stamp.tv_sec = tv.tv_sec;
+            dg->stamp.tv_nsec = tv.tv_usec * 1000l;
+        }
+#endif
+#ifdef  __linux__
+        if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int segment;
+            memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+            if(segment > 0 && (size_t)segment < len)
+                dg->segment = segment;
+        }
+#endif
+    }
+}
+
+#endif
+
+int Socket::recvbatch(socket_t so, datagram_t *list, unsigned count, int flags)
+{
+    assert(list != NULL);
+
+    if(count > DATAGRAM_BATCH)
+        count = DATAGRAM_BATCH;
+
+    if(!count)
+        return 0;
+
+#if defined(_MSWINDOWS_)
+    socklen_t slen = sizeof(list->address);
+    ssize_t result = _recvfrom_(so, (caddr_t)list->data, list->size, flags, (struct sockaddr *)&list->address, &slen);
+    if(result < 0)
+        return -1;
+    list->length = result;
+    list->segment = 0;
+    list->stamp.tv_sec = 0;
+    list->stamp.tv_nsec = 0;
+    return 1;
+#else
+    // a fiber parks until input is waiting rather than block its thread
+    bool parked = !(flags & MSG_DONTWAIT) && Fiber::get() != NULL;
+    if(parked)
+        flags |= MSG_DONTWAIT;
+
+#if defined(HAVE_RECVMMSG)
+    struct mmsghdr msgs[DATAGRAM_BATCH];
+    struct iovec iov[DATAGRAM_BATCH];
+    char control[DATAGRAM_BATCH][DATAGRAM_CONTROL];
+    int result;
+
+    for(unsigned pos = 0; pos < count; ++pos)
+        datagram_header(&msgs[pos].msg_hdr, &iov[pos], control[pos], &list[pos]);
+
+    for(;;) {
+        result = ::recvmmsg(so, msgs, count, flags | MSG_WAITFORONE, NULL);
+        if(result > -1 || !parked || (errno != EAGAIN && errno != EWOULDBLOCK))
+            break;
+        Fiber::wait(so);
+    }
+
+    for(int pos = 0; pos < result; ++pos)
+        datagram_received(&msgs[pos].msg_hdr, &list[pos], msgs[pos].msg_len);
+    return result;
+#else
+    unsigned pos = 0;
+    while(pos < count) {
+        struct msghdr msg;
+        struct iovec iov;
+        char control[DATAGRAM_CONTROL];
+
+        datagram_header(&msg, &iov, control, &list[pos]);
+        ssize_t result = ::recvmsg(so, &msg, flags);
+        if(result < 0) {
+            if(pos)
+                break;
+            if(parked && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                Fiber::wait(so);
+                continue;
+            }
+            return -1;
+        }
+        datagram_received(&msg, &list[pos++], result);
+        flags |= MSG_DONTWAIT;
+    }
+    return (int)pos;
+#endif
+#endif
+}
+
+int Socket::sendbatch(socket_t so, const datagram_t *list, unsigned count, int flags)
+{
+    assert(list != NULL);
+
+    if(count > DATAGRAM_BATCH)
+        count = DATAGRAM_BATCH;
+
+    if(!count)
+        return 0;
+
+#if defined(HAVE_SENDMMSG)
+    struct mmsghdr msgs[DATAGRAM_BATCH];
+    struct iovec iov[DATAGRAM_BATCH];
+    bool parked = !(flags & MSG_DONTWAIT) && Fiber::get() != NULL;
+    int result;
+
+    if(parked)
+        flags |= MSG_DONTWAIT;
+
+    for(unsigned pos = 0; pos < count; ++pos) {
+        datagram_header(&msgs[pos].msg_hdr, &iov[pos], &list[pos]);
+        msgs[pos].msg_len = 0;
+    }
+
+    for(;;) {
+        result = ::sendmmsg(so, msgs, count, flags | MSG_NOSIGNAL);
+        if(result > -1 || !parked || (errno != EAGAIN && errno != EWOULDBLOCK))
+            break;
+        Fiber::wait(so, true);
+    }
+    return result;
+#else
+    unsigned pos = 0;
+    while(pos < count) {
+        const struct sockaddr *dest = NULL;
+        socklen_t slen = 0;
+        if(list[pos].address.ss_family) {
+            dest = (const struct sockaddr *)&list[pos].address;
+            slen = len(dest);
+        }
+        if(_sendto_(so, (caddr_t)list[pos].data, list[pos].length, MSG_NOSIGNAL | flags, dest, slen) < 0) {
+            if(pos)
+                break;
+            return -1;
+        }
+        ++pos;
+    }
+    return (int)pos;
+#endif
+}
+
+ssize_t Socket::sendsegments(socket_t so, const void *data, size_t size, size_t segment, const struct sockaddr *dest)
+{
+    assert(data != NULL);
+    assert(segment > 0);
+
+    const char *cp = (const char *)data;
+    socklen_t slen = 0;
+    size_t sent = 0;
+
+    if(dest)
+        slen = len(dest);
+
+#ifdef  __linux__
+    // the kernel splits up to 64 segments and 64k in each send
+    size_t chunk = 65000 / segment;
+    if(chunk > 64)
+        chunk = 64;
+    chunk *= segment;
+
+    bool parked = Fiber::get() != NULL;
+    while(chunk && segment < size && sent < size) {
+        struct msghdr msg;
+        struct iovec iov;
+        union {
+            char buf[CMSG_SPACE(sizeof(uint16_t))];
+            struct cmsghdr align;
+        } control;
+        size_t part = size - sent;
+
+        if(part > chunk)
+            part = chunk;
+
+        memset(&msg, 0, sizeof(msg));
+        iov.iov_base = (caddr_t)(cp + sent);
+        iov.iov_len = part;
+        msg.msg_name = (caddr_t)dest;
+        msg.msg_namelen = slen;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        if(part > segment) {
+            uint16_t gso = (uint16_t)segment;
+            memset(&control, 0, sizeof(control));
+            msg.msg_control = control.buf;
+            msg.msg_controllen = sizeof(control.buf);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(gso));
+            memcpy(CMSG_DATA(cmsg), &gso, sizeof(gso));
+        }
+
+        ssize_t result = ::sendmsg(so, &msg, MSG_NOSIGNAL | (parked ? MSG_DONTWAIT : 0));
+        if(result < 0) {
+            if(parked && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                Fiber::wait(so, true);
+                continue;
+            }
+            // without offload for this socket or route, batch instead
+            if(!sent && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP))
+                break;
+            return sent ? (ssize_t)sent : -1;
+        }
+        sent += result;
+    }
+#endif
+
+    datagram_t list[DATAGRAM_BATCH];
+    while(sent < size) {
+        unsigned count = 0;
+        size_t offset = sent;
+
+        while(count < DATAGRAM_BATCH && offset < size) {
+            list[count].data = (caddr_t)(cp + offset);
+            list[count].length = size - offset;
+            if(list[count].length > segment)
+                list[count].length = segment;
+            list[count].address.ss_family = 0;
+            if(dest)
+                memcpy(&list[count].address, dest, slen);
+            offset += list[count++].length;
+        }
+
+        int result = sendbatch(so, list, count);
+        if(result < 1)
+            return sent ? (ssize_t)sent : -1;
+
+        for(int pos = 0; pos < result; ++pos)
+            sent += list[pos].length;
+    }
+    return (ssize_t)sent;
+}
+
+// files are spliced and copied in chunks of this size, and buffers are only
+// sent without copying from the minimum size, below which pinning the pages
+// costs more than copying them.
+
+#define SENDFILE_CHUNK      65536
+#define ZEROCOPY_MINIMUM    16384
+
+#if defined(__linux__) && defined(HAVE_SPLICE)
+
+static ssize_t splicefile(socket_t so, fd_t fd, off_t *offset, size_t size, bool parked)
+{
+    int pipes[2];
+    size_t sent = 0;
+    ssize_t result = 0;
+    loff_t pos = 0, *from = NULL;
+
+    if(::pipe(pipes))
+        return -1;
+
+    if(offset) {
+        pos = *offset;
+        from = &pos;
+    }
+
+    while(sent < size && result > -1) {
+        size_t request = size - sent;
+        if(request > SENDFILE_CHUNK)
+            request = SENDFILE_CHUNK;
+
+        ssize_t filled = ::splice(fd, from, pipes[1], NULL, request, SPLICE_F_MOVE);
+        if(filled < 1) {
+            result = filled;
+            break;
+        }
+
+        while(filled > 0) {
+            result = ::splice(pipes[0], NULL, so, NULL, filled, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if(result < 0 && parked && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                Fiber::wait(so, true);
+                continue;
+            }
+            if(result < 1) {
+                result = -1;
+                break;
+            }
+            filled -= result;
+            sent += result;
+        }
+    }
+
+    int saved = errno;
+    ::close(pipes[0]);
+    ::close(pipes[1]);
+    errno = saved;
+
+    if(offset)
+        *offset += sent;
+    if(result < 0 && !sent)
+        return -1;
+    return (ssize_t)sent;
+}
+
+#endif
+
+ssize_t Socket::sendfile(socket_t so, fd_t fd, off_t *offset, size_t size)
+{
+    size_t sent = 0;
+    ssize_t result;
+
+#if defined(__linux__) && defined(HAVE_SYS_SENDFILE_H)
+    // a fiber sends without blocking its thread, parking when the socket
+    // is full, as for Fiber::sendto.
+    bool parked = Fiber::get() != NULL;
+    int flags = -1;
+    if(parked) {
+        flags = fcntl(so, F_GETFL);
+        if(flags != -1 && !(flags & O_NONBLOCK))
+            fcntl(so, F_SETFL, flags | O_NONBLOCK);
+        else
+            flags = -1;
+    }
+
+    result = 0;
+    while(sent < size) {
+        size_t request = size - sent;
+        if(request > 0x40000000)
+            request = 0x40000000;
+        result = ::sendfile(so, fd, offset, request);
+        if(result > 0)
+            sent += result;
+        else if(result < 0 && parked && (errno == EAGAIN || errno == EWOULDBLOCK))
+            Fiber::wait(so, true);
+        else
+            break;
+    }
+
+    // descriptors that cannot be mapped, such as pipes, are spliced
+    bool copying = result < 0 && !sent && (errno == EINVAL || errno == ENOSYS);
+#ifdef  HAVE_SPLICE
+    if(copying) {
+        result = splicefile(so, fd, offset, size, parked);
+        if(result > -1)
+            sent = (size_t)result;
+        copying = result < 0 && (errno == EINVAL || errno == ENOSYS);
+    }
+#endif
+
+    if(flags != -1) {
+        int saved = errno;
+        fcntl(so, F_SETFL, flags);
+        errno = saved;
+    }
+
+    if(!copying) {
+        if(result < 0 && !sent)
+            return -1;
+        return (ssize_t)sent;
+    }
+#endif
+
+    char *buf = (char *)malloc(SENDFILE_CHUNK);
+    if(!buf)
+        return -1;
+
+    result = 0;
+    while(sent < size) {
+        size_t request = size - sent;
+        if(request > SENDFILE_CHUNK)
+            request = SENDFILE_CHUNK;
+
+        ssize_t count = fsys::read(fd, buf, request, offset);
+        if(count < 1) {
+            result = count;
+            break;
+        }
+
+        ssize_t written = 0;
+        while(written < count) {
+            result = _send_(so, buf + written, count - written, MSG_NOSIGNAL);
+            if(result < 1)
+                break;
+            written += result;
+        }
+        sent += written;
+        if(written < count) {
+            // leave the offset after the data actually sent
+            if(offset)
+                *offset -= (off_t)(count - written);
+            result = -1;
+            break;
+        }
+    }
+    free(buf);
+
+    if(result < 0 && !sent)
+        return -1;
+    return (ssize_t)sent;
+}
+
+int Socket::zerocopy(socket_t so, zerocopy_t *state)
+{
+    assert(state != NULL);
+
+    memset(state, 0, sizeof(zerocopy_t));
+    if(so == INVALID_SOCKET)
+        return EBADF;
+#ifdef  __linux__
+    int opt = 1;
+    if(!::setsockopt(so, SOL_SOCKET, SO_ZEROCOPY, (char *)&opt, (socklen_t)sizeof(opt))) {
+        state->enabled = true;
+        return 0;
+    }
+    int err = Socket::error();
+    if(!err)
+        err = EIO;
+    return err;
+#else
+    return ENOSYS;
+#endif
+}
+
+ssize_t Socket::sendzerocopy(socket_t so, const void *data, size_t size, zerocopy_t *state)
+{
+    assert(data != NULL);
+    assert(state != NULL);
+
+#ifdef  __linux__
+    bool parked = Fiber::get() != NULL;
+    while(state->enabled && size >= ZEROCOPY_MINIMUM) {
+        ssize_t result = ::send(so, (const char *)data, size, MSG_ZEROCOPY | MSG_NOSIGNAL | (parked ? MSG_DONTWAIT : 0));
+        if(result > -1) {
+            ++state->sent;
+            return result;
+        }
+        if(parked && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            Fiber::wait(so, true);
+            continue;
+        }
+        // out of memory to pin pages, so this send is copied
+        if(errno != ENOBUFS)
+            return -1;
+        break;
+    }
+#endif
+    return _send_(so, (const char *)data, size, MSG_NOSIGNAL);
+}
+
+unsigned Socket::reclaim(socket_t so, zerocopy_t *state, timeout_t timeout)
+{
+    assert(state != NULL);
+
+    unsigned completed = 0;
+
+#ifdef  __linux__
+    if(!state->enabled)
+        return 0;
+
+    for(;;) {
+        struct msghdr msg;
+        union {
+            char buf[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_storage))];
+            struct cmsghdr align;
+        } control;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        if(::recvmsg(so, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if(completed || !timeout || state->completed == state->sent)
+                break;
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                break;
+
+            // notices are only waited for once
+            if(!Fiber::wait(so, false, timeout))
+                break;
+            timeout = 0;
+            continue;
+        }
+
+        for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if(!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+              (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+                continue;
+
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if(err.ee_errno || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            // each notice is a range of send numbers completed together
+            if(err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                state->copied = true;
+            completed += err.ee_data - err.ee_info + 1;
+        }
+    }
+    state->completed += completed;
+#endif
+    return completed;
+}
+
+ssize_t Socket::sendfile(fd_t file, off_t *offset, size_t size)
+{
+    ssize_t result = sendfile(so, file, offset, size);
+    if(result < 0)
+        ioerr = Socket::error();
+    return result;
+}
+
+unsigned Socket::readbatch(datagram_t *list, unsigned count)
+{
+    assert(list != NULL);
+
+    // wait for input by timer if possible...
+    if(iowait && iowait != Timer::inf && !Socket::wait(so, iowait))
+        return 0;
+
+    int result = recvbatch(so, list, count);
+    if(result < 0) {
+        ioerr = Socket::error();
+        return 0;
+    }
+    return (unsigned)result;
+}
+
+unsigned Socket::writebatch(const datagram_t *list, unsigned count)
+{
+    assert(list != NULL);
+
+    int result = sendbatch(so, list, count);
+    if(result < 0) {
+        ioerr = Socket::error();
+        return 0;
+    }
+    return (unsigned)result;
+}
+
 size_t Socket::writes(const char *str)
 {
     if(!str)
@@ -2270,6 +2915,45 @@ int Socket::keepalive(socket_t so, bool enable)
 #endif
 }
 
+int Socket::coalesce(socket_t so, bool enable)
+{
+    if(so == INVALID_SOCKET)
+        return EBADF;
+#ifdef  __linux__
+    int opt = (enable ? 1 : 0);
+    if(!::setsockopt(so, SOL_UDP, UDP_GRO, (char *)&opt, (socklen_t)sizeof(opt)))
+        return 0;
+    int err = Socket::error();
+    if(!err)
+        err = EIO;
+    return err;
+#else
+    return ENOSYS;
+#endif
+}
+
+int Socket::timestamps(socket_t so, bool enable)
+{
+    if(so == INVALID_SOCKET)
+        return EBADF;
+#if defined(SO_TIMESTAMPNS) || defined(SO_TIMESTAMP)
+    int opt = (enable ? 1 : 0);
+#ifdef  SO_TIMESTAMPNS
+    if(!::setsockopt(so, SOL_SOCKET, SO_TIMESTAMPNS, (char *)&opt, (socklen_t)sizeof(opt)))
+        return 0;
+#else
+    if(!::setsockopt(so, SOL_SOCKET, SO_TIMESTAMP, (char *)&opt, (socklen_t)sizeof(opt)))
+        return 0;
+#endif
+    int err = Socket::error();
+    if(!err)
+        err = EIO;
+    return err;
+#else
+    return ENOSYS;
+#endif
+}
+
 int Socket::multicast(socket_t so, unsigned ttl)
 {
     struct sockaddr_internet addr;
@@ -2730,6 +3414,9 @@ bool Socket::wait(socket_t so, timeout_t timeout)
 {
     int status;
 
+    if(so != INVALID_SOCKET && Fiber::get())
+        return Fiber::wait(so, false, timeout);
+
 #ifdef  USE_POLL
     struct pollfd pfd;
 
@@ -2783,6 +3470,9 @@ bool Socket::wait(socket_t so, timeout_t timeout)
 bool Socket::waitSending(timeout_t timeout) const
 {
     int status;
+
+    if(so != INVALID_SOCKET && Fiber::get())
+        return Fiber::wait(so, true, timeout);
 #ifdef  USE_POLL
     struct pollfd pfd;
 
@@ -2877,6 +3567,258 @@ ListenSocket(address, service, backlog)
 {
 }
 
+ListenGroup::ListenGroup(const char *iface, const char *svc, unsigned members, unsigned backlog, int family, int type, int protocol)
+{
+    struct addrinfo hint, *res = NULL;
+    struct sockaddr_storage addr;
+    socklen_t alen;
+    unsigned index;
+    int reuse = 1;
+
+    if(!iface)
+        iface = "*";
+
+    assert(iface != NULL && *iface != 0);
+    assert(svc != NULL && *svc != 0);
+    assert(members > 0 && backlog > 0);
+
+    listeners = NULL;
+    count = 0;
+    shared = nonblock = stopped = false;
+
+    if(!type)
+        type = SOCK_STREAM;
+
+#if defined(AF_UNIX) && !defined(_MSWINDOWS_)
+    // a unix path can only be bound once, so members share it
+    if(strchr(iface, '/')) {
+        socket_t so = ListenSocket::create(iface, svc, backlog, family, type, protocol);
+        if(so == INVALID_SOCKET)
+            return;
+        listeners = new socket_t[members];
+        for(index = 0; index < members; ++index)
+            listeners[index] = so;
+        shared = true;
+        count = members;
+        return;
+    }
+#endif
+
+#ifdef  _MSWINDOWS_
+    Socket::init();
+#endif
+
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_flags = AI_PASSIVE | AI_NUMERICHOST;
+    hint.ai_family = setfamily(family, iface);
+    hint.ai_socktype = type;
+    hint.ai_protocol = protocol;
+
+#if defined(AF_INET6) && defined(AI_V4MAPPED)
+    if(hint.ai_family == AF_INET6 && !v6only)
+        hint.ai_flags |= AI_V4MAPPED;
+#endif
+
+    if(!strcmp(iface, "*"))
+        iface = NULL;
+
+    getaddrinfo(iface, svc, &hint, &res);
+    if(res == NULL)
+        return;
+
+    family = res->ai_family;
+    type = res->ai_socktype;
+    protocol = res->ai_protocol;
+    alen = (socklen_t)res->ai_addrlen;
+    memcpy(&addr, res->ai_addr, alen);
+    freeaddrinfo(res);
+
+    listeners = new socket_t[members];
+    for(index = 0; index < members;) {
+        socket_t so = Socket::create(family, type, protocol);
+        if(so == INVALID_SOCKET)
+            break;
+        setsockopt(so, SOL_SOCKET, SO_REUSEADDR, (caddr_t)&reuse, sizeof(reuse));
+#ifdef  SO_REUSEPORT
+        if(setsockopt(so, SOL_SOCKET, SO_REUSEPORT, (caddr_t)&reuse, sizeof(reuse)))
+            shared = true;
+#else
+        shared = true;
+#endif
+        if(_bind_(so, (struct sockaddr *)&addr, alen) || _listen_(so, backlog)) {
+            Socket::release(so);
+            break;
+        }
+        // later members bind to the port actually given to the first
+        if(!index) {
+            alen = sizeof(addr);
+            _getsockname_(so, (struct sockaddr *)&addr, &alen);
+        }
+        listeners[index++] = so;
+        if(shared)
+            break;
+    }
+
+    if(!index) {
+        delete[] listeners;
+        listeners = NULL;
+        return;
+    }
+
+    // fall back to members sharing the first listener
+    if(index < members || shared) {
+        while(index > 1)
+            Socket::release(listeners[--index]);
+        while(index < members)
+            listeners[index++] = listeners[0];
+        shared = true;
+    }
+    count = members;
+}
+
+ListenGroup::~ListenGroup()
+{
+    stop();
+
+    // listeners are already shut down, so they are only closed here
+    for(unsigned index = 0; index < count; ++index) {
+        if(shared && index)
+            break;
+#ifdef  _MSWINDOWS_
+        ::closesocket(listeners[index]);
+#else
+        ::close(listeners[index]);
+#endif
+    }
+
+    if(listeners)
+        delete[] listeners;
+}
+
+void ListenGroup::accepted(unsigned, socket_t so, struct sockaddr_storage *)
+{
+    Socket::release(so);
+}
+
+socket_t ListenGroup::get(unsigned index) const
+{
+    if(index >= count)
+        return INVALID_SOCKET;
+    return listeners[index];
+}
+
+void ListenGroup::nonblocking(bool enable)
+{
+    nonblock = enable;
+}
+
+bool ListenGroup::steer(void)
+{
+#ifdef  __linux__
+    if(shared || count < 2)
+        return false;
+
+    // select the member by receiving cpu; the program is attached to
+    // the kernel's reuseport group, so one listener covers all of them
+    struct sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, (__u32)(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, count},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+
+    return !setsockopt(listeners[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+#else
+    return false;
+#endif
+}
+
+socket_t ListenGroup::accept(unsigned index, struct sockaddr_storage *addr) const
+{
+    socklen_t len = sizeof(struct sockaddr_storage);
+    socklen_t *alen = NULL;
+    socket_t so = get(index);
+
+    if(so == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    if(addr)
+        alen = &len;
+
+#if defined(HAVE_ACCEPT4) && !defined(HAVE_SOCKS) && !defined(__PTH__)
+    if(Fiber::get() && !Socket::wait(so, Timer::inf))
+        return INVALID_SOCKET;
+
+    // flags are set as part of the accept rather than by added calls
+    int flags = SOCK_CLOEXEC;
+    if(nonblock)
+        flags |= SOCK_NONBLOCK;
+    return ::accept4(so, (struct sockaddr *)addr, alen, flags);
+#else
+    socket_t client = _accept_(so, (struct sockaddr *)addr, alen);
+#ifndef _MSWINDOWS_
+    if(client != INVALID_SOCKET) {
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        if(nonblock)
+            fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+    }
+#else
+    if(client != INVALID_SOCKET && nonblock) {
+        u_long enable = 1;
+        ioctlsocket(client, FIONBIO, &enable);
+    }
+#endif
+    return client;
+#endif
+}
+
+void ListenGroup::run(unsigned index)
+{
+    struct sockaddr_storage addr;
+
+    while(!stopped) {
+        socket_t so = accept(index, &addr);
+        if(so != INVALID_SOCKET) {
+            accepted(index, so, &addr);
+            continue;
+        }
+        if(stopped)
+            break;
+
+        switch(Socket::error()) {
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+            // wait for descriptors to be released rather than spin
+            if(Fiber::get())
+                Fiber::sleep(10);
+            else
+                Thread::sleep(10);
+            continue;
+        case EBADF:
+        case EINVAL:
+        case ENOTSOCK:
+            return;
+        default:
+            continue;
+        }
+    }
+}
+
+void ListenGroup::stop(void)
+{
+    stopped = true;
+
+    for(unsigned index = 0; index < count; ++index) {
+        if(shared && index)
+            break;
+        Socket::cancel(listeners[index]);
+    }
+}
+
 #ifdef  _MSWINDOWS_
 #undef  AF_UNIX
 #endif
@@ -3023,7 +3965,7 @@ socklen_t Socket::query(socket_t so, struct sockaddr_storage *sa, const char *ho
     if(!hinting(so, &hint) || !svc)
         return 0;
 
-    if(getaddrinfo(host, svc, &hint, &res) || !res)
+    if(_getaddrinfo_(host, svc, &hint, &res) || !res)
         goto exit;
 
     memcpy(sa, res->ai_addr, res->ai_addrlen);
@@ -3031,7 +3973,7 @@ socklen_t Socket::query(socket_t so, struct sockaddr_storage *sa, const char *ho
 
 exit:
     if(res)
-        freeaddrinfo(res);
+        _freeaddrinfo_(res);
     return len;
 }
 
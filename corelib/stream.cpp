@@ -343,6 +343,57 @@ void tcpstream::close(void)
     Socket::disconnect(so);
 }
 
+bool tcpstream::_direct(void)
+{
+    return true;
+}
+
+size_t tcpstream::sendfile(fd_t file, off_t *offset, size_t size)
+{
+    size_t sent = 0;
+
+    if(!bufsize)
+        return 0;
+
+    sync();
+
+    if(_direct()) {
+        ssize_t result = Socket::sendfile(so, file, offset, size);
+        if(result < 0) {
+            clear(ios::failbit | rdstate());
+            return 0;
+        }
+        return (size_t)result;
+    }
+
+    // encoded output is read from the file and written through the stream
+    char *buf = new char[bufsize];
+    while(sent < size) {
+        size_t request = size - sent;
+        if(request > bufsize)
+            request = bufsize;
+
+        ssize_t count = fsys::read(file, buf, request, offset);
+        if(count < 1)
+            break;
+
+        ssize_t written = 0;
+        while(written < count) {
+            ssize_t result = _write(buf + written, count - written);
+            if(result < 1)
+                break;
+            written += result;
+        }
+        sent += written;
+        if(written < count) {
+            clear(ios::failbit | rdstate());
+            break;
+        }
+    }
+    delete[] buf;
+    return sent;
+}
+
 void tcpstream::allocate(unsigned mss)
 {
     unsigned size = mss;
@@ -581,6 +632,7 @@ void pipestream::open(const char *path, access_t mode, char **args, char **envp,
             }
             return;
         }
+        fsys::inherit(output, false);
     }
     else
         stdio[0] = fsys::null();
@@ -26,6 +26,15 @@
 #endif
 #include <limits.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define TOKEN_X86_KERNELS
+#include <immintrin.h>
+#endif
+#endif
+
+#include "cpu.h"
+
 namespace ucommon {
 
 #if _MSC_VER > 1400        // windows broken dll linkage issue...
@@ -1401,6 +1410,8 @@ char *String::token(char *text, char **token, const char *clist, const char *quo
     if(!token || !clist)
         return NULL;
 
+    charmap separators(clist);
+
     if(!*token)
         *token = text;
 
@@ -1409,7 +1420,7 @@ char *String::token(char *text, char **token, const char *clist, const char *quo
         return NULL;
     }
 
-    while(**token && strchr(clist, **token))
+    while(**token && separators(**token))
         ++*token;
 
     result = *token;
@@ -1443,7 +1454,7 @@ char *String::token(char *text, char **token, const char *clist, const char *quo
         return result;
     }
 
-    while(**token && !strchr(clist, **token))
+    while(**token && !separators(**token))
         ++(*token);
 
     if(**token) {
@@ -2324,4 +2335,286 @@ uint16_t String::crc16(uint8_t *binary, size_t size)
     return crc;
 }
 
+charmap::charmap(const char *list)
+{
+    set(list);
+}
+
+void charmap::set(const char *list)
+{
+    memset(bits, 0, sizeof(bits));
+    while(list && *list) {
+        uint8_t ch = (uint8_t)*(list++);
+        bits[ch >> 5] |= (uint32_t)1 << (ch & 31);
+    }
+}
+
+/*
+ * Separators are classified by the shufti method: every byte indexes one
+ * table by its low nibble and another by its high nibble, and is in the
+ * set when the two results share a bit.  Each bit stands for a group of
+ * high nibbles with the same set of low nibbles, so a set is exact when
+ * it has no more than eight such groups; larger sets use the table alone.
+ */
+#define TOKEN_BLOCKS    128
+
+#define KERNEL_UNKNOWN  0
+#define KERNEL_PORTABLE 1
+#define KERNEL_AVX2     2
+
+static volatile unsigned kernels = KERNEL_UNKNOWN;
+
+static unsigned select_kernels(void)
+{
+    unsigned found = KERNEL_PORTABLE;
+
+#ifdef  TOKEN_X86_KERNELS
+    if(cpu_features() & CPU_AVX2)
+        found = KERNEL_AVX2;
+#endif
+
+    kernels = found;
+    return found;
+}
+
+static inline unsigned lowbit(uint32_t mask)
+{
+#ifdef  __GNUC__
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned bit = 0;
+    while(!(mask & 1)) {
+        mask >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+static void classify(const charmap& separators, const uint8_t *text, size_t blocks, uint32_t *masks)
+{
+    while(blocks--) {
+        uint32_t mask = 0;
+        for(unsigned bit = 0; bit < 32; ++bit) {
+            if(separators(text[bit]))
+                mask |= (uint32_t)1 << bit;
+        }
+        *(masks++) = mask;
+        text += 32;
+    }
+}
+
+#ifdef  TOKEN_X86_KERNELS
+
+__attribute__((target("avx2")))
+static inline uint32_t classify_block(__m256i bytes, __m256i low, __m256i high)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(low, _mm256_and_si256(bytes, nibble));
+    __m256i hi = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+    __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+    return ~(uint32_t)_mm256_movemask_epi8(none);
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const uint8_t *low, const uint8_t *high, const uint8_t *text, size_t blocks, uint32_t *masks)
+{
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)low));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)high));
+
+    while(blocks--) {
+        *(masks++) = classify_block(_mm256_loadu_si256((const __m256i *)text), lo, hi);
+        text += 32;
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t find_avx2(const uint8_t *low, const uint8_t *high, const uint8_t *text, size_t len)
+{
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)low));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)high));
+    size_t pos = 0;
+
+    while(pos + 32 <= len) {
+        uint32_t mask = classify_block(_mm256_loadu_si256((const __m256i *)(text + pos)), lo, hi);
+        if(mask)
+            return pos + lowbit(mask);
+        pos += 32;
+    }
+    return pos;
+}
+
+#endif
+
+Tokenizer::Tokenizer(const char *list, size_t reserve) :
+separators(list)
+{
+    uint16_t nibbles[16];
+    uint16_t groups[8];
+    unsigned group, count = 0;
+
+    memset(nibbles, 0, sizeof(nibbles));
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    vector = true;
+
+    while(list && *list) {
+        uint8_t ch = (uint8_t)*(list++);
+        nibbles[ch >> 4] |= (uint16_t)(1 << (ch & 0x0f));
+    }
+
+    for(unsigned nibble = 0; vector && nibble < 16; ++nibble) {
+        if(!nibbles[nibble])
+            continue;
+        for(group = 0; group < count; ++group) {
+            if(groups[group] == nibbles[nibble])
+                break;
+        }
+        if(group == count) {
+            if(count == 8) {
+                vector = false;
+                break;
+            }
+            groups[count++] = nibbles[nibble];
+        }
+        high[nibble] |= (uint8_t)(1 << group);
+    }
+
+    for(group = 0; group < count; ++group) {
+        for(unsigned nibble = 0; nibble < 16; ++nibble) {
+            if(groups[group] & (1 << nibble))
+                low[nibble] |= (uint8_t)(1 << group);
+        }
+    }
+
+    text = NULL;
+    spans = NULL;
+    this->count = limit = 0;
+    if(reserve) {
+        spans = (span_t *)malloc(reserve * sizeof(span_t));
+        if(spans)
+            limit = reserve;
+    }
+}
+
+Tokenizer::~Tokenizer()
+{
+    if(spans)
+        free(spans);
+}
+
+bool Tokenizer::grow(void)
+{
+    size_t size = limit ? limit * 2 : 64;
+    span_t *list = (span_t *)realloc(spans, size * sizeof(span_t));
+
+    if(!list)
+        return false;
+
+    spans = list;
+    limit = size;
+    return true;
+}
+
+size_t Tokenizer::find(const char *string, size_t len) const
+{
+    size_t pos = 0;
+
+    if(!string)
+        return 0;
+
+#ifdef  TOKEN_X86_KERNELS
+    unsigned kernel = kernels;
+
+    if(kernel == KERNEL_UNKNOWN)
+        kernel = select_kernels();
+
+    if(kernel == KERNEL_AVX2 && vector) {
+        pos = find_avx2(low, high, (const uint8_t *)string, len);
+        if(pos < len && separators(string[pos]))
+            return pos;
+    }
+#endif
+
+    while(pos < len && !separators(string[pos]))
+        ++pos;
+    return pos;
+}
+
+size_t Tokenizer::scan(const char *string, size_t len, bool empty)
+{
+    uint32_t masks[TOKEN_BLOCKS];
+    size_t base = 0, start = 0, pos;
+    unsigned kernel = kernels;
+
+    text = string;
+    count = 0;
+    if(!string || !len)
+        return 0;
+
+    if(kernel == KERNEL_UNKNOWN)
+        kernel = select_kernels();
+
+    // separators are found a chunk of blocks at a time as bit masks, and
+    // the spans between them are taken from the masks.
+    while(len - base >= 32) {
+        size_t blocks = (len - base) / 32;
+        if(blocks > TOKEN_BLOCKS)
+            blocks = TOKEN_BLOCKS;
+
+#ifdef  TOKEN_X86_KERNELS
+        if(kernel == KERNEL_AVX2 && vector)
+            classify_avx2(low, high, (const uint8_t *)string + base, blocks, masks);
+        else
+#endif
+            classify(separators, (const uint8_t *)string + base, blocks, masks);
+
+        for(size_t block = 0; block < blocks; ++block) {
+            uint32_t mask = masks[block];
+            while(mask) {
+                pos = base + block * 32 + lowbit(mask);
+                mask &= mask - 1;
+                if(empty || pos > start) {
+                    if(count == limit && !grow())
+                        return count;
+                    spans[count].offset = start;
+                    spans[count++].size = pos - start;
+                }
+                start = pos + 1;
+            }
+        }
+        base += blocks * 32;
+    }
+
+    for(pos = base; pos < len; ++pos) {
+        if(!separators(string[pos]))
+            continue;
+        if(empty || pos > start) {
+            if(count == limit && !grow())
+                return count;
+            spans[count].offset = start;
+            spans[count++].size = pos - start;
+        }
+        start = pos + 1;
+    }
+
+    if(empty || len > start) {
+        if(count == limit && !grow())
+            return count;
+        spans[count].offset = start;
+        spans[count++].size = len - start;
+    }
+    return count;
+}
+
+size_t Tokenizer::fields(const char *string, size_t len)
+{
+    return scan(string, len, true);
+}
+
+size_t Tokenizer::token(const char *string, size_t len)
+{
+    return scan(string, len, false);
+}
+
 } // namespace ucommon
@@ -26,6 +26,8 @@
 
 namespace ucommon {
 
+#define SENDFILE_CHUNK  16384
+
 TCPBuffer::TCPBuffer() :
 BufferProtocol()
 {
@@ -178,6 +180,47 @@ size_t TCPBuffer::_pull(char *address, size_t len)
     return (size_t)result;
 }
 
+bool TCPBuffer::_direct(void)
+{
+    return true;
+}
+
+size_t TCPBuffer::sendfile(fd_t file, off_t *offset, size_t size)
+{
+    size_t sent = 0;
+
+    if(!flush())
+        return 0;
+
+    if(_direct()) {
+        ssize_t result = Socket::sendfile(so, file, offset, size);
+        if(result < 0) {
+            ioerr = Socket::error();
+            return 0;
+        }
+        return (size_t)result;
+    }
+
+    // encoded output is read from the file and pushed through the buffer
+    char *buf = new char[SENDFILE_CHUNK];
+    while(sent < size) {
+        size_t request = size - sent;
+        if(request > SENDFILE_CHUNK)
+            request = SENDFILE_CHUNK;
+
+        ssize_t count = fsys::read(file, buf, request, offset);
+        if(count < 1)
+            break;
+
+        size_t written = _push(buf, count);
+        sent += written;
+        if(written < (size_t)count)
+            break;
+    }
+    delete[] buf;
+    return sent;
+}
+
 bool TCPBuffer::_pending(void)
 {
     if(input_pending())
@@ -26,6 +26,11 @@
 #include <stdarg.h>
 #include <limits.h>
 
+#ifdef  HAVE_LINUX_FUTEX_H
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #if _POSIX_PRIORITY_SCHEDULING > 0
 #include <sched.h>
 static int realtime_policy = SCHED_FIFO;
@@ -37,6 +42,238 @@ static unsigned max_sharing = 0;
 
 namespace ucommon {
 
+#if defined(_MSWINDOWS_) && !defined(__GNUC__)
+#define sync_cas(p, o, v)   (InterlockedCompareExchange((LONG volatile *)(p), (LONG)(v), (LONG)(o)) == (LONG)(o))
+#define sync_add(p, v)      ((unsigned)InterlockedExchangeAdd((LONG volatile *)(p), (LONG)(v)))
+#define sync_load(p)        (MemoryBarrier(), *(p))
+#elif defined(__ATOMIC_ACQUIRE)
+#define sync_cas(p, o, v)   __sync_bool_compare_and_swap(p, o, v)
+#define sync_add(p, v)      __sync_fetch_and_add(p, v)
+#define sync_load(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#else
+#define sync_cas(p, o, v)   __sync_bool_compare_and_swap(p, o, v)
+#define sync_add(p, v)      __sync_fetch_and_add(p, v)
+#define sync_load(p)        (__sync_synchronize(), *(p))
+#endif
+
+// barrier state holds the threads arrived in the low 16 bits, and the
+// generation, which advances each time the barrier opens, above them.
+
+#define BARRIER_ARRIVED     0xffffu
+#define BARRIER_NEXT        0x10000u
+
+static inline bool sync_take(volatile unsigned *used, volatile unsigned *limit)
+{
+    unsigned current = *used;
+    while(current < *limit) {
+        if(sync_cas(used, current, current + 1))
+            return true;
+        current = *used;
+    }
+    return false;
+}
+
+#ifdef  HAVE_LINUX_FUTEX_H
+static Timer::tick_t sync_deadline(timeout_t timeout)
+{
+    if(timeout == Timer::inf)
+        return 0;
+    return Timer::ticks() + (Timer::tick_t)timeout * 10000l + 1;
+}
+
+// private futexes, since these are never shared between processes
+static void sync_sleep(volatile unsigned *addr, unsigned value, Timer::tick_t deadline)
+{
+    struct timespec ts, *tsp = NULL;
+    if(deadline) {
+        Timer::tick_t now = Timer::ticks();
+        if(now >= deadline)
+            return;
+        Timer::tick_t remains = deadline - now;
+        ts.tv_sec = (time_t)(remains / 10000000l);
+        ts.tv_nsec = (long)((remains % 10000000l) * 100l);
+        tsp = &ts;
+    }
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, tsp, NULL, 0);
+}
+
+static void sync_wake(volatile unsigned *addr, int count)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+#endif
+
+// Reader biased locks keep their readers in slots of a per-thread record,
+// so a reader only writes to memory of its own thread.  A writer revoking
+// the bias scans every thread record for slots still holding the lock.
+// This needs thread exit notification to recycle records, so is only
+// offered with native posix threads.
+
+#if !defined(_MSTHREADS_) && !defined(__PTH__) && defined(__GNUC__)
+#define READER_BIAS
+#define READER_SLOTS        8
+
+namespace {
+
+class __LOCAL reader_slots
+{
+public:
+    char head[64];
+    const void *volatile locks[READER_SLOTS];
+    unsigned counts[READER_SLOTS];
+    reader_slots *next;
+    volatile unsigned active;
+    char tail[64];
+};
+
+static reader_slots *volatile reader_list = NULL;
+static pthread_key_t reader_key;
+static pthread_once_t reader_once = PTHREAD_ONCE_INIT;
+
+} // namespace
+
+static void reader_exit(void *record)
+{
+    reader_slots *rec = (reader_slots *)record;
+
+    // a record still holding a lock is never reused
+    for(unsigned pos = 0; pos < READER_SLOTS; ++pos) {
+        if(rec->locks[pos])
+            return;
+    }
+    sync_cas(&rec->active, 1u, 0u);
+}
+
+static void reader_init(void)
+{
+    pthread_key_create(&reader_key, reader_exit);
+}
+
+static reader_slots *reader_self(void)
+{
+    reader_slots *rec = (reader_slots *)pthread_getspecific(reader_key);
+    if(rec)
+        return rec;
+
+    for(rec = reader_list; rec; rec = rec->next) {
+        if(!rec->active && sync_cas(&rec->active, 0u, 1u))
+            break;
+    }
+
+    if(!rec) {
+        rec = new reader_slots;
+        memset((void *)rec, 0, sizeof(reader_slots));
+        rec->active = 1;
+        do {
+            rec->next = reader_list;
+        } while(!sync_cas(&reader_list, rec->next, rec));
+    }
+    pthread_setspecific(reader_key, rec);
+    return rec;
+}
+
+static bool reader_enter(const void *lock, volatile bool *biased)
+{
+    pthread_once(&reader_once, reader_init);
+    reader_slots *rec = reader_self();
+    unsigned empty = READER_SLOTS;
+
+    for(unsigned pos = 0; pos < READER_SLOTS; ++pos) {
+        if(rec->locks[pos] == lock) {
+            ++rec->counts[pos];
+            return true;
+        }
+        if(!rec->locks[pos] && empty == READER_SLOTS)
+            empty = pos;
+    }
+
+    if(empty == READER_SLOTS || !*biased)
+        return false;
+
+    // publish our slot before checking the bias; a writer clears the bias
+    // before scanning slots, so one of us sees the other.
+    rec->counts[empty] = 1;
+    rec->locks[empty] = lock;
+    __sync_synchronize();
+    if(*biased)
+        return true;
+
+    rec->locks[empty] = NULL;
+    return false;
+}
+
+static unsigned reader_take(const void *lock)
+{
+    pthread_once(&reader_once, reader_init);
+    reader_slots *rec = (reader_slots *)pthread_getspecific(reader_key);
+
+    if(!rec)
+        return 0;
+
+    for(unsigned pos = 0; pos < READER_SLOTS; ++pos) {
+        if(rec->locks[pos] == lock) {
+            unsigned count = rec->counts[pos];
+            rec->locks[pos] = NULL;
+            return count;
+        }
+    }
+    return 0;
+}
+
+static bool reader_leave(const void *lock)
+{
+    pthread_once(&reader_once, reader_init);
+    reader_slots *rec = (reader_slots *)pthread_getspecific(reader_key);
+
+    if(!rec)
+        return false;
+
+    for(unsigned pos = 0; pos < READER_SLOTS; ++pos) {
+        if(rec->locks[pos] == lock) {
+            if(!--rec->counts[pos]) {
+                __sync_synchronize();
+                rec->locks[pos] = NULL;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// a deadline of 0 waits for readers to drain however long they take;
+// otherwise the bias is restored and false returned once it passes.
+static bool reader_revoke(const void *lock, volatile bool *biased, Timer::tick_t *inhibit, Timer::tick_t deadline = 0)
+{
+    Timer::tick_t start = Timer::ticks();
+
+    *biased = false;
+    __sync_synchronize();
+
+    for(reader_slots *rec = reader_list; rec; rec = rec->next) {
+        for(unsigned pos = 0; pos < READER_SLOTS; ++pos) {
+            while(rec->locks[pos] == lock) {
+                if(deadline && Timer::ticks() >= deadline) {
+                    *biased = true;
+                    return false;
+                }
+                Thread::yield();
+            }
+        }
+    }
+
+    // stay unbiased for a while, so revoking costs writers little
+    Timer::tick_t now = Timer::ticks();
+    *inhibit = now + (now - start) * 9 + 10000;
+    return true;
+}
+
+static inline void reader_rebias(bool biasing, volatile bool *biased, Timer::tick_t inhibit)
+{
+    if(biasing && !*biased && Timer::ticks() >= inhibit)
+        *biased = true;
+}
+#endif
+
 #if _POSIX_TIMERS > 0 && defined(POSIX_TIMERS)
 extern int _posix_clocking;
 int _posix_clocking = CLOCK_REALTIME;
@@ -212,6 +449,7 @@ Conditional()
 	waits = 0;
 	count = limit;
 	used = 0;
+	sequence = 0;
 }
 
 Semaphore::Semaphore(unsigned limit, unsigned avail) :
@@ -223,6 +461,7 @@ Conditional()
 	waits = 0;
 	count = limit;
 	used = limit - avail;
+	sequence = 0;
 }
 
 void Semaphore::_share(void)
@@ -235,10 +474,80 @@ void Semaphore::_unlock(void)
     release();
 }
 
+bool Semaphore::blocking(timeout_t timeout)
+{
+    bool result = true;
+
+    // we are counted as waiting before our last look for a permit, so
+    // a release either sees us waiting or leaves a permit we will see.
+    sync_add(&waits, 1);
+
+#ifdef  HAVE_LINUX_FUTEX_H
+    Timer::tick_t deadline = sync_deadline(timeout);
+    for(;;) {
+        unsigned event = sync_load(&sequence);
+        if(sync_take(&used, &count))
+            break;
+        if(deadline && Timer::ticks() >= deadline) {
+            result = false;
+            break;
+        }
+        sync_sleep(&sequence, event, deadline);
+    }
+#else
+    struct timespec ts;
+    if(timeout != Timer::inf)
+        Conditional::set(&ts, timeout);
+
+    lock();
+    for(;;) {
+        if(sync_take(&used, &count)) {
+            result = true;
+            break;
+        }
+        if(!result)
+            break;
+        if(timeout == Timer::inf)
+            Conditional::wait();
+        else
+            result = Conditional::wait(&ts);
+    }
+    unlock();
+#endif
+
+    sync_add(&waits, (unsigned)(-1));
+    return result;
+}
+
+void Semaphore::unblock(bool all)
+{
+#ifdef  HAVE_LINUX_FUTEX_H
+    sync_add(&sequence, 1);
+    sync_wake(&sequence, all ? INT_MAX : 1);
+#else
+    lock();
+    if(all)
+        broadcast();
+    else
+        signal();
+    unlock();
+#endif
+}
+
 bool Semaphore::wait(timeout_t timeout)
 {
     bool result = true;
     struct timespec ts;
+
+    if(count) {
+        if(sync_take(&used, &count))
+            return true;
+        if(!timeout)
+            return false;
+        return blocking(timeout);
+    }
+
+    // a count of 0 is a group release, which is done under the lock
     Conditional::set(&ts, timeout);
 
     lock();
@@ -257,6 +566,12 @@ bool Semaphore::wait(timeout_t timeout)
 
 void Semaphore::wait(void)
 {
+    if(count) {
+        if(!sync_take(&used, &count))
+            blocking(Timer::inf);
+        return;
+    }
+
     lock();
     if(used >= count) {
         ++waits;
@@ -270,15 +585,24 @@ void Semaphore::wait(void)
 
 void Semaphore::release(void)
 {
+    if(count) {
+        unsigned current = used;
+        while(current) {
+            if(sync_cas(&used, current, current - 1)) {
+                if(waits)
+                    unblock(false);
+                return;
+            }
+            current = used;
+        }
+        return;
+    }
+
     lock();
     if(used)
         --used;
-    if(waits) {
-		if(count)
-	        signal();
-		else
-			broadcast();
-	}
+    if(waits)
+        broadcast();
     unlock();
 }
 
@@ -286,23 +610,18 @@ void Semaphore::set(unsigned value)
 {
     assert(value > 0);
 
-    unsigned diff;
-
-    lock();
+    unsigned prior = count;
     count = value;
-    if(used >= count || !waits) {
-        unlock();
-        return;
-    }
-    diff = count - used;
-    if(diff > waits)
-        diff = waits;
-    unlock();
-    while(diff--) {
+    sync_add(&sequence, 0);
+
+    // wake everyone to recheck against the new limit
+    if(!prior) {
         lock();
-        signal();
+        broadcast();
         unlock();
     }
+    else if(waits && value > prior)
+        unblock(true);
 }
 
 #ifdef  _MSTHREADS_
@@ -833,6 +1152,20 @@ ThreadLock::ThreadLock() :
 ConditionalAccess()
 {
     writers = 0;
+    biased = false;
+    biasing = false;
+    inhibit = 0;
+}
+
+void ThreadLock::bias(bool enable)
+{
+    biasing = enable;
+
+#ifdef  READER_BIAS
+    // the bias itself is only set by a reader holding the lock
+    if(!enable && biased)
+        reader_revoke(this, &biased, &inhibit);
+#endif
 }
 
 void ThreadLock::_lock(void)
@@ -854,6 +1187,12 @@ bool ThreadLock::modify(timeout_t timeout)
 {
     bool rtn = true;
     struct timespec ts;
+#ifdef  READER_BIAS
+    Timer::tick_t deadline = 0;
+
+    if(timeout != Timer::inf)
+        deadline = Timer::ticks() + (Timer::tick_t)timeout * 10000;
+#endif
 
     if(timeout && timeout != Timer::inf)
         set(&ts, timeout);
@@ -878,6 +1217,23 @@ bool ThreadLock::modify(timeout_t timeout)
         ++writers;
     }
     unlock();
+
+#ifdef  READER_BIAS
+    // new readers now wait on writers, so fast readers can drain unlocked;
+    // if they outlast the timeout, give the lock back to them.
+    if(rtn && biased && !reader_revoke(this, &biased, &inhibit, deadline)) {
+        lock();
+        if(!--writers) {
+            memset(&writeid, 0, sizeof(writeid));
+            if(pending)
+                signal();
+            else if(waiting)
+                broadcast();
+        }
+        unlock();
+        rtn = false;
+    }
+#endif
     return rtn;
 }
 
@@ -886,6 +1242,11 @@ bool ThreadLock::access(timeout_t timeout)
     struct timespec ts;
     bool rtn = true;
 
+#ifdef  READER_BIAS
+    if(reader_enter(this, &biased))
+        return true;
+#endif
+
     if(timeout && timeout != Timer::inf)
         set(&ts, timeout);
 
@@ -901,14 +1262,24 @@ bool ThreadLock::access(timeout_t timeout)
         --waiting;
     }
     assert(!max_sharing || sharing < max_sharing);
-    if(rtn)
+    if(rtn) {
         ++sharing;
+#ifdef  READER_BIAS
+        if(!pending)
+            reader_rebias(biasing, &biased, inhibit);
+#endif
+    }
     unlock();
     return rtn;
 }
 
 void ThreadLock::release(void)
 {
+#ifdef  READER_BIAS
+    if(reader_leave(this))
+        return;
+#endif
+
     lock();
     assert(sharing || writers);
 
@@ -1486,6 +1857,9 @@ ConditionalLock::ConditionalLock() :
 ConditionalAccess()
 {
     contexts = NULL;
+    biased = false;
+    biasing = false;
+    inhibit = 0;
 }
 
 ConditionalLock::~ConditionalLock()
@@ -1519,6 +1893,31 @@ ConditionalLock::Context *ConditionalLock::getContext(void)
     return slot;
 }
 
+void ConditionalLock::bias(bool enable)
+{
+    biasing = enable;
+
+#ifdef  READER_BIAS
+    if(!enable && biased)
+        reader_revoke(this, &biased, &inhibit);
+#endif
+}
+
+void ConditionalLock::revoke(void)
+{
+#ifdef  READER_BIAS
+    // readers holding the lock through a slot must drain without the
+    // mutex being held, and pending keeps slow readers from re-biasing.
+    if(biased) {
+        ++pending;
+        unlock();
+        reader_revoke(this, &biased, &inhibit);
+        lock();
+        --pending;
+    }
+#endif
+}
+
 void ConditionalLock::_share(void)
 {
     access();
@@ -1539,6 +1938,10 @@ void ConditionalLock::modify(void)
     assert(context && sharing >= context->count);
 
     sharing -= context->count;
+#ifdef  READER_BIAS
+    context->count += reader_take(this);
+#endif
+    revoke();
     while(sharing) {
         ++pending;
         waitSignal();
@@ -1564,6 +1967,11 @@ void ConditionalLock::release(void)
 {
     Context *context;
 
+#ifdef  READER_BIAS
+    if(reader_leave(this))
+        return;
+#endif
+
     lock();
     context = getContext();
     assert(sharing && context && context->count > 0);
@@ -1579,6 +1987,12 @@ void ConditionalLock::release(void)
 void ConditionalLock::access(void)
 {
     Context *context;
+
+#ifdef  READER_BIAS
+    if(reader_enter(this, &biased))
+        return;
+#endif
+
     lock();
     context = getContext();
     assert(context && (!max_sharing || sharing < max_sharing));
@@ -1594,6 +2008,10 @@ void ConditionalLock::access(void)
         --waiting;
     }
     ++sharing;
+#ifdef  READER_BIAS
+    if(!pending)
+        reader_rebias(biasing, &biased, inhibit);
+#endif
     unlock();
 }
 
@@ -1603,8 +2021,12 @@ void ConditionalLock::exclusive(void)
 
     lock();
     context = getContext();
-    assert(sharing && context && context->count > 0);
     sharing -= context->count;
+#ifdef  READER_BIAS
+    context->count += reader_take(this);
+#endif
+    assert(context && context->count > 0);
+    revoke();
     while(sharing) {
         ++pending;
         waitSignal();
@@ -1623,110 +2045,144 @@ void ConditionalLock::share(void)
 barrier::barrier(unsigned limit) :
 Conditional()
 {
+    assert(limit <= BARRIER_ARRIVED);
+
     count = limit;
-    waits = 0;
+    state = 0;
 }
 
 barrier::~barrier()
 {
+    advance(0);
+}
+
+void barrier::wakeup(void)
+{
+#ifdef  HAVE_LINUX_FUTEX_H
+    sync_wake(&state, INT_MAX);
+#else
     lock();
-    if(waits)
-        broadcast();
+    broadcast();
     unlock();
+#endif
 }
 
-void barrier::set(unsigned limit)
+void barrier::advance(unsigned limit)
 {
-    assert(limit > 0);
+    // open the barrier if enough threads are waiting for the limit
+    unsigned current = state;
+    for(;;) {
+        unsigned arrived = current & BARRIER_ARRIVED;
+        if(!arrived || arrived < limit)
+            return;
+        if(sync_cas(&state, current, (current & ~BARRIER_ARRIVED) + BARRIER_NEXT))
+            break;
+        current = state;
+    }
+    wakeup();
+}
+
+bool barrier::pass(timeout_t timeout)
+{
+    unsigned current = state, next;
+
+    for(;;) {
+        unsigned limit = count;
+        if(!limit)
+            return true;
+        next = current + 1;
+        if((next & BARRIER_ARRIVED) >= limit)
+            next = (current & ~BARRIER_ARRIVED) + BARRIER_NEXT;
+        if(sync_cas(&state, current, next))
+            break;
+        current = state;
+    }
+
+    // we were the last to arrive
+    if(!(next & BARRIER_ARRIVED)) {
+        wakeup();
+        return true;
+    }
+
+    unsigned generation = next & ~BARRIER_ARRIVED;
+
+#ifdef  HAVE_LINUX_FUTEX_H
+    Timer::tick_t deadline = sync_deadline(timeout);
+    for(;;) {
+        current = sync_load(&state);
+        if((current & ~BARRIER_ARRIVED) != generation)
+            return true;
+        if(deadline && Timer::ticks() >= deadline)
+            break;
+        sync_sleep(&state, current, deadline);
+    }
+#else
+    bool result = true;
+    struct timespec ts;
+    if(timeout != Timer::inf)
+        Conditional::set(&ts, timeout);
 
     lock();
-    count = limit;
-    if(count <= waits) {
-        waits = 0;
-        broadcast();
+    while(result && (state & ~BARRIER_ARRIVED) == generation) {
+        if(timeout == Timer::inf)
+            Conditional::wait();
+        else
+            result = Conditional::wait(&ts);
     }
     unlock();
+#endif
+
+    // timed out, so withdraw unless the barrier opened in the meantime
+    current = state;
+    while((current & ~BARRIER_ARRIVED) == generation) {
+        if(sync_cas(&state, current, current - 1))
+            return false;
+        current = state;
+    }
+    return true;
+}
+
+void barrier::set(unsigned limit)
+{
+    assert(limit > 0 && limit <= BARRIER_ARRIVED);
+
+    count = limit;
+    advance(limit);
 }
 
 void barrier::dec(void)
 {
-    lock();
-    if(count)
-        --count;
-    unlock();
+    unsigned current = count;
+    while(current && !sync_cas(&count, current, current - 1))
+        current = count;
 }
 
 unsigned barrier::operator--(void)
 {
-    unsigned result;
-    lock();
-    if(count)
-        --count;
-    result = count;
-    unlock();
-    return result;
+    dec();
+    return count;
 }
 
 void barrier::inc(void)
 {
-    lock();
-    count++;
-    if(count <= waits) {
-        waits = 0;
-        broadcast();
-    }
-    unlock();
+    advance(sync_add(&count, 1) + 1);
 }
 
 unsigned barrier::operator++(void)
 {
-    unsigned result;
-    lock();
-    count++;
-    if(count <= waits) {
-        waits = 0;
-        broadcast();
-    }
-    result = count;
-    unlock();
+    unsigned result = sync_add(&count, 1) + 1;
+    advance(result);
     return result;
 }
 
 bool barrier::wait(timeout_t timeout)
 {
-    bool result;
-
-    Conditional::lock();
-    if(!count) {
-        Conditional::unlock();
-        return true;
-    }
-    if(++waits >= count) {
-        waits = 0;
-        Conditional::broadcast();
-        Conditional::unlock();
-        return true;
-    }
-    result = Conditional::wait(timeout);
-    Conditional::unlock();
-    return result;
+    return pass(timeout);
 }
 
 void barrier::wait(void)
 {
-    Conditional::lock();
-    if(!count) {
-        Conditional::unlock();
-        return;
-    }
-    if(++waits >= count) {
-        waits = 0;
-        Conditional::broadcast();
-        Conditional::unlock();
-        return;
-    }
-    Conditional::wait();
-    Conditional::unlock();
+    pass(Timer::inf);
 }
 
 LockedPointer::LockedPointer()
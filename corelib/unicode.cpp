@@ -35,11 +35,312 @@
 typedef ucs4_t  wchar_t;
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define UTF8_X86_KERNELS
+#include <immintrin.h>
+#endif
+#endif
+
+#include "cpu.h"
+
 namespace ucommon {
 
 const char *utf8::nil = NULL;
 const unsigned utf8::ucsize = sizeof(wchar_t);
 
+#define ASCII_MASK  0x8080808080808080ull
+
+static inline bool lead(uint8_t ch)
+{
+    return (ch & 0xc0) != 0x80;
+}
+
+/*
+ * Validate a utf8 buffer and count its codepoints in one pass.  Valid
+ * text always starts a codepoint at each non-continuation byte, which is
+ * what lets the kernels count and locate codepoints without decoding.
+ */
+static bool measure(const uint8_t *text, size_t len, size_t *points)
+{
+    size_t pos = 0, count = 0;
+    uint64_t word;
+
+    while(pos < len) {
+        if(pos + 8 <= len) {
+            memcpy(&word, text + pos, 8);
+            if(!(word & ASCII_MASK)) {
+                pos += 8;
+                count += 8;
+                continue;
+            }
+        }
+
+        uint8_t ch = text[pos];
+        size_t need;
+
+        if(ch < 0x80) {
+            ++pos;
+            ++count;
+            continue;
+        }
+        else if(ch < 0xc2)
+            return false;
+        else if(ch < 0xe0)
+            need = 1;
+        else if(ch < 0xf0)
+            need = 2;
+        else if(ch < 0xf5)
+            need = 3;
+        else
+            return false;
+
+        if(len - pos <= need)
+            return false;
+
+        uint8_t next = text[pos + 1];
+        if((ch == 0xe0 && next < 0xa0) || (ch == 0xed && next > 0x9f))
+            return false;
+        if((ch == 0xf0 && next < 0x90) || (ch == 0xf4 && next > 0x8f))
+            return false;
+
+        while(need--) {
+            if((text[++pos] & 0xc0) != 0x80)
+                return false;
+        }
+        ++pos;
+        ++count;
+    }
+
+    *points = count;
+    return true;
+}
+
+// byte offset of codepoint in valid text, or len if at end
+static size_t locate(const uint8_t *text, size_t len, size_t codepoint)
+{
+    size_t pos = 0;
+    uint64_t word;
+
+    while(pos < len) {
+        if(codepoint >= 8 && pos + 8 <= len) {
+            memcpy(&word, text + pos, 8);
+            if(!(word & ASCII_MASK)) {
+                pos += 8;
+                codepoint -= 8;
+                continue;
+            }
+        }
+        if(lead(text[pos]) && !codepoint--)
+            return pos;
+        ++pos;
+    }
+    return len;
+}
+
+/*
+ * Avx2 kernels, following the lookup table validation of Keiser and
+ * Lemire: three nibble lookups classify each pair of adjacent bytes, and
+ * the only errors they cannot see are missing continuations of three and
+ * four byte sequences, which are checked from the bytes two and three
+ * back.  Blocks of plain ascii skip all of this.
+ */
+#ifdef  UTF8_X86_KERNELS
+
+#define TOO_SHORT   (1 << 0)
+#define TOO_LONG    (1 << 1)
+#define OVERLONG_3  (1 << 2)
+#define TOO_LARGE   (1 << 3)
+#define SURROGATE   (1 << 4)
+#define OVERLONG_2  (1 << 5)
+#define TOO_LARGE_1000  (1 << 6)
+#define OVERLONG_4  (1 << 6)
+#define TWO_CONTS   (1 << 7)
+#define CARRY       (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define LARGE       (CARRY | TOO_LARGE | TOO_LARGE_1000)
+#define CONTINUE    (TOO_LONG | OVERLONG_2 | TWO_CONTS)
+
+__attribute__((target("avx2,popcnt")))
+static inline __m256i table(char b0, char b1, char b2, char b3, char b4, char b5, char b6, char b7,
+    char b8, char b9, char b10, char b11, char b12, char b13, char b14, char b15)
+{
+    return _mm256_broadcastsi128_si256(_mm_setr_epi8(b0, b1, b2, b3, b4, b5, b6, b7,
+        b8, b9, b10, b11, b12, b13, b14, b15));
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline __m256i high(__m256i bytes)
+{
+    return _mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0f));
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline unsigned leads(__m256i bytes)
+{
+    return (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(-65)));
+}
+
+__attribute__((target("avx2,popcnt")))
+static bool measure_avx2(const uint8_t *text, size_t len, size_t *points)
+{
+    const __m256i byte_1_high = table(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2, TOO_SHORT, TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m256i byte_1_low = table(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY, CARRY,
+        CARRY | TOO_LARGE, LARGE, LARGE, LARGE, LARGE, LARGE, LARGE, LARGE, LARGE,
+        LARGE | SURROGATE, LARGE, LARGE);
+    const __m256i byte_2_high = table(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        CONTINUE | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4, CONTINUE | OVERLONG_3 | TOO_LARGE,
+        CONTINUE | SURROGATE | TOO_LARGE, CONTINUE | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    const __m256i incomplete = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1));
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i prior = _mm256_setzero_si256();
+    __m256i pending = _mm256_setzero_si256();
+    uint8_t tail[32];
+    size_t pos = 0, count = 0;
+
+    while(pos < len) {
+        __m256i input;
+
+        if(len - pos >= 32)
+            input = _mm256_loadu_si256((const __m256i *)(text + pos));
+        else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, text + pos, len - pos);
+            input = _mm256_loadu_si256((const __m256i *)tail);
+            count -= 32 - (len - pos);
+        }
+
+        if(!_mm256_movemask_epi8(input)) {
+            error = _mm256_or_si256(error, pending);
+            pending = _mm256_setzero_si256();
+            count += 32;
+        }
+        else {
+            __m256i carry = _mm256_permute2x128_si256(prior, input, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(input, carry, 15);
+            __m256i prev2 = _mm256_alignr_epi8(input, carry, 14);
+            __m256i prev3 = _mm256_alignr_epi8(input, carry, 13);
+
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(byte_1_high, high(prev1)),
+                    _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0f)))),
+                _mm256_shuffle_epi8(byte_2_high, high(input)));
+
+            __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xe0 - 0x80)));
+            __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xf0 - 0x80)));
+            __m256i must = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+
+            error = _mm256_or_si256(error, _mm256_xor_si256(must, special));
+            pending = _mm256_subs_epu8(input, incomplete);
+            count += __builtin_popcount(leads(input));
+        }
+        prior = input;
+        pos += 32;
+    }
+
+    error = _mm256_or_si256(error, pending);
+    if(!_mm256_testz_si256(error, error))
+        return false;
+
+    *points = count;
+    return true;
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t locate_avx2(const uint8_t *text, size_t len, size_t codepoint)
+{
+    size_t pos = 0;
+
+    while(len - pos >= 32) {
+        unsigned mask = leads(_mm256_loadu_si256((const __m256i *)(text + pos)));
+        size_t found = (size_t)__builtin_popcount(mask);
+        if(found > codepoint) {
+            while(codepoint--)
+                mask &= mask - 1;
+            return pos + (size_t)__builtin_ctz(mask);
+        }
+        codepoint -= found;
+        pos += 32;
+    }
+
+    return pos + locate(text + pos, len - pos, codepoint);
+}
+
+#endif
+
+#define KERNEL_UNKNOWN  0
+#define KERNEL_PORTABLE 1
+#define KERNEL_AVX2     2
+
+static volatile unsigned kernels = KERNEL_UNKNOWN;
+
+static unsigned select_kernels(void)
+{
+    unsigned found = KERNEL_PORTABLE;
+
+#ifdef  UTF8_X86_KERNELS
+    unsigned features = cpu_features();
+
+    if((features & CPU_AVX2) && (features & CPU_POPCNT))
+        found = KERNEL_AVX2;
+#endif
+
+    kernels = found;
+    return found;
+}
+
+static bool measure_text(const char *text, size_t len, size_t *points)
+{
+    unsigned kernel = kernels;
+
+    if(kernel == KERNEL_UNKNOWN)
+        kernel = select_kernels();
+
+#ifdef  UTF8_X86_KERNELS
+    if(kernel == KERNEL_AVX2 && len >= 32)
+        return measure_avx2((const uint8_t *)text, len, points);
+#endif
+    return measure((const uint8_t *)text, len, points);
+}
+
+static size_t locate_text(const char *text, size_t len, size_t codepoint)
+{
+#ifdef  UTF8_X86_KERNELS
+    if(kernels == KERNEL_AVX2 && len >= 32)
+        return locate_avx2((const uint8_t *)text, len, codepoint);
+#endif
+    return locate((const uint8_t *)text, len, codepoint);
+}
+
+// step a pointer forward over plain ascii eight bytes at a time; aligned
+// words never cross into another page, so reading past the terminator of
+// a string is harmless here.
+static uint8_t *forward(uint8_t *text, long& offset)
+{
+    uint64_t word;
+
+    while(offset >= 8 && !((uintptr_t)text & 7)) {
+        memcpy(&word, text, 8);
+        if((word & ASCII_MASK) || ((word - 0x0101010101010101ull) & ~word & ASCII_MASK))
+            break;
+        text += 8;
+        offset -= 8;
+    }
+    return text;
+}
+
 ucs4_t utf8::get(CharacterProtocol& cp)
 {
     int ch = cp.getchar();
@@ -155,6 +456,14 @@ ucs4_t utf8::codepoint(const char *string)
 }
 
 size_t utf8::count(const char *string)
+{
+    if(!string)
+        return 0;
+
+    return count(string, strlen(string));
+}
+
+size_t utf8::count(const char *string, size_t len)
 {
     size_t pos = 0;
     unsigned codesize;
@@ -162,20 +471,53 @@ size_t utf8::count(const char *string)
     if(!string)
         return 0;
 
-    while(*string && (codesize = size(string)) != 0) {
+    if(measure_text(string, len, &pos))
+        return pos;
+
+    // legacy and malformed text is walked by lead bytes
+    pos = 0;
+    while(len && *string && (codesize = size(string)) != 0 && codesize <= len) {
         ++pos;
         string += codesize;
+        len -= codesize;
     }
 
     return pos;
 }
 
+bool utf8::valid(const char *string, size_t len)
+{
+    size_t points;
+
+    if(!string)
+        return false;
+
+    if(!len)
+        len = strlen(string);
+
+    return measure_text(string, len, &points);
+}
+
 char *utf8::offset(char *string, ssize_t pos)
 {
+    size_t len, points;
+
     if(!string)
         return NULL;
 
-    ssize_t codepoints = count(string);
+    len = strlen(string);
+    if(measure_text(string, len, &points)) {
+        if(pos > (ssize_t)points)
+            return NULL;
+        if(pos < 0) {
+            if(-pos > (ssize_t)points)
+                return NULL;
+            pos += (ssize_t)points;
+        }
+        return string + locate_text(string, len, (size_t)pos);
+    }
+
+    ssize_t codepoints = count(string, len);
     if(pos > codepoints)
         return NULL;
 
@@ -429,41 +771,163 @@ const char *utf8::rfind(const char *cp, ucs4_t code, size_t pos)
     return result;
 }
 
-UString::UString()
+/*
+ * The codepoint index records the byte offset of every INDEX_STRIDE'th
+ * codepoint, so a lookup walks at most INDEX_STRIDE - 1 codepoints.  It
+ * is keyed to the cstring and length it was built from.
+ */
+#define INDEX_STRIDE    32
+
+struct UString::index_t
 {
-    str = NULL;
+    const void *key;
+    strsize_t len;
+    size_t points;
+    strsize_t marks[1];
+};
+
+UString::UString() :
+String()
+{
+    cache = NULL;
+    indexed = false;
 }
 
-UString::~UString() {}
+UString::~UString()
+{
+    reset();
+}
 
-UString::UString(strsize_t size)
+UString::UString(strsize_t size) :
+String(size)
 {
-    str = create(size);
-    str->retain();
+    cache = NULL;
+    indexed = false;
 }
 
-UString::UString(const char *text, strsize_t size)
+UString::UString(const char *text, strsize_t size) :
+String(text, size)
 {
-    str = NULL;
-    String::set(0, text, size);
+    cache = NULL;
+    indexed = false;
 }
 
 UString::UString(const unicode_t text)
 {
     str = NULL;
+    cache = NULL;
+    indexed = false;
     set(text);
 }
 
-UString::UString(const UString& copy)
+UString::UString(const UString& copy) :
+String(copy)
 {
-    str = NULL;
-    if(copy.str)
-        String::set(copy.str->text);
+    cache = NULL;
+    indexed = copy.indexed;
+    reindex();
+}
+
+UString& UString::operator=(const UString& copy)
+{
+    if(this != &copy) {
+        String::operator=(copy);
+        reindex();
+    }
+    return *this;
+}
+
+void UString::reset(void)
+{
+    if(cache)
+        ::free(cache);
+    cache = NULL;
+}
+
+void UString::index(bool enable)
+{
+    indexed = enable;
+    reindex();
+}
+
+bool UString::current(void) const
+{
+    return indexed && cache && str && cache->key == str && cache->len == str->len;
+}
+
+void UString::reindex(void)
+{
+    reset();
+
+    if(!indexed || !str)
+        return;
+
+    const char *text = str->text;
+    strsize_t len = str->len;
+    size_t points = 0, mark = 0, offset = 0;
+    bool valid = measure_text(text, len, &points);
+
+    if(!valid)
+        points = utf8::count(text, len);
+
+    cache = (index_t *)::malloc(sizeof(index_t) + sizeof(strsize_t) * (points / INDEX_STRIDE));
+    if(!cache)
+        return;
+
+    cache->key = str;
+    cache->len = len;
+    cache->points = points;
+    for(size_t point = 0; point <= points; point += INDEX_STRIDE) {
+        if(valid)
+            offset += locate_text(text + offset, len - offset, mark ? INDEX_STRIDE : 0);
+        else if(mark) {
+            for(unsigned step = 0; step < INDEX_STRIDE; ++step)
+                offset += utf8::size(text + offset);
+        }
+        cache->marks[mark++] = (strsize_t)offset;
+    }
+}
+
+const char *UString::lookup(ssize_t pos) const
+{
+    if(!str)
+        return NULL;
+
+    // a stale index is never rebuilt here, so const access stays read only
+    if(!current())
+        return utf8::offset(str->text, pos);
+
+    if(pos > (ssize_t)cache->points)
+        return NULL;
+
+    if(pos < 0) {
+        if(-pos > (ssize_t)cache->points)
+            return NULL;
+        pos += (ssize_t)cache->points;
+    }
+
+    const char *cp = str->text + cache->marks[pos / INDEX_STRIDE];
+    pos %= INDEX_STRIDE;
+    while(pos--)
+        cp += utf8::size(cp);
+    return cp;
+}
+
+strsize_t UString::count(void) const
+{
+    if(!str)
+        return 0;
+
+    if(current())
+        return (strsize_t)cache->points;
+
+    return (strsize_t)utf8::count(str->text, str->len);
 }
 
 void UString::set(const unicode_t text)
 {
     strsize_t size = utf8::chars(text);
+    reset();
     str = NULL;
     str = create(size);
     str->retain();
@@ -471,12 +935,14 @@ void UString::set(const unicode_t text)
     chartext cp(str->text, str->max);
     utf8::unpack(text, cp);
     str->fix();
+    reindex();
 }
 
 void UString::add(const unicode_t text)
 {
     strsize_t alloc, size;
 
+    reset();
     size = alloc = utf8::chars(text);
     if(str)
         alloc += str->len;
@@ -487,6 +953,7 @@ void UString::add(const unicode_t text)
     chartext cp(str->text + str->len, size);
     utf8::unpack(text, cp);
     str->fix();
+    reindex();
 }
 
 size_t UString::get(unicode_t output, size_t points) const
@@ -500,26 +967,43 @@ void UString::cut(strsize_t pos, strsize_t size)
     if(!str)
         return;
 
-    strsize_t bpos = 0, blen = 0;
+    const char *start = str->text, *end = NULL;
     if(pos && pos != npos)
-         bpos = String::offset(utf8::offset(str->text, (ssize_t)pos));
+        start = lookup((ssize_t)pos);
+
+    if(!start)
+        return;
 
     if(size && size != npos)
-        blen = String::offset(utf8::offset(str->text, (ssize_t)size));
+        end = lookup((ssize_t)(pos + size));
+
+    strsize_t bpos = String::offset(start);
+    strsize_t blen = end ? (strsize_t)(end - start) : 0;
 
     String::cut(bpos, blen);
+    reindex();
 }
 
 void UString::paste(strsize_t pos, const char *text, strsize_t size)
 {
     strsize_t bpos = 0, blen = 0;
-    if(pos && pos != npos && str)
-         bpos = String::offset(utf8::offset(str->text, (ssize_t)pos));
 
-    if(size && size != npos && str)
-        blen = String::offset(utf8::offset(str->text, (ssize_t)size));
+    if(!text)
+        return;
+
+    if(pos && pos != npos && str) {
+        const char *cp = lookup((ssize_t)pos);
+        bpos = cp ? String::offset(cp) : str->len;
+    }
+
+    if(size && size != npos) {
+        const char *end = utf8::offset((char *)text, (ssize_t)size);
+        if(end)
+            blen = (strsize_t)(end - text);
+    }
 
     String::paste(bpos, text, blen);
+    reindex();
 }
 
 UString UString::get(strsize_t pos, strsize_t size) const
@@ -527,19 +1011,21 @@ UString UString::get(strsize_t pos, strsize_t size) const
     if(!str)
         return UString("", 0);
 
-    char *substr = utf8::offset(str->text, (ssize_t)pos);
+    const char *substr = lookup((ssize_t)pos);
     if(!substr)
         return UString("", 0);
 
     if(!size)
         return UString(substr, 0);
 
-    const char *end = utf8::offset(substr, size);
+    const char *end = lookup((ssize_t)(pos + size));
     if(!end)
-        return UString(substr);
+        return UString(substr, 0);
+
+    if(end == substr)
+        return UString("", 0);
 
-    pos = (end - substr + 1);
-    return UString(substr, pos);
+    return UString(substr, (strsize_t)(end - substr));
 }
 
 ucs4_t UString::at(int offset) const
@@ -549,7 +1035,7 @@ ucs4_t UString::at(int offset) const
     if(!str)
         return -1;
 
-    cp = utf8::offset(str->text, offset);
+    cp = lookup(offset);
 
     if(!cp)
         return -1;
@@ -583,15 +1069,18 @@ unsigned UString::ccount(ucs4_t code) const
 
 UString UString::operator()(int codepoint, strsize_t size) const
 {
-    return UString::get(codepoint, size);
+    if(codepoint < 0) {
+        int points = (int)count();
+        if(-codepoint > points)
+            return UString("", 0);
+        codepoint += points;
+    }
+    return UString::get((strsize_t)codepoint, size);
 }
 
 const char *UString::operator()(int offset) const
 {
-    if(!str)
-        return NULL;
-
-    return utf8::offset(str->text, offset);
+    return lookup(offset);
 }
 
 utf8_pointer::utf8_pointer()
@@ -653,8 +1142,13 @@ utf8_pointer& utf8_pointer::operator+=(long offset)
         return *this;
 
     if(offset > 0) {
-        while(offset--)
+        while(offset > 0) {
+            text = forward(text, offset);
+            if(!offset)
+                break;
             inc();
+            --offset;
+        }
     }
     else {
         while(offset++)
@@ -673,8 +1167,14 @@ utf8_pointer& utf8_pointer::operator-=(long offset)
             dec();
     }
     else {
-        while(offset++)
+        offset = -offset;
+        while(offset > 0) {
+            text = forward(text, offset);
+            if(!offset)
+                break;
             inc();
+            --offset;
+        }
     }
     return *this;
 }
@@ -709,10 +1209,8 @@ ucs4_t utf8_pointer::operator[](long offset) const
     if(!offset)
         return utf8::codepoint((const char*)text);
 
-    if(offset > 0) {
-        while(offset--)
-            ncp.inc();
-    }
+    if(offset > 0)
+        ncp += offset;
     else {
         while(offset++)
             ncp.dec();
@@ -28,6 +28,20 @@ namespace ucommon {
 
 const vectorsize_t Vector::npos = (vectorsize_t)(-1);
 
+// Lists grow geometrically so that repeated appends copy each pointer
+// a constant number of times on average.
+
+static vectorsize_t grow(vectorsize_t current, vectorsize_t needed)
+{
+    vectorsize_t size = current * 2;
+
+    if(size < 8)
+        size = 8;
+    if(size < needed || size < current)
+        size = needed;
+    return size;
+}
+
 Vector::array::array(vectorsize_t size)
 {
     assert(size > 0);
@@ -102,21 +116,56 @@ void Vector::array::add(ObjectProtocol **items)
 {
     assert(items != NULL);
 
-    vectorsize_t size = Vector::size((void **)(items));
+    add(items, Vector::size((void **)(items)));
+}
+
+void Vector::array::add(ObjectProtocol **items, vectorsize_t size)
+{
+    if(len + size > max)
+        size = max - len;
 
     if(!size)
         return;
 
+    memcpy(&list[len], items, size * sizeof(ObjectProtocol *));
+    len += size;
+    list[len] = 0;
+    while(size--)
+        (*(items++))->retain();
+}
+
+void Vector::array::insert(vectorsize_t pos, ObjectProtocol **items, vectorsize_t size)
+{
+    if(pos > len)
+        pos = len;
+
     if(len + size > max)
         size = max - len;
 
-    if(size < 1)
+    if(!size)
         return;
 
-    for(vectorsize_t pos = 0; pos < size; ++pos) {
-        list[len++] = items[pos];
-        items[pos]->retain();
-    }
+    memmove(&list[pos + size], &list[pos], (len - pos) * sizeof(ObjectProtocol *));
+    memcpy(&list[pos], items, size * sizeof(ObjectProtocol *));
+    len += size;
+    list[len] = 0;
+    while(size--)
+        (*(items++))->retain();
+}
+
+void Vector::array::erase(vectorsize_t pos, vectorsize_t size)
+{
+    if(pos >= len)
+        return;
+
+    if(size > len - pos)
+        size = len - pos;
+
+    for(vectorsize_t index = pos; index < pos + size; ++index)
+        list[index]->release();
+
+    memmove(&list[pos], &list[pos + size], (len - pos - size) * sizeof(ObjectProtocol *));
+    len -= size;
     list[len] = 0;
 }
 
@@ -165,6 +214,23 @@ Vector::Vector(ObjectProtocol **items, vectorsize_t limit)
     data->set(items);
 }
 
+Vector::Vector(const Vector &copy)
+{
+    data = copy.data;
+    if(!data)
+        return;
+
+    // an unretained list is in external memory, so cannot be shared
+    if(data->is_retained()) {
+        data->retain();
+        return;
+    }
+
+    data = create(copy.data->max);
+    data->retain();
+    data->add(copy.data->list, copy.data->len);
+}
+
 Vector::Vector(vectorsize_t size)
 {
     assert(size > 0);
@@ -196,15 +262,15 @@ ObjectProtocol *Vector::get(int offset) const
     if(!data || !data->len)
         return invalid();
 
-    if(offset >= (int)(data->len))
-        return invalid();
+    if(offset >= 0) {
+        if((vectorsize_t)offset >= data->len)
+            return invalid();
+        return data->list[offset];
+    }
 
-    if(((vectorsize_t)(-offset)) >= data->len)
+    if((vectorsize_t)(-offset) > data->len)
         return invalid();
 
-    if(offset >= 0)
-        return data->list[offset];
-
     return data->list[data->len + offset];
 }
 
@@ -228,7 +294,8 @@ Vector::array *Vector::create(vectorsize_t size) const
 {
     assert(size > 0);
 
-    void *mem = ::malloc((size_t)size);
+    void *mem = ::malloc(sizeof(array) + (size_t)size * sizeof(ObjectProtocol *));
+    crit(mem != NULL, "vector alloc failed");
     return new(mem) array(size);
 }
 
@@ -275,6 +342,8 @@ void Vector::split(vectorsize_t pos)
     if(!data || pos >= data->len)
         return;
 
+    cow();
+
     while(data->len > pos) {
         --data->len;
         data->list[data->len]->release();
@@ -289,6 +358,7 @@ void Vector::rsplit(vectorsize_t pos)
     if(!data || pos >= data->len || !pos)
         return;
 
+    cow();
     while(head < pos)
         data->list[head++]->release();
 
@@ -304,12 +374,29 @@ void Vector::set(ObjectProtocol **list)
 {
     assert(list);
 
-    if(!data && list) {
-        data = create(size((void **)list));
+    vectorsize_t count = size((void **)list);
+
+    // a list taken from our own is held so it is copied, not purged
+    array *hold = NULL;
+    if(data && list >= data->list && list <= &data->list[data->max]) {
+        if(list == data->list)
+            return;
+        hold = data;
+        hold->retain();
+    }
+
+    if(data && (data->is_copied() || count > data->max))
+        resize(count);
+
+    if(!data && count) {
+        data = create(count);
         data->retain();
     }
-    if(data && list)
+    if(data)
         data->set(list);
+
+    if(hold)
+        hold->release();
 }
 
 void Vector::set(vectorsize_t pos, ObjectProtocol *obj)
@@ -319,37 +406,90 @@ void Vector::set(vectorsize_t pos, ObjectProtocol *obj)
     if(!data || pos > data->len)
         return;
 
-    if(pos == data->len && data->len < data->max) {
-        data->list[data->len++] = obj;
-        data->list[data->len] = NULL;
-        obj->retain();
+    if(pos == data->len) {
+        add(obj);
         return;
     }
+
+    cow();
+    obj->retain();
     data->list[pos]->release();
     data->list[pos] = obj;
-    obj->retain();
 }
 
 void Vector::add(ObjectProtocol **list)
 {
     assert(list);
 
-    if(data && list)
-        data->add(list);
+    add(list, size((void **)list));
 }
 
 void Vector::add(ObjectProtocol *obj)
 {
     assert(obj);
 
-    if(data && obj)
+    cow(1);
+    if(data)
         data->add(obj);
 }
 
-void Vector::clear(void)
+void Vector::add(ObjectProtocol **list, vectorsize_t count)
+{
+    insert(npos, list, count);
+}
+
+void Vector::insert(vectorsize_t pos, ObjectProtocol **list, vectorsize_t count)
 {
+    if(!list || !count)
+        return;
+
+    // hold our current list if we are inserting from it, so that it is
+    // copied rather than moved or shifted underneath us.
+    array *hold = NULL;
+    if(data && list >= data->list && list <= &data->list[data->max]) {
+        hold = data;
+        hold->retain();
+    }
+
+    cow(count);
     if(data)
-        data->purge();
+        data->insert(pos, list, count);
+
+    if(hold)
+        hold->release();
+}
+
+void Vector::erase(vectorsize_t pos, vectorsize_t count)
+{
+    if(!data || pos >= data->len || !count)
+        return;
+
+    cow();
+    data->erase(pos, count);
+}
+
+void Vector::reserve(vectorsize_t size)
+{
+    vectorsize_t current = len();
+
+    if(size > current)
+        cow(size - current);
+}
+
+void Vector::clear(void)
+{
+    if(!data)
+        return;
+
+    if(data->is_copied()) {
+        array *a = create(data->max);
+        a->retain();
+        data->release();
+        data = a;
+        return;
+    }
+
+    data->purge();
 }
 
 bool Vector::resize(vectorsize_t size)
@@ -360,8 +500,8 @@ bool Vector::resize(vectorsize_t size)
         return true;
     }
 
-    if(data->is_copied() || data->max < size) {
-        data->release();
+    if(!data || data->is_copied() || data->max < size) {
+        release();
         data = create(size);
         data->retain();
     }
@@ -370,22 +510,42 @@ bool Vector::resize(vectorsize_t size)
 
 void Vector::cow(vectorsize_t size)
 {
+    vectorsize_t current = 0;
+    bool shared = false;
+
     if(data) {
+        shared = data->is_copied();
+        current = data->max;
         size += data->len;
+        if(!shared && size <= current)
+            return;
     }
 
-    if(!size)
+    if(size > current)
+        current = grow(current, size);
+
+    if(!current)
         return;
 
-    if(!data || !data->max || data->is_copied() || size > data->max) {
-        array *a = create(size);
+    array *a = create(current);
+    if(data) {
         a->len = data->len;
         memcpy(a->list, data->list, data->len * sizeof(ObjectProtocol *));
-        a->list[a->len] = 0;
-        a->retain();
+
+        // a shared list keeps its references, otherwise they are moved
+        if(shared) {
+            for(vectorsize_t pos = 0; pos < a->len; ++pos)
+                a->list[pos]->retain();
+        }
+        else {
+            data->len = 0;
+            data->list[0] = 0;
+        }
         data->release();
-        data = a;
     }
+    a->list[a->len] = 0;
+    a->retain();
+    data = a;
 }
 
 void Vector::operator^=(Vector &v)
@@ -401,10 +561,7 @@ Vector &Vector::operator^(Vector &v)
     if(!vs)
         return *this;
 
-    if(data && data->len + vs > data->max)
-        cow();
-
-    add(v.list());
+    add(v.list(), vs);
     return *this;
 }
 
@@ -413,6 +570,7 @@ void Vector::operator++()
     if(!data)
         return;
 
+    cow();
     data->inc(1);
 }
 
@@ -421,6 +579,7 @@ void Vector::operator--()
     if(!data)
         return;
 
+    cow();
     data->dec(1);
 }
 
@@ -429,6 +588,7 @@ void Vector::operator+=(vectorsize_t inc)
     if(!data)
         return;
 
+    cow();
     data->inc(inc);
 }
 
@@ -437,7 +597,8 @@ void Vector::operator-=(vectorsize_t dec)
     if(!data)
         return;
 
-    data->inc(dec);
+    cow();
+    data->dec(dec);
 }
 
 MemVector::MemVector(void *mem, vectorsize_t size)
@@ -0,0 +1,521 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ucommon-config.h>
+#include <ucommon/export.h>
+#include <ucommon/thread.h>
+#include <ucommon/string.h>
+#include <ucommon/fsys.h>
+#include <ucommon/executor.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#ifdef  HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef  HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_DIRENT_H) && !defined(_MSWINDOWS_)
+#include <dirent.h>
+#endif
+#ifdef  __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace ucommon {
+
+#if defined(_MSWINDOWS_) && !defined(__GNUC__)
+#define sync_add(p, v)      ((unsigned long)InterlockedExchangeAdd((LONG volatile *)(p), (LONG)(v)))
+#else
+#define sync_add(p, v)      __sync_fetch_and_add(p, v)
+#endif
+
+#ifdef  PATH_MAX
+#define WALK_PATH   PATH_MAX
+#else
+#define WALK_PATH   1024
+#endif
+
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW  0
+#endif
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC   0
+#endif
+
+// on linux the directory is read with getdents64 directly, which fills the
+// whole batch buffer in one call, records included.
+
+#if defined(__linux__) && defined(SYS_getdents64) && defined(DT_UNKNOWN)
+#define USE_GETDENTS
+
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+} batch_t;
+#endif
+
+// where directories are read through a descriptor, subdirectories are
+// opened relative to their parent, so a walk never leaves the tree through
+// a directory replaced by a link after it was read.
+
+#if defined(HAVE_OPENAT) && !defined(_MSWINDOWS_) && (defined(USE_GETDENTS) || defined(HAVE_FDOPENDIR))
+#define USE_OPENAT
+#endif
+
+#define WALK_FLAGS  (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+
+static bool dots(const char *name)
+{
+    if(name[0] != '.')
+        return false;
+
+    if(!name[1] || (name[1] == '.' && !name[2]))
+        return true;
+
+    return false;
+}
+
+#if defined(DT_UNKNOWN) && !defined(_MSWINDOWS_)
+static DirWalker::type_t dtype(unsigned char type)
+{
+    switch(type) {
+    case DT_UNKNOWN:
+        return DirWalker::UNKNOWN;
+    case DT_REG:
+        return DirWalker::REGULAR;
+    case DT_DIR:
+        return DirWalker::DIRECTORY;
+    case DT_LNK:
+        return DirWalker::SYMLINK;
+    default:
+        return DirWalker::SPECIAL;
+    }
+}
+#endif
+
+class __LOCAL DirWalker::crawler : public Executor::task
+{
+private:
+    DirWalker *walker;
+    char *path;
+    fd_t fd;
+    unsigned level;
+
+public:
+    crawler(DirWalker *owner, const char *dir, fd_t at, unsigned depth);
+    ~crawler();
+
+    void run(void);
+};
+
+DirWalker::crawler::crawler(DirWalker *owner, const char *dir, fd_t at, unsigned depth) :
+Executor::task(true)
+{
+    walker = owner;
+    path = strdup(dir);
+    fd = at;
+    level = depth;
+}
+
+DirWalker::crawler::~crawler()
+{
+    if(path)
+        free(path);
+#ifndef _MSWINDOWS_
+    if(fd != INVALID_HANDLE_VALUE)
+        ::close(fd);
+#endif
+}
+
+void DirWalker::crawler::run(void)
+{
+    fd_t at = fd;
+
+    fd = INVALID_HANDLE_VALUE;
+    walker->crawl(path, at, level);
+}
+
+DirWalker::reader::reader(const char *dir, size_t bufsize)
+{
+    path = strdup(dir);
+    size = bufsize;
+    open(INVALID_HANDLE_VALUE, dir);
+}
+
+DirWalker::reader::reader(reader& parent, const char *name, const char *dir, size_t bufsize)
+{
+    path = strdup(dir);
+    size = bufsize;
+    open(parent.fd, name);
+}
+
+DirWalker::reader::reader(fd_t at, const char *dir, size_t bufsize)
+{
+    path = strdup(dir);
+    size = bufsize;
+
+#ifdef  USE_OPENAT
+    if(at != INVALID_HANDLE_VALUE) {
+        fd = at;
+        dp = NULL;
+        buffer = NULL;
+        pos = used = 0;
+        error = 0;
+        if(!path)
+            error = ENOMEM;
+        else
+            attach();
+        return;
+    }
+#endif
+
+    open(INVALID_HANDLE_VALUE, dir);
+}
+
+DirWalker::reader::~reader()
+{
+#ifdef  _MSWINDOWS_
+    if(dp)
+        delete (dir *)dp;
+#else
+    if(dp)
+        ::closedir((DIR *)dp);
+    else if(fd != INVALID_HANDLE_VALUE)
+        ::close(fd);
+#endif
+    if(buffer)
+        free(buffer);
+    if(path)
+        free(path);
+}
+
+#ifdef  _MSWINDOWS_
+
+void DirWalker::reader::open(fd_t at, const char *name)
+{
+    fd = INVALID_HANDLE_VALUE;
+    dp = NULL;
+    pos = used = 0;
+    error = 0;
+
+    buffer = (char *)malloc(size);
+    if(!buffer || !path) {
+        error = ENOMEM;
+        return;
+    }
+
+    dir *ds = new dir(path);
+    if(!*ds) {
+        error = ds->err();
+        if(!error)
+            error = ENOENT;
+        delete ds;
+        return;
+    }
+    dp = ds;
+}
+
+const char *DirWalker::reader::next(type_t *type)
+{
+    if(type)
+        *type = UNKNOWN;
+
+    if(error)
+        return NULL;
+
+    while(((dir *)dp)->read(buffer, size) > 0) {
+        if(!dots(buffer))
+            return buffer;
+    }
+    return NULL;
+}
+
+#else
+
+void DirWalker::reader::open(fd_t at, const char *name)
+{
+    fd = INVALID_HANDLE_VALUE;
+    dp = NULL;
+    buffer = NULL;
+    pos = used = 0;
+    error = 0;
+
+    if(!path) {
+        error = ENOMEM;
+        return;
+    }
+
+#if defined(USE_GETDENTS) || defined(HAVE_FDOPENDIR)
+#ifdef  USE_OPENAT
+    if(at != INVALID_HANDLE_VALUE)
+        fd = ::openat(at, name, WALK_FLAGS | O_NOFOLLOW);
+    else
+#endif
+        fd = ::open(path, WALK_FLAGS);
+
+    if(fd < 0) {
+        error = errno;
+        fd = INVALID_HANDLE_VALUE;
+        return;
+    }
+
+    attach();
+#else
+    dp = ::opendir(path);
+    if(!dp)
+        error = errno;
+#endif
+}
+
+void DirWalker::reader::attach(void)
+{
+#ifdef  USE_GETDENTS
+    buffer = (char *)malloc(size);
+    if(!buffer)
+        error = ENOMEM;
+#elif defined(HAVE_FDOPENDIR)
+    dp = ::fdopendir(fd);
+    if(!dp)
+        error = errno;
+#endif
+}
+
+const char *DirWalker::reader::next(type_t *type)
+{
+    if(type)
+        *type = UNKNOWN;
+
+    if(error)
+        return NULL;
+
+#ifdef  USE_GETDENTS
+    for(;;) {
+        if(pos >= used) {
+            long result = ::syscall(SYS_getdents64, fd, buffer, size);
+            if(result < 0)
+                error = errno;
+            if(result <= 0)
+                return NULL;
+            used = (size_t)result;
+            pos = 0;
+        }
+
+        batch_t *entry = (batch_t *)(buffer + pos);
+        pos += entry->d_reclen;
+        if(dots(entry->d_name))
+            continue;
+
+        if(type)
+            *type = dtype(entry->d_type);
+        return entry->d_name;
+    }
+#else
+    struct dirent *entry;
+
+    while((entry = ::readdir((DIR *)dp)) != NULL) {
+        if(dots(entry->d_name))
+            continue;
+#ifdef  DT_UNKNOWN
+        if(type)
+            *type = dtype(entry->d_type);
+#endif
+        return entry->d_name;
+    }
+    return NULL;
+#endif
+}
+
+#endif
+
+int DirWalker::reader::info(const char *name, struct stat *ino)
+{
+#if defined(HAVE_FSTATAT) && !defined(_MSWINDOWS_)
+    if(fd != INVALID_HANDLE_VALUE) {
+        if(::fstatat(fd, name, ino, AT_SYMLINK_NOFOLLOW))
+            return errno;
+        return 0;
+    }
+#endif
+
+    char filename[WALK_PATH];
+    snprintf(filename, sizeof(filename), "%s/%s", path, name);
+
+#if defined(HAVE_LSTAT) && !defined(_MSWINDOWS_)
+    if(::lstat(filename, ino))
+        return errno;
+    return 0;
+#else
+    return fsys::info(filename, ino);
+#endif
+}
+
+DirWalker::DirWalker(unsigned limit, size_t size) :
+Conditional()
+{
+    depth = limit;
+    bufsize = size;
+    pool = NULL;
+    pending = 0;
+    entries = 0;
+    stopped = false;
+}
+
+DirWalker::~DirWalker()
+{
+}
+
+void DirWalker::failed(const char *, int)
+{
+}
+
+DirWalker::type_t DirWalker::type(const struct stat *ino)
+{
+    if(S_ISREG(ino->st_mode))
+        return REGULAR;
+
+    if(S_ISDIR(ino->st_mode))
+        return DIRECTORY;
+
+#ifdef  S_ISLNK
+    if(S_ISLNK(ino->st_mode))
+        return SYMLINK;
+#endif
+
+    return SPECIAL;
+}
+
+void DirWalker::scan(reader& from, char *path, size_t len, unsigned level)
+{
+    const char *name;
+    type_t type;
+    size_t sep = 1;
+
+    if(len && (path[len - 1] == '/' || path[len - 1] == '\\'))
+        sep = 0;
+
+    while(!stopped && (name = from.next(&type)) != NULL) {
+        size_t size = strlen(name);
+        if(len + sep + size >= WALK_PATH) {
+            path[len] = 0;
+            failed(path, ENAMETOOLONG);
+            continue;
+        }
+
+        if(sep)
+            path[len] = '/';
+        memcpy(path + len + sep, name, size + 1);
+
+        if(type == UNKNOWN) {
+            struct stat ino;
+            if(!from.info(name, &ino))
+                type = DirWalker::type(&ino);
+        }
+
+        sync_add(&entries, 1);
+        if(!visit(path, name, type, from, level) || type != DIRECTORY || level >= depth)
+            continue;
+
+        if(pool) {
+            fd_t at = INVALID_HANDLE_VALUE;
+#ifdef  USE_OPENAT
+            // opened here, so the crawler reads what was found in this
+            // directory, not whatever is at the path by then.
+            at = ::openat(from.fd, name, WALK_FLAGS | O_NOFOLLOW);
+            if(at < 0) {
+                failed(path, errno);
+                continue;
+            }
+#endif
+            lock();
+            ++pending;
+            unlock();
+            pool->submit(new crawler(this, path, at, level + 1));
+            continue;
+        }
+
+        reader sub(from, name, path, bufsize);
+        if(!sub)
+            failed(path, sub.err());
+        else
+            scan(sub, path, len + sep + size, level + 1);
+    }
+    path[len] = 0;
+}
+
+void DirWalker::crawl(const char *dir, fd_t at, unsigned level)
+{
+    char path[WALK_PATH];
+    size_t len = strlen(dir);
+
+    if(len >= sizeof(path))
+        failed(dir, ENAMETOOLONG);
+    else if(!stopped) {
+        memcpy(path, dir, len + 1);
+        reader from(at, path, bufsize);
+        at = INVALID_HANDLE_VALUE;
+        if(!from)
+            failed(path, from.err());
+        else
+            scan(from, path, len, level);
+    }
+
+#ifndef _MSWINDOWS_
+    if(at != INVALID_HANDLE_VALUE)
+        ::close(at);
+#endif
+
+    lock();
+    if(!--pending)
+        signal();
+    unlock();
+}
+
+unsigned long DirWalker::walk(const char *path, Executor *executor)
+{
+    entries = 0;
+    stopped = false;
+    pool = executor;
+    pending = 1;
+
+    if(!executor) {
+        crawl(path, INVALID_HANDLE_VALUE, 0);
+        return entries;
+    }
+
+    executor->submit(new crawler(this, path, INVALID_HANDLE_VALUE, 0));
+
+    lock();
+    while(pending)
+        Conditional::wait();
+    unlock();
+
+    pool = NULL;
+    return entries;
+}
+
+} // namespace ucommon
@@ -159,4 +159,21 @@ buffer[count]);
     return buffer;
 }
 
+unsigned Digest::hash(const char *type, unsigned count, const void *const *messages, const size_t *sizes, unsigned char *const *digests)
+{
+    if(!has(type))
+        return 0;
+
+    unsigned size = 0;
+    Digest digest;
+    for(unsigned pos = 0; pos < count; ++pos) {
+        digest.set(type);
+        digest.put(messages[pos], sizes[pos]);
+        const unsigned char *result = digest.get();
+        size = digest.size();
+        memcpy(digests[pos], result, size);
+    }
+    return size;
+}
+
 } // namespace ucommon
@@ -32,14 +32,9 @@ bool Random::seed(const unsigned char *buf, size_t size)
 
 size_t Random::key(unsigned char *buf, size_t size)
 {
-    gnutls_rnd(GNUTLS_RND_KEY, buf, size);
-    return 0;
-}
-
-size_t Random::fill(unsigned char *buf, size_t size)
-{
-    gnutls_rnd(GNUTLS_RND_RANDOM, buf, size);
-    return 0;
+    if(gnutls_rnd(GNUTLS_RND_KEY, buf, size) < 0)
+        return 0;
+    return size;
 }
 
 bool Random::status(void)
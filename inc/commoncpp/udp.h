@@ -211,6 +211,27 @@ public:
      */
     ssize_t receive(void *buf, size_t len, bool reply = false);
 
+    /**
+     * Send a batch of message packets.  Packets without a destination
+     * address are sent to the peer host, and the peer address is filled
+     * in for them.
+     *
+     * @param list of packets to send.
+     * @param count of packets in list.
+     * @return number of packets sent, -1 if error.
+     */
+    int send(ucommon::Socket::datagram_t *list, unsigned count);
+
+    /**
+     * Receive a batch of message packets from any hosts.
+     *
+     * @param list of packets to receive into.
+     * @param count of packets in list.
+     * @return number of packets received, -1 if error.
+     */
+    inline int receive(ucommon::Socket::datagram_t *list, unsigned count)
+        {return ucommon::Socket::recvbatch(so, list, count);}
+
     /**
      * Examine address of sender of next waiting packet.  This also
      * sets "peer" address to the sender so that the next "send"
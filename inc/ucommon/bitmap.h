@@ -43,9 +43,12 @@ namespace ucommon {
  * where performing reference and manipulations may change the state of the
  * device and hence must be aligned with the device register being effected.
  *
- * This class offers only the most basic bit manipulations, getting and
- * setting individual bits in the bitmap.  More advanced bit manipulations
- * and other operations can be created in derived classes.
+ * Besides getting and setting individual bits, the bitmap can be searched
+ * for set or clear bits, counted, and have ranges of bits or other bitmaps
+ * applied to it.  These operate a whole word at a time, and on locally
+ * allocated bitmaps may use vector instructions, so they are the preferred
+ * way to manage large allocation maps.  Device bitmaps are still only
+ * accessed with their native bus size.
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 class __EXPORT bitmap
@@ -83,7 +86,42 @@ protected:
 
     unsigned memsize(void) const;
 
+    /**
+     * Get 64 bits of the bitmap through the bus.
+     * @param chunk of 64 bits to get.
+     * @return bits, with bit 0 being the first bit of the chunk.
+     */
+    uint64_t load(size_t chunk) const;
+
+    /**
+     * Change 64 bits of the bitmap through the bus.  Only bus words that
+     * are covered by the mask are written.
+     * @param chunk of 64 bits to change.
+     * @param bits to store.
+     * @param mask of bits to change.
+     */
+    void save(size_t chunk, uint64_t bits, uint64_t mask);
+
+    /**
+     * Get mask of chunk bits that lie within the bitmap.
+     * @param chunk of 64 bits.
+     * @return mask of valid bits.
+     */
+    uint64_t valid(size_t chunk) const;
+
+    /**
+     * Get whether the bitmap is held in native 64 bit words.
+     * @return true if directly accessible as 64 bit words.
+     */
+    inline bool direct(void) const
+        {return bus == BMALLOC || bus == B64;}
+
 public:
+    /**
+     * A constant for an invalid bit offset.
+     */
+    static const size_t npos;
+
     /**
      * Create an object to reference the specified bitmap.
      * @param addr of the bitmap in mapped memory.
@@ -124,6 +162,61 @@ public:
      * @param value to change specified bit to.
      */
     void set(size_t offset, bool value);
+
+    /**
+     * Set a range of bits in the bitmask.
+     * @param offset to first bit in map to change.
+     * @param count of bits to change.
+     * @param value to change bits to.
+     */
+    void set(size_t offset, size_t count, bool value);
+
+    /**
+     * Find the first bit with a given value.  This is how free slots
+     * are found in allocation maps.
+     * @param offset to start search from.
+     * @param value of bit to search for.
+     * @return offset of bit found or npos if none.
+     */
+    size_t scan(size_t offset = 0, bool value = true) const;
+
+    /**
+     * Count the bits that are set in the bitmap.
+     * @return number of bits set.
+     */
+    size_t count(void) const;
+
+    /**
+     * Get the length of the bitmap.
+     * @return length in bits.
+     */
+    inline size_t length(void) const
+        {return size;}
+
+    /**
+     * And another bitmap into this one.  Bits beyond the end of the
+     * other bitmap are treated as clear.
+     * @param source to and with.
+     * @return this bitmap.
+     */
+    bitmap& operator&=(const bitmap& source);
+
+    /**
+     * Or another bitmap into this one.
+     * @param source to or with.
+     * @return this bitmap.
+     */
+    bitmap& operator|=(const bitmap& source);
+
+    /**
+     * Exclusive or another bitmap into this one.
+     * @param source to exclusive or with.
+     * @return this bitmap.
+     */
+    bitmap& operator^=(const bitmap& source);
+
+private:
+    void merge(const bitmap& source, int op);
 };
 
 } // namespace ucommon
@@ -66,6 +66,13 @@ protected:
     void _clear(void);
     bool _blocking(void);
 
+    /**
+     * Check if output may be sent to the socket directly rather than
+     * through _push.  Derived classes that encode output return false.
+     * @return true if output is sent unchanged.
+     */
+    virtual bool _direct(void);
+
     /**
      * Get the low level socket object.
      * @return socket we are using.
@@ -121,6 +128,18 @@ public:
      */
     void close(void);
 
+    /**
+     * Send from a file directly to the connection.  Buffered output is
+     * flushed first, and the file is then sent without copying through
+     * user memory where supported.
+     * @param file descriptor to send from.
+     * @param offset in file to send from and advance, or NULL for the
+     * current file position.
+     * @param size of data to send.
+     * @return number of bytes sent.
+     */
+    size_t sendfile(fd_t file, off_t *offset, size_t size);
+
 protected:
     /**
      * Check for pending tcp or ssl data.
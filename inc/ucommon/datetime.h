@@ -846,6 +846,40 @@ public:
      * @param object to release.
      */
     static void release(tm_t *object);
+
+    /**
+     * Convert time to local time in a caller supplied buffer.  The broken
+     * down time and utc offset of the most recently converted minute is
+     * cached and shared between threads, so repeated conversions of
+     * nearby times neither allocate nor call into the C library.
+     * @param time object or NULL if using current time.
+     * @param buffer to store local time in.
+     * @return buffer or NULL if time cannot be converted.
+     */
+    static tm_t *local(const time_t *time, tm_t *buffer);
+
+    /**
+     * Convert time to gmt in a caller supplied buffer.
+     * @param time object or NULL if using current time.
+     * @param buffer to store gmt in.
+     * @return buffer or NULL if time cannot be converted.
+     */
+    static tm_t *gmt(const time_t *time, tm_t *buffer);
+
+    /**
+     * Get offset of local time from utc.
+     * @param time object or NULL if using current time.
+     * @return seconds east of utc.
+     */
+    static long offset(const time_t *time = NULL);
+
+    /**
+     * Get current time of day.  This uses the coarse (scheduler tick)
+     * realtime clock where available, which is much cheaper to read than
+     * the precise clock and is all second resolution timestamps need.
+     * @return current time.
+     */
+    static time_t now(void);
 };
 
 /**
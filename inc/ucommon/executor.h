@@ -0,0 +1,280 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Thread pool task executor.
+ * The executor runs task objects on a fixed set of worker threads.  Each
+ * worker keeps its own deque of tasks; a worker pushes and pops tasks it
+ * spawns at one end, and idle workers steal from the other end of another
+ * worker's deque.  Tasks submitted from outside the pool are queued to a
+ * shared list the workers pull from.  This replaces the common pattern of
+ * threads pulling work from a locked Queue.
+ * @file ucommon/executor.h
+ */
+
+/**
+ * An example of submitting tasks and splitting ranges over an executor.
+ * @example executor.cpp
+ */
+
+#ifndef _UCOMMON_EXECUTOR_H_
+#define _UCOMMON_EXECUTOR_H_
+
+#ifndef _UCOMMON_THREAD_H_
+#include <ucommon/thread.h>
+#endif
+
+#ifndef _UCOMMON_TIMERS_H_
+#include <ucommon/timers.h>
+#endif
+
+namespace ucommon {
+
+/**
+ * A work stealing thread pool.  Tasks are objects derived from
+ * Executor::task which are submitted to the executor and then run on one
+ * of its worker threads.  A task may be waited on like a future, or may
+ * act on its own completion through its completed method.  Ranges may be
+ * split and processed in parallel, and tasks may be scheduled to start
+ * after a delay.  Workers may optionally be pinned to cpus, and when
+ * pinned by numa node, idle workers steal from workers on their own node
+ * first.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT Executor : private Conditional
+{
+public:
+    /**
+     * How worker threads are placed on cpus.
+     */
+    typedef enum {
+        FLOATING = 0,   /**< leave placement to the scheduler. */
+        PINNED,         /**< pin each worker to a cpu in turn. */
+        NODES           /**< pin workers filling one numa node at a time. */
+    } placement_t;
+
+    /**
+     * A unit of work run by the executor.  A derived class implements run,
+     * and may override completed to act when the task finishes.  A task
+     * created to release itself is deleted by the executor once completed,
+     * and cannot be waited on.  Otherwise the task belongs to the caller,
+     * may be waited on, and may be submitted again once done.  A task must
+     * not be deleted while it is still queued or running.
+     * @author David Sugar <dyfet@gnutelephony.org>
+     */
+    class __EXPORT task
+    {
+    private:
+        friend class Executor;
+
+        task *next;
+        Executor *owner;
+        volatile unsigned state;
+        bool release;
+
+    protected:
+        /**
+         * Create a task.
+         * @param release if the executor deletes the task when completed.
+         */
+        task(bool release = false);
+
+        /**
+         * Method to run the work of the task in a worker thread.
+         */
+        virtual void run(void) = 0;
+
+        /**
+         * Called in the worker thread after run, before the task is
+         * considered done.  This is used for completion callbacks.
+         */
+        virtual void completed(void);
+
+    public:
+        /**
+         * Destroy task.
+         */
+        virtual ~task();
+
+        /**
+         * Wait for the task to complete.  If called from a worker of the
+         * same executor, the worker runs other tasks while it waits.
+         * @param timeout to wait in milliseconds.
+         * @return true if completed, false if timed out.
+         */
+        bool wait(timeout_t timeout = Timer::inf);
+
+        /**
+         * Test if the task has completed.
+         * @return true if completed.
+         */
+        bool is_done(void) const;
+
+        /**
+         * Test if the task is queued or running.
+         * @return true if not yet completed.
+         */
+        bool is_pending(void) const;
+    };
+
+    /**
+     * A range of indexes to process in parallel.  The derived class
+     * implements run for each sub-range the executor splits off.
+     * @author David Sugar <dyfet@gnutelephony.org>
+     */
+    class __EXPORT range
+    {
+    protected:
+        friend class Executor;
+
+        /**
+         * Process a part of the range.
+         * @param first index to process.
+         * @param last index, not included.
+         */
+        virtual void run(size_t first, size_t last) = 0;
+
+    public:
+        virtual ~range();
+    };
+
+private:
+    class __LOCAL worker;
+    class __LOCAL splitter;
+    class __LOCAL delayed;
+
+    friend class worker;
+    friend class splitter;
+    friend class delayed;
+
+    class __LOCAL notifier : public Conditional
+    {
+    private:
+        friend class Executor;
+    };
+
+    class __LOCAL timers : public TimerQueue
+    {
+    private:
+        friend class Executor;
+
+        RecursiveMutex guard;
+        Executor *owner;
+
+        void modify(void);
+        void update(void);
+    };
+
+    friend class timers;
+
+    worker **workers;
+    unsigned count;
+    placement_t placement;
+    task *first, *last;
+    volatile unsigned injected, idle, waiters, outstanding, timing;
+    volatile bool stopping;
+    volatile Timer::tick_t due;
+    notifier finished;
+    timers delays;
+
+    worker *self(void) const;
+    task *acquire(worker *thread);
+    void execute(task *job);
+    void notify(void);
+    void retime(void);
+    bool rest(void);
+    timeout_t expire(void);
+    void service(void);
+    bool until(volatile unsigned *word, unsigned value, timeout_t timeout);
+
+public:
+    /**
+     * Create an executor and start its workers.
+     * @param workers to start, or 0 for one per cpu.
+     * @param placement of workers on cpus.
+     * @param stack size of workers, or 0 for default.
+     */
+    Executor(unsigned workers = 0, placement_t placement = FLOATING, size_t stack = 0);
+
+    /**
+     * Destroy executor.  Tasks already submitted are completed first, and
+     * delayed tasks that have not yet started are dropped.
+     */
+    ~Executor();
+
+    /**
+     * Submit a task to run.  When called from a worker the task is pushed
+     * to that worker's own deque, or run directly if the deque is full.
+     * @param job to run.
+     */
+    void submit(task *job);
+
+    /**
+     * Submit a task to run once a delay passes.  Delayed tasks are started
+     * by workers between tasks through a timer queue.
+     * @param job to run.
+     * @param delay in milliseconds.
+     */
+    void schedule(task *job, timeout_t delay);
+
+    /**
+     * Process a range in parallel, splitting it in halves until parts
+     * are no larger than a grain.  Returns when all of the range is done.
+     * @param body to run over parts of the range.
+     * @param first index of range.
+     * @param last index of range, not included.
+     * @param grain size of smallest part, or 0 for one per worker.
+     */
+    void parallel(range& body, size_t first, size_t last, size_t grain = 1);
+
+    /**
+     * Wait for all submitted tasks to complete.  This must not be called
+     * from a task of the same executor.
+     * @param timeout to wait in milliseconds.
+     * @return true if all completed, false if timed out.
+     */
+    bool wait(timeout_t timeout = Timer::inf);
+
+    /**
+     * Number of worker threads.
+     * @return workers in pool.
+     */
+    inline unsigned size(void) const
+        {return count;}
+
+    /**
+     * Number of cpus available.
+     * @return cpus online.
+     */
+    static unsigned cpus(void);
+
+    /**
+     * Numa node of a cpu.
+     * @param cpu to look up.
+     * @return node of cpu, or 0 if unknown.
+     */
+    static unsigned node(unsigned cpu);
+};
+
+/**
+ * Convenience type for executor tasks.
+ */
+typedef Executor::task ExecutorTask;
+
+} // namespace ucommon
+
+#endif
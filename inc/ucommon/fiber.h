@@ -0,0 +1,271 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Stackful fibers for blocking style socket code.
+ * A fiber is a light weight execution context with its own small stack,
+ * run on one of the threads of a fiber scheduler.  When a fiber would
+ * block in socket i/o, such as in Socket::wait or a Socket read, it is
+ * instead parked on the scheduler's event poller and its thread goes on to
+ * run other fibers.  This lets protocol code written for a blocking thread
+ * per connection serve many more connections on a few threads.  Where the
+ * platform lacks user contexts or epoll, each fiber runs as its own thread.
+ * @file ucommon/fiber.h
+ */
+
+/**
+ * An example of fiber sessions using blocking socket calls.
+ * @example fiber.cpp
+ */
+
+#ifndef _UCOMMON_FIBER_H_
+#define _UCOMMON_FIBER_H_
+
+#ifndef _UCOMMON_THREAD_H_
+#include <ucommon/thread.h>
+#endif
+
+#ifndef _UCOMMON_SOCKET_H_
+#include <ucommon/socket.h>
+#endif
+
+namespace ucommon {
+
+class FiberScheduler;
+
+/**
+ * A fiber execution context.  A derived class implements run, and the
+ * fiber is then started on a fiber scheduler.  Like a detached thread, a
+ * fiber is normally created with new and deleted through exit when its
+ * run method returns.  A fiber always resumes on the scheduler thread it
+ * started on, so thread specific data remains valid in it.  The static
+ * socket methods are used by the socket layer, and act as the plain
+ * system calls when not called from a fiber.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT Fiber
+{
+private:
+    friend class FiberScheduler;
+
+    class __LOCAL context;
+
+    context *cp;
+    Fiber *next;
+    size_t stack;
+
+    __LOCAL static context *self(void);
+    __LOCAL static bool park(context *ctx, socket_t socket, unsigned events, timeout_t timeout);
+
+protected:
+    /**
+     * Create a fiber.
+     * @param stack size to use, or 0 for the scheduler default.
+     */
+    Fiber(size_t stack = 0);
+
+    /**
+     * Method to run in the fiber.
+     */
+    virtual void run(void) = 0;
+
+    /**
+     * Called in the scheduler thread when the fiber's run method returns.
+     * By default the fiber object is deleted.
+     */
+    virtual void exit(void);
+
+public:
+    /**
+     * Destroy fiber.
+     */
+    virtual ~Fiber();
+
+    /**
+     * Start the fiber on a scheduler.  A fiber started from another fiber
+     * of the same scheduler runs on the same thread.
+     * @param scheduler to run fiber on.
+     */
+    void start(FiberScheduler *scheduler);
+
+    /**
+     * Get the fiber of the current execution context.
+     * @return current fiber or NULL if not in a fiber.
+     */
+    static Fiber *get(void);
+
+    /**
+     * Yield to other fibers ready to run, or yield the thread if not in
+     * a fiber.
+     */
+    static void yield(void);
+
+    /**
+     * Sleep the current fiber, or thread if not in a fiber.
+     * @param timeout to sleep in milliseconds.
+     */
+    static void sleep(timeout_t timeout);
+
+    /**
+     * Wait for a socket to become ready, parking the current fiber.
+     * @param socket to wait on.
+     * @param output to wait to send rather than receive.
+     * @param timeout to wait in milliseconds.
+     * @return true if ready, false if timed out.
+     */
+    static bool wait(socket_t socket, bool output = false, timeout_t timeout = Timer::inf);
+
+    /**
+     * Receive from a socket, parking the current fiber until data arrives.
+     * @param socket to receive from.
+     * @param data buffer to receive into.
+     * @param size of buffer.
+     * @param flags for receive.
+     * @return bytes received or -1 on error.
+     */
+    static ssize_t recv(socket_t socket, void *data, size_t size, int flags = 0);
+
+    /**
+     * Send to a socket, parking the current fiber while the socket is full.
+     * @param socket to send to.
+     * @param data to send.
+     * @param size of data.
+     * @param flags for send.
+     * @return bytes sent or -1 on error.
+     */
+    static ssize_t send(socket_t socket, const void *data, size_t size, int flags = 0);
+
+    /**
+     * Receive a message and its source address, parking the current fiber.
+     * @param socket to receive from.
+     * @param data buffer to receive into.
+     * @param size of buffer.
+     * @param flags for receive.
+     * @param address of sender, may be NULL.
+     * @param length of address buffer, may be NULL.
+     * @return bytes received or -1 on error.
+     */
+    static ssize_t recvfrom(socket_t socket, void *data, size_t size, int flags, struct sockaddr *address, socklen_t *length);
+
+    /**
+     * Send a message to an address, parking the current fiber.
+     * @param socket to send to.
+     * @param data to send.
+     * @param size of data.
+     * @param flags for send.
+     * @param address to send to, may be NULL.
+     * @param length of address.
+     * @return bytes sent or -1 on error.
+     */
+    static ssize_t sendto(socket_t socket, const void *data, size_t size, int flags, const struct sockaddr *address, socklen_t length);
+
+    /**
+     * Accept a connection, parking the current fiber until one arrives.
+     * @param socket to accept from.
+     * @param address of peer, may be NULL.
+     * @param length of address buffer, may be NULL.
+     * @return accepted socket or INVALID_SOCKET.
+     */
+    static socket_t accept(socket_t socket, struct sockaddr *address, socklen_t *length);
+
+    /**
+     * Connect a socket, parking the current fiber until connected.
+     * @param socket to connect.
+     * @param address to connect to.
+     * @param length of address.
+     * @return 0 on success, -1 on error.
+     */
+    static int connect(socket_t socket, const struct sockaddr *address, socklen_t length);
+};
+
+/**
+ * A scheduler running fibers on a set of threads.  Each thread runs its
+ * own fibers from an epoll driven loop, and fibers are spread over the
+ * threads as they are started.  Fiber stacks are mapped with a guard page
+ * below them and kept for reuse when fibers exit.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT FiberScheduler : private Conditional
+{
+private:
+    friend class Fiber;
+
+    class __LOCAL worker;
+    class __LOCAL runner;
+
+    friend class worker;
+    friend class runner;
+
+    worker **workers;
+    unsigned count;
+    size_t stack;
+    volatile unsigned next, live;
+    volatile bool stopping;
+
+    void finished(void);
+
+public:
+    /**
+     * Create a scheduler and start its threads.
+     * @param threads to run fibers on, or 0 for one per cpu.
+     * @param stack size for fibers, or 0 for default.
+     */
+    FiberScheduler(unsigned threads = 1, size_t stack = 0);
+
+    /**
+     * Destroy the scheduler once all of its fibers have exited.
+     */
+    ~FiberScheduler();
+
+    /**
+     * Start a fiber on the scheduler.
+     * @param fiber to start.
+     */
+    void start(Fiber *fiber);
+
+    /**
+     * Wait for all fibers to exit.
+     * @param timeout to wait in milliseconds.
+     * @return true if all exited, false if timed out.
+     */
+    bool wait(timeout_t timeout = Timer::inf);
+
+    /**
+     * Number of fibers that have not yet exited.
+     * @return live fibers.
+     */
+    inline unsigned active(void) const
+        {return live;}
+
+    /**
+     * Number of threads running fibers.
+     * @return scheduler threads.
+     */
+    inline unsigned size(void) const
+        {return count;}
+
+    /**
+     * Memory mapped for fiber stacks, including guard pages and stacks
+     * kept for reuse.
+     * @return bytes mapped.
+     */
+    size_t mapped(void) const;
+};
+
+} // namespace ucommon
+
+#endif
@@ -572,6 +572,16 @@ public:
      */
     static void release(fd_t descriptor);
 
+    /**
+     * Direct means to read from a descriptor at an offset.
+     * @param descriptor to read from.
+     * @param buffer to read into.
+     * @param count of bytes to read.
+     * @param offset to read from and advance, or NULL for current position.
+     * @return bytes transferred, -1 if error.
+     */
+    static ssize_t read(fd_t descriptor, void *buffer, size_t count, off_t *offset);
+
     /**
      * Create pipe.  These are created inheritable by default.
      * @param input descriptor.
@@ -795,6 +805,188 @@ public:
         {return ptr == NULL;}
 };
 
+class Executor;
+
+/**
+ * Directory tree walker.  Directories are read many entries at a time
+ * relative to the descriptor of their parent, and the entry type the
+ * directory itself records is passed on so most entries never need a
+ * stat.  Entries are delivered to a visit method in a derived class, and
+ * subtrees may be crawled in parallel on an executor.  The reader may also
+ * be used alone to iterate a single directory.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT DirWalker : private Conditional
+{
+public:
+    /**
+     * Type of a directory entry.
+     */
+    typedef enum {
+        UNKNOWN = 0,    /**< type could not be found. */
+        REGULAR,        /**< regular file. */
+        DIRECTORY,      /**< subdirectory. */
+        SYMLINK,        /**< symbolic link, which is never followed. */
+        SPECIAL         /**< device, fifo, or socket. */
+    } type_t;
+
+    /**
+     * Batched reader for the entries of one directory.  The "." and ".."
+     * entries are skipped.
+     * @author David Sugar <dyfet@gnutelephony.org>
+     */
+    class __EXPORT reader
+    {
+    private:
+        fd_t fd;
+        void *dp;
+        char *buffer;
+        size_t size, pos, used;
+        char *path;
+        int error;
+
+        __LOCAL void open(fd_t at, const char *name);
+        __LOCAL void attach(void);
+
+        __LOCAL reader(fd_t at, const char *path, size_t size);
+        reader(const reader& copy);
+        reader& operator=(const reader& copy);
+
+        friend class DirWalker;
+
+    public:
+        /**
+         * Open a directory by path.
+         * @param path of directory.
+         * @param size of batch buffer.
+         */
+        reader(const char *path, size_t size = 32768);
+
+        /**
+         * Open a subdirectory relative to an open directory.
+         * @param parent directory reader.
+         * @param name of subdirectory in parent.
+         * @param path of subdirectory.
+         * @param size of batch buffer.
+         */
+        reader(reader& parent, const char *name, const char *path, size_t size = 32768);
+
+        /**
+         * Close directory.
+         */
+        ~reader();
+
+        /**
+         * Get next entry of directory.
+         * @param type of entry, UNKNOWN if not recorded by the directory.
+         * @return name of entry, valid until next call, or NULL at end.
+         */
+        const char *next(type_t *type = NULL);
+
+        /**
+         * Get information of an entry without following links.
+         * @param name of entry in this directory.
+         * @param ino to save information in.
+         * @return error number or 0 on success.
+         */
+        int info(const char *name, struct stat *ino);
+
+        inline const char *operator*() const
+            {return path;}
+
+        inline int err(void) const
+            {return error;}
+
+        inline operator bool() const
+            {return error == 0;}
+
+        inline bool operator!() const
+            {return error != 0;}
+    };
+
+private:
+    class __LOCAL crawler;
+
+    friend class crawler;
+
+    unsigned depth;
+    size_t bufsize;
+    Executor *pool;
+    volatile unsigned pending;
+    volatile unsigned long entries;
+    volatile bool stopped;
+
+    __LOCAL void scan(reader& from, char *path, size_t len, unsigned level);
+    __LOCAL void crawl(const char *path, fd_t at, unsigned level);
+
+    DirWalker(const DirWalker& copy);
+    DirWalker& operator=(const DirWalker& copy);
+
+protected:
+    /**
+     * Called for each entry found.  In a parallel walk this is called
+     * from executor workers at the same time, and entries are not in any
+     * order between directories.
+     * @param path of entry.
+     * @param name of entry in its directory.
+     * @param type of entry, found with a stat if not recorded.
+     * @param from reader of the directory holding the entry.
+     * @param level of directory, 0 for the top.
+     * @return true to descend if entry is a directory.
+     */
+    virtual bool visit(const char *path, const char *name, type_t type, reader& from, unsigned level) = 0;
+
+    /**
+     * Called when a directory cannot be opened, or holds an entry whose
+     * path is too long (ENAMETOOLONG).  The default ignores it.
+     * @param path of directory.
+     * @param error number.
+     */
+    virtual void failed(const char *path, int error);
+
+public:
+    /**
+     * Create a directory walker.
+     * @param depth of subdirectories to descend into.
+     * @param size of batch buffer of each directory read.
+     */
+    DirWalker(unsigned depth = (unsigned)-1, size_t size = 32768);
+
+    virtual ~DirWalker();
+
+    /**
+     * Walk a directory tree.  When an executor is given each subdirectory
+     * is read by a task of its own, and this returns when all are done.
+     * This waits for those tasks, so it must not be called from a task
+     * of the same executor, which may have no other worker to run them.
+     * @param path of top directory.
+     * @param executor to crawl subtrees on, or NULL to walk serially.
+     * @return number of entries visited.
+     */
+    unsigned long walk(const char *path, Executor *executor = NULL);
+
+    /**
+     * Stop a walk in progress.  Directories already being read are
+     * finished.
+     */
+    inline void stop(void)
+        {stopped = true;}
+
+    /**
+     * Number of entries visited so far.
+     * @return entries visited.
+     */
+    inline unsigned long count(void) const
+        {return entries;}
+
+    /**
+     * Convert file information into an entry type.
+     * @param ino information of file.
+     * @return type of entry.
+     */
+    static type_t type(const struct stat *ino);
+};
+
 /**
  * Convience type for fsys.
  */
@@ -66,12 +66,15 @@ protected:
     size_t size, used;
     char idname[65];
     bool erase;
+    unsigned options;
+    int node;
 
     MappedMemory();
 
     /**
      * Supporting function to construct a new or access an existing
-     * shared memory segment.  Used by primary constructors.
+     * shared memory segment.  Used by primary constructors.  Placement
+     * of the segment follows the current options and node.
      * @param name of segment to create or access.
      * @param size of segment if creating new.  Use 0 for read-only access.
      */
@@ -89,6 +92,16 @@ protected:
     virtual void fault(void) const;
 
 public:
+    /**
+     * Placement options for a mapped segment, which may be combined.
+     * Options that the platform cannot honor are quietly ignored.
+     */
+    enum {
+        LOCKED = 0x01,      /**< lock pages in memory (the default). */
+        PREFAULT = 0x02,    /**< fault in all pages when mapped. */
+        HUGEPAGES = 0x04    /**< back with huge pages when possible. */
+    };
+
     /**
      * Construct a read/write access mapped shared segment of memory of a
      * known size.  This constructs a new memory segment.
@@ -97,6 +110,18 @@ public:
      */
     MappedMemory(const char *name, size_t size);
 
+    /**
+     * Construct a read/write access mapped shared segment of memory with
+     * specific placement.  Huge pages come from a hugetlbfs mount if one
+     * has pages reserved, and otherwise transparent huge pages are
+     * requested for the segment.
+     * @param name of segment.
+     * @param size of segment.
+     * @param options to place segment with.
+     * @param node to bind segment memory to, or -1 for any numa node.
+     */
+    MappedMemory(const char *name, size_t size, unsigned options, int node = -1);
+
     /**
      * Provide read-only mapped access to an existing named shared memory
      * segment.  The size of the map is found by the size of the already
@@ -155,7 +180,9 @@ public:
 
     /**
      * Copy memory from specific offset within the mapped memory segment.
-     * This function assures the copy is not in the middle of being modified.
+     * This function assures the copy is not in the middle of being modified
+     * by comparing repeated copies.  Records that are updated often should
+     * be published with mapped_records and read with mapped_snapshot.
      * @param offset from start of segment.
      * @param buffer to copy into.
      * @param size of object to copy.
@@ -187,6 +214,133 @@ public:
     static void disable(void);
 };
 
+/**
+ * Version stamp for a record held in a shared memory segment.  The writer
+ * makes the stamp odd while it updates the record and even again when it
+ * is done.  A reader's copy is consistent if the stamp was even and did not
+ * change while copying, so readers never block the writer or each other.
+ * Only one writer may update a given record at a time.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT MappedStamp
+{
+private:
+    volatile uint32_t value;
+
+public:
+    /**
+     * Create a new stamp for an unmodified record.
+     */
+    MappedStamp();
+
+    /**
+     * Begin updating the record this stamp guards.
+     */
+    void begin(void);
+
+    /**
+     * Publish the updated record to readers.
+     */
+    void commit(void);
+
+    /**
+     * Copy a consistent snapshot of the record this stamp guards.  The
+     * copy is retried if the writer was active, up to a limit, so a
+     * reader cannot be held forever by a writer that updates constantly.
+     * @param source record in the mapped segment.
+     * @param target to copy into.
+     * @param size of record.
+     * @param retries before giving up.
+     * @return true if a consistent copy was made.
+     */
+    bool copy(const void *source, void *target, size_t size, unsigned retries = 1000) const;
+
+    /**
+     * Get the number of updates committed to the record.
+     * @return current version of record.
+     */
+    inline unsigned version(void) const
+        {return (unsigned)(value >> 1);}
+
+    /**
+     * Test if the record is being updated right now.
+     * @return true if writer is active.
+     */
+    inline bool busy(void) const
+        {return (value & 1) != 0;}
+};
+
+/**
+ * A message ring held in a named shared memory segment, used to pass
+ * variable length messages between processes without sockets.  Any number
+ * of processes may put messages into the ring, but only one may get them.
+ * Producers and the consumer coordinate through atomic head and tail
+ * positions kept on separate cache lines, and block on a futex when the
+ * ring is full or empty where the platform offers one.  The ring is
+ * removed when the process that created it releases it.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT MappedRing : protected MappedMemory
+{
+private:
+    size_t capacity;
+
+    void *control(void) const;
+
+public:
+    /**
+     * Create a new ring in a named shared memory segment.
+     * @param name of segment to create.
+     * @param size of message space, rounded up to a power of two.
+     */
+    MappedRing(const char *name, size_t size);
+
+    /**
+     * Attach to an existing ring created by another process.
+     * @param name of existing segment.
+     */
+    MappedRing(const char *name);
+
+    /**
+     * Put a message into the ring, waiting for space if full.
+     * @param data of message.
+     * @param size of message, must be between 1 and limit().
+     * @param timeout to wait for space in milliseconds.
+     * @return true if queued, false if timed out or too large.
+     */
+    bool put(const void *data, size_t size, timeout_t timeout = Timer::inf);
+
+    /**
+     * Get the next message from the ring, waiting if empty.  A message
+     * larger than the buffer is truncated.
+     * @param data buffer to save message into.
+     * @param size of buffer.
+     * @param timeout to wait for a message in milliseconds.
+     * @return size of message copied, or 0 if timed out.
+     */
+    size_t get(void *data, size_t size, timeout_t timeout = Timer::inf);
+
+    /**
+     * Get size of largest message the ring accepts.
+     * @return largest message size.
+     */
+    size_t limit(void) const;
+
+    /**
+     * Test if ring is usable.
+     * @return true if mapped and valid.
+     */
+    inline operator bool() const
+        {return capacity != 0;}
+
+    /**
+     * Test if ring failed to create or attach.
+     * @return true if not valid.
+     */
+    inline bool operator!() const
+        {return capacity == 0;}
+};
+
 /**
  * Map a reusable allocator over a named shared memory segment.  This may be
  * used to form a resource bound fixed size managed heap in shared memory.
@@ -294,6 +448,17 @@ public:
     inline mapped_array(const char *name, unsigned number) :
         MappedMemory(name, number * sizeof(T)) {}
 
+    /**
+     * Construct mapped vector array of typed objects with specific
+     * placement in memory.
+     * @param name of mapped segment to construct.
+     * @param number of objects in the mapped vector.
+     * @param options to place segment with.
+     * @param node to bind segment memory to, or -1 for any numa node.
+     */
+    inline mapped_array(const char *name, unsigned number, unsigned options, int node = -1) :
+        MappedMemory(name, number * sizeof(T), options, node) {}
+
     /**
      * Initialize typed data in mapped array.  Assumes default constructor
      * for type.
@@ -459,6 +624,96 @@ public:
         {ReusableAllocator::release(object);}
 };
 
+/**
+ * Layout of a version stamped record in a shared memory segment.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+template <class T>
+class mapped_record
+{
+public:
+    MappedStamp stamp;
+    T data;
+};
+
+/**
+ * Template class to publish a typed vector of version stamped records in
+ * shared memory.  Each record is updated between begin and commit, and
+ * other processes read consistent copies with mapped_snapshot without
+ * ever locking out the writer.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+template <class T>
+class mapped_records : public MappedMemory
+{
+protected:
+    inline mapped_records() : MappedMemory() {}
+
+    inline void create(const char *fn, unsigned members)
+        {MappedMemory::create(fn, members * sizeof(mapped_record<T>));}
+
+    inline mapped_record<T> *record(unsigned member)
+        {return static_cast<mapped_record<T>*>(offset(member * sizeof(mapped_record<T>)));}
+
+public:
+    /**
+     * Construct mapped vector of stamped records for read/write access.
+     * @param name of mapped segment to construct.
+     * @param number of records in the mapped vector.
+     */
+    inline mapped_records(const char *name, unsigned number) :
+        MappedMemory(name, number * sizeof(mapped_record<T>)) {}
+
+    /**
+     * Construct mapped vector of stamped records with specific placement
+     * in memory.
+     * @param name of mapped segment to construct.
+     * @param number of records in the mapped vector.
+     * @param options to place segment with.
+     * @param node to bind segment memory to, or -1 for any numa node.
+     */
+    inline mapped_records(const char *name, unsigned number, unsigned options, int node = -1) :
+        MappedMemory(name, number * sizeof(mapped_record<T>), options, node) {}
+
+    /**
+     * Initialize typed records and stamps in mapped vector.  Assumes
+     * default constructor for type.
+     */
+    inline void initialize(void)
+        {new((caddr_t)offset(0)) mapped_record<T>[max()];}
+
+    /**
+     * Begin updating a record.  The record should be committed promptly
+     * since readers retry while it is being updated.
+     * @param member to update.
+     * @return typed pointer to record data.
+     */
+    inline T *begin(unsigned member)
+        {mapped_record<T> *rec = record(member); rec->stamp.begin(); return &rec->data;}
+
+    /**
+     * Publish an updated record.
+     * @param member that was updated.
+     */
+    inline void commit(unsigned member)
+        {record(member)->stamp.commit();}
+
+    /**
+     * Replace a record in a single update.
+     * @param member to update.
+     * @param value to store.
+     */
+    inline void set(unsigned member, const T& value)
+        {*(begin(member)) = value; commit(member);}
+
+    /**
+     * Get member size of records that can be held in mapped vector.
+     * @return members mapped in segment.
+     */
+    inline unsigned max(void) const
+        {return (unsigned)(size / sizeof(mapped_record<T>));}
+};
+
 /**
  * Class to access a named mapped segment published from another process.
  * This offers a simple typed vector interface to access the shared memory
@@ -507,6 +762,53 @@ public:
         {return (unsigned)(size / sizeof(T));}
 };
 
+/**
+ * Class to take consistent copies of version stamped records published by
+ * mapped_records from another process.  The segment is mapped read-only.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+template <class T>
+class mapped_snapshot : protected MappedMemory
+{
+private:
+    inline const mapped_record<T> *record(unsigned member) const
+        {return static_cast<const mapped_record<T>*>(offset(member * sizeof(mapped_record<T>)));}
+
+public:
+    /**
+     * Map existing named memory segment of stamped records.
+     * @param name of memory segment to map.
+     */
+    inline mapped_snapshot(const char *name) :
+        MappedMemory(name) {}
+
+    /**
+     * Copy a consistent snapshot of a record.
+     * @param member to copy.
+     * @param buffer to copy into.
+     * @param retries before giving up on a busy record.
+     * @return true if copied, false if writer was always active.
+     */
+    inline bool snapshot(unsigned member, T& buffer, unsigned retries = 1000) const
+        {const mapped_record<T> *rec = record(member); return rec->stamp.copy(&rec->data, &buffer, sizeof(T), retries);}
+
+    /**
+     * Get number of updates committed to a record.  This can be used to
+     * skip copying records that have not changed.
+     * @param member to check.
+     * @return version of record.
+     */
+    inline unsigned version(unsigned member) const
+        {return record(member)->stamp.version();}
+
+    /**
+     * Get count of records held in this map.
+     * @return count of records.
+     */
+    inline unsigned count(void) const
+        {return (unsigned)(size / sizeof(mapped_record<T>));}
+};
+
 } // namespace ucommon
 
 #endif
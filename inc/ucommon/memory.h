@@ -475,6 +475,14 @@ public:
      */
     void add(char **list);
 
+    /**
+     * Add the spans a tokenizer found to list.  Each member and its text
+     * are allocated together.
+     * @param tokens found in text.
+     * @return number of members added.
+     */
+    unsigned add(const Tokenizer& tokens);
+
     /**
      * Set list to list.  This is a list of string pointers terminated with
      * NULL.
@@ -526,10 +534,17 @@ public:
         {push(text); return *this;}
 
     /**
-     * Sort members.
+     * Sort members by locale collation.  When the locale collates by
+     * byte value the members are radix sorted instead.
      */
     void sort(void);
 
+    /**
+     * Sort members.
+     * @param collate by locale, or by byte value with a radix sort if false.
+     */
+    void sort(bool collate);
+
     /**
      * Gather index list.
      * @return index.
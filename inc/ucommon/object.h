@@ -56,10 +56,25 @@ class __EXPORT CountedObject : public ObjectProtocol
 {
 private:
     volatile unsigned count;
+    unsigned local;
+    void *volatile owner;
+    CountedObject *deferred;
+
+    inline unsigned references(void) const
+        {return (unsigned)((int)(count & ~3u) / 4 + (int)local);}
+
+    void unbias(void);
+    void defer(void *owner);
+    void settle(void);
+
+    static void drain(void *owner);
+    static void detach(void *owner);
 
 protected:
     /**
-     * Construct a counted object, mark initially as unreferenced.
+     * Construct a counted object, mark initially as unreferenced.  If
+     * biasing is enabled for the calling thread the object is biased
+     * to it.
      */
     CountedObject();
 
@@ -79,10 +94,10 @@ protected:
     virtual void dealloc(void);
 
     /**
-     * Force reset of count.
+     * Force reset of count.  This also returns the object to ordinary
+     * (unbiased) counting.
      */
-    inline void reset(void)
-        {count = 0;}
+    void reset(void);
 
 public:
     /**
@@ -91,32 +106,73 @@ public:
      * @return true if referenced by more than one object.
      */
     inline bool is_copied(void) const
-        {return count > 1;}
+        {return references() > 1;}
 
     /**
      * Test if the object has been referenced (retained) by anyone yet.
      * @return true if retained.
      */
     inline bool is_retained(void) const
-        {return count > 0;}
+        {return references() > 0;}
 
     /**
      * Return the number of active references (retentions) to our object.
+     * When other threads are also retaining the object this is only a
+     * snapshot.
      * @return number of references to our object.
      */
     inline unsigned copied(void) const
-        {return count;}
+        {return references();}
 
     /**
-     * Increase reference count when retained.
+     * Test if the object is currently biased to an owning thread.
+     * @return true if biased.
+     */
+    inline bool is_biased(void) const
+        {return owner != NULL;}
+
+    /**
+     * Increase reference count when retained.  This is thread safe, and
+     * uses a relaxed atomic increment unless called by the owner of a
+     * biased object.
      */
     void retain(void);
 
     /**
      * Decrease reference count when released.  If no longer retained, then
-     * the object is dealloc'd.
+     * the object is dealloc'd.  The decrement is atomic and orders all
+     * prior use of the object before the dealloc in whichever thread
+     * releases it last.
      */
     void release(void);
+
+    /**
+     * Bias the object to the calling thread.  The owning thread then
+     * retains and releases the object without atomic operations, while
+     * other threads still may safely share it.  References released by
+     * other threads beyond those they retained are handed back to the
+     * owner, which merges them on its next release, on merge(), or when
+     * it exits.  This should only be used on an object that is not yet
+     * visible to other threads, and where the owner does most of the
+     * retaining and releasing.  Where the platform has no support for
+     * biased counting, this does nothing.
+     */
+    void bias(void);
+
+    /**
+     * Set whether counted objects constructed by the calling thread are
+     * biased to it.  This is a per-thread setting and is initially off.
+     * @param enable biasing for new objects.
+     */
+    static void biasing(bool enable);
+
+    /**
+     * Merge releases that other threads have handed back to objects biased
+     * to the calling thread.  This is done automatically on release, and is
+     * only needed by an owning thread that keeps objects alive but rarely
+     * releases any.
+     */
+    static void merge(void);
 };
 
 /**
@@ -207,24 +263,38 @@ public:
  * for the first time.  This is an abstract class because it is a type
  * factory for objects who's derived class form constructor is not known
  * in advance and is a helper class for the sarray template.
+ *
+ * Storage is paged, so that pages of the index space are only allocated
+ * once something in them is referenced.  Members may be fetched and
+ * created from multiple threads at once; each member is created exactly
+ * once, and threads racing for it wait for the one that creates it.  A
+ * population bitmap is kept so that counting and scanning skip over the
+ * unused parts of the array.
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 class __EXPORT SparseObjects
 {
 private:
-    ObjectProtocol **vector;
+    class __LOCAL page;
+
+    page **pages;
+    uint64_t *present;
     unsigned max;
 
+    page *fetch(unsigned offset);
+
 protected:
     /**
      * Object factory for creating members of the spare array when they
-     * are initially requested.
+     * are initially requested.  This may be called from any thread that
+     * references an empty member, but is only called once per member.
      * @return new object.
      */
     virtual ObjectProtocol *create(void) = 0;
 
     /**
-     * Purge the array by deleting all created objects.
+     * Purge the array by deleting all created objects.  This should not
+     * be done while other threads are still accessing the array.
      */
     void purge(void);
 
@@ -237,6 +307,13 @@ protected:
      */
     ObjectProtocol *get(unsigned offset);
 
+    /**
+     * Get an object at a specified offset only if it was already created.
+     * @param offset in array.
+     * @return existing object or NULL if none.
+     */
+    ObjectProtocol *find(unsigned offset) const;
+
     /**
      * Create a sparse array of known size.  No member objects are
      * created until they are referenced.
@@ -251,10 +328,30 @@ protected:
 
 public:
     /**
-     * Get count of array elements.
+     * Offset returned by scan when there are no more members.
+     */
+    static const unsigned npos;
+
+    /**
+     * Get count of array elements that have been created.
      * @return array elements.
      */
-    unsigned count(void);
+    unsigned count(void) const;
+
+    /**
+     * Find the next created member of the array.  Members created while
+     * scanning may or may not be seen.
+     * @param offset to start from.
+     * @return offset of member or npos if no more.
+     */
+    unsigned scan(unsigned offset = 0) const;
+
+    /**
+     * Get the size of the index space of the array.
+     * @return array size.
+     */
+    inline unsigned size(void) const
+        {return max;}
 };
 
 /**
@@ -263,7 +360,12 @@ public:
  * that are generated by sarray must have Object as a base class.  Managed
  * sparse arrays differ from standard arrays in that the member elements
  * are not allocated from the heap when the array is created, but rather
- * as they are needed.
+ * as they are needed.  Created members may be visited in order with
+ * scan:
+ * @code
+ * for(unsigned pos = list.scan(); pos != list.npos; pos = list.scan(pos + 1))
+ *     list.at(pos)->...;
+ * @endcode
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 template <class T>
@@ -292,10 +394,15 @@ public:
      * @return pointer to typed object.
      */
     inline T& operator[](unsigned offset)
-        {return get(offset);}
+        {return *get(offset);}
 
+    /**
+     * Get typed member of array only if it already exists.
+     * @param offset in array for object.
+     * @return pointer to typed object or NULL if not created.
+     */
     inline const T* at(unsigned offset) const
-        {return static_cast<const T&>(SparseObjects::get(offset));}
+        {return static_cast<const T*>(SparseObjects::find(offset));}
 
 private:
     __LOCAL ObjectProtocol *create(void)
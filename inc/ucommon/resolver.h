@@ -0,0 +1,202 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+/**
+ * Caching and asynchronous host name resolution.
+ * Host lookups made through Socket::query and Socket::address are answered
+ * from a cache of recent results, including failed lookups, for a limited
+ * time.  Concurrent lookups of the same name share one resolver call, and
+ * names in active use are refreshed in the background before they expire.
+ * Lookups may also be started asynchronously and waited on as futures or
+ * acted on through a completion callback.  For testing, names may be
+ * answered from a local table, such as a hosts file, in place of the
+ * system resolver.
+ * @file ucommon/resolver.h
+ */
+
+/**
+ * An example of cached and asynchronous name resolution.
+ * @example resolver.cpp
+ */
+
+#ifndef _UCOMMON_RESOLVER_H_
+#define _UCOMMON_RESOLVER_H_
+
+#ifndef _UCOMMON_SOCKET_H_
+#include <ucommon/socket.h>
+#endif
+
+#ifndef _UCOMMON_EXECUTOR_H_
+#include <ucommon/executor.h>
+#endif
+
+namespace ucommon {
+
+/**
+ * Caching name resolver.  This is a set of static methods that control
+ * the resolver cache used by the socket layer, and that resolve names in
+ * the background on a small executor of resolver threads.  Numeric
+ * addresses and wildcard binds are passed straight to the system.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT Resolver
+{
+public:
+    /**
+     * An asynchronous name lookup.  The request is a task of the
+     * resolver's executor, so it may be waited on like a future, or a
+     * derived class may override completed to act on the result in the
+     * resolver thread.  A request created to release itself is deleted
+     * once completed.
+     * @author David Sugar <dyfet@gnutelephony.org>
+     */
+    class __EXPORT request : public Executor::task
+    {
+    private:
+        friend class Resolver;
+
+        char *host, *service;
+        int type, protocol;
+        struct addrinfo *list;
+
+    protected:
+        /**
+         * Resolve the request in the resolver thread.
+         */
+        void run(void);
+
+    public:
+        /**
+         * Create a resolver request.
+         * @param release if the request is deleted when completed.
+         */
+        request(bool release = false);
+
+        /**
+         * Destroy request and any result it still holds.
+         */
+        virtual ~request();
+
+        /**
+         * Get the resolved address list once completed.
+         * @return address list or NULL if not resolved.
+         */
+        inline struct addrinfo *get(void) const
+            {return list;}
+
+        /**
+         * Take ownership of the resolved address list.  The list is
+         * later freed with Socket::release.
+         * @return address list or NULL if not resolved.
+         */
+        struct addrinfo *take(void);
+
+        /**
+         * Test if the name was resolved.
+         * @return true if an address list is held.
+         */
+        inline operator bool() const
+            {return list != NULL;}
+
+        inline bool operator!() const
+            {return list == NULL;}
+    };
+
+    /**
+     * Resolve a name through the cache.  This has the same semantics as
+     * the system getaddrinfo call, and the list returned is freed with
+     * Socket::release.
+     * @param host name to resolve.
+     * @param service name or port, may be NULL.
+     * @param hint for the lookup, may be NULL.
+     * @param result list returned.
+     * @return 0 on success, else a getaddrinfo error code.
+     */
+    static int query(const char *host, const char *service, const struct addrinfo *hint, struct addrinfo **result);
+
+    /**
+     * Free an address list returned by query.  Lists answered from the
+     * cache are not made by the system getaddrinfo, so they cannot be
+     * given to freeaddrinfo.  Socket::release calls this.
+     * @param list to free, may be NULL.
+     */
+    static void release(struct addrinfo *list);
+
+    /**
+     * Start resolving a name in the background.  The host and service are
+     * parsed as for Socket::query.
+     * @param request to resolve, must not already be pending.
+     * @param host name to resolve.
+     * @param service name or port, may be NULL.
+     * @param type of socket.
+     * @param protocol of socket.
+     */
+    static void resolve(request *request, const char *host, const char *service = NULL, int type = SOCK_STREAM, int protocol = 0);
+
+    /**
+     * Set cache limits.  A time to live of 0 disables the cache.
+     * @param ttl of resolved names in milliseconds.
+     * @param negative time to keep failed lookups in milliseconds.
+     * @param limit of cached names.
+     */
+    static void cache(timeout_t ttl, timeout_t negative = 5000, unsigned limit = 1024);
+
+    /**
+     * Remove all cached results.
+     */
+    static void flush(void);
+
+    /**
+     * Answer a host name with a numeric address, in place of the system
+     * resolver.
+     * @param host name to answer.
+     * @param address to answer with, or NULL to remove the name.
+     */
+    static void assign(const char *host, const char *address);
+
+    /**
+     * Load names to answer locally from a file in hosts file format.
+     * @param path of file to load.
+     * @return true if loaded.
+     */
+    static bool hosts(const char *path);
+
+    /**
+     * Answer names only from the local table, so that names not found
+     * there fail without querying the system resolver.
+     * @param enable local only resolution.
+     */
+    static void local(bool enable = true);
+
+    /**
+     * Number of lookups answered from the cache.
+     * @return cache hits.
+     */
+    static unsigned long hits(void);
+
+    /**
+     * Number of lookups passed to the system resolver.
+     * @return cache misses.
+     */
+    static unsigned long misses(void);
+};
+
+typedef Resolver::request ResolverRequest;
+
+} // namespace ucommon
+
+#endif
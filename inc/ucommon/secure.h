@@ -247,6 +247,9 @@ public:
 
     bool _pending(void);
 
+    inline bool _direct(void)
+        {return bio == NULL;}
+
     inline bool is_secure(void) const
         {return bio != NULL;}
 };
@@ -440,7 +443,7 @@ private:
 
     unsigned bufsize;
     unsigned char buffer[MAX_DIGEST_HASHSIZE / 8];
-    char textbuf[MAX_DIGEST_HASHSIZE / 8 + 1];
+    char textbuf[MAX_DIGEST_HASHSIZE / 4 + 1];
 
 protected:
     void release(void);
@@ -521,6 +524,20 @@ public:
      */
     static bool has(const char *name);
 
+    /**
+     * Compute binary digests of many independent messages at once.
+     * Where the backend supports it, messages are hashed together in
+     * parallel lanes, which is much faster for many small records than
+     * a digest object per record.
+     * @param name of digest to use.
+     * @param count of messages.
+     * @param messages to digest.
+     * @param sizes of each message.
+     * @param digests to save each binary digest into.
+     * @return size of each digest or 0 if not supported.
+     */
+    static unsigned hash(const char *name, unsigned count, const void *const *messages, const size_t *sizes, unsigned char *const *digests);
+
     static void uuid(char *string, const char *name, const unsigned char *ns = NULL);
 
     static String uuid(const char *name, const unsigned char *ns = NULL);
@@ -544,7 +561,7 @@ private:
 
     unsigned bufsize;
     unsigned char buffer[MAX_DIGEST_HASHSIZE / 8];
-    char textbuf[MAX_DIGEST_HASHSIZE / 8 + 1];
+    char textbuf[MAX_DIGEST_HASHSIZE / 4 + 1];
 
 protected:
     void release(void);
@@ -645,7 +662,9 @@ public:
     /**
      * Fill memory with pseudo-random values.  This is used
      * as the basis for all get and real operations and does
-     * not depend on seed entropy.
+     * not depend on seed entropy.  Values come from a buffered
+     * per-thread stream keyed from key(), so small requests do
+     * not make a system call each time.
      * @param memory buffer to fill.
      * @param size of buffer to fill.
      * @return number of bytes set.
@@ -767,6 +786,9 @@ public:
 
     bool _wait(void);
 
+    inline bool _direct(void)
+        {return bio == NULL;}
+
     inline void flush(void)
         {sync();}
 
@@ -793,6 +793,34 @@ public:
 
     friend class address;
 
+    /**
+     * A datagram for batched socket i/o.  When receiving, data and size
+     * give the buffer to fill, and the length, address, segment and stamp
+     * are set from the message received.  When sending, data and length
+     * give the message, and address its destination, or a zero family for
+     * a connected socket.
+     */
+    typedef struct {
+        void *data;
+        size_t size;
+        size_t length;
+        struct sockaddr_storage address;
+        size_t segment;         /**< size of coalesced segments, 0 if one. */
+        struct timespec stamp;  /**< kernel receive time, if enabled. */
+    } datagram_t;
+
+    /**
+     * State of zero copy sends on a socket.  Sends made without copying
+     * are numbered in order from 0, and the memory each was sent from must
+     * be kept unchanged until the completed count passes its number.
+     */
+    typedef struct {
+        unsigned sent;          /**< zero copy sends made. */
+        unsigned completed;     /**< zero copy sends released by kernel. */
+        bool enabled;           /**< zero copy enabled on socket. */
+        bool copied;            /**< kernel copied data rather than pinning. */
+    } zerocopy_t;
+
     /**
      * Create a socket object for use.
      */
@@ -931,6 +959,30 @@ public:
     inline int keepalive(bool enable)
         {return keepalive(so, enable);}
 
+    /**
+     * Set socket to coalesce received datagrams of a flow (udp gro).
+     * @param enable coalescing if true.
+     * @return 0 on success, else error code.
+     */
+    inline int coalesce(bool enable)
+        {return coalesce(so, enable);}
+
+    /**
+     * Set socket to record kernel receive time of datagrams.
+     * @param enable timestamps if true.
+     * @return 0 on success, else error code.
+     */
+    inline int timestamps(bool enable)
+        {return timestamps(so, enable);}
+
+    /**
+     * Enable zero copy sends on the socket.
+     * @param state of zero copy sends to initialize.
+     * @return 0 on success, else error code.
+     */
+    inline int zerocopy(zerocopy_t *state)
+        {return zerocopy(so, state);}
+
     /**
      * Set socket blocking I/O mode.
      * @param enable true for blocking I/O.
@@ -1131,6 +1183,33 @@ public:
      */
     size_t writeto(const void *data, size_t number, const struct sockaddr *address = NULL);
 
+    /**
+     * Read a batch of datagrams from the socket receive buffer.
+     * @param list of datagrams to receive into.
+     * @param count of datagrams in list.
+     * @return number of datagrams received, 0 if none or error.
+     */
+    unsigned readbatch(datagram_t *list, unsigned count);
+
+    /**
+     * Write a batch of datagrams to the socket send buffer.
+     * @param list of datagrams to send.
+     * @param count of datagrams in list.
+     * @return number of datagrams sent, 0 if none or error.
+     */
+    unsigned writebatch(const datagram_t *list, unsigned count);
+
+    /**
+     * Send from a file to the connected socket without copying through
+     * user memory where supported.
+     * @param file descriptor to send from.
+     * @param offset in file to send from and advance, or NULL for the
+     * current file position.
+     * @param size of data to send.
+     * @return number of bytes sent, less at end of file, -1 if error.
+     */
+    ssize_t sendfile(fd_t file, off_t *offset, size_t size);
+
     /**
      * Read a newline of text data from the socket and save in NULL terminated
      * string.  This uses an optimized I/O method that takes advantage of
@@ -1332,6 +1411,25 @@ public:
      */
     static int keepalive(socket_t socket, bool enable);
 
+    /**
+     * Set socket descriptor to coalesce received datagrams of a flow into
+     * one buffer of equal sized segments (udp gro).  The segment size of
+     * each datagram received in a batch is then reported.
+     * @param socket descriptor.
+     * @param enable coalescing if true.
+     * @return 0 on success, else error code.
+     */
+    static int coalesce(socket_t socket, bool enable);
+
+    /**
+     * Set socket descriptor to record kernel receive time of datagrams,
+     * which is then reported for datagrams received in a batch.
+     * @param socket descriptor.
+     * @param enable timestamps if true.
+     * @return 0 on success, else error code.
+     */
+    static int timestamps(socket_t socket, bool enable);
+
     /**
      * Set socket for unicast mode broadcasts on socket descriptor.
      * @param socket descriptor.
@@ -1450,6 +1548,89 @@ public:
      */
     static ssize_t recvinet(socket_t socket, void *buffer, size_t size, int flags = 0, struct sockaddr_internet *address = NULL);
 
+    /**
+     * Receive a batch of datagrams in one system call where supported.
+     * This waits for the first datagram, unless MSG_DONTWAIT is given, and
+     * then takes those already waiting up to the count.
+     * @param socket to receive from.
+     * @param list of datagrams to receive into.
+     * @param count of datagrams in list.
+     * @param flags for i/o operation.
+     * @return number of datagrams received, -1 if error.
+     */
+    static int recvbatch(socket_t socket, datagram_t *list, unsigned count, int flags = 0);
+
+    /**
+     * Send a batch of datagrams in one system call where supported.
+     * @param socket to send to.
+     * @param list of datagrams to send.
+     * @param count of datagrams in list.
+     * @param flags for i/o operation.
+     * @return number of datagrams sent, -1 if error.
+     */
+    static int sendbatch(socket_t socket, const datagram_t *list, unsigned count, int flags = 0);
+
+    /**
+     * Send a burst of equal sized datagrams to one destination.  The
+     * buffer is sent as datagrams of the segment size, the last of which
+     * may be shorter.  The kernel splits the buffer where segmentation
+     * offload (udp gso) is supported, else the datagrams are batched.
+     * @param socket to send to.
+     * @param buffer of datagrams to send.
+     * @param size of buffer.
+     * @param segment size of each datagram.
+     * @param address of destination, NULL if connected.
+     * @return number of bytes sent, -1 if error.
+     */
+    static ssize_t sendsegments(socket_t socket, const void *buffer, size_t size, size_t segment, const struct sockaddr *address = NULL);
+
+    /**
+     * Send from a file to a connected socket without copying through user
+     * memory where supported.  Regular files are sent with sendfile, and
+     * pipes and other descriptors are spliced through a pipe.  Otherwise
+     * the file is read and sent in chunks.
+     * @param socket to send to.
+     * @param file descriptor to send from.
+     * @param offset in file to send from and advance, or NULL for the
+     * current file position.
+     * @param size of data to send.
+     * @return number of bytes sent, less at end of file, -1 if error.
+     */
+    static ssize_t sendfile(socket_t socket, fd_t file, off_t *offset, size_t size);
+
+    /**
+     * Enable zero copy sends on a socket descriptor.  This is only
+     * supported on linux.
+     * @param socket descriptor.
+     * @param state of zero copy sends to initialize.
+     * @return 0 on success, else error code.
+     */
+    static int zerocopy(socket_t socket, zerocopy_t *state);
+
+    /**
+     * Send a buffer without copying it into the kernel, if zero copy is
+     * enabled.  Buffers smaller than a few pages are copied, since that
+     * costs less than pinning them.  If the sent count of the state is
+     * advanced, the buffer must be kept until reclaimed.
+     * @param socket to send to.
+     * @param buffer to send.
+     * @param size of buffer.
+     * @param state of zero copy sends.
+     * @return number of bytes sent, -1 if error.
+     */
+    static ssize_t sendzerocopy(socket_t socket, const void *buffer, size_t size, zerocopy_t *state);
+
+    /**
+     * Collect completion notices of zero copy sends, so that the memory
+     * they were sent from may be reused.
+     * @param socket descriptor.
+     * @param state of zero copy sends to update.
+     * @param timeout to wait for a notice if none are ready and sends are
+     * still pending.
+     * @return number of sends newly completed.
+     */
+    static unsigned reclaim(socket_t socket, zerocopy_t *state, timeout_t timeout = 0);
+
     /**
      * Bind the socket descriptor to a known interface and service port.
      * @param socket descriptor to bind.
@@ -1847,6 +2028,129 @@ public:
     TCPServer(const char *address, const char *service, unsigned backlog = 5);
 };
 
+/**
+ * A group of listeners bound to the same address.  Where SO_REUSEPORT is
+ * supported, each worker gets a listening socket of its own and the kernel
+ * balances new connections between them, so workers do not contend on one
+ * accept queue.  Connections may optionally be steered to the listener
+ * matching the cpu that received them, which works best when worker n is
+ * pinned to cpu n.  Where SO_REUSEPORT is not supported, every member of
+ * the group shares a single listener.  Each member has an accept loop that
+ * a worker thread or fiber runs, passing accepted connections to the
+ * virtual accepted method.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT ListenGroup
+{
+private:
+    socket_t *listeners;
+    unsigned count;
+    bool shared, nonblock;
+    volatile bool stopped;
+
+    ListenGroup(const ListenGroup&);
+    ListenGroup& operator=(const ListenGroup&);
+
+protected:
+    /**
+     * Called from the accept loop for each connection accepted.  The
+     * default releases the connection.
+     * @param index of listener that accepted.
+     * @param socket of connection, owned by the callee.
+     * @param address of peer connecting.
+     */
+    virtual void accepted(unsigned index, socket_t socket, struct sockaddr_storage *address);
+
+public:
+    /**
+     * Create and bind a group of listeners.
+     * @param address to bind on or "*" for all.
+     * @param service port to bind listeners, or "0" for one ephemeral port.
+     * @param count of listeners in the group.
+     * @param backlog size for buffering pending connections per listener.
+     * @param family of socket.
+     * @param type of socket.
+     * @param protocol for socket if not TCPIP.
+     */
+    ListenGroup(const char *address, const char *service, unsigned count, unsigned backlog = 5, int family = AF_UNSPEC, int type = 0, int protocol = 0);
+
+    /**
+     * Stop and release all listeners.
+     */
+    virtual ~ListenGroup();
+
+    /**
+     * Steer each connection to the listener of the cpu that received it,
+     * rather than by hash of the connection.  This is only supported on
+     * linux.
+     * @return true if steering was attached.
+     */
+    bool steer(void);
+
+    /**
+     * Set if accepted connections are non-blocking, as for use with an
+     * event loop.  Accepted connections are always close on exec.
+     * @param enable non-blocking connections.
+     */
+    void nonblocking(bool enable = true);
+
+    /**
+     * Accept a connection on one listener of the group.
+     * @param index of listener.
+     * @param address to save peer connecting.
+     * @return socket descriptor of connection or INVALID_SOCKET.
+     */
+    socket_t accept(unsigned index, struct sockaddr_storage *address = NULL) const;
+
+    /**
+     * Run the accept loop of one listener until the group is stopped.
+     * Each worker runs the loop of its own index.
+     * @param index of listener.
+     */
+    void run(unsigned index);
+
+    /**
+     * Stop all accept loops.  Listeners are shut down so that workers
+     * blocked in accept return.
+     */
+    void stop(void);
+
+    /**
+     * Get the socket descriptor of one listener.
+     * @param index of listener.
+     * @return socket descriptor.
+     */
+    socket_t get(unsigned index) const;
+
+    inline socket_t operator[](unsigned index) const
+        {return get(index);}
+
+    /**
+     * Get the number of members in the group.
+     * @return number of listeners.
+     */
+    inline unsigned size(void) const
+        {return count;}
+
+    /**
+     * Test if members share one listener because SO_REUSEPORT is not
+     * supported.
+     * @return true if listener is shared.
+     */
+    inline bool is_shared(void) const
+        {return shared;}
+
+    /**
+     * Test if the group is bound.
+     * @return true if listening.
+     */
+    inline operator bool() const
+        {return count > 0;}
+
+    inline bool operator!() const
+        {return count == 0;}
+};
+
 /**
  * Helper function for linked_pointer<struct sockaddr>.
  */
@@ -122,6 +122,13 @@ protected:
 
     virtual bool _wait(void);
 
+    /**
+     * Check if output may be sent to the socket directly rather than
+     * through _write.  Derived classes that encode output return false.
+     * @return true if output is sent unchanged.
+     */
+    virtual bool _direct(void);
+
     /**
      * Release the tcp stream and destroy the underlying socket.
      */
@@ -217,6 +224,18 @@ public:
      * socket but is a disconnect.
      */
     void close(void);
+
+    /**
+     * Send from a file directly to the stream connection.  Pending
+     * output is flushed first, and the file is then sent without copying
+     * through user memory where supported.
+     * @param file descriptor to send from.
+     * @param offset in file to send from and advance, or NULL for the
+     * current file position.
+     * @param size of data to send.
+     * @return number of bytes sent.
+     */
+    size_t sendfile(fd_t file, off_t *offset, size_t size);
 };
 
 /**
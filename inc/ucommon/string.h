@@ -1777,6 +1777,147 @@ public:
         {return data + size;}
 };
 
+/**
+ * A set of characters held as a 256 bit lookup table.  This is used to
+ * test for separators in one step rather than searching a list of them
+ * for every character examined.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT charmap
+{
+private:
+    uint32_t bits[8];
+
+public:
+    /**
+     * Create a character set.
+     * @param list of characters in set, or NULL for empty.
+     */
+    charmap(const char *list = NULL);
+
+    /**
+     * Set characters in set.
+     * @param list of characters to hold.
+     */
+    void set(const char *list);
+
+    /**
+     * Test if a character is in the set.
+     * @param ch to test.
+     * @return true if in set.
+     */
+    inline bool is(char ch) const
+        {return (bits[(uint8_t)ch >> 5] >> ((uint8_t)ch & 31)) & 1;}
+
+    inline bool operator()(char ch) const
+        {return is(ch);}
+};
+
+/**
+ * Bulk tokenizer for large text buffers.  Separators are compiled into a
+ * lookup table once, and text is classified 32 bytes at a time with simd
+ * instructions where available.  Tokens are kept as offset and length
+ * spans in one contiguous array rather than as copies, and so refer to
+ * the text, which is not modified and need not be null terminated.
+ * @author David Sugar <dyfet@gnutelephony.org>
+ */
+class __EXPORT Tokenizer
+{
+public:
+    /**
+     * A token found in text.
+     */
+    typedef struct {
+        size_t offset;
+        size_t size;
+    } span_t;
+
+private:
+    charmap separators;
+    uint8_t low[16], high[16];
+    bool vector;
+    span_t *spans;
+    size_t count, limit;
+    const char *text;
+
+    __LOCAL size_t scan(const char *text, size_t len, bool empty);
+    __LOCAL bool grow(void);
+
+    Tokenizer(const Tokenizer& copy);
+    Tokenizer& operator=(const Tokenizer& copy);
+
+public:
+    /**
+     * Create a tokenizer.
+     * @param list of separator characters.
+     * @param reserve spans to allocate up front.
+     */
+    Tokenizer(const char *list, size_t reserve = 0);
+
+    /**
+     * Release spans.
+     */
+    ~Tokenizer();
+
+    /**
+     * Split text into fields.  Each separator ends a field, so adjacent
+     * separators produce empty fields, as in comma separated records.
+     * @param text to split.
+     * @param len of text.
+     * @return number of fields found.
+     */
+    size_t fields(const char *text, size_t len);
+
+    /**
+     * Split text into tokens.  Runs of separators are skipped, so no
+     * tokens are empty, as with String::token.
+     * @param text to split.
+     * @param len of text.
+     * @return number of tokens found.
+     */
+    size_t token(const char *text, size_t len);
+
+    /**
+     * Find the first separator in text.
+     * @param text to search.
+     * @param len of text.
+     * @return offset of separator, or len if none.
+     */
+    size_t find(const char *text, size_t len) const;
+
+    /**
+     * Drop spans found, keeping their memory.
+     */
+    inline void clear(void)
+        {count = 0;}
+
+    inline size_t size(void) const
+        {return count;}
+
+    inline const span_t& operator[](size_t index) const
+        {return spans[index];}
+
+    /**
+     * Get the text of a span.
+     * @param index of span.
+     * @return start of span in the split text.
+     */
+    inline const char *at(size_t index) const
+        {return text + spans[index].offset;}
+
+    inline size_t length(size_t index) const
+        {return spans[index].size;}
+
+    inline const char *data(void) const
+        {return text;}
+
+    inline const span_t *begin(void) const
+        {return spans;}
+
+    inline const span_t *end(void) const
+        {return spans + count;}
+};
+
 } // namespace ucommon
 
 #endif
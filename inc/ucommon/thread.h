@@ -523,6 +523,13 @@ public:
  * the number of threads that may use the lock.  Finally, both the exclusive
  * and shared protocols are implimented to support exclusive_lock and
  * shared_lock referencing.
+ *
+ * A lock that is read far more often than it is written may be biased
+ * toward readers.  While biased, readers only mark a slot of their own
+ * thread, so they never write to a shared cache line, and a writer
+ * revokes the bias and waits for those readers to drain.  The bias is
+ * restored by later readers after a delay proportional to how long the
+ * revocation took.
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 class __EXPORT ThreadLock : private ConditionalAccess, public ExclusiveAccess, public SharedAccess
@@ -530,6 +537,9 @@ class __EXPORT ThreadLock : private ConditionalAccess, public ExclusiveAccess, p
 protected:
     unsigned writers;
     pthread_t writeid;
+    volatile bool biased;
+    bool biasing;
+    Timer::tick_t inhibit;
 
     virtual void _lock(void);
     virtual void _share(void);
@@ -657,6 +667,13 @@ public:
      */
     bool access(timeout_t timeout = Timer::inf);
 
+    /**
+     * Set whether the lock is biased toward readers.  Reader biasing is
+     * off by default, and is only available with native posix threads.
+     * @param enable reader biasing.
+     */
+    void bias(bool enable = true);
+
     /**
      * Specify hash table size for guard protection.  The default is 1.
      * This should be called at initialization time from the main thread
@@ -739,6 +756,10 @@ protected:
  * a little lighter, and read (shared) locks can be converted to exclusive
  * (write) locks to perform brief modify operations and then returned to read
  * locks, rather than having to release and re-aquire locks to change mode.
+ *
+ * Like ThreadLock, the lock may be biased toward readers.  Biased readers
+ * keep their (recursive) share count in a slot of their own thread rather
+ * than in the lock, and move it into the lock if they convert to exclusive.
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 class __EXPORT ConditionalLock : protected ConditionalAccess, public SharedAccess
@@ -754,12 +775,18 @@ protected:
     };
 
     LinkedObject *contexts;
+    volatile bool biased;
+    bool biasing;
+    Timer::tick_t inhibit;
 
     virtual void _share(void);
     virtual void _unlock(void);
 
     Context *getContext(void);
 
+private:
+    void revoke(void);
+
 public:
     /**
      * Construct conditional lock for default concurrency.
@@ -801,6 +828,13 @@ public:
      * Return an exclusive access lock back to share mode.
      */
     virtual void share(void);
+
+    /**
+     * Set whether the lock is biased toward readers.  Reader biasing is
+     * off by default, and is only available with native posix threads.
+     * @param enable reader biasing.
+     */
+    void bias(bool enable = true);
 };
 
 /**
@@ -813,17 +847,27 @@ public:
  * which, when supported, have a fixed limit defined at creation time.  Since
  * we use conditionals, another feature we can add is optional support for a
  * wait with timeout.
+ *
+ * Arrival is a single atomic update of a word holding the number of
+ * threads waiting and a generation that advances each time the barrier
+ * releases.  Waiters sleep until the generation changes, on a futex
+ * where available, so the barrier is reusable without a reset.
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 class __EXPORT barrier : private Conditional
 {
 private:
-    unsigned count;
-    unsigned waits;
+    volatile unsigned count;
+    volatile unsigned state;
+
+    __LOCAL bool pass(timeout_t timeout);
+    __LOCAL void advance(unsigned limit);
+    __LOCAL void wakeup(void);
 
 public:
     /**
-     * Construct a barrier with an initial size.
+     * Construct a barrier with an initial size.  At most 65535 threads
+     * may wait at a barrier.
      * @param count of threads required.
      */
     barrier(unsigned count);
@@ -878,12 +922,24 @@ public:
  * Unlike pthread semaphore, our semaphore class supports it's count limit
  * to be altered during runtime and the use of timed waits.  This class also
  * implements the shared_lock protocol.
+ *
+ * When a permit is available, wait and release are a single atomic
+ * compare and swap.  Only threads that have to block go to sleep, on a
+ * futex where available, and release only wakes one if any are sleeping.
+ * A semaphore with a count of 0 releases all waiting threads as a group,
+ * and is always handled under the lock.
  * @author David Sugar <dyfet@gnutelephony.org>
  */
 class __EXPORT Semaphore : public SharedAccess, protected Conditional
 {
+private:
+    volatile unsigned sequence;
+
+    __LOCAL bool blocking(timeout_t timeout);
+    __LOCAL void unblock(bool all);
+
 protected:
-    unsigned count, waits, used;
+    volatile unsigned count, waits, used;
 
     virtual void _share(void);
     virtual void _unlock(void);
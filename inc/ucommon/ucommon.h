@@ -103,6 +103,9 @@
 #include <ucommon/bitmap.h>
 #include <ucommon/socket.h>
 #include <ucommon/thread.h>
+#include <ucommon/executor.h>
+#include <ucommon/fiber.h>
+#include <ucommon/resolver.h>
 #include <ucommon/containers.h>
 #include <ucommon/fsys.h>
 #include <ucommon/file.h>
@@ -86,10 +86,28 @@ public:
     /**
      * Count ut8 encoded ucs4 codepoints in string.
      * @param string of utf8 data.
-     * @return codepount count, 0 if empty or invalid.
+     * @return codepoint count, up to the first invalid or truncated one.
      */
     static size_t count(const char *string);
 
+    /**
+     * Count utf8 encoded ucs4 codepoints in string of known length.
+     * @param string of utf8 data.
+     * @param size of string in bytes.
+     * @return codepoint count, up to the first invalid or truncated one.
+     */
+    static size_t count(const char *string, size_t size);
+
+    /**
+     * Check if a string is well formed utf8 as defined by RFC 3629.  This
+     * rejects overlong and truncated sequences, surrogates, and codepoints
+     * past 0x10ffff.
+     * @param string of utf8 data.
+     * @param size of string in bytes or 0 if null terminated.
+     * @return true if valid.
+     */
+    static bool valid(const char *string, size_t size = 0);
+
     /**
      * Get codepoint offset in a string.
      * @param string of utf8 data.
@@ -196,7 +214,18 @@ public:
  */
 class __EXPORT UString : public String, public utf8
 {
-protected:
+private:
+    struct index_t;
+
+    index_t *cache;
+    bool indexed;
+
+    const char *lookup(ssize_t codepoint) const;
+    bool current(void) const;
+    void reindex(void);
+    void reset(void);
+
+public:
     /**
      * Create a new empty utf8 aware string object.
      */
@@ -320,6 +349,26 @@ protected:
     inline UString copy(strsize_t offset, strsize_t size) const
         {return operator()((int)offset, size);}
 
+    /**
+     * Enable or disable a cached codepoint index for the string.  With the
+     * index, repeated positional access by codepoint no longer walks the
+     * string from the start each time.  The index is built here and rebuilt
+     * when the text is changed through UString methods; const access only
+     * reads it, so an indexed string may be read by many threads at once.
+     * If the text is changed through String methods, the index is not used
+     * until index() is called again.  A change in place that keeps the
+     * length cannot be detected, so call index() after one.
+     * @param enable or disable index.
+     */
+    void index(bool enable = true);
+
+    /**
+     * Assign a copy of another utf8 string.
+     * @param copy of string to assign.
+     * @return this string.
+     */
+    UString& operator=(const UString& copy);
+
     /**
      * Cut (remove) text from string using codepoint offsets.
      * @param offset to start of text field to remove.
@@ -356,8 +405,7 @@ protected:
      * Count codepoints in current string.
      * @return count of codepoints.
      */
-    inline strsize_t count(void) const
-        {return utf8::count(str->text);}
+    strsize_t count(void) const;
 
     /**
      * Count occurrences of a unicode character in string.
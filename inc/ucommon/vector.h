@@ -33,7 +33,7 @@
 
 namespace ucommon {
 
-typedef unsigned short vectorsize_t;
+typedef unsigned vectorsize_t;
 
 /**
  * An array of reusable objects.  This class is used to support the
@@ -103,6 +103,10 @@ protected:
  * we store in the vector are objects inherited from Object, a vector can
  * itself act as a vector of smart pointers to  reference counted objects
  * (derived from CountedObject).
+ *
+ * Copies of a vector share the list until one of them is modified.  The
+ * list grows geometrically as members are added, so appending is amortized
+ * constant time, and reserve may be used to size it in advance.
  * @author David Sugar <dyfet@gnutelephony.org>.
  */
 class __EXPORT Vector
@@ -120,7 +124,10 @@ public:
         void dealloc(void);
         void set(ObjectProtocol **items);
         void add(ObjectProtocol **list);
+        void add(ObjectProtocol **list, vectorsize_t count);
         void add(ObjectProtocol *obj);
+        void insert(vectorsize_t position, ObjectProtocol **list, vectorsize_t count);
+        void erase(vectorsize_t position, vectorsize_t count);
         void purge(void);
         void inc(vectorsize_t adj);
         void dec(vectorsize_t adj);
@@ -172,6 +179,13 @@ public:
      */
     Vector(ObjectProtocol **items, vectorsize_t size = 0);
 
+    /**
+     * Create a copy of a vector.  The copy shares the list of the original
+     * until either of them is modified.
+     * @param copy of vector.
+     */
+    Vector(const Vector &copy);
+
     /**
      * Destroy the current reference counted vector of object pointers.
      */
@@ -268,6 +282,54 @@ public:
      */
     void add(ObjectProtocol *pointer);
 
+    /**
+     * Add (append) a range of object pointers to the vector.  The list
+     * grows at most once for the whole range.
+     * @param list of object pointers to add.
+     * @param count of pointers in list.
+     */
+    void add(ObjectProtocol **list, vectorsize_t count);
+
+    /**
+     * Insert a range of object pointers into the vector.  Members from the
+     * position onward are moved up to make room.
+     * @param position to insert at, or past the end to append.
+     * @param list of object pointers to insert.
+     * @param count of pointers in list.
+     */
+    void insert(vectorsize_t position, ObjectProtocol **list, vectorsize_t count);
+
+    /**
+     * Insert a single object pointer into the vector.
+     * @param position to insert at, or past the end to append.
+     * @param pointer to insert.
+     */
+    inline void insert(vectorsize_t position, ObjectProtocol *pointer)
+        {insert(position, &pointer, 1);}
+
+    /**
+     * Insert an existing vector into our vector.
+     * @param position to insert at, or past the end to append.
+     * @param vector to insert.
+     */
+    inline void insert(vectorsize_t position, Vector &vector)
+        {insert(position, vector.list(), vector.len());}
+
+    /**
+     * De-reference and remove a range of members from the vector.  Members
+     * after the range are moved down.
+     * @param position of first member to remove.
+     * @param count of members to remove.
+     */
+    void erase(vectorsize_t position, vectorsize_t count = 1);
+
+    /**
+     * Make sure the vector can hold at least size members without being
+     * re-allocated.
+     * @param size to reserve.
+     */
+    void reserve(vectorsize_t size);
+
     /**
      * De-reference and remove all pointers from the vector.
      */
@@ -291,7 +353,7 @@ public:
      * @param vector to append.
      */
     inline void add(Vector &vector)
-        {add(vector.list());}
+        {add(vector.list(), vector.len());}
 
     /**
      * Return a pointer from the vector by array reference.
@@ -335,14 +397,14 @@ public:
      * @param vector to append from.
      */
     inline void operator+=(Vector &vector)
-        {add(vector.list());}
+        {add(vector.list(), vector.len());}
 
     /**
      * Concatenate into our existing vector from assignment list.
      * @param vector to append from.
      */
     inline Vector& operator+(Vector &vector)
-        {add(vector.list()); return *this;}
+        {add(vector.list(), vector.len()); return *this;}
 
     /**
      * Release vector and concat vector from another vector.
@@ -400,6 +462,8 @@ private:
     void cow(vectorsize_t adj = 0);
     void release(void);
 
+    MemVector(const MemVector& copy);
+
     friend class Vector::array;
 
 public:
@@ -445,10 +509,10 @@ public:
     inline vectorof(vectorsize_t size) : Vector(size) {}
 
     inline T& operator[](int index)
-        {return static_cast<T&>(Vector::get(index));}
+        {return *static_cast<T*>(Vector::get(index));}
 
     inline const T& at(int index)
-        {return static_cast<const T&>(Vector::get(index));}
+        {return *static_cast<const T*>(Vector::get(index));}
 
     /**
      * Retrieve a typed member of the vector directly.
@@ -383,6 +383,204 @@ size_t Cipher::process(unsigned char *buf, size_t len, bool flag)
         return put(buf, len);
 }
 
+// A per-thread chacha20 stream is used for Random::fill in all crypto
+// backends.  Each thread's stream is keyed from Random::key, rekeys itself
+// from its own output after every refill so earlier output cannot be
+// recovered, and is reseeded periodically and in the child after a fork.
+
+#define RNG_KEYSIZE 40
+#define RNG_BUFSIZE (16 * 64)
+#define RNG_RESEED  (1024l * 1024l)
+
+#define RNG_ROTATE(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define RNG_QUARTER(a, b, c, d) \
+    a += b; d ^= a; d = RNG_ROTATE(d, 16); \
+    c += d; b ^= c; b = RNG_ROTATE(b, 12); \
+    a += b; d ^= a; d = RNG_ROTATE(d, 8); \
+    c += d; b ^= c; b = RNG_ROTATE(b, 7);
+
+class __LOCAL rng_stream
+{
+public:
+    uint32_t input[16];
+    unsigned char buffer[RNG_BUFSIZE];
+    size_t avail;
+    size_t count;
+    unsigned generation;
+
+    void seed(void);
+    void fill(unsigned char *data, size_t size);
+
+private:
+    void rekey(const unsigned char *key);
+    void refill(void);
+};
+
+static volatile unsigned rng_generation = 0;
+
+static inline uint32_t rng_get32(const unsigned char *cp)
+{
+    return ((uint32_t)cp[0]) | (((uint32_t)cp[1]) << 8) |
+        (((uint32_t)cp[2]) << 16) | (((uint32_t)cp[3]) << 24);
+}
+
+static inline void rng_put32(unsigned char *cp, uint32_t value)
+{
+    cp[0] = (unsigned char)(value & 0xff);
+    cp[1] = (unsigned char)((value >> 8) & 0xff);
+    cp[2] = (unsigned char)((value >> 16) & 0xff);
+    cp[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+void rng_stream::rekey(const unsigned char *key)
+{
+    // "expand 32-byte k", 256 bit key, 64 bit counter, 64 bit nonce
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for(unsigned pos = 0; pos < 8; ++pos)
+        input[pos + 4] = rng_get32(key + pos * 4);
+    input[12] = input[13] = 0;
+    input[14] = rng_get32(key + 32);
+    input[15] = rng_get32(key + 36);
+}
+
+void rng_stream::refill(void)
+{
+    uint32_t x[16];
+    unsigned pos, round;
+
+    for(pos = 0; pos < RNG_BUFSIZE; pos += 64) {
+        memcpy(x, input, sizeof(x));
+        for(round = 0; round < 10; ++round) {
+            RNG_QUARTER(x[0], x[4], x[8], x[12])
+            RNG_QUARTER(x[1], x[5], x[9], x[13])
+            RNG_QUARTER(x[2], x[6], x[10], x[14])
+            RNG_QUARTER(x[3], x[7], x[11], x[15])
+            RNG_QUARTER(x[0], x[5], x[10], x[15])
+            RNG_QUARTER(x[1], x[6], x[11], x[12])
+            RNG_QUARTER(x[2], x[7], x[8], x[13])
+            RNG_QUARTER(x[3], x[4], x[9], x[14])
+        }
+        for(round = 0; round < 16; ++round)
+            rng_put32(buffer + pos + round * 4, x[round] + input[round]);
+        if(!++input[12])
+            ++input[13];
+    }
+
+    // fast key erasure; the start of each buffer keys the next one
+    rekey(buffer);
+    zerofill(buffer, RNG_KEYSIZE);
+    zerofill(x, sizeof(x));
+    avail = RNG_BUFSIZE - RNG_KEYSIZE;
+}
+
+void rng_stream::seed(void)
+{
+    unsigned char key[RNG_KEYSIZE];
+    size_t size = Random::key(key, sizeof(key));
+
+    // ugly...would not trust it, but better than a fixed stream
+    if(size < sizeof(key)) {
+        Timer::tick_t ticks = Timer::ticks();
+        void *addr = this;
+        memcpy(key, &ticks, sizeof(ticks));
+        memcpy(key + sizeof(ticks), &addr, sizeof(addr));
+        while(size < sizeof(key)) {
+            key[size] ^= (unsigned char)(rand() & 0xff);
+            ++size;
+        }
+    }
+
+    rekey(key);
+    zerofill(key, sizeof(key));
+    zerofill(buffer, sizeof(buffer));
+    avail = 0;
+    count = 0;
+    generation = rng_generation;
+}
+
+void rng_stream::fill(unsigned char *data, size_t size)
+{
+    if(generation != rng_generation || count >= RNG_RESEED)
+        seed();
+
+    count += size;
+    while(size) {
+        if(!avail)
+            refill();
+
+        size_t chunk = size;
+        if(chunk > avail)
+            chunk = avail;
+
+        unsigned char *cp = buffer + RNG_BUFSIZE - avail;
+        memcpy(data, cp, chunk);
+        zerofill(cp, chunk);
+        data += chunk;
+        size -= chunk;
+        avail -= chunk;
+    }
+}
+
+#ifdef  _MSTHREADS_
+
+static rng_stream *rng_shared = NULL;
+
+size_t Random::fill(unsigned char *buf, size_t size)
+{
+    Mutex::protect(&rng_shared);
+    if(!rng_shared) {
+        rng_shared = new rng_stream;
+        rng_shared->seed();
+    }
+    rng_shared->fill(buf, size);
+    Mutex::release(&rng_shared);
+    return size;
+}
+
+#else
+
+static pthread_key_t rng_key;
+static pthread_once_t rng_once = PTHREAD_ONCE_INIT;
+
+extern "C" {
+    static void rng_release(void *stream)
+    {
+        zerofill(stream, sizeof(rng_stream));
+        delete (rng_stream *)stream;
+    }
+
+    static void rng_child(void)
+    {
+        ++rng_generation;
+    }
+
+    static void rng_init(void)
+    {
+        pthread_key_create(&rng_key, &rng_release);
+        pthread_atfork(NULL, NULL, &rng_child);
+    }
+}
+
+size_t Random::fill(unsigned char *buf, size_t size)
+{
+    pthread_once(&rng_once, &rng_init);
+    rng_stream *stream = (rng_stream *)pthread_getspecific(rng_key);
+
+    if(!stream) {
+        stream = new rng_stream;
+        stream->seed();
+        pthread_setspecific(rng_key, stream);
+    }
+
+    stream->fill(buf, size);
+    return size;
+}
+
+#endif
+
 int Random::get(void)
 {
     uint16_t v;;
@@ -19,6 +19,15 @@
 
 namespace ucommon {
 
+static void hexbuffer(char *text, const unsigned char *bin, unsigned size)
+{
+    unsigned count = 0;
+    while(count < size) {
+        snprintf(text + (count * 2), 3, "%2.2x", bin[count]);
+        ++count;
+    }
+}
+
 bool Digest::has(const char *id)
 {
     if(eq_case(id, "md5"))
@@ -27,6 +36,9 @@ bool Digest::has(const char *id)
     if(eq_case(id, "sha1") || eq_case(id, "sha") || eq_case(id, "sha160"))
         return true;
 
+    if(eq_case(id, "sha256") || eq_case(id, "sha384") || eq_case(id, "sha512"))
+        return true;
+
     return false;
 }
 
@@ -44,6 +56,21 @@ void Digest::set(const char *type)
         context = new SHA1_CTX;
         SHA1Init((SHA1_CTX*)context);
     }
+    else if(eq_case(type, "sha256")) {
+        hashtype = "2";
+        context = new SHA256_CTX;
+        SHA256Init((SHA256_CTX*)context);
+    }
+    else if(eq_case(type, "sha384")) {
+        hashtype = "3";
+        context = new SHA512_CTX;
+        SHA384Init((SHA512_CTX*)context);
+    }
+    else if(eq_case(type, "sha512")) {
+        hashtype = "5";
+        context = new SHA512_CTX;
+        SHA512Init((SHA512_CTX*)context);
+    }
 }
 
 void Digest::release(void)
@@ -57,6 +84,13 @@ void Digest::release(void)
         case 's':
             delete (SHA1_CTX *)context;
             break;
+        case '2':
+            delete (SHA256_CTX *)context;
+            break;
+        case '3':
+        case '5':
+            delete (SHA512_CTX *)context;
+            break;
         default:
             break;
         }
@@ -80,6 +114,13 @@ bool Digest::put(const void *address, size_t size)
     case 's':
         SHA1Update((SHA1_CTX*)context, (const unsigned char *)address, size);
         return true;
+    case '2':
+        SHA256Update((SHA256_CTX*)context, (const unsigned char *)address, size);
+        return true;
+    case '3':
+    case '5':
+        SHA512Update((SHA512_CTX*)context, (const unsigned char *)address, size);
+        return true;
     default:
         return false;
     }
@@ -99,6 +140,21 @@ void Digest::reset(void)
                 context = new SHA1_CTX;
             SHA1Init((SHA1_CTX*)context);
             break;
+        case '2':
+            if(!context)
+                context = new SHA256_CTX;
+            SHA256Init((SHA256_CTX*)context);
+            break;
+        case '3':
+            if(!context)
+                context = new SHA512_CTX;
+            SHA384Init((SHA512_CTX*)context);
+            break;
+        case '5':
+            if(!context)
+                context = new SHA512_CTX;
+            SHA512Init((SHA512_CTX*)context);
+            break;
         default:
             break;
         }
@@ -150,6 +206,39 @@ char *)textbuf, size * 2);
 char *)textbuf, size * 2);
         }
         break;
+    case '2':
+        if(!bufsize)
+            SHA256Final(buffer, (SHA256_CTX*)context);
+        size = 32;
+        SHA256Init((SHA256_CTX*)context);
+        if(bin)
+            SHA256Update((SHA256_CTX*)context, (const unsigned char *)buffer, size);
+        else {
+            hexbuffer(textbuf, buffer, size);
+            SHA256Update((SHA256_CTX*)context, (const unsigned char *)textbuf, size * 2);
+        }
+        break;
+    case '3':
+    case '5':
+        if(*((char *)hashtype) == '3') {
+            if(!bufsize)
+                SHA384Final(buffer, (SHA512_CTX*)context);
+            size = 48;
+            SHA384Init((SHA512_CTX*)context);
+        }
+        else {
+            if(!bufsize)
+                SHA512Final(buffer, (SHA512_CTX*)context);
+            size = 64;
+            SHA512Init((SHA512_CTX*)context);
+        }
+        if(bin)
+            SHA512Update((SHA512_CTX*)context, (const unsigned char *)buffer, size);
+        else {
+            hexbuffer(textbuf, buffer, size);
+            SHA512Update((SHA512_CTX*)context, (const unsigned char *)textbuf, size * 2);
+        }
+        break;
     default:
         break;
     }
@@ -177,6 +266,21 @@ const unsigned char *Digest::get(void)
         release();
         bufsize = 20;
         break;
+    case '2':
+        SHA256Final(buffer, (SHA256_CTX*)context);
+        release();
+        bufsize = 32;
+        break;
+    case '3':
+        SHA384Final(buffer, (SHA512_CTX*)context);
+        release();
+        bufsize = 48;
+        break;
+    case '5':
+        SHA512Final(buffer, (SHA512_CTX*)context);
+        release();
+        bufsize = 64;
+        break;
     default:
         break;
     }
@@ -188,4 +292,56 @@ const unsigned char *Digest::get(void)
     return buffer;
 }
 
+unsigned Digest::hash(const char *type, unsigned count, const void *const *messages, const size_t *sizes, unsigned char *const *digests)
+{
+    unsigned pos;
+
+    if(eq_case(type, "sha256")) {
+        SHA256Lanes(count, (const uint8_t *const *)messages, sizes, digests);
+        return 32;
+    }
+
+    if(eq_case(type, "md5")) {
+        MD5_CTX ctx;
+        for(pos = 0; pos < count; ++pos) {
+            MD5Init(&ctx);
+            MD5Update(&ctx, (const unsigned char *)messages[pos], sizes[pos]);
+            MD5Final(digests[pos], &ctx);
+        }
+        return 16;
+    }
+
+    if(eq_case(type, "sha") || eq_case(type, "sha1") || eq_case(type, "sha160")) {
+        SHA1_CTX ctx;
+        for(pos = 0; pos < count; ++pos) {
+            SHA1Init(&ctx);
+            SHA1Update(&ctx, (const unsigned char *)messages[pos], sizes[pos]);
+            SHA1Final(digests[pos], &ctx);
+        }
+        return 20;
+    }
+
+    if(eq_case(type, "sha384")) {
+        SHA512_CTX ctx;
+        for(pos = 0; pos < count; ++pos) {
+            SHA384Init(&ctx);
+            SHA384Update(&ctx, (const unsigned char *)messages[pos], sizes[pos]);
+            SHA384Final(digests[pos], &ctx);
+        }
+        return 48;
+    }
+
+    if(eq_case(type, "sha512")) {
+        SHA512_CTX ctx;
+        for(pos = 0; pos < count; ++pos) {
+            SHA512Init(&ctx);
+            SHA512Update(&ctx, (const unsigned char *)messages[pos], sizes[pos]);
+            SHA512Final(digests[pos], &ctx);
+        }
+        return 64;
+    }
+
+    return 0;
+}
+
 } // namespace ucommon
@@ -21,6 +21,10 @@
 #include <fcntl.h>
 #endif
 
+#if defined(HAVE_GETRANDOM) && defined(HAVE_SYS_RANDOM_H)
+#include <sys/random.h>
+#endif
+
 namespace ucommon {
 
 void Random::seed(void)
@@ -55,39 +59,31 @@ size_t Random::key(unsigned char *buf, size_t size)
         return size;
     return 0;
 #else
-    int fd = open("/dev/random", O_RDONLY);
     ssize_t result = 0;
 
-    if(fd > -1) {
-        result = read(fd, buf, size);
-        close(fd);
+#if defined(HAVE_GETRANDOM) && defined(HAVE_SYS_RANDOM_H)
+    // one system call, and only blocks until the pool is initialized
+    while((size_t)result < size) {
+        ssize_t count = getrandom(buf + result, size - result, 0);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count < 1)
+            break;
+        result += count;
     }
 
-    if(result < 0)
-        result = 0;
+    if((size_t)result == size)
+        return size;
 
-    return (size_t)result;
+    result = 0;
 #endif
-}
 
-size_t Random::fill(unsigned char *buf, size_t size)
-{
-#ifdef  _MSWINDOWS_
-    return key(buf, size);
-#else
-    int fd = open("/dev/urandom", O_RDONLY);
-    ssize_t result = 0;
+    int fd = open("/dev/random", O_RDONLY);
 
     if(fd > -1) {
         result = read(fd, buf, size);
         close(fd);
     }
-    // ugly...would not trust it
-    else {
-        result = 0;
-        while(result++ < (ssize_t)size)
-            *(buf++) = rand() & 0xff;
-    }
 
     if(result < 0)
         result = 0;
@@ -0,0 +1,631 @@
+// Copyright (C) 2010-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+ * Test Vectors (from FIPS PUB 180-4 examples)
+ * "abc"
+ *   SHA-256 BA7816BF 8F01CFEA 414140DE 5DAE2223 B00361A3 96177A9C B410FF61 F20015AD
+ *   SHA-512 DDAF35A1 93617ABA CC417349 AE204131 12E6FA4E 89A97EA2 0A9EEEE6 4B55D39A
+ *           2192992A 274FC1A8 36BA3C23 A3FEEBBD 454D4423 643CE80E 2A9AC94F A54CA49F
+ */
+
+#include <ucommon/string.h>
+#include "sha2.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define SHA2_X86_KERNELS
+#include <immintrin.h>
+#endif
+#endif
+
+#include "../corelib/cpu.h"
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define CH(x, y, z)     (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)    (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define S256_0(x)   (ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define S256_1(x)   (ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define s256_0(x)   (ROR32(x, 7) ^ ROR32(x, 18) ^ ((x) >> 3))
+#define s256_1(x)   (ROR32(x, 17) ^ ROR32(x, 19) ^ ((x) >> 10))
+
+#define S512_0(x)   (ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define S512_1(x)   (ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+#define s512_0(x)   (ROR64(x, 1) ^ ROR64(x, 8) ^ ((x) >> 7))
+#define s512_1(x)   (ROR64(x, 19) ^ ROR64(x, 61) ^ ((x) >> 6))
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint64_t K512[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull
+};
+
+static const uint32_t H256[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint64_t H384[8] = {
+    0xcbbb9d5dc1059ed8ull, 0x629a292a367cd507ull, 0x9159015a3070dd17ull, 0x152fecd8f70e5939ull,
+    0x67332667ffc00b31ull, 0x8eb44a8768581511ull, 0xdb0c2e0d64f98fa7ull, 0x47b5481dbefa4fa4ull
+};
+
+static const uint64_t H512[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+    0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull
+};
+
+static inline uint32_t get32(const uint8_t *cp)
+{
+    return (((uint32_t)cp[0]) << 24) | (((uint32_t)cp[1]) << 16) |
+        (((uint32_t)cp[2]) << 8) | ((uint32_t)cp[3]);
+}
+
+static inline uint64_t get64(const uint8_t *cp)
+{
+    return (((uint64_t)get32(cp)) << 32) | (uint64_t)get32(cp + 4);
+}
+
+static inline void put32(uint8_t *cp, uint32_t value)
+{
+    cp[0] = (uint8_t)(value >> 24);
+    cp[1] = (uint8_t)(value >> 16);
+    cp[2] = (uint8_t)(value >> 8);
+    cp[3] = (uint8_t)value;
+}
+
+static inline void put64(uint8_t *cp, uint64_t value)
+{
+    put32(cp, (uint32_t)(value >> 32));
+    put32(cp + 4, (uint32_t)value);
+}
+
+/*
+ * Portable kernels, one or more consecutive blocks at a time.
+ */
+static void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    uint32_t W[64];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    unsigned t;
+
+    while(blocks--) {
+        for(t = 0; t < 16; ++t)
+            W[t] = get32(data + t * 4);
+        for(t = 16; t < 64; ++t)
+            W[t] = s256_1(W[t - 2]) + W[t - 7] + s256_0(W[t - 15]) + W[t - 16];
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+        for(t = 0; t < 64; ++t) {
+            t1 = h + S256_1(e) + CH(e, f, g) + K256[t] + W[t];
+            t2 = S256_0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += SHA256_BLOCK_LENGTH;
+    }
+    memset(W, 0, sizeof(W));
+}
+
+static void sha512_blocks(uint64_t state[8], const uint8_t *data, size_t blocks)
+{
+    uint64_t W[80];
+    uint64_t a, b, c, d, e, f, g, h, t1, t2;
+    unsigned t;
+
+    while(blocks--) {
+        for(t = 0; t < 16; ++t)
+            W[t] = get64(data + t * 8);
+        for(t = 16; t < 80; ++t)
+            W[t] = s512_1(W[t - 2]) + W[t - 7] + s512_0(W[t - 15]) + W[t - 16];
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+        for(t = 0; t < 80; ++t) {
+            t1 = h + S512_1(e) + CH(e, f, g) + K512[t] + W[t];
+            t2 = S512_0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += SHA512_BLOCK_LENGTH;
+    }
+    memset(W, 0, sizeof(W));
+}
+
+#ifdef SHA2_X86_KERNELS
+
+/*
+ * SHA-256 using the Intel SHA extensions.  State is kept as ABEF/CDGH
+ * pairs and the message schedule as a rolling set of four quads.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_shani(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+    __m128i msg[4], abef, cdgh, abef_save, cdgh_save, tmp;
+    unsigned quad;
+
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+    abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+    while(blocks--) {
+        abef_save = abef;
+        cdgh_save = cdgh;
+
+        for(quad = 0; quad < 4; ++quad)
+            msg[quad] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + quad * 16)), mask);
+
+        for(quad = 0; quad < 16; ++quad) {
+            tmp = _mm_add_epi32(msg[quad & 3], _mm_loadu_si128((const __m128i *)&K256[quad * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, tmp);
+            tmp = _mm_shuffle_epi32(tmp, 0x0e);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, tmp);
+            if(quad < 12) {
+                tmp = _mm_sha256msg1_epu32(msg[quad & 3], msg[(quad + 1) & 3]);
+                tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(msg[(quad + 3) & 3], msg[(quad + 2) & 3], 4));
+                msg[quad & 3] = _mm_sha256msg2_epu32(tmp, msg[(quad + 3) & 3]);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+        data += SHA256_BLOCK_LENGTH;
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1b);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+#define VROR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define VADD(x, y) _mm256_add_epi32(x, y)
+#define VXOR(x, y) _mm256_xor_si256(x, y)
+
+/*
+ * One block from each of eight independent messages.  The state is
+ * word major, state[word][lane], so lanes can be loaded and retired
+ * individually by the scheduler.
+ */
+__attribute__((target("avx2")))
+static void sha256_avx2x8(uint32_t state[8][8], const uint8_t *const blocks[8])
+{
+    const __m256i swap = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i W[16], r[8], t[8], u[8], v[8];
+    __m256i a, b, c, d, e, f, g, h, t1, t2;
+    unsigned half, pos;
+
+    // transpose the eight blocks so each vector holds one word per lane
+    for(half = 0; half < 2; ++half) {
+        for(pos = 0; pos < 8; ++pos)
+            r[pos] = _mm256_loadu_si256((const __m256i *)(blocks[pos] + half * 32));
+        for(pos = 0; pos < 8; pos += 2) {
+            t[pos] = _mm256_unpacklo_epi32(r[pos], r[pos + 1]);
+            t[pos + 1] = _mm256_unpackhi_epi32(r[pos], r[pos + 1]);
+        }
+        for(pos = 0; pos < 8; pos += 4) {
+            u[pos] = _mm256_unpacklo_epi64(t[pos], t[pos + 2]);
+            u[pos + 1] = _mm256_unpackhi_epi64(t[pos], t[pos + 2]);
+            u[pos + 2] = _mm256_unpacklo_epi64(t[pos + 1], t[pos + 3]);
+            u[pos + 3] = _mm256_unpackhi_epi64(t[pos + 1], t[pos + 3]);
+        }
+        for(pos = 0; pos < 4; ++pos) {
+            v[pos] = _mm256_permute2x128_si256(u[pos], u[pos + 4], 0x20);
+            v[pos + 4] = _mm256_permute2x128_si256(u[pos], u[pos + 4], 0x31);
+        }
+        for(pos = 0; pos < 8; ++pos)
+            W[half * 8 + pos] = _mm256_shuffle_epi8(v[pos], swap);
+    }
+
+    a = _mm256_loadu_si256((const __m256i *)state[0]);
+    b = _mm256_loadu_si256((const __m256i *)state[1]);
+    c = _mm256_loadu_si256((const __m256i *)state[2]);
+    d = _mm256_loadu_si256((const __m256i *)state[3]);
+    e = _mm256_loadu_si256((const __m256i *)state[4]);
+    f = _mm256_loadu_si256((const __m256i *)state[5]);
+    g = _mm256_loadu_si256((const __m256i *)state[6]);
+    h = _mm256_loadu_si256((const __m256i *)state[7]);
+
+    for(pos = 0; pos < 64; ++pos) {
+        if(pos >= 16) {
+            __m256i w2 = W[(pos - 2) & 15], w15 = W[(pos - 15) & 15];
+            __m256i s1 = VXOR(VXOR(VROR(w2, 17), VROR(w2, 19)), _mm256_srli_epi32(w2, 10));
+            __m256i s0 = VXOR(VXOR(VROR(w15, 7), VROR(w15, 18)), _mm256_srli_epi32(w15, 3));
+            W[pos & 15] = VADD(VADD(s1, W[(pos - 7) & 15]), VADD(s0, W[pos & 15]));
+        }
+        t1 = VADD(h, VXOR(VXOR(VROR(e, 6), VROR(e, 11)), VROR(e, 25)));
+        t1 = VADD(t1, VXOR(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)));
+        t1 = VADD(t1, VADD(_mm256_set1_epi32((int)K256[pos]), W[pos & 15]));
+        t2 = VXOR(VXOR(VROR(a, 2), VROR(a, 13)), VROR(a, 22));
+        t2 = VADD(t2, _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))));
+        h = g; g = f; f = e; e = VADD(d, t1);
+        d = c; c = b; b = a; a = VADD(t1, t2);
+    }
+
+    _mm256_storeu_si256((__m256i *)state[0], VADD(a, _mm256_loadu_si256((const __m256i *)state[0])));
+    _mm256_storeu_si256((__m256i *)state[1], VADD(b, _mm256_loadu_si256((const __m256i *)state[1])));
+    _mm256_storeu_si256((__m256i *)state[2], VADD(c, _mm256_loadu_si256((const __m256i *)state[2])));
+    _mm256_storeu_si256((__m256i *)state[3], VADD(d, _mm256_loadu_si256((const __m256i *)state[3])));
+    _mm256_storeu_si256((__m256i *)state[4], VADD(e, _mm256_loadu_si256((const __m256i *)state[4])));
+    _mm256_storeu_si256((__m256i *)state[5], VADD(f, _mm256_loadu_si256((const __m256i *)state[5])));
+    _mm256_storeu_si256((__m256i *)state[6], VADD(g, _mm256_loadu_si256((const __m256i *)state[6])));
+    _mm256_storeu_si256((__m256i *)state[7], VADD(h, _mm256_loadu_si256((const __m256i *)state[7])));
+}
+
+#undef VROR
+#undef VADD
+#undef VXOR
+
+#endif
+
+/*
+ * Kernel selection, done once on first use.
+ */
+#define ENGINE_UNKNOWN  0
+#define ENGINE_PORTABLE 1
+#define ENGINE_SHANI    2
+
+static volatile int sha256_engine = ENGINE_UNKNOWN;
+static volatile bool sha256_lanes = false;
+
+static void select_engine(void)
+{
+    int engine = ENGINE_PORTABLE;
+    bool lanes = false;
+
+#ifdef SHA2_X86_KERNELS
+    unsigned features = ucommon::cpu_features();
+    unsigned shani = CPU_SHA | CPU_SSE41 | CPU_SSSE3;
+
+    if((features & shani) == shani)
+        engine = ENGINE_SHANI;
+    if(features & CPU_AVX2)
+        lanes = true;
+#endif
+
+    sha256_lanes = lanes;
+    sha256_engine = engine;
+}
+
+static inline void sha256_transform(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+    if(sha256_engine == ENGINE_UNKNOWN)
+        select_engine();
+
+#ifdef SHA2_X86_KERNELS
+    if(sha256_engine == ENGINE_SHANI) {
+        sha256_shani(state, data, blocks);
+        return;
+    }
+#endif
+    sha256_blocks(state, data, blocks);
+}
+
+const char *SHA256Engine(void)
+{
+    if(sha256_engine == ENGINE_UNKNOWN)
+        select_engine();
+
+    if(sha256_engine == ENGINE_SHANI)
+        return sha256_lanes ? "sha-ni, avx2 x8 lanes" : "sha-ni";
+    return sha256_lanes ? "portable, avx2 x8 lanes" : "portable";
+}
+
+void SHA256Init(SHA256_CTX *context)
+{
+    memcpy(context->state, H256, sizeof(H256));
+    context->count = 0;
+}
+
+void SHA256Update(SHA256_CTX *context, const uint8_t *data, size_t len)
+{
+    size_t used = (size_t)(context->count & 63);
+    size_t blocks;
+
+    context->count += len;
+    if(used) {
+        size_t fill = SHA256_BLOCK_LENGTH - used;
+        if(len < fill) {
+            memcpy(context->buffer + used, data, len);
+            return;
+        }
+        memcpy(context->buffer + used, data, fill);
+        sha256_transform(context->state, context->buffer, 1);
+        data += fill;
+        len -= fill;
+    }
+
+    blocks = len / SHA256_BLOCK_LENGTH;
+    if(blocks) {
+        sha256_transform(context->state, data, blocks);
+        data += blocks * SHA256_BLOCK_LENGTH;
+        len -= blocks * SHA256_BLOCK_LENGTH;
+    }
+
+    if(len)
+        memcpy(context->buffer, data, len);
+}
+
+void SHA256Final(uint8_t digest[SHA256_DIGEST_LENGTH], SHA256_CTX *context)
+{
+    uint8_t pad[SHA256_BLOCK_LENGTH * 2];
+    size_t used = (size_t)(context->count & 63);
+    size_t padlen = (used < 56) ? 56 - used : 120 - used;
+    uint64_t bits = context->count << 3;
+    unsigned pos;
+
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    put64(pad + padlen, bits);
+    SHA256Update(context, pad, padlen + 8);
+
+    if(digest) {
+        for(pos = 0; pos < 8; ++pos)
+            put32(digest + pos * 4, context->state[pos]);
+    }
+    memset(context, 0, sizeof(*context));
+}
+
+void SHA512Init(SHA512_CTX *context)
+{
+    memcpy(context->state, H512, sizeof(H512));
+    context->count[0] = context->count[1] = 0;
+}
+
+void SHA384Init(SHA512_CTX *context)
+{
+    memcpy(context->state, H384, sizeof(H384));
+    context->count[0] = context->count[1] = 0;
+}
+
+void SHA512Update(SHA512_CTX *context, const uint8_t *data, size_t len)
+{
+    size_t used = (size_t)(context->count[0] & 127);
+    size_t blocks;
+
+    context->count[0] += len;
+    if(context->count[0] < (uint64_t)len)
+        ++context->count[1];
+
+    if(used) {
+        size_t fill = SHA512_BLOCK_LENGTH - used;
+        if(len < fill) {
+            memcpy(context->buffer + used, data, len);
+            return;
+        }
+        memcpy(context->buffer + used, data, fill);
+        sha512_blocks(context->state, context->buffer, 1);
+        data += fill;
+        len -= fill;
+    }
+
+    blocks = len / SHA512_BLOCK_LENGTH;
+    if(blocks) {
+        sha512_blocks(context->state, data, blocks);
+        data += blocks * SHA512_BLOCK_LENGTH;
+        len -= blocks * SHA512_BLOCK_LENGTH;
+    }
+
+    if(len)
+        memcpy(context->buffer, data, len);
+}
+
+static void sha512_final(uint8_t *digest, unsigned size, SHA512_CTX *context)
+{
+    uint8_t pad[SHA512_BLOCK_LENGTH * 2];
+    size_t used = (size_t)(context->count[0] & 127);
+    size_t padlen = (used < 112) ? 112 - used : 240 - used;
+    uint64_t high = (context->count[1] << 3) | (context->count[0] >> 61);
+    uint64_t low = context->count[0] << 3;
+    unsigned pos;
+
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    put64(pad + padlen, high);
+    put64(pad + padlen + 8, low);
+    SHA512Update(context, pad, padlen + 16);
+
+    if(digest) {
+        for(pos = 0; pos < size / 8; ++pos)
+            put64(digest + pos * 8, context->state[pos]);
+    }
+    memset(context, 0, sizeof(*context));
+}
+
+void SHA512Final(uint8_t digest[SHA512_DIGEST_LENGTH], SHA512_CTX *context)
+{
+    sha512_final(digest, SHA512_DIGEST_LENGTH, context);
+}
+
+void SHA384Final(uint8_t digest[SHA384_DIGEST_LENGTH], SHA512_CTX *context)
+{
+    sha512_final(digest, SHA384_DIGEST_LENGTH, context);
+}
+
+static void sha256_single(const uint8_t *data, size_t size, uint8_t *digest)
+{
+    SHA256_CTX ctx;
+
+    SHA256Init(&ctx);
+    SHA256Update(&ctx, data, size);
+    SHA256Final(digest, &ctx);
+}
+
+#ifdef SHA2_X86_KERNELS
+
+/*
+ * A lane walks one message a block at a time.  Whole blocks come
+ * straight from the message, and the last one or two padded blocks
+ * from the lane's own tail buffer.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t blocks;
+    size_t next;
+    unsigned tails;
+    unsigned id;
+    bool busy;
+    uint8_t tail[SHA256_BLOCK_LENGTH * 2];
+} sha256_lane;
+
+static void lane_load(sha256_lane *lane, unsigned id, const uint8_t *data, size_t size)
+{
+    size_t whole = size / SHA256_BLOCK_LENGTH;
+    size_t rest = size - whole * SHA256_BLOCK_LENGTH;
+
+    lane->data = data;
+    lane->next = 0;
+    lane->id = id;
+    lane->busy = true;
+    lane->tails = (rest < 56) ? 1 : 2;
+    lane->blocks = whole + lane->tails;
+
+    memset(lane->tail, 0, sizeof(lane->tail));
+    if(rest)
+        memcpy(lane->tail, data + whole * SHA256_BLOCK_LENGTH, rest);
+    lane->tail[rest] = 0x80;
+    put64(lane->tail + lane->tails * SHA256_BLOCK_LENGTH - 8, ((uint64_t)size) << 3);
+}
+
+static inline const uint8_t *lane_block(sha256_lane *lane)
+{
+    size_t whole = lane->blocks - lane->tails;
+
+    if(lane->next < whole)
+        return lane->data + lane->next * SHA256_BLOCK_LENGTH;
+    return lane->tail + (lane->next - whole) * SHA256_BLOCK_LENGTH;
+}
+
+#endif
+
+void SHA256Lanes(unsigned count, const uint8_t *const *data, const size_t *sizes, uint8_t *const *digests)
+{
+    unsigned pos;
+
+    if(sha256_engine == ENGINE_UNKNOWN)
+        select_engine();
+
+#ifdef SHA2_X86_KERNELS
+    // sha-ni hashes a single stream faster than eight avx2 lanes, and
+    // lanes only pay when there is enough to fill them
+    if(sha256_lanes && sha256_engine != ENGINE_SHANI && count > 2) {
+        static const uint8_t idle[SHA256_BLOCK_LENGTH] = {0};
+        sha256_lane lanes[8];
+        uint32_t state[8][8];
+        const uint8_t *blocks[8];
+        unsigned next = 0, busy = 0, lane, word;
+
+        for(lane = 0; lane < 8; ++lane) {
+            lanes[lane].busy = false;
+            if(next < count) {
+                lane_load(&lanes[lane], next, data[next], sizes[next]);
+                for(word = 0; word < 8; ++word)
+                    state[word][lane] = H256[word];
+                ++next;
+                ++busy;
+            }
+            else {
+                for(word = 0; word < 8; ++word)
+                    state[word][lane] = 0;
+            }
+        }
+
+        while(busy) {
+            for(lane = 0; lane < 8; ++lane)
+                blocks[lane] = lanes[lane].busy ? lane_block(&lanes[lane]) : idle;
+
+            sha256_avx2x8(state, blocks);
+
+            for(lane = 0; lane < 8; ++lane) {
+                if(!lanes[lane].busy || ++lanes[lane].next < lanes[lane].blocks)
+                    continue;
+
+                for(word = 0; word < 8; ++word)
+                    put32(digests[lanes[lane].id] + word * 4, state[word][lane]);
+
+                lanes[lane].busy = false;
+                --busy;
+                if(next < count) {
+                    lane_load(&lanes[lane], next, data[next], sizes[next]);
+                    for(word = 0; word < 8; ++word)
+                        state[word][lane] = H256[word];
+                    ++next;
+                    ++busy;
+                }
+            }
+        }
+        memset(state, 0, sizeof(state));
+        memset(lanes, 0, sizeof(lanes));
+        return;
+    }
+#endif
+
+    for(pos = 0; pos < count; ++pos)
+        sha256_single(data[pos], sizes[pos], digests[pos]);
+}
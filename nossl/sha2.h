@@ -0,0 +1,70 @@
+// Copyright (C) 2010-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+/*
+ * SHA-256, SHA-384 and SHA-512 as specified in FIPS 180-4, in the same
+ * style as the md5 and sha1 code.  SHA-256 has SHA-NI and multi-buffer
+ * AVX2 kernels that are selected at runtime on x86.
+ */
+
+#ifndef _SHA2_H
+#define _SHA2_H
+
+#define SHA256_BLOCK_LENGTH     64
+#define SHA256_DIGEST_LENGTH    32
+#define SHA384_DIGEST_LENGTH    48
+#define SHA512_BLOCK_LENGTH     128
+#define SHA512_DIGEST_LENGTH    64
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t count;
+    uint8_t buffer[SHA256_BLOCK_LENGTH];
+} SHA256_CTX;
+
+typedef struct {
+    uint64_t state[8];
+    uint64_t count[2];
+    uint8_t buffer[SHA512_BLOCK_LENGTH];
+} SHA512_CTX;
+
+void SHA256Init(SHA256_CTX *);
+void SHA256Update(SHA256_CTX *, const uint8_t *, size_t);
+void SHA256Final(uint8_t [SHA256_DIGEST_LENGTH], SHA256_CTX *);
+
+void SHA384Init(SHA512_CTX *);
+void SHA384Final(uint8_t [SHA384_DIGEST_LENGTH], SHA512_CTX *);
+
+void SHA512Init(SHA512_CTX *);
+void SHA512Update(SHA512_CTX *, const uint8_t *, size_t);
+void SHA512Final(uint8_t [SHA512_DIGEST_LENGTH], SHA512_CTX *);
+
+#define SHA384Update SHA512Update
+
+/*
+ * Digest count independent messages, running up to eight of them at a
+ * time in parallel lanes when the cpu can.  Each digest receives
+ * SHA256_DIGEST_LENGTH bytes.
+ */
+void SHA256Lanes(unsigned count, const uint8_t *const *data, const size_t *sizes, uint8_t *const *digests);
+
+/*
+ * Name of the SHA-256 kernel in use, for reporting.
+ */
+const char *SHA256Engine(void);
+
+#endif /* _SHA2_H */
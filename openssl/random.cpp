@@ -42,15 +42,6 @@ size_t Random::key(unsigned char *buf, size_t size)
     return 0;
 }
 
-size_t Random::fill(unsigned char *buf, size_t size)
-{
-    secure::init();
-
-    if(RAND_pseudo_bytes(buf, size))
-        return size;
-    return 0;
-}
-
 bool Random::status(void)
 {
     if(RAND_status())
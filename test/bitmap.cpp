@@ -0,0 +1,186 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon-config.h>
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace ucommon;
+
+#define BITS    1000
+#define SLOTS   131072
+
+static bool model[BITS];
+static bool other[BITS];
+
+static void check(bitmap& map)
+{
+    size_t count = 0;
+
+    for(size_t pos = 0; pos < BITS; ++pos) {
+        assert(map.get(pos) == model[pos]);
+        if(model[pos])
+            ++count;
+    }
+    assert(map.count() == count);
+
+    for(size_t pos = 0; pos < BITS; pos += 37) {
+        size_t set = pos, clear = pos;
+        while(set < BITS && !model[set])
+            ++set;
+        while(clear < BITS && model[clear])
+            ++clear;
+        assert(map.scan(pos) == (set < BITS ? set : bitmap::npos));
+        assert(map.scan(pos, false) == (clear < BITS ? clear : bitmap::npos));
+    }
+}
+
+static void exercise(bitmap& map, bitmap& with)
+{
+    memset(model, 0, sizeof(model));
+    memset(other, 0, sizeof(other));
+    map.clear();
+    with.clear();
+    check(map);
+    assert(map.scan() == bitmap::npos);
+    assert(map.scan(0, false) == 0);
+
+    for(unsigned pass = 0; pass < 200; ++pass) {
+        size_t pos = rand() % BITS;
+        size_t count = rand() % 300;
+        bool value = (rand() & 1) != 0;
+
+        map.set(pos, count, value);
+        for(size_t bit = pos; bit < pos + count && bit < BITS; ++bit)
+            model[bit] = value;
+
+        pos = rand() % BITS;
+        map.set(pos, !model[pos]);
+        model[pos] = !model[pos];
+
+        pos = rand() % BITS;
+        with.set(pos, true);
+        other[pos] = pos < with.length();
+    }
+    check(map);
+
+    map ^= with;
+    for(size_t pos = 0; pos < BITS; ++pos)
+        model[pos] = model[pos] != other[pos];
+    check(map);
+
+    map |= with;
+    for(size_t pos = 0; pos < BITS; ++pos)
+        model[pos] = model[pos] || other[pos];
+    check(map);
+
+    map.set(0, BITS, true);
+    for(size_t pos = 0; pos < BITS; ++pos)
+        model[pos] = true;
+    check(map);
+    assert(map.scan(0, false) == bitmap::npos);
+
+    map &= with;
+    for(size_t pos = 0; pos < BITS; ++pos)
+        model[pos] = other[pos];
+    check(map);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t words[2][(BITS + 63) / 64 + 1];
+    bitmap::bus_t buses[] = {bitmap::B8, bitmap::B16, bitmap::B32, bitmap::B64};
+
+    bitmap local(BITS);
+    bitmap shadow(BITS);
+    exercise(local, shadow);
+
+    for(unsigned bus = 0; bus < 4; ++bus) {
+        memset(words, 0xa5, sizeof(words));
+        bitmap device(words[0], BITS, buses[bus]);
+        bitmap mixed(words[1], BITS - 100, buses[3 - bus]);
+        exercise(device, mixed);
+        exercise(device, local);
+
+        // memory past the end of a device map must be left alone
+        assert(words[0][(BITS + 63) / 64] == 0xa5a5a5a5a5a5a5a5ull);
+    }
+
+    // allocator style use of a large map: keep it nearly full and
+    // release and find free slots...
+    bitmap slots(SLOTS);
+    size_t hint = 0, found;
+    unsigned long count = 0;
+
+    slots.set(0, SLOTS - SLOTS / 64, true);
+    Timer::tick_t start = Timer::ticks();
+    while(Timer::ticks() - start < 5000000) {
+        for(unsigned pass = 0; pass < 1000; ++pass) {
+            found = (size_t)rand() % SLOTS;
+            if(!slots.get(found))
+                continue;
+            slots.set(found, false);
+            found = slots.scan(hint, false);
+            if(found == bitmap::npos)
+                found = slots.scan(0, false);
+            assert(found != bitmap::npos);
+            slots.set(found, true);
+            hint = found;
+            ++count;
+        }
+    }
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    printf("%lu allocations/sec with scan\n", (unsigned long)(count * 10000000ull / elapsed));
+
+    count = 0;
+    start = Timer::ticks();
+    while(Timer::ticks() - start < 5000000) {
+        for(unsigned pass = 0; pass < 100; ++pass) {
+            found = (size_t)rand() % SLOTS;
+            if(!slots.get(found))
+                continue;
+            slots.set(found, false);
+            found = hint;
+            while(found < SLOTS && slots.get(found))
+                ++found;
+            if(found >= SLOTS) {
+                found = 0;
+                while(slots.get(found))
+                    ++found;
+            }
+            slots.set(found, true);
+            hint = found;
+            ++count;
+        }
+    }
+    elapsed = Timer::ticks() - start;
+    printf("%lu allocations/sec with get\n", (unsigned long)(count * 10000000ull / elapsed));
+
+    start = Timer::ticks();
+    for(unsigned pass = 0; pass < 1000; ++pass)
+        assert(slots.count() > 0);
+    elapsed = Timer::ticks() - start;
+    printf("%lu bits counted/usec\n", (unsigned long)(1000ull * SLOTS * 10 / (elapsed ? elapsed : 1)));
+
+    return 0;
+}
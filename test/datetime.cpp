@@ -45,6 +45,7 @@ int main(int argc, char **argv)
     exp_dt.tm_year = exp_year - 1900;
     exp_dt.tm_mon = exp_month - 1;
     exp_dt.tm_mday = exp_day;
+    exp_dt.tm_isdst = -1;
     exp_ctime = mktime(&exp_dt);
 
     assert(exp_year == date.year());
@@ -97,6 +98,55 @@ int main(int argc, char **argv)
     tmp += 5;   // add 5 seconds to force rollover...
     assert((long)tmp == 20030301l);
 
+    // cached conversions must match the C library...
+    time_t base = DateTime::now();
+    for(time_t when = base - 3600; when < base + 3600; when += 7) {
+        tm_t cached, libc;
+        assert(DateTime::local(&when, &cached) != NULL);
+        localtime_r(&when, &libc);
+        assert(cached.tm_year == libc.tm_year);
+        assert(cached.tm_yday == libc.tm_yday);
+        assert(cached.tm_mday == libc.tm_mday);
+        assert(cached.tm_hour == libc.tm_hour);
+        assert(cached.tm_min == libc.tm_min);
+        assert(cached.tm_sec == libc.tm_sec);
+        assert(cached.tm_wday == libc.tm_wday);
+
+        DateTime stamp(when);
+        assert(stamp.get() == when);
+        assert(Date(when).timeref() == when - Time(when).get());
+    }
+    assert(DateTime::offset(&base) == DateTime::offset());
+    assert(DateTime::now() - time(NULL) <= 1);
+
+    // timestamps per second...
+    Timer::tick_t start = Timer::ticks();
+    unsigned long count = 0;
+    while(Timer::ticks() - start < 5000000) {
+        for(unsigned pass = 0; pass < 1000; ++pass) {
+            DateTime stamp;
+            assert(is(stamp));
+        }
+        count += 1000;
+    }
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    printf("%lu timestamps/sec\n", (unsigned long)(count * 10000000ull / elapsed));
+
+    start = Timer::ticks();
+    count = 0;
+    while(Timer::ticks() - start < 5000000) {
+        for(unsigned pass = 0; pass < 1000; ++pass) {
+            time_t now = time(NULL);
+            tm_t *dt = new tm_t;
+            localtime_r(&now, dt);
+            DateTime stamp(dt);
+            delete dt;
+        }
+        count += 1000;
+    }
+    elapsed = Timer::ticks() - start;
+    printf("%lu localtime_r/sec\n", (unsigned long)(count * 10000000ull / elapsed));
+
     return 0;
 }
 
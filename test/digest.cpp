@@ -26,6 +26,58 @@
 
 using namespace ucommon;
 
+static const char *algorithms[] = {"md5", "sha1", "sha256", "sha512", NULL};
+
+static double rate(size_t bytes, Timer::tick_t start)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return ((double)bytes / 1048576.0) / ((double)elapsed / 10000000.0);
+}
+
+static void throughput(void)
+{
+    static unsigned char block[65536];
+    unsigned char *records = new unsigned char[256 * 4096];
+    unsigned char *results = new unsigned char[64 * 4096];
+    const void *messages[4096];
+    unsigned char *digests[4096];
+    size_t sizes[4096];
+    unsigned pos, lanes, pass;
+
+    memset(block, 'x', sizeof(block));
+    for(pos = 0; pos < 4096; ++pos) {
+        messages[pos] = records + pos * 256;
+        digests[pos] = results + pos * 64;
+        sizes[pos] = 256;
+    }
+    memset(records, 'r', 256 * 4096);
+
+    for(pos = 0; algorithms[pos]; ++pos) {
+        if(!Digest::has(algorithms[pos]))
+            continue;
+
+        digest_t digest = algorithms[pos];
+        Timer::tick_t start = Timer::ticks();
+        for(pass = 0; pass < 256; ++pass)
+            digest.put(block, sizeof(block));
+        digest.get();
+        printf("%-8s stream %8.1f MB/s\n", algorithms[pos], rate(sizeof(block) * 256, start));
+
+        // 256 byte records handed over a batch at a time
+        for(lanes = 1; lanes <= 16; lanes *= 2) {
+            start = Timer::ticks();
+            for(pass = 0; pass < 4096; pass += lanes)
+                Digest::hash(algorithms[pos], lanes, messages + pass, sizes + pass, digests + pass);
+            printf("%-8s %2u lane %8.1f MB/s\n", algorithms[pos], lanes, rate(256 * 4096, start));
+        }
+    }
+
+    delete[] records;
+    delete[] results;
+}
+
 int main(int argc, char **argv)
 {
     digest_t md5 = "md5";
@@ -41,6 +93,50 @@ int main(int argc, char **argv)
     md5.puts("this is some text");
     assert(eq("684d9d89b9de8178dcd80b7b4d018103", *md5));
 
+    assert(Digest::has("sha256"));
+    md5 = "sha256";
+    md5.puts("abc");
+    assert(eq("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", *md5));
+
+    assert(Digest::has("sha512"));
+    md5 = "sha512";
+    md5.puts("abc");
+    assert(eq("ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+        "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f", *md5));
+
+    // batches must agree with one digest per message, for every length
+    // around the padding boundaries
+    unsigned char data[300], results[40][64];
+    const void *messages[40];
+    unsigned char *digests[40];
+    size_t sizes[40];
+    unsigned pos, alg;
+
+    for(pos = 0; pos < sizeof(data); ++pos)
+        data[pos] = (unsigned char)(pos * 7);
+    for(pos = 0; pos < 40; ++pos) {
+        messages[pos] = data + pos;
+        sizes[pos] = (pos * 37) % 260;
+        digests[pos] = results[pos];
+    }
+    sizes[3] = 0;
+    sizes[5] = 55;
+    sizes[6] = 56;
+    sizes[7] = 64;
+
+    for(alg = 0; algorithms[alg]; ++alg) {
+        unsigned size = Digest::hash(algorithms[alg], 40, messages, sizes, digests);
+        assert(size > 0);
+        for(pos = 0; pos < 40; ++pos) {
+            digest_t digest = algorithms[alg];
+            digest.put(messages[pos], sizes[pos]);
+            assert(digest.get() != NULL);
+            assert(digest.size() == size);
+            assert(!memcmp(digest.get(), results[pos], size));
+        }
+    }
+
+    throughput();
     return 0;
 }
 
@@ -0,0 +1,251 @@
+// Copyright (C) 2010-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+
+using namespace ucommon;
+
+#define TASKS   200000
+
+static volatile unsigned ran = 0, callbacks = 0;
+
+class counting : public ExecutorTask
+{
+public:
+    counting(bool release = false) : ExecutorTask(release) {}
+
+    void run(void) {
+        __sync_add_and_fetch(&ran, 1);
+    }
+
+    void completed(void) {
+        __sync_add_and_fetch(&callbacks, 1);
+    }
+};
+
+class summing : public Executor::range
+{
+public:
+    unsigned char *marks;
+    volatile unsigned long total;
+
+    void run(size_t first, size_t last) {
+        unsigned long sum = 0;
+        while(first < last) {
+            ++marks[first];
+            sum += first++;
+        }
+        __sync_add_and_fetch(&total, sum);
+    }
+};
+
+// a task that fans out children on its own worker and waits on them
+class fanning : public ExecutorTask
+{
+public:
+    Executor *pool;
+
+    void run(void) {
+        counting children[16];
+        for(unsigned pos = 0; pos < 16; ++pos)
+            pool->submit(&children[pos]);
+        for(unsigned pos = 0; pos < 16; ++pos)
+            assert(children[pos].wait());
+    }
+};
+
+class stamping : public ExecutorTask
+{
+public:
+    Timer::tick_t when;
+
+    void run(void) {
+        when = Timer::ticks();
+    }
+};
+
+// a task that keeps every worker busy by submitting itself again
+static volatile bool saturate = false;
+
+class spinning : public ExecutorTask
+{
+public:
+    Executor *pool;
+
+    spinning(Executor *executor) : ExecutorTask(true) {pool = executor;}
+
+    void run(void) {
+        Timer::tick_t until = Timer::ticks() + 2000;
+        while(Timer::ticks() < until)
+            ;
+        if(saturate) {
+            spinning *next = new spinning(pool);
+            pool->submit(next);
+        }
+    }
+};
+
+// the hand rolled pattern the executor replaces
+class message : public CountedObject
+{
+public:
+    bool last;
+
+    message(bool stop = false) : CountedObject() {last = stop;}
+};
+
+static Queue messages;
+
+class consumer : public JoinableThread
+{
+public:
+    consumer() : JoinableThread() {}
+
+    ~consumer() {join();}
+
+    void run(void) {
+        for(;;) {
+            message *msg = static_cast<message *>(messages.fifo(Timer::inf));
+            bool last = msg->last;
+            if(!last)
+                __sync_add_and_fetch(&ran, 1);
+            msg->release();
+            if(last)
+                break;
+        }
+    }
+};
+
+static unsigned long rate(unsigned long count, Timer::tick_t start)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return (unsigned long)(count * 10000000ull / elapsed);
+}
+
+extern "C" int main()
+{
+    Executor pool(4);
+    assert(pool.size() == 4);
+    assert(Executor::cpus() >= 1);
+
+    // futures and completion callbacks
+    counting tasks[64];
+    for(unsigned pos = 0; pos < 64; ++pos)
+        pool.submit(&tasks[pos]);
+    for(unsigned pos = 0; pos < 64; ++pos) {
+        assert(tasks[pos].wait());
+        assert(tasks[pos].is_done());
+    }
+    assert(ran == 64 && callbacks == 64);
+
+    // resubmitting a completed task
+    pool.submit(&tasks[0]);
+    assert(tasks[0].wait(1000));
+    assert(ran == 65);
+
+    // nested submission waits by helping
+    fanning fan;
+    fan.pool = &pool;
+    pool.submit(&fan);
+    assert(fan.wait());
+    assert(ran == 65 + 16);
+
+    // ranges split over workers cover every index once
+    summing sum;
+    sum.marks = new unsigned char[100000];
+    memset(sum.marks, 0, 100000);
+    sum.total = 0;
+    pool.parallel(sum, 0, 100000, 64);
+    assert(sum.total == 100000ul * 99999ul / 2);
+    for(unsigned pos = 0; pos < 100000; ++pos)
+        assert(sum.marks[pos] == 1);
+    delete[] sum.marks;
+
+    // delayed tasks start after their delay
+    stamping stamp;
+    Timer::tick_t start = Timer::ticks();
+    pool.schedule(&stamp, 50);
+    assert(stamp.is_pending());
+    assert(!stamp.wait(10));
+    assert(stamp.wait());
+    assert(stamp.when - start >= 450000);
+
+    // and while no worker is ever idle
+    saturate = true;
+    for(unsigned pos = 0; pos < 16; ++pos)
+        pool.submit(new spinning(&pool));
+    Thread::sleep(20);
+    start = Timer::ticks();
+    pool.schedule(&stamp, 50);
+    assert(stamp.wait(5000));
+    assert(stamp.when - start >= 450000);
+    saturate = false;
+    assert(pool.wait());
+
+    // fine grained tasks through the executor
+    ran = 0;
+    start = Timer::ticks();
+    for(unsigned pos = 0; pos < TASKS; ++pos)
+        pool.submit(new counting(true));
+    assert(pool.wait());
+    assert(ran == TASKS);
+    unsigned long submitted = rate(TASKS, start);
+
+    summing spread;
+    spread.marks = new unsigned char[TASKS];
+    memset(spread.marks, 0, TASKS);
+    spread.total = 0;
+    start = Timer::ticks();
+    pool.parallel(spread, 0, TASKS, 1);
+    unsigned long split = rate(TASKS, start);
+    assert(spread.total == (unsigned long)TASKS * (TASKS - 1) / 2);
+    delete[] spread.marks;
+
+    // and through consumer threads on a locked queue
+    consumer *consumers[4];
+    ran = 0;
+    start = Timer::ticks();
+    for(unsigned pos = 0; pos < 4; ++pos) {
+        consumers[pos] = new consumer();
+        consumers[pos]->start();
+    }
+    for(unsigned pos = 0; pos < TASKS; ++pos)
+        messages.post(new message());
+    for(unsigned pos = 0; pos < 4; ++pos)
+        messages.post(new message(true));
+    for(unsigned pos = 0; pos < 4; ++pos)
+        delete consumers[pos];
+    assert(ran == TASKS);
+    unsigned long queued = rate(TASKS, start);
+
+    printf("%lu submitted, %lu split, %lu queued tasks/sec\n", submitted, split, queued);
+
+    // workers placed by numa node
+    Executor placed(2, Executor::NODES);
+    counting local;
+    placed.submit(&local);
+    assert(local.wait());
+    return 0;
+}
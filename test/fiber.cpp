@@ -0,0 +1,170 @@
+// Copyright (C) 2010-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+using namespace ucommon;
+
+static FiberScheduler *scheduler;
+static volatile unsigned connected = 0, echoed = 0, failed = 0;
+static volatile bool closing = false;
+static char port[16];
+
+class sleeper : public Fiber
+{
+public:
+    Timer::tick_t slept;
+
+    sleeper() : Fiber() {}
+
+    void exit(void) {}
+
+    void run(void) {
+        Timer::tick_t start = Timer::ticks();
+        Fiber::yield();
+        Fiber::sleep(20);
+        slept = Timer::ticks() - start;
+        assert(Fiber::get() == this);
+    }
+};
+
+// blocking style session code, unchanged from a thread per connection
+class session : public Fiber
+{
+public:
+    Socket remote;
+
+    session(socket_t so) : Fiber(), remote(so) {}
+
+    void run(void) {
+        char buf[64];
+        while(remote.readline(buf, sizeof(buf)) > 0)
+            remote.printf("%s\n", buf);
+    }
+};
+
+class listener : public Fiber
+{
+public:
+    socket_t so;
+    unsigned count;
+
+    listener(socket_t s, unsigned n) : Fiber() {so = s; count = n;}
+
+    void run(void) {
+        while(count--) {
+            socket_t client = Socket::acceptfrom(so);
+            if(client == INVALID_SOCKET)
+                break;
+            (new session(client))->start(scheduler);
+        }
+    }
+};
+
+class client : public Fiber
+{
+public:
+    client() : Fiber() {}
+
+    void run(void) {
+        char buf[64];
+        Socket::address addr("127.0.0.1", port);
+        Socket sock(AF_INET, SOCK_STREAM);
+
+        if(sock.connectto(addr.getList())) {
+            __sync_add_and_fetch(&failed, 1);
+            return;
+        }
+        __sync_add_and_fetch(&connected, 1);
+        sock.writes("hello\n");
+        if(sock.readline(buf, sizeof(buf)) == 6 && eq(buf, "hello"))
+            __sync_add_and_fetch(&echoed, 1);
+
+        // hold the session open until every client has connected
+        while(!closing)
+            Fiber::sleep(5);
+    }
+};
+
+static size_t resident(void)
+{
+    unsigned long pages = 0, size = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if(!fp)
+        return 0;
+    if(fscanf(fp, "%lu %lu", &size, &pages) != 2)
+        pages = 0;
+    fclose(fp);
+    return (size_t)pages * 4096;
+}
+
+extern "C" int main()
+{
+    struct sockaddr_storage local;
+    socklen_t len = sizeof(local);
+    struct rlimit files;
+    unsigned sessions = 1000;
+    FiberScheduler fibers(2);
+
+    scheduler = &fibers;
+    assert(fibers.size() == 2);
+
+    // fibers park and resume in order with their own stacks
+    sleeper nap;
+    nap.start(scheduler);
+    assert(scheduler->wait(1000));
+    assert(nap.slept >= 190000);
+
+    if(!getrlimit(RLIMIT_NOFILE, &files) && files.rlim_cur < sessions * 2 + 64)
+        sessions = (unsigned)(files.rlim_cur - 64) / 2;
+
+    socket_t so = ListenSocket::create("127.0.0.1", "0", 1024, AF_INET);
+    assert(so != INVALID_SOCKET);
+    assert(!getsockname(so, (struct sockaddr *)&local, &len));
+    snprintf(port, sizeof(port), "%u", ntohs(((struct sockaddr_in *)&local)->sin_port));
+
+    size_t before = resident();
+    Timer::tick_t start = Timer::ticks();
+    (new listener(so, sessions))->start(scheduler);
+    for(unsigned pos = 0; pos < sessions; ++pos)
+        (new client())->start(scheduler);
+
+    while(connected + failed < sessions || echoed < connected)
+        Thread::sleep(10);
+
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    size_t used = resident() - before;
+    unsigned active = fibers.active();
+    size_t mapped = fibers.mapped();
+    closing = true;
+    assert(fibers.wait(10000));
+    Socket::release(so);
+
+    assert(failed == 0);
+    assert(echoed == sessions);
+    printf("%u sessions in %lu ms with %u fibers, %lu kb stacks mapped, %lu kb resident\n",
+        sessions, (unsigned long)(elapsed / 10000), active,
+        (unsigned long)(mapped / 1024), (unsigned long)(used / 1024));
+    return 0;
+}
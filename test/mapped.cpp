@@ -0,0 +1,246 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#ifndef _MSWINDOWS_
+#include <sys/wait.h>
+#endif
+
+#include <stdio.h>
+
+using namespace ucommon;
+
+typedef struct {
+    unsigned long sequence;
+    unsigned long values[15];
+} channel_t;
+
+#define CHANNELS    64
+#define UPDATES     2000000ul
+
+static bool consistent(const channel_t& channel)
+{
+    for(unsigned pos = 0; pos < 15; ++pos) {
+        if(channel.values[pos] != channel.sequence + pos)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    char name[65];
+    channel_t channel;
+    unsigned pos;
+
+    snprintf(name, sizeof(name), "ucommon-mapped-%ld", (long)getpid());
+    MappedMemory::remove(name);
+
+    mapped_records<channel_t> records(name, CHANNELS);
+    assert(records.max() == CHANNELS);
+    records.initialize();
+
+    memset(&channel, 0, sizeof(channel));
+    for(pos = 0; pos < 15; ++pos)
+        channel.values[pos] = pos;
+    for(pos = 0; pos < CHANNELS; ++pos)
+        records.set(pos, channel);
+
+    mapped_snapshot<channel_t> view(name);
+    assert(view.count() == CHANNELS);
+    assert(view.version(0) == 1);
+    assert(view.snapshot(0, channel));
+    assert(consistent(channel));
+
+    // a record left mid-update is refused rather than spun on forever
+    records.begin(1);
+    assert(!view.snapshot(1, channel, 20));
+    records.commit(1);
+    assert(view.snapshot(1, channel));
+    assert(view.version(1) == 2);
+
+#ifndef _MSWINDOWS_
+    // one writer updating constantly, and several reader processes
+    for(unsigned readers = 1; readers <= 4; readers *= 2) {
+        pid_t pids[4];
+        int fds[2];
+        assert(pipe(fds) == 0);
+
+        for(unsigned reader = 0; reader < readers; ++reader) {
+            pids[reader] = fork();
+            assert(pids[reader] > -1);
+            if(pids[reader])
+                continue;
+
+            mapped_snapshot<channel_t> monitor(name);
+            unsigned long count = 0, failed = 0;
+            Timer::tick_t start = Timer::ticks();
+            while(Timer::ticks() - start < 2000000) {
+                for(pos = 0; pos < CHANNELS; ++pos) {
+                    if(!monitor.snapshot(pos, channel))
+                        ++failed;
+                    else if(!consistent(channel))
+                        _exit(1);
+                    else
+                        ++count;
+                }
+            }
+            unsigned long rate = (unsigned long)(count * 10000000ull / (Timer::ticks() - start));
+            ssize_t result = write(fds[1], &rate, sizeof(rate));
+            _exit(result == sizeof(rate) ? 0 : 2);
+        }
+
+        unsigned long updates = 0;
+        Timer::tick_t start = Timer::ticks();
+        while(Timer::ticks() - start < 2000000 && updates < UPDATES) {
+            for(pos = 0; pos < CHANNELS; ++pos) {
+                channel_t *rec = records.begin(pos);
+                rec->sequence = updates;
+                for(unsigned item = 0; item < 15; ++item)
+                    rec->values[item] = updates + item;
+                records.commit(pos);
+                ++updates;
+            }
+        }
+
+        unsigned long total = 0;
+        for(unsigned reader = 0; reader < readers; ++reader) {
+            int status = 0;
+            unsigned long rate = 0;
+            assert(read(fds[0], &rate, sizeof(rate)) == sizeof(rate));
+            waitpid(pids[reader], &status, 0);
+            assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+            total += rate;
+        }
+        close(fds[0]);
+        close(fds[1]);
+        printf("%u readers, %lu snapshots/sec, %lu updates\n", readers, total, updates);
+    }
+
+    // message ring between two processes, variable length then throughput
+    char ringname[65], backname[65];
+    unsigned char msg[256], reply[256];
+    snprintf(ringname, sizeof(ringname), "ucommon-ring-%ld", (long)getpid());
+    snprintf(backname, sizeof(backname), "ucommon-back-%ld", (long)getpid());
+
+    MappedRing ring(ringname, 65536);
+    MappedRing back(backname, 4096);
+    assert(ring && back);
+    assert(ring.limit() == 32768 - 8);
+    assert(!ring.put(msg, 0));
+    assert(ring.get(reply, sizeof(reply), 10) == 0);
+
+    pid_t pid = fork();
+    assert(pid > -1);
+    if(!pid) {
+        MappedRing out(ringname);
+        MappedRing in(backname);
+        if(!out || !in)
+            _exit(1);
+
+        for(unsigned long count = 0; count < 100000; ++count) {
+            size_t len = 1 + count % 200;
+            memset(msg, (int)(count & 0xff), len);
+            if(!out.put(msg, len))
+                _exit(2);
+        }
+
+        for(unsigned long count = 0; count < 2000000; ++count) {
+            if(!out.put(&count, sizeof(count)))
+                _exit(3);
+        }
+
+        // echo back for round trip latency
+        for(;;) {
+            size_t len = in.get(msg, sizeof(msg));
+            if(len == 1)
+                break;
+            out.put(msg, len);
+        }
+        _exit(0);
+    }
+
+    for(unsigned long count = 0; count < 100000; ++count) {
+        size_t len = 1 + count % 200;
+        assert(ring.get(reply, sizeof(reply)) == len);
+        assert(reply[0] == (count & 0xff) && reply[len - 1] == (count & 0xff));
+    }
+
+    Timer::tick_t start = Timer::ticks();
+    for(unsigned long count = 0; count < 2000000; ++count) {
+        unsigned long value = 0;
+        assert(ring.get(&value, sizeof(value)) == sizeof(value));
+        assert(value == count);
+    }
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    printf("ring %lu messages/sec\n", (unsigned long)(2000000ull * 10000000ull / (elapsed ? elapsed : 1)));
+
+    start = Timer::ticks();
+    for(unsigned trip = 0; trip < 10000; ++trip) {
+        assert(back.put(&trip, sizeof(trip)));
+        unsigned value = 0;
+        assert(ring.get(&value, sizeof(value)) == sizeof(value));
+        assert(value == trip);
+    }
+    elapsed = Timer::ticks() - start;
+    printf("ring %lu usec round trip\n", (unsigned long)(elapsed / 10000 / 10));
+
+    back.put(msg, 1);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#endif
+
+    // random access over a large table with different page placement
+    static const unsigned placements[] = {
+        0,
+        MappedMemory::PREFAULT,
+        MappedMemory::PREFAULT | MappedMemory::HUGEPAGES,
+        MappedMemory::PREFAULT | MappedMemory::HUGEPAGES | MappedMemory::LOCKED};
+    static const char *labels[] = {"default", "prefault", "hugepages", "locked"};
+
+    for(unsigned option = 0; option < 4; ++option) {
+        snprintf(name, sizeof(name), "ucommon-table-%ld", (long)getpid());
+        Timer::tick_t start = Timer::ticks();
+        mapped_array<unsigned long> table(name, 16 * 1048576, placements[option], option == 3 ? 0 : -1);
+        assert(table.max() == 16 * 1048576);
+        Timer::tick_t setup = Timer::ticks() - start;
+
+        // readers see the size asked for, not the page rounded one
+        mapped_view<unsigned long> peek(name);
+        assert(peek.count() == 16 * 1048576);
+
+        unsigned long index = 1, sum = 0;
+        start = Timer::ticks();
+        for(unsigned count = 0; count < 4000000; ++count) {
+            index = index * 6364136223846793005ul + 1442695040888963407ul;
+            unsigned long &slot = table[(unsigned)((index >> 33) % table.max())];
+            sum += slot++;
+        }
+        Timer::tick_t elapsed = Timer::ticks() - start;
+        printf("%-9s setup %lu msec, %lu nsec per access (%lu)\n", labels[option],
+            (unsigned long)(setup / 10000), (unsigned long)(elapsed * 100 / 4000000), sum);
+    }
+
+    return 0;
+}
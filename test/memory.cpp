@@ -22,9 +22,54 @@
 #include <ucommon/ucommon.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace ucommon;
 
+#define STRINGS 200000
+
+extern "C" {
+    static int compare(const void *s1, const void *s2)
+    {
+        return strcmp(*(const char * const *)s1, *(const char * const *)s2);
+    }
+}
+
+static void sorting(void)
+{
+    StringPager pager(4096);
+    char **texts = new char *[STRINGS];
+    char buf[32];
+
+    // shared prefixes, duplicates, and high bytes
+    srand(7);
+    for(unsigned pos = 0; pos < STRINGS; ++pos) {
+        snprintf(buf, sizeof(buf), "cdr-%05u-%c%u", rand() % 50000, 'A' + rand() % 60, rand() % 1000);
+        if(!(pos % 1000))
+            buf[4] = (char)0xe9;
+        texts[pos] = strdup(buf);
+        pager.add(buf);
+    }
+
+    Timer::tick_t start = Timer::ticks();
+    pager.sort(false);
+    unsigned long radix = (unsigned long)((Timer::ticks() - start) / 10000);
+
+    start = Timer::ticks();
+    qsort(texts, STRINGS, sizeof(char *), &compare);
+    unsigned long quick = (unsigned long)((Timer::ticks() - start) / 10000);
+
+    StringPager::iterator sp = pager.begin();
+    for(unsigned pos = 0; pos < STRINGS; ++pos) {
+        assert(eq(sp->get(), texts[pos]));
+        free(texts[pos]);
+        sp.next();
+    }
+    delete[] texts;
+
+    printf("%u strings: %lu ms radix, %lu ms qsort\n", STRINGS, radix, quick);
+}
+
 extern "C" int main()
 {
     stringlist_t mylist;
@@ -52,5 +97,25 @@ extern "C" int main()
     assert(eq(list[1], "300"));
 
     assert(list[2] == NULL);
+
+    // tokens are added without a copy of the whole text, and spans are
+    // added with one allocation each.
+    stringlist_t tokens;
+    assert(tokens.token("  one two\tthree  ", " \t") == 3);
+    assert(eq(tokens[2u], "three"));
+    assert(tokens.token("a \"b c\" d", " ", "\"\"") == 3);
+    assert(eq(tokens[4u], "b c"));
+    assert(tokens.token("no separators", NULL) == 0);
+
+    Tokenizer fields(",");
+    fields.fields("x,,zz", 5);
+    assert(tokens.add(fields) == 3);
+    assert(tokens.count() == 9);
+    assert(eq(tokens[6u], "x") && eq(tokens[7u], "") && eq(tokens[8u], "zz"));
+
+    tokens.sort(false);
+    assert(eq(tokens[0u], "") && eq(tokens[1u], "a") && eq(tokens[8u], "zz"));
+
+    sorting();
     return 0;
 }
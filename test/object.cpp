@@ -0,0 +1,273 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+
+using namespace ucommon;
+
+static volatile unsigned freed = 0;
+
+class counted : public CountedObject
+{
+public:
+    counted() : CountedObject() {}
+
+    inline void own(void)
+        {bias();}
+
+protected:
+    void dealloc(void) {
+        __sync_fetch_and_add(&freed, 1);
+        delete this;
+    }
+};
+
+#define PAIRS   200000
+
+static counted *handed = NULL;
+
+class sharing : public JoinableThread
+{
+public:
+    counted *object;
+    unsigned pairs;
+    bool drop;
+
+    sharing(counted *obj, unsigned count, bool release = false) :
+    JoinableThread(), object(obj), pairs(count), drop(release) {}
+
+    ~sharing() {join();}
+
+    void run(void) {
+        for(unsigned pass = 0; pass < pairs; ++pass) {
+            object->retain();
+            object->release();
+        }
+        // release a reference handed to us by the owner
+        if(drop)
+            object->release();
+    }
+};
+
+class owning : public JoinableThread
+{
+public:
+    owning() : JoinableThread() {}
+
+    ~owning() {join();}
+
+    void run(void) {
+        counted *obj = new counted();
+        obj->own();
+        obj->retain();
+        obj->retain();
+        obj->retain();
+        obj->release();
+        obj->release();
+        // one reference left for whoever joins us
+        handed = obj;
+    }
+};
+
+// owner retain/release pairs per second while other threads also retain
+// and release the same object.
+static volatile unsigned created = 0;
+
+class channel : public CountedObject
+{
+public:
+    unsigned id;
+
+    channel() : CountedObject(), id(0) {
+        __sync_fetch_and_add(&created, 1);
+    }
+};
+
+#define CHANNELS    65536
+
+class indexing : public JoinableThread
+{
+public:
+    sarray<channel> *list;
+    unsigned first;
+
+    indexing(sarray<channel> *array, unsigned from) :
+    JoinableThread(), list(array), first(from) {}
+
+    ~indexing() {join();}
+
+    void run(void) {
+        // every thread walks all channels, from a different start
+        for(unsigned pass = 0; pass < 4; ++pass) {
+            for(unsigned pos = 0; pos < CHANNELS; ++pos) {
+                channel *ch = list->get((pos + first) % CHANNELS);
+                assert(ch != NULL);
+            }
+        }
+    }
+};
+
+static unsigned long contend(counted *obj, unsigned threads)
+{
+    sharing *workers[8];
+
+    for(unsigned pos = 0; pos < threads; ++pos) {
+        workers[pos] = new sharing(obj, PAIRS);
+        workers[pos]->start();
+    }
+
+    Timer::tick_t start = Timer::ticks();
+    for(unsigned pass = 0; pass < PAIRS * 10; ++pass) {
+        obj->retain();
+        obj->release();
+    }
+    Timer::tick_t elapsed = Timer::ticks() - start;
+
+    for(unsigned pos = 0; pos < threads; ++pos)
+        delete workers[pos];
+
+    if(!elapsed)
+        elapsed = 1;
+    return (unsigned long)(PAIRS * 10ull * 10000000ull / elapsed);
+}
+
+extern "C" int main()
+{
+    // plain counting
+    counted *obj = new counted();
+    assert(!obj->is_retained());
+    assert(!obj->is_biased());
+    obj->retain();
+    obj->retain();
+    assert(obj->is_copied());
+    assert(obj->copied() == 2);
+    obj->release();
+    assert(freed == 0);
+    obj->release();
+    assert(freed == 1);
+
+    // atomic counting under contention
+    obj = new counted();
+    obj->retain();
+    unsigned long rate = contend(obj, 4);
+    assert(obj->copied() == 1);
+    assert(freed == 1);
+    obj->release();
+    assert(freed == 2);
+    printf("%lu atomic retain/release pairs/sec\n", rate);
+
+    // biased to us, with other threads retaining and releasing
+    obj = new counted();
+    obj->own();
+#if defined(__ATOMIC_RELAXED) && !defined(_MSWINDOWS_)
+    assert(obj->is_biased());
+#endif
+    obj->retain();
+    rate = contend(obj, 4);
+    assert(obj->copied() == 1);
+    assert(freed == 2);
+
+    // owner retains for other threads that release what they are handed
+    sharing *workers[4];
+    for(unsigned pos = 0; pos < 4; ++pos) {
+        obj->retain();
+        workers[pos] = new sharing(obj, 1000, true);
+    }
+    for(unsigned pos = 0; pos < 4; ++pos)
+        workers[pos]->start();
+    for(unsigned pos = 0; pos < 4; ++pos)
+        delete workers[pos];
+    assert(freed == 2);
+    CountedObject::merge();
+    assert(obj->copied() == 1);
+    obj->release();
+    assert(freed == 3);
+    printf("%lu biased retain/release pairs/sec\n", rate);
+
+    // owner drops its own reference first; the last is released elsewhere
+    obj = new counted();
+    obj->own();
+    obj->retain();
+    obj->retain();
+    obj->release();
+    sharing *last = new sharing(obj, 1000, true);
+    last->start();
+    delete last;
+    CountedObject::merge();
+    assert(freed == 4);
+
+    // owner exits with a reference still handed out
+    owning *owner = new owning();
+    owner->start();
+    delete owner;
+    assert(handed != NULL);
+    assert(freed == 4);
+    handed->release();
+    assert(freed == 5);
+
+    // sparse array basics
+    sarray<channel> *list = new sarray<channel>(100000);
+    assert(list->count() == 0);
+    assert(list->scan() == list->npos);
+    assert(list->at(5) == NULL);
+    list->get(5)->id = 5;
+    (*list)[70000].id = 70000;
+    list->get(99999)->id = 99999;
+    assert(list->get(100000) == NULL);
+    assert(created == 3);
+    assert(list->count() == 3);
+    assert(list->at(5)->id == 5);
+    assert(list->at(6) == NULL);
+    assert(list->scan() == 5);
+    assert(list->scan(6) == 70000);
+    assert(list->scan(70001) == 99999);
+    assert(list->scan(100000) == list->npos);
+    unsigned visited = 0;
+    for(unsigned pos = list->scan(); pos != list->npos; pos = list->scan(pos + 1)) {
+        assert(list->at(pos)->id == pos);
+        ++visited;
+    }
+    assert(visited == 3);
+    delete list;
+
+    // concurrent lookup and creation
+    created = 0;
+    list = new sarray<channel>(CHANNELS);
+    indexing *indexers[4];
+    Timer::tick_t started = Timer::ticks();
+    for(unsigned pos = 0; pos < 4; ++pos) {
+        indexers[pos] = new indexing(list, pos * (CHANNELS / 4));
+        indexers[pos]->start();
+    }
+    for(unsigned pos = 0; pos < 4; ++pos)
+        delete indexers[pos];
+    Timer::tick_t elapsed = Timer::ticks() - started;
+    assert(created == CHANNELS);
+    assert(list->count() == CHANNELS);
+    assert(list->scan(CHANNELS - 1) == CHANNELS - 1);
+    delete list;
+    if(!elapsed)
+        elapsed = 1;
+    printf("%lu sparse gets/sec\n", (unsigned long)(16ull * CHANNELS * 10000000ull / elapsed));
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon-config.h>
+#include <ucommon/secure.h>
+
+#ifndef _MSWINDOWS_
+#include <sys/wait.h>
+#endif
+
+#include <stdio.h>
+
+using namespace ucommon;
+
+int main(int argc, char **argv)
+{
+    unsigned char first[64], second[64];
+    unsigned count;
+
+    assert(Random::fill(first, sizeof(first)) == sizeof(first));
+    assert(Random::fill(second, sizeof(second)) == sizeof(second));
+    assert(memcmp(first, second, sizeof(first)) != 0);
+
+    for(count = 0; count < 1000; ++count) {
+        int value = Random::get(1, 6);
+        assert(value >= 1 && value <= 6);
+    }
+
+#ifndef _MSWINDOWS_
+    // parent and child must not continue the same stream after fork
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t pid = fork();
+    assert(pid > -1);
+    if(!pid) {
+        Random::fill(first, sizeof(first));
+        ssize_t result = write(fds[1], first, sizeof(first));
+        _exit(result == sizeof(first) ? 0 : 1);
+    }
+    Random::fill(first, sizeof(first));
+    assert(read(fds[0], second, sizeof(second)) == sizeof(second));
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+    close(fds[1]);
+    assert(memcmp(first, second, sizeof(first)) != 0);
+#endif
+
+    Timer::tick_t start = Timer::ticks();
+    for(count = 0; count < 100000; ++count)
+        Random::fill(first, 16);
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(elapsed)
+        printf("%lu small fills per second\n", (unsigned long)(100000ll * 10000000ll / elapsed));
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+// Copyright (C) 2010-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+
+using namespace ucommon;
+
+#define CONNECTS    2000
+
+static volatile unsigned callbacks = 0;
+
+class notify : public ResolverRequest
+{
+public:
+    notify() : ResolverRequest(true) {}
+
+    void completed(void) {
+        if(get())
+            __sync_add_and_fetch(&callbacks, 1);
+    }
+};
+
+static unsigned long connecting(socket_t listener, const char *port)
+{
+    Timer::tick_t start = Timer::ticks();
+
+    for(unsigned pos = 0; pos < CONNECTS; ++pos) {
+        Socket::address addr("localhost", port);
+        Socket client(AF_INET, SOCK_STREAM);
+        assert(client.connectto(addr.getList()) == 0);
+        socket_t session = Socket::acceptfrom(listener);
+        assert(session != INVALID_SOCKET);
+        Socket::release(session);
+    }
+
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return (unsigned long)(CONNECTS * 10000000ull / elapsed);
+}
+
+extern "C" int main()
+{
+    char port[16];
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    unsigned long hits, misses;
+
+    // a second lookup is answered from the cache with its own copy
+    Resolver::flush();
+    misses = Resolver::misses();
+    hits = Resolver::hits();
+    struct addrinfo *first = Socket::query("localhost", "80", SOCK_STREAM);
+    struct addrinfo *second = Socket::query("LocalHost", "80", SOCK_STREAM);
+    assert(first != NULL && second != NULL && first != second);
+    assert(Socket::equal(first->ai_addr, second->ai_addr));
+    assert(Resolver::misses() == misses + 1);
+    assert(Resolver::hits() == hits + 1);
+    Socket::release(first);
+    Socket::release(second);
+
+    // cached copies may be joined with lists from the system
+    hits = Resolver::hits();
+    Socket::address joined("127.0.0.1", "80", SOCK_STREAM);
+    joined.add("localhost", "80", SOCK_STREAM);
+    joined.add("127.0.0.2", "80", SOCK_STREAM);
+    assert(Resolver::hits() == hits + 1);
+    assert(joined.remove(joined.get()));
+    joined.clear();
+
+    // address literals bypass the cache
+    misses = Resolver::misses();
+    hits = Resolver::hits();
+    first = Socket::query("127.0.0.1", "80", SOCK_STREAM);
+    assert(first != NULL);
+    Socket::release(first);
+    first = Socket::query("::1", "80", SOCK_STREAM);
+    if(first)
+        Socket::release(first);
+    assert(Resolver::misses() == misses && Resolver::hits() == hits);
+
+    // failed lookups are cached too
+    misses = Resolver::misses();
+    assert(Socket::query("nonexistent.invalid", "80") == NULL);
+    assert(Socket::query("nonexistent.invalid", "80") == NULL);
+    assert(Resolver::misses() == misses + 1);
+
+    // a local table stands in for the system resolver
+    FILE *fp = fopen("resolver.hosts", "w");
+    assert(fp != NULL);
+    fprintf(fp, "# test hosts\n127.0.0.2\ttrunk.example trunk\n\n127.0.0.3 proxy.example # comment\n");
+    fclose(fp);
+    assert(Resolver::hosts("resolver.hosts"));
+    remove("resolver.hosts");
+    Resolver::local();
+
+    Socket::address trunk("trunk.example", "5060");
+    assert(trunk.getList() != NULL);
+    assert(((struct sockaddr_in *)trunk.get(AF_INET))->sin_addr.s_addr == htonl(0x7f000002));
+    Socket::address proxy("PROXY.example", "5060");
+    assert(((struct sockaddr_in *)proxy.get(AF_INET))->sin_addr.s_addr == htonl(0x7f000003));
+    Socket::address missing("missing.example", "5060");
+    assert(missing.getList() == NULL);
+
+    Resolver::assign("trunk.example", "127.0.0.4");
+    trunk.set("trunk", "5060");
+    assert(((struct sockaddr_in *)trunk.get(AF_INET))->sin_addr.s_addr == htonl(0x7f000002));
+    trunk.set("trunk.example", "5060");
+    assert(((struct sockaddr_in *)trunk.get(AF_INET))->sin_addr.s_addr == htonl(0x7f000004));
+    Resolver::assign("trunk.example", NULL);
+    trunk.set("trunk.example", "5060");
+    assert(trunk.getList() == NULL);
+    Resolver::local(false);
+
+    // asynchronous lookups as futures and with callbacks
+    ResolverRequest future;
+    Resolver::resolve(&future, "localhost", "5060");
+    assert(future.wait(5000));
+    assert(future);
+    Socket::address resolved;
+    resolved.copy(future.get());
+    assert(resolved.get(AF_INET) != NULL);
+    Resolver::resolve(&future, "proxy.example", "5060");
+    assert(future.wait(5000));
+    assert(future);
+
+    for(unsigned pos = 0; pos < 8; ++pos)
+        Resolver::resolve(new notify(), "localhost", "5060");
+    for(unsigned tries = 0; callbacks < 8 && tries < 500; ++tries)
+        Thread::sleep(10);
+    assert(callbacks == 8);
+
+    // connection setup with and without the cache
+    socket_t listener = ListenSocket::create("127.0.0.1", "0", 16, AF_INET);
+    assert(listener != INVALID_SOCKET);
+    assert(!getsockname(listener, (struct sockaddr *)&local, &len));
+    snprintf(port, sizeof(port), "%u", ntohs(local.sin_port));
+
+    Resolver::cache(0);
+    unsigned long uncached = connecting(listener, port);
+    Resolver::cache(30000);
+    hits = Resolver::hits();
+    unsigned long cached = connecting(listener, port);
+    assert(Resolver::hits() >= hits + CONNECTS - 1);
+    Socket::release(listener);
+
+    printf("%lu uncached, %lu cached connects/sec\n", uncached, cached);
+    return 0;
+}
@@ -22,9 +22,85 @@
 #include <ucommon/ucommon.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSWINDOWS_
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 using namespace ucommon;
 
+#ifndef _MSWINDOWS_
+
+#define SPAWNS  100
+#define HEAP    (256l * 1024l * 1024l)
+
+static char *true_argv[] = {(char *)"true", NULL};
+
+static unsigned long spawning(bool forked)
+{
+    Timer::tick_t start = Timer::ticks();
+
+    for(unsigned pos = 0; pos < SPAWNS; ++pos) {
+        if(forked) {
+            pid_t pid = fork();
+            if(!pid) {
+                execv("/bin/true", true_argv);
+                _exit(-1);
+            }
+            assert(pid > 0);
+            assert(shell::wait(pid) == 0);
+        }
+        else {
+            shell::pid_t pid = shell::spawn("/bin/true", true_argv);
+            assert(pid != INVALID_PID_VALUE);
+            assert(shell::wait(pid) == 0);
+        }
+    }
+
+    // usec per launch, ticks are in 100ns units
+    return (unsigned long)((Timer::ticks() - start) / (SPAWNS * 10));
+}
+
+static void launching(void)
+{
+    // the environment is merged and stdio remapped in the child
+    char *echo_argv[] = {(char *)"sh", (char *)"-c", (char *)"echo $UCOMMON_TEST", NULL};
+    char *echo_envp[] = {(char *)"UCOMMON_TEST=42", NULL};
+    int value = 0;
+
+    pipestream echo("/bin/sh", pipestream::RDONLY, echo_argv, echo_envp);
+    echo >> value;
+    assert(value == 42);
+    assert(echo.close() == 0);
+    assert(getenv("UCOMMON_TEST") == NULL);
+
+    // descriptors beyond stdio never leak into a child
+    char command[64];
+    int fd = ::open("/dev/null", O_RDONLY);
+    assert(fd > 2);
+    snprintf(command, sizeof(command), "test ! -e /dev/fd/%d", fd);
+    int status = shell::system(command);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ::close(fd);
+
+    assert(shell::spawn("/nonexistent/command", true_argv) == INVALID_PID_VALUE);
+
+    // launch latency from a process with a large, touched heap
+    char *heap = (char *)malloc(HEAP);
+    assert(heap != NULL);
+    memset(heap, 1, HEAP);
+    unsigned long forked = spawning(true);
+    unsigned long spawned = spawning(false);
+    free(heap);
+
+    printf("%lu usec fork, %lu usec spawn per launch\n", forked, spawned);
+}
+
+#endif
+
 extern "C" int main()
 {
     int test_argc;
@@ -62,4 +138,9 @@ extern "C" int main()
 
     assert(eq(basedir, "/test"));
     assert(eq(subdir, prefix));
+
+#ifndef _MSWINDOWS_
+    launching();
+#endif
+    return 0;
 }
@@ -22,6 +22,7 @@
 #include <ucommon/ucommon.h>
 
 #include <stdio.h>
+#include <fcntl.h>
 
 using namespace ucommon;
 
@@ -33,6 +34,232 @@ static Socket::address testing6("44:022:66::1", 4444);
 static Socket::address localhost6("::1", 4444);
 #endif
 
+#define BURST       64
+#define BURSTS      1000
+#define PAYLOAD     160
+#define WORKERS     4
+#define CONNECTIONS 2000
+
+static unsigned long rate(unsigned long count, Timer::tick_t start)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return (unsigned long)(count * 10000000ull / elapsed);
+}
+
+static volatile unsigned accepts = 0;
+
+class acceptors : public ListenGroup
+{
+public:
+    volatile unsigned members[WORKERS];
+
+    acceptors() : ListenGroup("127.0.0.1", "0", WORKERS, 128, AF_INET) {
+        memset((void *)members, 0, sizeof(members));
+    }
+
+protected:
+    void accepted(unsigned index, socket_t so, struct sockaddr_storage *) {
+        __sync_add_and_fetch(&members[index], 1);
+        __sync_add_and_fetch(&accepts, 1);
+        Socket::release(so);
+    }
+};
+
+class worker : public JoinableThread
+{
+public:
+    ListenGroup *group;
+    socket_t listener;
+    unsigned index;
+
+    worker(ListenGroup *g, unsigned i) : JoinableThread() {group = g; index = i; listener = INVALID_SOCKET;}
+    worker(socket_t so) : JoinableThread() {group = NULL; index = 0; listener = so;}
+    ~worker() {join();}
+
+    void run(void) {
+        if(group) {
+            group->run(index);
+            return;
+        }
+        // workers contending on one shared listener
+        for(;;) {
+            socket_t so = Socket::acceptfrom(listener);
+            if(so == INVALID_SOCKET)
+                break;
+            __sync_add_and_fetch(&accepts, 1);
+            Socket::release(so);
+        }
+    }
+};
+
+static unsigned long connecting(socket_t so)
+{
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    char port[16];
+
+    assert(!getsockname(so, (struct sockaddr *)&local, &len));
+    snprintf(port, sizeof(port), "%u", ntohs(local.sin_port));
+    Socket::address addr("127.0.0.1", port);
+
+    accepts = 0;
+    Timer::tick_t start = Timer::ticks();
+    for(unsigned pos = 0; pos < CONNECTIONS; ++pos) {
+        Socket client(AF_INET, SOCK_STREAM);
+        assert(client.connectto(addr.getList()) == 0);
+    }
+    while(accepts < CONNECTIONS)
+        Thread::sleep(1);
+    return rate(CONNECTIONS, start);
+}
+
+static void listening(void)
+{
+    struct sockaddr_in first, local;
+    socklen_t len = sizeof(first);
+    worker *workers[WORKERS];
+    unsigned pos;
+
+    // accepted connections get their flags from accept itself
+    ListenGroup single("127.0.0.1", "0", 1, 5, AF_INET);
+    assert(single && single.size() == 1);
+    single.nonblocking();
+    assert(!getsockname(single[0], (struct sockaddr *)&first, &len));
+    socket_t so = Socket::create(AF_INET, SOCK_STREAM, 0);
+    assert(!connect(so, (struct sockaddr *)&first, len));
+    socket_t client = single.accept(0);
+    assert(client != INVALID_SOCKET);
+    assert(fcntl(client, F_GETFD) & FD_CLOEXEC);
+    assert(fcntl(client, F_GETFL) & O_NONBLOCK);
+    Socket::release(client);
+    Socket::release(so);
+
+    // every member is bound to the port given to the first
+    acceptors group;
+    assert(group && group.size() == WORKERS);
+    assert(group[WORKERS] == INVALID_SOCKET);
+    len = sizeof(first);
+    assert(!getsockname(group[0], (struct sockaddr *)&first, &len));
+    for(pos = 1; pos < WORKERS; ++pos) {
+        len = sizeof(local);
+        assert(!getsockname(group[pos], (struct sockaddr *)&local, &len));
+        assert(local.sin_port == first.sin_port);
+    }
+    bool steered = group.steer();
+
+    for(pos = 0; pos < WORKERS; ++pos)
+        (workers[pos] = new worker(&group, pos))->start();
+    unsigned long grouped = connecting(group[0]);
+    group.stop();
+    for(pos = 0; pos < WORKERS; ++pos)
+        delete workers[pos];
+
+    unsigned total = 0;
+    for(pos = 0; pos < WORKERS; ++pos)
+        total += group.members[pos];
+    assert(total == CONNECTIONS);
+
+    so = ListenSocket::create("127.0.0.1", "0", 128, AF_INET);
+    assert(so != INVALID_SOCKET);
+    for(pos = 0; pos < WORKERS; ++pos)
+        (workers[pos] = new worker(so))->start();
+    unsigned long contended = connecting(so);
+    Socket::cancel(so);
+    for(pos = 0; pos < WORKERS; ++pos)
+        delete workers[pos];
+    Socket::release(so);
+
+    printf("%lu shared, %lu %s%s connects/sec (%u/%u/%u/%u)\n", contended, grouped,
+        group.is_shared() ? "shared group" : "reuseport", steered ? " steered" : "",
+        group.members[0], group.members[1], group.members[2], group.members[3]);
+}
+
+static void datagrams(void)
+{
+    char out[BURST][PAYLOAD], in[BURST][PAYLOAD * 8];
+    Socket::datagram_t sending[BURST], receiving[BURST];
+    struct sockaddr_storage dest;
+    socklen_t dlen = sizeof(dest);
+    unsigned count = 0, received = 0;
+
+    socket_t txs = Socket::create("127.0.0.1", "0", AF_INET, SOCK_DGRAM);
+    socket_t rxs = Socket::create("127.0.0.1", "0", AF_INET, SOCK_DGRAM);
+    assert(txs != INVALID_SOCKET && rxs != INVALID_SOCKET);
+    assert(!getsockname(rxs, (struct sockaddr *)&dest, &dlen));
+    Socket tx(txs), rx(rxs);
+    bool stamped = rx.timestamps(true) == 0;
+
+    for(unsigned pos = 0; pos < BURST; ++pos) {
+        memset(out[pos], pos, PAYLOAD);
+        sending[pos].data = out[pos];
+        sending[pos].length = PAYLOAD;
+        memcpy(&sending[pos].address, &dest, dlen);
+        receiving[pos].data = in[pos];
+        receiving[pos].size = sizeof(in[pos]);
+    }
+
+    // a batch arrives in order with its sender
+    assert(Socket::sendbatch(txs, sending, BURST) == BURST);
+    while(count < BURST) {
+        int result = Socket::recvbatch(rxs, receiving + count, BURST - count);
+        assert(result > 0);
+        count += result;
+    }
+    for(unsigned pos = 0; pos < BURST; ++pos) {
+        assert(receiving[pos].length == PAYLOAD);
+        assert(receiving[pos].segment == 0);
+        assert(in[pos][0] == (char)pos && in[pos][PAYLOAD - 1] == (char)pos);
+        assert(receiving[pos].address.ss_family == AF_INET);
+        if(stamped)
+            assert(receiving[pos].stamp.tv_sec != 0);
+    }
+
+    // a burst to one destination, split by the kernel where it can
+    char burst[PAYLOAD * 10 + 20];
+    for(unsigned pos = 0; pos < sizeof(burst); ++pos)
+        burst[pos] = (char)(pos / PAYLOAD);
+    assert(Socket::sendsegments(txs, burst, sizeof(burst), PAYLOAD, (struct sockaddr *)&dest) == (ssize_t)sizeof(burst));
+    for(count = 0; count < sizeof(burst); ) {
+        int result = Socket::recvbatch(rxs, receiving, BURST);
+        assert(result > 0);
+        for(int pos = 0; pos < result; ++pos) {
+            assert(receiving[pos].length == PAYLOAD || count + receiving[pos].length == sizeof(burst));
+            assert(((char *)receiving[pos].data)[0] == (char)(count / PAYLOAD));
+            count += receiving[pos].length;
+        }
+    }
+    assert(count == sizeof(burst));
+
+    // packets per second one datagram per call and batched
+    Timer::tick_t start = Timer::ticks();
+    for(unsigned loop = 0; loop < BURSTS; ++loop) {
+        for(unsigned pos = 0; pos < BURST; ++pos)
+            tx.writeto(out[pos], PAYLOAD, (struct sockaddr *)&dest);
+        for(unsigned pos = 0; pos < BURST; ++pos)
+            received += (rx.readfrom(in[pos], PAYLOAD) == PAYLOAD);
+    }
+    unsigned long single = rate(received, start);
+    assert(received == BURST * BURSTS);
+
+    received = 0;
+    start = Timer::ticks();
+    for(unsigned loop = 0; loop < BURSTS; ++loop) {
+        assert(tx.writebatch(sending, BURST) == BURST);
+        for(count = 0; count < BURST; ) {
+            unsigned got = rx.readbatch(receiving, BURST - count);
+            assert(got > 0);
+            count += got;
+        }
+        received += count;
+    }
+    unsigned long batched = rate(received, start);
+    assert(received == BURST * BURSTS);
+
+    printf("%lu single, %lu batched datagrams/sec\n", single, batched);
+}
+
 extern "C" int main()
 {
     struct sockaddr_internet addr;
@@ -93,5 +320,8 @@ extern "C" int main()
         assert(0 == strcmp(addrbuf, "44:22:66::1"));
     }
 #endif
+
+    datagrams();
+    listening();
     return 0;
 }
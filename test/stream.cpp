@@ -23,10 +23,223 @@
 #include <ucommon/ucommon.h>
 
 #include <stdio.h>
+#include <sys/resource.h>
 
 using namespace ucommon;
 using namespace std;
 
+#define FILESIZE    (32l * 1024l * 1024l)
+#define CHUNK       65536
+
+static char port[16];
+
+static inline char pattern(size_t pos)
+{
+    return (char)(pos % 251);
+}
+
+class sink : public JoinableThread
+{
+public:
+    size_t received, skip, first;
+    bool checking, valid;
+
+    sink(size_t header = 0, size_t from = 0, bool check = true) : JoinableThread() {
+        received = 0;
+        skip = header;
+        first = from;
+        checking = check;
+        valid = true;
+    }
+
+    ~sink() {join();}
+
+    void finish(void) {join();}
+
+    void run(void) {
+        char buf[CHUNK];
+        size_t count;
+        Socket::address addr("127.0.0.1", port);
+        Socket client(AF_INET, SOCK_STREAM);
+
+        if(client.connectto(addr.getList())) {
+            valid = false;
+            return;
+        }
+        while((count = client.readfrom(buf, sizeof(buf))) > 0) {
+            for(size_t pos = 0; checking && pos < count; ++pos) {
+                size_t offset = received + pos;
+                if(offset >= skip && buf[pos] != pattern(first + offset - skip))
+                    valid = false;
+            }
+            received += count;
+        }
+    }
+};
+
+class feeder : public JoinableThread
+{
+public:
+    fd_t fd;
+    size_t size;
+
+    feeder(fd_t pipe, size_t count) : JoinableThread() {fd = pipe; size = count;}
+    ~feeder() {join();}
+
+    void run(void) {
+        char buf[CHUNK];
+        size_t sent = 0;
+        while(sent < size) {
+            size_t count = size - sent;
+            if(count > sizeof(buf))
+                count = sizeof(buf);
+            for(size_t pos = 0; pos < count; ++pos)
+                buf[pos] = pattern(sent + pos);
+            if(::write(fd, buf, count) != (ssize_t)count)
+                break;
+            sent += count;
+        }
+        ::close(fd);
+    }
+};
+
+static Timer::tick_t cputime(void)
+{
+    struct rusage usage;
+#ifdef  RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 10000000ull +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 10ull;
+}
+
+static void report(const char *label, size_t size, Timer::tick_t start, Timer::tick_t cpu)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    cpu = cputime() - cpu;
+    if(!elapsed)
+        elapsed = 1;
+    printf("%s: %lu MB/s, %lu ms cpu per GB\n", label,
+        (unsigned long)(size * 10000000ull / elapsed / (1024 * 1024)),
+        (unsigned long)(cpu * 1024ull / (size / (1024 * 1024)) / 10000));
+}
+
+// send the file through user memory, through sendfile, and memory zero copy
+static void benchmark(TCPServer& server, fd_t fd, const char *memory)
+{
+    char *buf = new char[CHUNK];
+    off_t offset = 0;
+
+    sink copied(0, 0, false);
+    copied.start();
+    socket_t so = server.accept();
+    assert(so != INVALID_SOCKET);
+    Timer::tick_t start = Timer::ticks(), cpu = cputime();
+    ssize_t count;
+    while((count = fsys::read(fd, buf, CHUNK, &offset)) > 0)
+        assert(Socket::sendto(so, buf, count) == count);
+    report("copy", FILESIZE, start, cpu);
+    Socket::release(so);
+    delete[] buf;
+
+    sink sent(0, 0, false);
+    sent.start();
+    so = server.accept();
+    assert(so != INVALID_SOCKET);
+    offset = 0;
+    start = Timer::ticks();
+    cpu = cputime();
+    assert(Socket::sendfile(so, fd, &offset, FILESIZE) == FILESIZE);
+    report("sendfile", FILESIZE, start, cpu);
+    Socket::release(so);
+
+    Socket::zerocopy_t state;
+    sink zero(0, 0, false);
+    zero.start();
+    so = server.accept();
+    assert(so != INVALID_SOCKET);
+    Socket::zerocopy(so, &state);
+    start = Timer::ticks();
+    cpu = cputime();
+    size_t pos = 0;
+    while(pos < FILESIZE) {
+        count = Socket::sendzerocopy(so, memory + pos, 4 * CHUNK, &state);
+        assert(count > 0);
+        pos += count;
+        Socket::reclaim(so, &state);
+    }
+    while(state.completed != state.sent)
+        assert(Socket::reclaim(so, &state, 1000) > 0);
+    report(state.enabled ? (state.copied ? "zerocopy (copied)" : "zerocopy") : "zerocopy (unsupported)", FILESIZE, start, cpu);
+    Socket::release(so);
+}
+
+static void transmitting(void)
+{
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    char *memory = new char[FILESIZE];
+    int pipes[2];
+
+    for(size_t pos = 0; pos < FILESIZE; ++pos)
+        memory[pos] = pattern(pos);
+    FILE *fp = fopen("sendfile.data", "w");
+    assert(fp != NULL);
+    assert(fwrite(memory, 1, FILESIZE, fp) == (size_t)FILESIZE);
+    fclose(fp);
+    fd_t fd = fsys::input("sendfile.data");
+    assert(fd != INVALID_HANDLE_VALUE);
+
+    TCPServer server("127.0.0.1", "0");
+    assert(!getsockname(server.getsocket(), (struct sockaddr *)&local, &len));
+    snprintf(port, sizeof(port), "%u", ntohs(local.sin_port));
+
+    // stream output is flushed before the file is sent
+    sink streamed(6);
+    streamed.start();
+    off_t offset = 0;
+    {
+        // released rather than closed, so queued data is still delivered
+        tcpstream tcp(&server, 16384);
+        tcp << "hello\n";
+        assert(tcp.sendfile(fd, &offset, FILESIZE) == (size_t)FILESIZE);
+        assert(offset == FILESIZE);
+    }
+    streamed.finish();
+    assert(streamed.valid && streamed.received == 6 + FILESIZE);
+
+    // from the current file position, and short at end of file
+    sink buffered(4, 1000);
+    buffered.start();
+    TCPBuffer buffer(&server, 16384);
+    buffer.put("head", 4);
+    assert(lseek(fd, 1000, SEEK_SET) == 1000);
+    assert(buffer.sendfile(fd, NULL, FILESIZE) == (size_t)(FILESIZE - 1000));
+    buffer.close();
+    buffered.finish();
+    assert(buffered.valid && buffered.received == 4 + FILESIZE - 1000);
+
+    // pipes are spliced rather than sent with sendfile
+    assert(!::pipe(pipes));
+    sink spliced;
+    spliced.start();
+    feeder source(pipes[1], 1000000);
+    source.start();
+    socket_t so = server.accept();
+    assert(Socket::sendfile(so, pipes[0], NULL, 2000000) == 1000000);
+    Socket::release(so);
+    spliced.finish();
+    ::close(pipes[0]);
+    assert(spliced.valid && spliced.received == 1000000);
+
+    benchmark(server, fd, memory);
+    fsys::release(fd);
+    remove("sendfile.data");
+    delete[] memory;
+}
+
 class ThreadOut: public JoinableThread
 {
 public:
@@ -52,6 +265,7 @@ int main(int argc, char *argv[])
         tcp.getline(line, 200);
         assert(!strcmp(line, "pippo"));
         tcp.close();
+        transmitting();
         return 0;
     }
     assert(0);
@@ -22,11 +22,146 @@
 #include <ucommon/ucommon.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace ucommon;
 
 static string_t testing("second test");
 
+#define RECORDS 400000
+
+// separators found one list search per character, as before
+static size_t reference(const char *text, size_t len, const char *list, bool empty, Tokenizer::span_t *spans)
+{
+    size_t count = 0, start = 0;
+
+    for(size_t pos = 0; pos <= len; ++pos) {
+        if(pos < len && !memchr(list, text[pos], strlen(list)))
+            continue;
+        if(empty || pos > start) {
+            spans[count].offset = start;
+            spans[count++].size = pos - start;
+        }
+        start = pos + 1;
+    }
+    return count;
+}
+
+static void compare(const char *text, size_t len, const char *list)
+{
+    Tokenizer tokens(list);
+    Tokenizer::span_t *spans = new Tokenizer::span_t[len + 1];
+
+    size_t count = reference(text, len, list, true, spans);
+    assert(tokens.fields(text, len) == count);
+    for(size_t pos = 0; pos < count; ++pos)
+        assert(tokens[pos].offset == spans[pos].offset && tokens[pos].size == spans[pos].size);
+
+    count = reference(text, len, list, false, spans);
+    assert(tokens.token(text, len) == count);
+    for(size_t pos = 0; pos < count; ++pos)
+        assert(tokens[pos].offset == spans[pos].offset && tokens[pos].size == spans[pos].size);
+
+    for(size_t pos = 0; pos < len; pos += 97) {
+        size_t found = pos + tokens.find(text + pos, len - pos);
+        while(pos < found)
+            assert(!memchr(list, text[pos++], strlen(list)));
+        assert(found == len || memchr(list, text[found], strlen(list)));
+    }
+
+    delete[] spans;
+}
+
+static unsigned long rate(size_t len, Timer::tick_t start)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return (unsigned long)(len * 10ull / elapsed);
+}
+
+static void tokenizing(void)
+{
+    charmap set(",\n\xff");
+    assert(set(',') && set('\n') && set('\xff'));
+    assert(!set('a') && !set(0) && !set('\x7f'));
+
+    const char *record = "a,b,,c,";
+    Tokenizer comma(",");
+    assert(comma.fields(record, strlen(record)) == 5);
+    assert(comma.length(2) == 0 && comma.length(4) == 0);
+    assert(!strncmp(comma.at(3), "c", comma.length(3)));
+    assert(comma.token(",,a,,bc,,", 9) == 2);
+    assert(comma[1].offset == 5 && comma[1].size == 2);
+    assert(comma.fields("", 0) == 0);
+    assert(comma.token(",,,", 3) == 0);
+
+    // vector and table paths against a reference, with sets that fit the
+    // nibble tables and one with too many groups for them.
+    size_t len = 100000;
+    char *text = new char[len];
+    srand(1);
+    for(size_t pos = 0; pos < len; ++pos) {
+        if(rand() % 4)
+            text[pos] = (char)('a' + rand() % 26);
+        else
+            text[pos] = (char)(rand() % 256);
+    }
+    compare(text, len, ",");
+    compare(text, len, " \t\r\n");
+    compare(text, len, ",;|\xff\x80");
+    compare(text, len, "\x01\x12\x23\x34\x45\x56\x67\x78\x89");
+    compare(text + 1, len - 1, "aeiou");
+    delete[] text;
+
+    // throughput over call detail records, each split into lines and then
+    // fields, against a strchr per character and String::token.
+    const char *cdr = "2014-05-01 12:00:00,1000,15551234567,15556789012,ANSWERED,62,sip/trunk-0001,\"Doe, John\"\n";
+    size_t reclen = strlen(cdr);
+    len = reclen * RECORDS;
+    text = new char[len + 1];
+    for(unsigned pos = 0; pos < RECORDS; ++pos)
+        memcpy(text + pos * reclen, cdr, reclen);
+    text[len] = 0;
+
+    size_t found = 0;
+    Timer::tick_t start = Timer::ticks();
+    for(size_t pos = 0; pos < len; ++pos) {
+        if(strchr(",\n", text[pos]))
+            ++found;
+    }
+    unsigned long scanned = rate(len, start);
+    assert(found == RECORDS * 9);
+
+    char *copy = strdup(text);
+    char *last = NULL;
+    found = 0;
+    start = Timer::ticks();
+    while(NULL != String::token(copy, &last, ",\n"))
+        ++found;
+    unsigned long tokened = rate(len, start);
+    assert(found == RECORDS * 9);
+    free(copy);
+
+    Tokenizer lines("\n", RECORDS + 1), fields(",");
+    found = 0;
+    start = Timer::ticks();
+    lines.fields(text, len);
+    for(size_t pos = 0; pos < lines.size(); ++pos)
+        found += fields.fields(lines.at(pos), lines.length(pos));
+    unsigned long split = rate(len, start);
+    assert(lines.size() == RECORDS + 1);
+    assert(found == RECORDS * 9);
+
+    start = Timer::ticks();
+    assert(fields.fields(text, len) == RECORDS * 8 + 1);
+    unsigned long bulk = rate(len, start);
+    delete[] text;
+
+    printf("%lu MB/s strchr, %lu MB/s String::token, %lu MB/s lines and fields, %lu MB/s fields\n",
+        scanned, tokened, split, bulk);
+}
+
 extern "C" int main()
 {
     char buff[33];
@@ -89,5 +224,6 @@ extern "C" int main()
     delete[] test;
     delete[] cdup;
 
+    tokenizing();
     return 0;
 }
@@ -38,6 +38,133 @@ public:
     };
 };
 
+#define PASSES  20000
+
+static Semaphore admission(2);
+static volatile unsigned admitted = 0, peak = 0;
+
+class admitting : public JoinableThread
+{
+public:
+    admitting() : JoinableThread() {}
+
+    ~admitting() {join();}
+
+    void run(void) {
+        for(unsigned pass = 0; pass < PASSES; ++pass) {
+            admission.wait();
+            unsigned inside = __sync_add_and_fetch(&admitted, 1);
+            if(inside > peak)
+                peak = inside;
+            __sync_sub_and_fetch(&admitted, 1);
+            admission.release();
+        }
+    }
+};
+
+static barrier rounds(4);
+static volatile unsigned arrivals = 0;
+static volatile bool ordered = true;
+
+class rounding : public JoinableThread
+{
+public:
+    rounding() : JoinableThread() {}
+
+    ~rounding() {join();}
+
+    void run(void) {
+        for(unsigned round = 0; round < 2000; ++round) {
+            __sync_add_and_fetch(&arrivals, 1);
+            rounds.wait();
+            // nobody may get a round ahead until all have arrived
+            if(arrivals < (round + 1) * 4)
+                ordered = false;
+            rounds.wait();
+        }
+    }
+};
+
+static ThreadLock readlock;
+static ConditionalLock condlock;
+static volatile bool writing = false, excluded = true;
+
+class reading : public JoinableThread
+{
+public:
+    reading() : JoinableThread() {}
+
+    ~reading() {join();}
+
+    void run(void) {
+        for(unsigned pass = 0; pass < PASSES * 5; ++pass) {
+            readlock.access();
+            if(writing)
+                excluded = false;
+            readlock.release();
+            if(!(pass % 1000)) {
+                condlock.access();
+                condlock.access();
+                if(writing)
+                    excluded = false;
+                condlock.release();
+                condlock.release();
+            }
+        }
+    }
+};
+
+class writing_thread : public JoinableThread
+{
+public:
+    writing_thread() : JoinableThread() {}
+
+    ~writing_thread() {join();}
+
+    volatile bool done;
+
+    void run(void) {
+        while(!done) {
+            readlock.modify();
+            writing = true;
+            Thread::yield();
+            writing = false;
+            readlock.release();
+            condlock.modify();
+            writing = true;
+            writing = false;
+            condlock.commit();
+            Thread::sleep(5);
+        }
+    }
+};
+
+class holding : public JoinableThread
+{
+public:
+    holding() : JoinableThread() {held = done = false;}
+
+    ~holding() {join();}
+
+    volatile bool held, done;
+
+    void run(void) {
+        readlock.access();
+        held = true;
+        while(!done)
+            Thread::sleep(5);
+        readlock.release();
+    }
+};
+
+static unsigned long rate(unsigned long count, Timer::tick_t start)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return (unsigned long)(count * 10000000ull / elapsed);
+}
+
 extern "C" int main()
 {
     time_t now, later;
@@ -57,6 +184,115 @@ extern "C" int main()
     evt.wait(2000);
     time(&later);
     assert(later >= now + 1);
+
+    // semaphore permits and timed waits
+    Semaphore sem(2);
+    sem.wait();
+    assert(sem.wait(0));
+    assert(!sem.wait(0));
+    Timer::tick_t start = Timer::ticks();
+    assert(!sem.wait(50));
+    assert(Timer::ticks() - start >= 400000);
+    sem.release();
+    assert(sem.wait(50));
+    sem.set(3);
+    assert(sem.wait(0));
+    sem.release();
+    sem.release();
+    sem.release();
+    sem.release();
+    assert(sem.wait(0));
+
+    start = Timer::ticks();
+    for(unsigned pass = 0; pass < PASSES * 10; ++pass) {
+        sem.wait();
+        sem.release();
+    }
+    unsigned long single = rate(PASSES * 10, start);
+
+    admitting *admitters[4];
+    start = Timer::ticks();
+    for(unsigned pos = 0; pos < 4; ++pos) {
+        admitters[pos] = new admitting();
+        admitters[pos]->start();
+    }
+    for(unsigned pos = 0; pos < 4; ++pos)
+        delete admitters[pos];
+    assert(peak <= 2);
+    assert(admitted == 0);
+    printf("%lu uncontended, %lu contended semaphore passes/sec\n", single, rate(PASSES * 4, start));
+
+    // barrier timeouts withdraw, and rounds stay in step
+    barrier gate(2);
+    assert(!gate.wait(20));
+    assert(!gate.wait(20));
+
+    rounding *rounders[4];
+    start = Timer::ticks();
+    for(unsigned pos = 0; pos < 4; ++pos) {
+        rounders[pos] = new rounding();
+        rounders[pos]->start();
+    }
+    for(unsigned pos = 0; pos < 4; ++pos)
+        delete rounders[pos];
+    assert(ordered);
+    assert(arrivals == 8000);
+    printf("%lu barrier rounds/sec\n", rate(4000, start));
+
+    // recursive shared access with upgrade, while biased
+    condlock.bias();
+    condlock.access();
+    condlock.access();
+    condlock.access();
+    condlock.release();
+    condlock.modify();
+    condlock.commit();
+    condlock.release();
+    condlock.release();
+
+    // readers scale with bias, and writers still exclude them
+    for(unsigned biased = 0; biased < 2; ++biased) {
+        readlock.bias(biased != 0);
+        condlock.bias(biased != 0);
+        for(unsigned threads = 1; threads <= 4; threads *= 2) {
+            reading *readers[4];
+            writing_thread *writer = new writing_thread();
+            writer->done = false;
+            writer->start();
+            start = Timer::ticks();
+            for(unsigned pos = 0; pos < threads; ++pos) {
+                readers[pos] = new reading();
+                readers[pos]->start();
+            }
+            for(unsigned pos = 0; pos < threads; ++pos)
+                delete readers[pos];
+            unsigned long reads = rate(PASSES * 5 * threads, start);
+            writer->done = true;
+            delete writer;
+            printf("%lu %s reads/sec with %u readers\n", reads, biased ? "biased" : "unbiased", threads);
+        }
+    }
+    assert(excluded);
+    assert(readlock.modify(0));
+    readlock.release();
+
+    // a writer that times out on a biased reader leaves the lock to readers
+    readlock.bias();
+    Thread::sleep(50);
+    readlock.access();
+    readlock.release();
+    holding *holder = new holding();
+    holder->start();
+    while(!holder->held)
+        Thread::sleep(5);
+    assert(!readlock.modify(0));
+    assert(!readlock.modify(20));
+    assert(readlock.access(0));
+    readlock.release();
+    holder->done = true;
+    delete holder;
+    assert(readlock.modify(0));
+    readlock.release();
     return 0;
 }
 
@@ -22,11 +22,55 @@
 #include <ucommon/ucommon.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace ucommon;
 
-extern "C" int main()
+// passes over a 1 MB sample for each throughput figure; pass a larger
+// count, such as 1000, for steadier numbers.
+
+#define PASSES  10
+
+static unsigned passes = PASSES;
+
+// codepoint walk as done before validation, for reference
+static size_t walk(const char *text, size_t len)
+{
+    size_t count = 0;
+    unsigned size;
+
+    while(len && *text && (size = utf8::size(text)) != 0 && size <= len) {
+        ++count;
+        text += size;
+        len -= size;
+    }
+    return count;
+}
+
+static char *sample(size_t len)
 {
+    static const char *parts[] = {"plain ascii text ", "caf\xc3\xa9 ", "\xe2\x89\xa0 ", "\xf0\x9f\x98\x80", "x"};
+    char *text = (char *)malloc(len + 1);
+    size_t pos = 0;
+    unsigned part = 0;
+
+    while(pos < len) {
+        const char *cp = parts[part++ % 5];
+        size_t size = strlen(cp);
+        if(pos + size > len)
+            cp = "x", size = 1;
+        memcpy(text + pos, cp, size);
+        pos += size;
+    }
+    text[len] = 0;
+    return text;
+}
+
+extern "C" int main(int argc, char **argv)
+{
+    if(argc > 1)
+        passes = (unsigned)atol(argv[1]);
+
     char u1[] = {(char)0xc2, (char)0xa9, 0x00};
     char u2[] = {(char)0xe2, (char)0x89, (char)0xa0, 0x00};
 
@@ -37,5 +81,121 @@ extern "C" int main()
     assert(utf8::codepoint(u1) == 0x00a9);
     assert(utf8::codepoint(u2) == 0x2260);
 
+    assert(utf8::valid("plain"));
+    assert(utf8::valid(u1) && utf8::valid(u2));
+    assert(utf8::valid("\xf0\x9f\x98\x80"));
+    assert(!utf8::valid("\xc0\x80"));
+    assert(!utf8::valid("\xe0\x80\x80"));
+    assert(!utf8::valid("\xed\xa0\x80"));
+    assert(!utf8::valid("\xf4\x90\x80\x80"));
+    assert(!utf8::valid("\xf5\x80\x80\x80"));
+    assert(!utf8::valid("\xe2\x89"));
+    assert(!utf8::valid("\x80"));
+
+    // compare vector and portable results across block boundaries
+    char *text = sample(4000);
+    size_t len = strlen(text);
+    size_t points = walk(text, len);
+    assert(utf8::valid(text));
+    assert(utf8::count(text) == points);
+    for(size_t pos = 0; pos <= points; pos += 7) {
+        char *cp = text;
+        for(size_t step = 0; step < pos; ++step)
+            cp += utf8::size(cp);
+        assert(utf8::offset(text, (ssize_t)pos) == cp);
+        assert(utf8::offset(text, -(ssize_t)(points - pos)) == (pos ? cp : text));
+    }
+    assert(utf8::offset(text, (ssize_t)points + 1) == NULL);
+
+    for(size_t pos = 0; pos < 200; ++pos) {
+        char save = text[pos];
+        text[pos] = (char)0xff;
+        assert(!utf8::valid(text));
+        assert(utf8::count(text) == walk(text, len));
+        text[pos] = (char)0x80;
+        assert(utf8::valid(text) == false || (save & 0xc0) == 0x80);
+        text[pos] = save;
+    }
+    assert(!utf8::valid(text, len - 2) || walk(text, len - 2) == utf8::count(text, len - 2));
+
+    utf8_pointer ptr(text);
+    ptr += 100;
+    assert(ptr.c_str() == utf8::offset(text, 100));
+    assert(ptr[50] == utf8::codepoint(utf8::offset(text, 150)));
+
+    // positional access with and without the codepoint index
+    char *part = sample(60000);
+    ustring_t plain(part, 0), indexed(part, 0);
+    indexed.index();
+    assert(plain.count() == walk(part, strlen(part)));
+    assert(indexed.count() == plain.count());
+    for(int pos = 0; pos < (int)plain.count(); pos += 131)
+        assert(plain.at(pos) == indexed.at(pos) && plain(pos) - plain.c_str() == indexed(pos) - indexed.c_str());
+    assert(indexed.at(-1) == plain.at(-1));
+    assert(eq(indexed(5, 10), plain(5, 10)));
+    assert(indexed(5, 10).count() == 10);
+    assert(eq(indexed.right(3), plain.right(3)));
+
+    // a change through String methods leaves the index unused until rebuilt
+    indexed.String::add("\xc3\xa9");
+    assert(indexed.count() == plain.count() + 1);
+    assert(indexed.at(-1) == 0xe9);
+    indexed.index();
+    assert(indexed.at(-1) == 0xe9);
+
+    ustring_t edit("caf\xc3\xa9 \xe2\x89\xa0 x", 0);
+    edit.index();
+    assert(edit.count() == 8);
+    edit.cut(3, 2);
+    assert(eq(edit.c_str(), "caf\xe2\x89\xa0 x"));
+    assert(edit.count() == 6);
+    edit.paste(3, "\xc3\xa9 ", 1);
+    assert(eq(edit.c_str(), "caf\xc3\xa9\xe2\x89\xa0 x"));
+    assert(edit.at(4) == 0x2260);
+
+    // throughput
+    char *big = sample(1 << 20);
+    size_t bytes = strlen(big), total = 0;
+    Timer::tick_t start = Timer::ticks();
+    for(unsigned pass = 0; pass < passes; ++pass)
+        total += utf8::count(big);
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    printf("count %lu MB/s\n", (unsigned long)((uint64_t)bytes * passes * 10 / (elapsed ? elapsed : 1)));
+
+    start = Timer::ticks();
+    for(unsigned pass = 0; pass < passes; ++pass)
+        total += walk(big, bytes);
+    elapsed = Timer::ticks() - start;
+    printf("walk %lu MB/s\n", (unsigned long)((uint64_t)bytes * passes * 10 / (elapsed ? elapsed : 1)));
+
+    memset(big, 'a', bytes);
+    start = Timer::ticks();
+    for(unsigned pass = 0; pass < passes; ++pass)
+        total += utf8::count(big);
+    elapsed = Timer::ticks() - start;
+    printf("ascii count %lu MB/s\n", (unsigned long)((uint64_t)bytes * passes * 10 / (elapsed ? elapsed : 1)));
+
+    // each lookup without the index walks from the start
+    int count = (int)plain.count();
+    if(count > (int)passes * 50)
+        count = (int)passes * 50;
+    ucs4_t sum = 0;
+    start = Timer::ticks();
+    for(int pos = 0; pos < count; ++pos)
+        sum += plain.at(pos);
+    elapsed = Timer::ticks() - start;
+    printf("at %lu lookups/sec\n", (unsigned long)((uint64_t)count * 10000000ull / (elapsed ? elapsed : 1)));
+
+    start = Timer::ticks();
+    for(int pos = 0; pos < count; ++pos)
+        sum -= indexed.at(pos);
+    elapsed = Timer::ticks() - start;
+    printf("indexed at %lu lookups/sec\n", (unsigned long)((uint64_t)count * 10000000ull / (elapsed ? elapsed : 1)));
+    assert(sum == 0 && total > 0);
+
+    free(big);
+    free(part);
+    free(text);
+
 	return 0;
 }
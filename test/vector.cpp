@@ -0,0 +1,157 @@
+// Copyright (C) 2006-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+
+using namespace ucommon;
+
+static unsigned live = 0;
+
+class item : public CountedObject
+{
+public:
+    unsigned id;
+
+    item(unsigned value) : CountedObject(), id(value) {++live;}
+
+protected:
+    void dealloc(void) {
+        --live;
+        delete this;
+    }
+};
+
+#define ITEMS   1000000
+
+static item *items[ITEMS + 1];
+
+static double rate(unsigned long count, Timer::tick_t start)
+{
+    Timer::tick_t elapsed = Timer::ticks() - start;
+    if(!elapsed)
+        elapsed = 1;
+    return (double)count * 10000000.0 / (double)elapsed;
+}
+
+extern "C" int main()
+{
+    for(unsigned pos = 0; pos < ITEMS; ++pos) {
+        items[pos] = new item(pos);
+        items[pos]->retain();
+    }
+    items[ITEMS] = NULL;
+    ObjectProtocol **list = (ObjectProtocol **)items;
+
+    // growth, and references held by the vector
+    vectorof<item> *vec = new vectorof<item>();
+    for(unsigned pos = 0; pos < 100; ++pos)
+        vec->add(items[pos]);
+    assert(vec->len() == 100);
+    assert(vec->size() >= 100);
+    assert((*vec)[0].id == 0);
+    assert((*vec)[1].id == 1);
+    assert((*vec)[-1].id == 99);
+    assert(vec->get(100) == NULL);
+    assert(vec->get(-101) == NULL);
+    assert(items[5]->copied() == 2);
+
+    // copies share until modified
+    Vector *copy = new Vector(*vec);
+    assert(copy->len() == 100);
+    assert(items[5]->copied() == 2);
+    copy->add(items[100]);
+    assert(copy->len() == 101);
+    assert(vec->len() == 100);
+    assert(items[5]->copied() == 3);
+    delete copy;
+    assert(items[5]->copied() == 2);
+    assert(items[100]->copied() == 1);
+
+    // bulk insert and erase
+    vec->insert(10, &list[500], 5);
+    assert(vec->len() == 105);
+    assert((*vec)[9].id == 9);
+    assert((*vec)[10].id == 500);
+    assert((*vec)[14].id == 504);
+    assert((*vec)[15].id == 10);
+    assert(items[502]->copied() == 2);
+    vec->erase(10, 5);
+    assert(vec->len() == 100);
+    assert((*vec)[10].id == 10);
+    assert(items[502]->copied() == 1);
+    vec->erase(98, 10);
+    assert(vec->len() == 98);
+    assert((*vec)[-1].id == 97);
+    vec->insert(0, items[999]);
+    assert((*vec)[0].id == 999);
+    vec->erase(0);
+
+    // appending a vector to itself
+    vec->add(*vec);
+    assert(vec->len() == 196);
+    assert((*vec)[98].id == 0);
+    assert(items[5]->copied() == 3);
+    vec->clear();
+    assert(vec->len() == 0);
+    assert(items[5]->copied() == 1);
+
+    // fixed memory vectors do not grow
+    char mem[sizeof(Vector::array) + 8 * sizeof(ObjectProtocol *)];
+    MemVector *fixed = new MemVector(mem, 8);
+    fixed->add(list, 10);
+    assert(fixed->len() == 8);
+    fixed->clear();
+    delete fixed;
+    assert(items[5]->copied() == 1);
+    delete vec;
+
+    for(unsigned count = 10000; count <= ITEMS; count *= 10) {
+        Timer::tick_t start = Timer::ticks();
+        vec = new vectorof<item>();
+        for(unsigned pos = 0; pos < count; ++pos)
+            vec->add(items[pos]);
+        assert(vec->len() == count);
+        double appends = rate(count, start);
+
+        start = Timer::ticks();
+        vec->erase(count / 2, count / 4);
+        vec->insert(count / 2, &list[count / 2], count / 4);
+        double splices = rate(1, start);
+        assert(vec->len() == count);
+        assert((*vec)[count / 2].id == count / 2);
+        delete vec;
+
+        start = Timer::ticks();
+        vec = new vectorof<item>();
+        vec->add(list, count);
+        double bulk = rate(count, start);
+        delete vec;
+
+        printf("%u: %.0f appends/sec, %.0f bulk/sec, %.0f splices/sec\n", count, appends, bulk, splices);
+    }
+
+    for(unsigned pos = 0; pos < ITEMS; ++pos)
+        items[pos]->release();
+    assert(live == 0);
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Copyright (C) 2010-2014 David Sugar, Tycho Softworks.
+//
+// This file is part of GNU uCommon C++.
+//
+// GNU uCommon C++ is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// GNU uCommon C++ is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with GNU uCommon C++.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEBUG
+#define DEBUG
+#endif
+
+#include <ucommon/ucommon.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _MSWINDOWS_
+#include <unistd.h>
+#endif
+
+using namespace ucommon;
+
+// the tree has TOPS directories of SUBS directories each, with the files
+// spread over the subdirectories.  Pass a file count, such as 1000000, to
+// benchmark a larger tree.
+
+#define TREE    "walker.tmp"
+#define TOPS    10
+#define SUBS    10
+#define FILES   20000
+
+static unsigned files = FILES;
+
+class tally : public DirWalker
+{
+public:
+    volatile unsigned long regular, dirs, links, deepest;
+
+    tally(unsigned depth = (unsigned)-1) : DirWalker(depth) {
+        regular = dirs = links = deepest = 0;
+    }
+
+    bool visit(const char *path, const char *name, type_t type, reader& from, unsigned level) {
+        size_t len = strlen(*from);
+        assert(eq(path, *from, len) && path[len] == '/');
+        assert(eq(path + len + 1, name));
+        switch(type) {
+        case REGULAR:
+            __sync_add_and_fetch(&regular, 1);
+            break;
+        case DIRECTORY:
+            __sync_add_and_fetch(&dirs, 1);
+            break;
+        case SYMLINK:
+            __sync_add_and_fetch(&links, 1);
+            break;
+        default:
+            assert(type == REGULAR);
+        }
+        if(level > deepest)
+            deepest = level;
+        return true;
+    }
+};
+
+// the way a tree was walked before, one entry and one stat at a time
+static unsigned long serial(const char *path)
+{
+    unsigned long count = 0;
+    char name[128], filename[256];
+    struct stat ino;
+    dir_t ds(path);
+
+    while(ds.read(name, sizeof(name)) > 0) {
+        if(eq(name, ".") || eq(name, ".."))
+            continue;
+        ++count;
+        snprintf(filename, sizeof(filename), "%s/%s", path, name);
+        if(!fsys::info(filename, &ino) && S_ISDIR(ino.st_mode))
+            count += serial(filename);
+    }
+    return count;
+}
+
+static void subdir(char *buf, size_t size, unsigned top, unsigned sub)
+{
+    snprintf(buf, size, TREE "/t%u/s%u", top, sub);
+}
+
+static void generate(void)
+{
+    char path[128];
+    unsigned top, sub, pos;
+
+    assert(!dir::create(TREE, 0755));
+    for(top = 0; top < TOPS; ++top) {
+        snprintf(path, sizeof(path), TREE "/t%u", top);
+        assert(!dir::create(path, 0755));
+        for(sub = 0; sub < SUBS; ++sub) {
+            subdir(path, sizeof(path), top, sub);
+            assert(!dir::create(path, 0755));
+        }
+    }
+
+    for(pos = 0; pos < files; ++pos) {
+        char filename[160];
+        subdir(path, sizeof(path), pos % TOPS, (pos / TOPS) % SUBS);
+        snprintf(filename, sizeof(filename), "%s/f%u", path, pos);
+        FILE *fp = fopen(filename, "w");
+        assert(fp != NULL);
+        fclose(fp);
+    }
+}
+
+static void cleanup(void)
+{
+    char path[128], filename[160];
+    unsigned top, sub, pos;
+
+    for(pos = 0; pos < files; ++pos) {
+        subdir(path, sizeof(path), pos % TOPS, (pos / TOPS) % SUBS);
+        snprintf(filename, sizeof(filename), "%s/f%u", path, pos);
+        fsys::erase(filename);
+    }
+
+    for(top = 0; top < TOPS; ++top) {
+        for(sub = 0; sub < SUBS; ++sub) {
+            subdir(path, sizeof(path), top, sub);
+            dir::remove(path);
+        }
+        snprintf(path, sizeof(path), TREE "/t%u", top);
+        dir::remove(path);
+    }
+#ifndef _MSWINDOWS_
+    fsys::erase(TREE "/link");
+#endif
+    dir::remove(TREE);
+}
+
+static unsigned long elapsed(Timer::tick_t start)
+{
+    unsigned long ms = (unsigned long)((Timer::ticks() - start) / 10000);
+    if(!ms)
+        ms = 1;
+    return ms;
+}
+
+extern "C" int main(int argc, char **argv)
+{
+    const unsigned long total = TOPS + TOPS * SUBS;
+    unsigned long links = 0;
+
+    if(argc > 1)
+        files = (unsigned)atol(argv[1]);
+
+    cleanup();
+    generate();
+#ifndef _MSWINDOWS_
+    assert(!symlink("t0", TREE "/link"));
+    links = 1;
+#endif
+
+    // a serial walk finds every entry, and never follows links
+    tally walker;
+    assert(walker.walk(TREE) == files + total + links);
+    assert(walker.regular == files);
+    assert(walker.dirs == total);
+    assert(walker.links == links);
+    assert(walker.deepest == 2);
+
+    // depth limits how far the walk descends
+    tally top(0);
+    assert(top.walk(TREE) == TOPS + links);
+    assert(top.dirs == TOPS && top.regular == 0);
+
+    // a parallel walk finds the same entries
+    Executor pool(4);
+    tally parallel;
+    assert(parallel.walk(TREE, &pool) == files + total + links);
+    assert(parallel.regular == files);
+    assert(parallel.dirs == total);
+
+    // a directory alone through the reader and the pager
+    char path[128];
+    unsigned count = 0;
+    subdir(path, sizeof(path), 0, 0);
+    DirWalker::reader ds(path);
+    assert(ds);
+    while(ds.next())
+        ++count;
+    assert(count == files / (TOPS * SUBS));
+    DirPager pager(path);
+    assert(pager.count() == count);
+
+    DirWalker::reader missing(TREE "/missing");
+    assert(!missing && missing.err() == ENOENT);
+
+    // entry and stat at a time, against batched reads with types
+    Timer::tick_t start = Timer::ticks();
+    assert(serial(TREE) >= files + total);
+    unsigned long old = elapsed(start);
+
+    start = Timer::ticks();
+    walker.walk(TREE);
+    unsigned long batched = elapsed(start);
+
+    start = Timer::ticks();
+    parallel.walk(TREE, &pool);
+    unsigned long crawled = elapsed(start);
+
+    cleanup();
+
+    printf("%u files: %lu ms serial stat, %lu ms batched, %lu ms parallel\n",
+        files, old, batched, crawled);
+    return 0;
+}
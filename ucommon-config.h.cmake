@@ -35,7 +35,13 @@
 #cmakedefine HAVE_WCHAR_H 1
 #cmakedefine HAVE_REGEX_H 1
 #cmakedefine HAVE_SYS_INOTIFY_H 1
+#cmakedefine HAVE_LINUX_FUTEX_H 1
+#cmakedefine HAVE_LINUX_MEMPOLICY_H 1
 #cmakedefine HAVE_SYS_EVENT_H 1
+#cmakedefine HAVE_SYS_EPOLL_H 1
+#cmakedefine HAVE_SYS_SENDFILE_H 1
+#cmakedefine HAVE_SPAWN_H 1
+#cmakedefine HAVE_UCONTEXT_H 1
 #cmakedefine HAVE_SYSLOG_H 1
 #cmakedefine HAVE_LIBINTL_H 1
 #cmakedefine HAVE_NETINET_IN_H 1
@@ -43,6 +49,7 @@
 #cmakedefine HAVE_SYS_PARAM_H 1
 #cmakedefine HAVE_SYS_FILE_H 1
 #cmakedefine HAVE_SYS_LOCKF_H 1
+#cmakedefine HAVE_SYS_RANDOM_H 1
 #cmakedefine HAVE_REGEX_H 1
 
 #cmakedefine HAVE_FTOK 1
@@ -61,13 +68,19 @@
 #cmakedefine HAVE_CLOCK_GETTIME 1
 #cmakedefine HAVE_POSIX_FADVISE 1
 #cmakedefine HAVE_POSIX_MEMALIGN 1
+#cmakedefine HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP 1
 #cmakedefine HAVE_PTHREAD_CONDATTR_SETCLOCK 1
 #cmakedefine HAVE_PTHREAD_DELAY 1
 #cmakedefine HAVE_PTHREAD_DELAY_NP 1
 #cmakedefine HAVE_PTHREAD_SETCONCURRENCY 1
 #cmakedefine HAVE_PTHREAD_SETSCHEDPRIO 1
+#cmakedefine HAVE_PTHREAD_SETAFFINITY_NP 1
 #cmakedefine HAVE_PTHREAD_YIELD 1
 #cmakedefine HAVE_PTHREAD_YIELD_NP 1
+#cmakedefine HAVE_ACCEPT4 1
+#cmakedefine HAVE_SPLICE 1
+#cmakedefine HAVE_RECVMMSG 1
+#cmakedefine HAVE_SENDMMSG 1
 #cmakedefine HAVE_SHL_LOAD 1
 #cmakedefine HAVE_SHM_OPEN 1
 #cmakedefine HAVE_SOCKETPAIR 1
@@ -85,12 +98,16 @@
 #cmakedefine HAVE_EXECVP 1
 #cmakedefine HAVE_ATEXIT 1
 #cmakedefine HAVE_LSTAT 1
+#cmakedefine HAVE_OPENAT 1
+#cmakedefine HAVE_FSTATAT 1
+#cmakedefine HAVE_FDOPENDIR 1
 #cmakedefine HAVE_REALPATH 1
 #cmakedefine HAVE_SYMLINK 1
 #cmakedefine HAVE_READLINK 1
 #cmakedefine HAVE_WAITPID 1
 #cmakedefine HAVE_WAIT4 1
 #cmakedefine HAVE_SETGROUPS 1
+#cmakedefine HAVE_GETRANDOM 1
 #cmakedefine HAVE_FCNTL_H 1
 #cmakedefine HAVE_TERMIOS_H 1
 #cmakedefine HAVE_TERMIO_H 1
@@ -32,6 +32,7 @@ static shell::flagopt quiet('q', "--quiet", _TEXT("quiet operation"));
 static shell::flagopt recursive('R', "--recursive", _TEXT("recursive directory scan"));
 static shell::flagopt altrecursive('r', NULL, NULL);
 static shell::flagopt hidden('s', "--hidden", _TEXT("include hidden files"));
+static shell::flagopt throughput('T', "--throughput", _TEXT("report MB/s processed"));
 static shell::flagopt yes('y', "--overwrite", _TEXT("overwrite existing files"));
 
 static bool binary = false;
@@ -42,6 +43,85 @@ static cipher_t cipher;
 static FILE *output = stdout;
 static enum {d_text, d_file, d_scan, d_init} decoder = d_init;
 static unsigned frames;
+static unsigned long long total_bytes = 0;
+
+// frames moved per archive i/o call; a frame is one 48 byte cipher block
+static const size_t BLOCK_FRAMES = 21845;
+static const size_t FRAME_SIZE = 48;
+static const size_t LINE_SIZE = 65;
+
+/**
+ * Double buffered archive i/o.  One buffer is filled or drained by the
+ * main (cipher) thread while a worker thread moves the other to or from
+ * the archive file, so cipher work and archive i/o overlap.
+ */
+class __LOCAL pipeline : public JoinableThread, private Conditional
+{
+protected:
+    unsigned char *blocks[2];
+    size_t counts[2];
+    bool ready[2];
+    unsigned active, worker;
+    volatile bool stopping;
+    FILE *fp;
+
+    pipeline(FILE *file);
+    virtual ~pipeline();
+
+    unsigned char *wait_block(bool state);
+    void post_block(bool state);
+    void drain(void);
+    void finish(void);
+
+    // worker side...
+    bool take_block(bool state);
+    void give_block(bool state);
+};
+
+/**
+ * Archive writer; ciphered frames are gathered into large blocks and
+ * written, base64 line encoded for ascii archives, by the worker.
+ */
+class __LOCAL blockwriter : public pipeline
+{
+public:
+    blockwriter(FILE *file);
+    ~blockwriter();
+
+    unsigned char *reserve(size_t *avail);
+    void commit(size_t count);
+    void flush(void);
+
+private:
+    char *text;
+    unsigned char *current;
+    size_t used;
+
+    void run(void);
+};
+
+/**
+ * Archive reader; the worker reads blocks of frames, decoding base64
+ * lines for ascii archives, while the cipher thread processes the last.
+ */
+class __LOCAL blockreader : public pipeline
+{
+public:
+    blockreader(FILE *file);
+    ~blockreader();
+
+    size_t get(unsigned char **addr);
+    void release(void);
+
+    bool failed;
+
+private:
+    unsigned char *current;
+
+    void run(void);
+};
+
+static blockwriter *writer = NULL;
 
 static void report(const char *path, int code)
 {
@@ -97,61 +177,277 @@ static void report(const char *path, int code)
     exit_code = 1;
 }
 
-static bool encode(const char *path, FILE *fp, size_t offset = 0)
+pipeline::pipeline(FILE *file) : JoinableThread(), Conditional()
 {
-    memset(frame, 0, sizeof(frame));
+    blocks[0] = new unsigned char[BLOCK_FRAMES * FRAME_SIZE];
+    blocks[1] = new unsigned char[BLOCK_FRAMES * FRAME_SIZE];
+    counts[0] = counts[1] = 0;
+    ready[0] = ready[1] = false;
+    active = worker = 0;
+    stopping = false;
+    fp = file;
+}
 
-    size_t count = fread(frame + offset, 1, sizeof(frame) - offset, fp);
-    char buffer[128];
+pipeline::~pipeline()
+{
+    zerofill(blocks[0], BLOCK_FRAMES * FRAME_SIZE);
+    zerofill(blocks[1], BLOCK_FRAMES * FRAME_SIZE);
+    delete[] blocks[0];
+    delete[] blocks[1];
+}
+
+// wait until the cipher thread's next block is in the given state
+unsigned char *pipeline::wait_block(bool state)
+{
+    lock();
+    while(ready[active] != state)
+        Conditional::wait();
+    unlock();
+    return blocks[active];
+}
+
+void pipeline::post_block(bool state)
+{
+    lock();
+    ready[active] = state;
+    active = (active + 1) % 2;
+    broadcast();
+    unlock();
+}
+
+void pipeline::drain(void)
+{
+    lock();
+    while(ready[0] || ready[1])
+        Conditional::wait();
+    unlock();
+}
+
+void pipeline::finish(void)
+{
+    lock();
+    stopping = true;
+    broadcast();
+    unlock();
+    join();
+}
+
+bool pipeline::take_block(bool state)
+{
+    bool result;
+
+    lock();
+    while(ready[worker] != state && !stopping)
+        Conditional::wait();
+    result = (ready[worker] == state);
+    unlock();
+    return result;
+}
+
+void pipeline::give_block(bool state)
+{
+    lock();
+    ready[worker] = state;
+    worker = (worker + 1) % 2;
+    broadcast();
+    unlock();
+}
+
+blockwriter::blockwriter(FILE *file) : pipeline(file)
+{
+    text = new char[BLOCK_FRAMES * LINE_SIZE + 1];
+    current = NULL;
+    used = 0;
+    start();
+}
+
+blockwriter::~blockwriter()
+{
+    flush();
+    finish();
+    delete[] text;
+}
 
-    if(ferror(fp)) {
-        report(path, errno);
-        return false;
+unsigned char *blockwriter::reserve(size_t *avail)
+{
+    if(!current) {
+        current = wait_block(false);
+        used = 0;
     }
+    *avail = BLOCK_FRAMES - used;
+    return current + used * FRAME_SIZE;
+}
 
-    if(count)
-        count += offset;
+void blockwriter::commit(size_t count)
+{
+    used += count;
+    total_bytes += count * FRAME_SIZE;
+    if(used < BLOCK_FRAMES)
+        return;
 
-    // add padd value for last frame...
-    if(count < sizeof(frame))
-        frame[sizeof(frame) - 1] = (char)(count - offset);
+    counts[active] = used;
+    current = NULL;
+    post_block(true);
+}
 
-    // cipher it...
-    size_t encoded = cipher.put(frame, sizeof(frame));
-    if(encoded != sizeof(frame)) {
-        report(path, EINTR);
-        return false;
+void blockwriter::flush(void)
+{
+    if(current && used) {
+        counts[active] = used;
+        current = NULL;
+        post_block(true);
     }
+    drain();
+}
+
+void blockwriter::run(void)
+{
+    while(take_block(true)) {
+        unsigned char *block = blocks[worker];
+        size_t count = counts[worker];
 
-    if(binary)
-        fwrite(cbuf, sizeof(cbuf), 1, output);
-    else {
-        String::b64encode(buffer, cbuf, 48);
-        fprintf(output, "%s\n", buffer);
+        if(binary)
+            fwrite(block, FRAME_SIZE, count, fp);
+        else {
+            for(size_t pos = 0; pos < count; ++pos) {
+                char *line = text + pos * LINE_SIZE;
+                String::b64encode(line, block + pos * FRAME_SIZE, FRAME_SIZE);
+                line[LINE_SIZE - 1] = '\n';
+            }
+            fwrite(text, LINE_SIZE, count, fp);
+        }
+        fflush(fp);
+        give_block(false);
     }
+}
 
-    // return status
-    if(count == sizeof(frame))
-        return true;
+blockreader::blockreader(FILE *file) : pipeline(file)
+{
+    failed = false;
+    current = NULL;
+    start();
+}
+
+blockreader::~blockreader()
+{
+    finish();
+}
 
-    return false;
+size_t blockreader::get(unsigned char **addr)
+{
+    current = wait_block(true);
+    *addr = current;
+    return counts[active];
 }
 
-static void encodestream(void)
+void blockreader::release(void)
 {
+    current = NULL;
+    post_block(false);
+}
 
-    size_t offset = 6;
+void blockreader::run(void)
+{
+    char buffer[128];
+    size_t count;
+    bool ending = false;
 
-    if(fsys::is_tty(shell::input()))
-        fputs("car: type your message\n", stderr);
+    while(!ending && take_block(false)) {
+        unsigned char *block = blocks[worker];
 
-    memset(frame, 0, sizeof(frame));
+        if(binary) {
+            count = fread(block, FRAME_SIZE, BLOCK_FRAMES, fp);
+            if(count < BLOCK_FRAMES)
+                ending = true;
+        }
+        else for(count = 0; count < BLOCK_FRAMES;) {
+            if(fgets(buffer, sizeof(buffer), fp) == NULL ||
+              eq("-----END CAR STREAM-----\n", buffer)) {
+                ending = true;
+                break;
+            }
+
+            // ignore extra headers...
+            if(strstr(buffer, ": "))
+                continue;
+
+            if(String::b64decode(block + count * FRAME_SIZE, buffer, FRAME_SIZE) < FRAME_SIZE) {
+                failed = ending = true;
+                break;
+            }
+            ++count;
+        }
+
+        if(ferror(fp)) {
+            exit_code = errno;
+            failed = ending = true;
+        }
+
+        counts[worker] = count;
+        give_block(true);
+        if(!count)
+            return;
+    }
+
+    // empty block marks end of archive...
+    if(take_block(false)) {
+        counts[worker] = 0;
+        give_block(true);
+    }
+}
+
+// cipher a run of frames in place and restore single frame buffer
+static void crypt(unsigned char *data, size_t count)
+{
+    cipher.process(data, count * FRAME_SIZE);
+    cipher.set(cbuf, sizeof(cbuf));
+}
+
+static bool encode(const char *path, FILE *fp, size_t offset = 0)
+{
+    size_t avail, count, full, lead;
+    unsigned char *block;
 
     for(;;) {
-        if(!encode("-", stdin, offset))
-            break;
+        block = writer->reserve(&avail);
+        lead = offset;
         offset = 0;
+
+        memset(block, 0, lead);
+        count = lead + fread(block + lead, 1, avail * FRAME_SIZE - lead, fp);
+
+        if(ferror(fp)) {
+            report(path, errno);
+            return false;
+        }
+
+        if(count == avail * FRAME_SIZE) {
+            crypt(block, avail);
+            writer->commit(avail);
+            continue;
+        }
+
+        // add pad value for last frame...
+        full = count / FRAME_SIZE;
+        count -= full * FRAME_SIZE;
+        memset(block + full * FRAME_SIZE + count, 0, FRAME_SIZE - count);
+        if(!full)
+            count -= lead;
+        block[full * FRAME_SIZE + FRAME_SIZE - 1] = (unsigned char)count;
+        crypt(block, ++full);
+        writer->commit(full);
+        return true;
     }
+}
+
+static void encodestream(void)
+{
+    if(fsys::is_tty(shell::input()))
+        fputs("car: type your message\n", stderr);
+
+    encode("-", stdin, 6);
+    delete writer;
+    writer = NULL;
 
     if(!binary && !is(noheader))
         fprintf(output, "-----END CAR STREAM-----\n");
@@ -171,9 +467,9 @@ static void header(void)
 
 static void encodefile(const char *path, const char *name)
 {
-    char buffer[128];
-
     fsys::fileinfo_t ino;
+    unsigned char *block;
+    size_t avail;
 
     fsys::info(path, &ino);
 
@@ -183,24 +479,16 @@ static void encodefile(const char *path, const char *name)
         return;
     }
 
-    lsb_setlong(frame, ino.st_size);
-    frame[4] = 1;
-    frame[5] = 0;
-    String::set((char *)(frame + 6), sizeof(frame) - 6, name);
-
-    cipher.put(frame, sizeof(frame));
+    block = writer->reserve(&avail);
+    memset(block, 0, FRAME_SIZE);
+    lsb_setlong(block, ino.st_size);
+    block[4] = 1;
+    block[5] = 0;
+    String::set((char *)(block + 6), FRAME_SIZE - 6, name);
+    crypt(block, 1);
+    writer->commit(1);
 
-    if(binary)
-        fwrite(cbuf, sizeof(cbuf), 1, output);
-    else {
-        String::b64encode(buffer, cbuf, 48);
-        fprintf(output, "%s\n", buffer);
-    }
-
-    for(;;) {
-        if(!encode(name, fp))
-            break;
-    }
+    encode(name, fp);
     fclose(fp);
 }
 
@@ -279,6 +567,9 @@ static void process(void)
             }
         }
 
+        if(output != stdout)
+            fclose(output);
+
         output = fopen(*path, "w");
         if(!output)
             shell::errexit(8, "*** %s: %s: %s\n",
@@ -298,12 +589,61 @@ static void process(void)
     }
 }
 
-static void binarydecode(FILE *fp, const char *path)
+static void decodeblocks(FILE *fp, const char *path)
 {
-    char buffer[48];
+    blockreader reader(fp);
+    unsigned char *block;
+    size_t count, pos, run;
+    bool pending = false;
+
+    decoder = d_scan;
+    for(;;) {
+        count = reader.get(&block);
+        if(!count) {
+            if(pending && !reader.failed)
+                final();
+            break;
+        }
 
+        if(pending)
+            process();
+
+        total_bytes += count * FRAME_SIZE;
+
+        // the last frame is held back in case it is the final pad frame
+        for(pos = 0; pos < count - 1; pos += run) {
+            run = count - 1 - pos;
+            if(decoder == d_file && frames < run)
+                run = frames;
+
+            if(decoder == d_text || (decoder == d_file && run)) {
+                crypt(block + pos * FRAME_SIZE, run);
+                fwrite(block + pos * FRAME_SIZE, FRAME_SIZE, run, output);
+                if(decoder == d_file)
+                    frames -= (unsigned)run;
+                continue;
+            }
+
+            run = 1;
+            memcpy(frame, block + pos * FRAME_SIZE, FRAME_SIZE);
+            process();
+        }
+
+        memcpy(frame, block + pos * FRAME_SIZE, FRAME_SIZE);
+        pending = true;
+        reader.release();
+    }
+
+    if(output != stdout)
+        fclose(output);
+
+    if(reader.failed)
+        report(path, exit_code ? exit_code : EINTR);
+}
+
+static void binarydecode(FILE *fp, const char *path)
+{
     memset(frame, 0, sizeof(frame));
-    memset(buffer, 0, sizeof(buffer));
     if(fread(frame, sizeof(frame), 1, fp) < 1)
         shell::errexit(6, "*** %s: %s: %s\n",
             argv0, path, _TEXT("cannot read archive"));
@@ -312,23 +652,8 @@ static void binarydecode(FILE *fp, const char *path)
         shell::errexit(6, "*** %s: %s: %s\n",
             argv0, path, _TEXT("not a cryptographic archive"));
 
-    for(;;) {
-        if(feof(fp)) {
-            final();
-            return;
-        }
-
-        if(ferror(fp)) {
-            exit_code = errno;
-            report(path, exit_code);
-            return;
-        }
-
-        if(fread(buffer, sizeof(buffer), 1, fp) < 1)
-            continue;
-        process();
-        memcpy(frame, buffer, sizeof(frame));
-    }
+    binary = true;
+    decodeblocks(fp, path);
 }
 
 static void streamdecode(FILE *fp, const char *path)
@@ -347,37 +672,8 @@ static void streamdecode(FILE *fp, const char *path)
         if(eq("-----BEGIN CAR STREAM-----\n", buffer))
             break;
     }
-    for(;;) {
-        if(feof(fp)) {
-            final();
-            return;
-        }
 
-        if(ferror(fp)) {
-            exit_code = errno;
-            report(path, exit_code);
-            return;
-        }
-
-        if(fgets(buffer, sizeof(buffer), fp) == NULL)
-            continue;
-
-        if(eq("-----END CAR STREAM-----\n", buffer)) {
-            final();
-            return;
-        }
-
-        // ignore extra headers...
-        if(strstr(buffer, ": "))
-            continue;
-
-        process();
-        unsigned len = String::b64decode(frame, buffer, 48);
-        if(len < 48) {
-            report(path, EINTR);
-            return;
-        }
-    }
+    decodeblocks(fp, path);
 }
 
 static void scan(string_t path, string_t prefix)
@@ -421,6 +717,7 @@ PROGRAM_MAIN(argc, argv)
     char passphrase[256];
     char confirm[256];
     const char *ext;
+    Timer::tick_t started;
 
     argv0 = args.argv0();
 
@@ -462,6 +759,8 @@ PROGRAM_MAIN(argc, argv)
     else
         cipher.set(&key, Cipher::ENCRYPT, cbuf, sizeof(cbuf));
 
+    started = Timer::ticks();
+
     if(is(decode) && !args()) {
         streamdecode(stdin, "-");
         goto end;
@@ -503,6 +802,8 @@ PROGRAM_MAIN(argc, argv)
             fprintf(output, "Tag: %s\n", *tag);
     }
 
+    writer = new blockwriter(output);
+
     if(!args()) {
         encodestream();
         goto end;
@@ -524,10 +825,25 @@ PROGRAM_MAIN(argc, argv)
         }
     }
 
+    delete writer;
+    writer = NULL;
+
     if(!binary && !is(noheader))
         fprintf(output, "-----END CAR STREAM-----\n");
 
 end:
+    if(writer)
+        delete writer;
+
+    if(is(throughput)) {
+        Timer::tick_t elapsed = Timer::ticks() - started;
+        double secs = (double)(elapsed ? elapsed : 1) / 10000000.0;
+        fprintf(stderr, "%s: %s %.1f MB in %.3f sec, %.1f MB/s\n",
+            argv0, binary ? "binary" : "ascii",
+            (double)total_bytes / (1024.0 * 1024.0), secs,
+            (double)total_bytes / (1024.0 * 1024.0) / secs);
+    }
+
     PROGRAM_EXIT(exit_code);
 }
 
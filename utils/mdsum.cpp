@@ -17,21 +17,120 @@
 
 #include <ucommon/secure.h>
 #include <sys/stat.h>
+#ifndef _MSWINDOWS_
+#include <sys/mman.h>
+#endif
 
 using namespace ucommon;
 
 static shell::flagopt helpflag('h',"--help",    _TEXT("display this list"));
 static shell::flagopt althelp('?', NULL, NULL);
 static shell::stringopt hash('d', "--digest", _TEXT("digest method (md5)"), "method", "md5");
+static shell::numericopt jobs('j', "--jobs", _TEXT("files to digest in parallel (1-x)"), "count", 1);
 static shell::flagopt recursive('R', "--recursive", _TEXT("recursive directory scan"));
 static shell::flagopt altrecursive('r', NULL, NULL);
 static shell::flagopt hidden('s', "--hidden", _TEXT("show hidden files"));
+static shell::flagopt throughput('t', "--throughput", _TEXT("report files/s and MB/s"));
+
+// files at or above this size are mapped rather than read...
+static const size_t MAPPED_FILE = 1024 * 1024;
+static const size_t BUFFER_SIZE = 64 * 1024;
 
 static int exit_code = 0;
 static const char *argv0 = "md";
-static digest_t md;
+static const char *method = "md5";
+static unsigned long total_files = 0;
+static unsigned long long total_bytes = 0;
+
+/**
+ * A file queued for parallel digest.  Results are kept with the entry so
+ * they can be reported in the order the files were scanned.
+ */
+class __LOCAL entry : public OrderedObject
+{
+public:
+    string_t path;
+    string_t result;
+    unsigned long long bytes;
+    int code;
+    volatile bool done;
+
+    entry(OrderedIndex *index, const char *filepath);
+};
+
+/**
+ * Shared work list for parallel digest workers.  Workers claim entries
+ * in scan order and the main thread reports them back in that order.
+ */
+class __LOCAL worklist : public Conditional
+{
+public:
+    OrderedIndex list;
+    entry *next;
+
+    worklist();
+
+    entry *claim(void);
+    void finish(entry *node);
+    void wait_for(entry *node);
+};
+
+class __LOCAL worker : public JoinableThread
+{
+public:
+    worker(worklist *work);
+    ~worker();
+
+private:
+    worklist *queue;
+
+    void run(void);
+};
+
+static worklist *work = NULL;
+
+entry::entry(OrderedIndex *index, const char *filepath) :
+OrderedObject(index), path(filepath)
+{
+    bytes = 0;
+    code = 0;
+    done = false;
+}
+
+worklist::worklist() : Conditional()
+{
+    next = NULL;
+}
+
+entry *worklist::claim(void)
+{
+    entry *node;
+
+    lock();
+    node = next;
+    if(node)
+        next = static_cast<entry *>(node->getNext());
+    unlock();
+    return node;
+}
 
-static void result(const char *path, int code)
+void worklist::finish(entry *node)
+{
+    lock();
+    node->done = true;
+    broadcast();
+    unlock();
+}
+
+void worklist::wait_for(entry *node)
+{
+    lock();
+    while(!node->done)
+        Conditional::wait();
+    unlock();
+}
+
+static void result(const char *path, int code, const char *text = NULL)
 {
     const char *err = _TEXT("i/o error");
 
@@ -80,7 +179,7 @@ static void result(const char *path, int code)
     if(!code) {
         if(!path)
             path="-";
-        shell::printf("%s %s\n", *md, path);
+        shell::printf("%s %s\n", text, path);
         return;
     }
 
@@ -92,47 +191,143 @@ static void result(const char *path, int code)
     exit_code = 1;
 }
 
-static void digest(const char *path = NULL)
+// compute digest of a file into md, count bytes hashed, and return error...
+static int digest(digest_t& md, const char *path, unsigned long long& bytes)
 {
     fsys_t fs;
     fsys::fileinfo_t ino;
-    unsigned char buffer[1024];
+    caddr_t buffer;
+    int err;
 
+    bytes = 0;
     if(path) {
-        int err = fsys::info(path, &ino);
+        err = fsys::info(path, &ino);
 
-        if(err) {
-            result(path, err);
-            return;
-        }
+        if(err)
+            return err;
 
-        if(fsys::is_sys(&ino)) {
-            result(path, EBADF);
-            return;
-        }
+        if(fsys::is_sys(&ino))
+            return EBADF;
 
         fs.open(path, fsys::STREAM);
     }
     else
         fs.assign(shell::input());
 
-    if(!is(fs)) {
-        result(path, fs.err());
-        return;
+    if(!is(fs))
+        return fs.err();
+
+#ifndef _MSWINDOWS_
+    if(path && (size_t)ino.st_size >= MAPPED_FILE) {
+        size_t size = (size_t)ino.st_size;
+        void *map = ::mmap(NULL, size, PROT_READ, MAP_SHARED, *fs, 0);
+        if(map != MAP_FAILED) {
+#ifdef  MADV_SEQUENTIAL
+            ::madvise(map, size, MADV_SEQUENTIAL);
+#endif
+            // feed in large slices so the digest stays cache friendly
+            for(size_t pos = 0; pos < size; pos += BUFFER_SIZE * 16) {
+                size_t slice = size - pos;
+                if(slice > BUFFER_SIZE * 16)
+                    slice = BUFFER_SIZE * 16;
+                md.put((caddr_t)map + pos, slice);
+            }
+            ::munmap(map, size);
+            bytes = size;
+            fs.close();
+            return fs.err();
+        }
     }
+#endif
 
+    buffer = new char[BUFFER_SIZE];
     for(;;) {
-        ssize_t size = fs.read(buffer, sizeof(buffer));
+        ssize_t size = fs.read(buffer, BUFFER_SIZE);
         if(size < 1)
             break;
         md.put(buffer, size);
+        bytes += size;
     }
+    delete[] buffer;
 
     fs.close();
-    result(path, fs.err());
+    return fs.err();
+}
+
+static void digest(const char *path = NULL)
+{
+    static digest_t md = method;
+    unsigned long long bytes;
+
+    if(work) {
+        new entry(&work->list, path);
+        return;
+    }
+
+    int err = digest(md, path, bytes);
+    if(!err) {
+        ++total_files;
+        total_bytes += bytes;
+    }
+    result(path, err, *md);
     md.reset();
 }
 
+worker::worker(worklist *work) : JoinableThread()
+{
+    queue = work;
+}
+
+worker::~worker()
+{
+    join();
+}
+
+void worker::run(void)
+{
+    digest_t md = method;
+    entry *node;
+
+    while(NULL != (node = queue->claim())) {
+        node->code = digest(md, node->path, node->bytes);
+        if(!node->code)
+            node->result = *md;
+        md.reset();
+        queue->finish(node);
+    }
+}
+
+static void parallel(unsigned count)
+{
+    worker **workers;
+    unsigned pos;
+
+    work->next = static_cast<entry *>(work->list.begin());
+    if(!work->next)
+        return;
+
+    workers = new worker*[count];
+    for(pos = 0; pos < count; ++pos) {
+        workers[pos] = new worker(work);
+        workers[pos]->start();
+    }
+
+    linked_pointer<entry> ep = work->list.begin();
+    while(is(ep)) {
+        work->wait_for(*ep);
+        if(!ep->code) {
+            ++total_files;
+            total_bytes += ep->bytes;
+        }
+        result(ep->path, ep->code, ep->result);
+        ep.next();
+    }
+
+    for(pos = 0; pos < count; ++pos)
+        delete workers[pos];
+    delete[] workers;
+}
+
 static void scan(String path, bool top = true)
 {
     char filename[128];
@@ -164,6 +359,7 @@ PROGRAM_MAIN(argc, argv)
     shell args(argc, argv);
     argv0 = args.argv0();
     unsigned count = 0;
+    Timer::tick_t started = Timer::ticks();
 
     argv0 = args.argv0();
 
@@ -176,16 +372,24 @@ PROGRAM_MAIN(argc, argv)
         PROGRAM_EXIT(0);
     }
 
+    if(*jobs < 1)
+        shell::errexit(3, "*** %s: jobs: %ld: %s\n",
+            argv0, *jobs, _TEXT("must be at least one"));
+
     secure::init();
     if(!Digest::has(*hash))
         shell::errexit(2, "*** %s: %s: %s\n",
             argv0, *hash, _TEXT("unkown or unsupported digest method"));
 
-    md = *hash;
+    method = *hash;
 
     // we can symlink md as md5, etc, to set alternate default digest names
     if(!is(hash) && Digest::has(argv0))
-        md = argv0;
+        method = argv0;
+
+    // stdin is always digested serially, as it cannot be scheduled...
+    if(*jobs > 1 && args())
+        work = new worklist();
 
     if(!args())
         digest();
@@ -196,6 +400,16 @@ PROGRAM_MAIN(argc, argv)
             digest(args[count++]);
     }
 
+    if(work)
+        parallel((unsigned)*jobs);
+
+    if(is(throughput)) {
+        Timer::tick_t elapsed = Timer::ticks() - started;
+        double secs = (double)(elapsed ? elapsed : 1) / 10000000.0;
+        shell::printf("%s: %lu files, %.1f MB in %.3f sec, %.1f files/s, %.1f MB/s\n",
+            argv0, total_files, (double)total_bytes / (1024.0 * 1024.0), secs,
+            (double)total_files / secs, (double)total_bytes / (1024.0 * 1024.0) / secs);
+    }
+
     PROGRAM_EXIT(exit_code);
 }
-
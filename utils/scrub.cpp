@@ -17,22 +17,101 @@
 
 #include <ucommon/secure.h>
 #include <sys/stat.h>
+#ifndef _MSWINDOWS_
+#include <fcntl.h>
+#endif
 
 using namespace ucommon;
 
 static shell::flagopt helpflag('h',"--help",    _TEXT("display this list"));
 static shell::flagopt althelp('?', NULL, NULL);
 static shell::numericopt blocks('b', "--blocksize", _TEXT("size of i/o blocks in k (1-x)"), "size k", 1);
+static shell::flagopt direct('D', "--direct", _TEXT("bypass page cache (O_DIRECT)"));
 static shell::flagopt follow('F', "--follow", _TEXT("follow symlinks"));
+static shell::numericopt jobs('j', "--jobs", _TEXT("files to scrub in parallel (1-x)"), "count", 1);
 static shell::numericopt passes('p', "--passes", _TEXT("passes with randomized data (0-x)"), "count", 1);
 static shell::flagopt renamefile('n', "--rename", _TEXT("rename file randomly"));
 static shell::flagopt recursive('R', "--recursive", _TEXT("recursive directory scan"));
 static shell::flagopt altrecursive('r', NULL, NULL);
+static shell::flagopt throughput('T', "--throughput", _TEXT("report MB/s for each pass"));
 static shell::flagopt truncflag('t', "--truncate", _TEXT("decompose file by truncation"));
 static shell::flagopt verbose('v', "--verbose", _TEXT("show active status"));
 
+// size and alignment of i/o buffers, aligned for direct i/o
+static const size_t IO_BUFFER = 1024l * 1024l;
+static const size_t IO_ALIGN = 4096;
+
 static int exit_code = 0;
 static const char *argv0 = "scrub";
+static bool parallel = false;
+static Mutex reporting;
+
+// bytes written and time spent for each pass, final zero pass last
+static unsigned long long *pass_bytes = NULL;
+static Timer::tick_t *pass_ticks = NULL;
+
+/**
+ * Userspace random stream for fill passes.  This runs a randomly keyed
+ * cipher over its own output, so refills need no system calls.  If the
+ * crypto backend has no ciphers we fall back to Random::fill.
+ */
+class __LOCAL randomstream
+{
+public:
+    randomstream();
+    ~randomstream();
+
+    void fill(unsigned char *buffer, size_t size);
+
+private:
+    cipher_t cipher;
+    skey_t *key;
+};
+
+/**
+ * Per thread scrub state.  Each worker owns its own aligned buffer and
+ * random stream so files can be scrubbed concurrently.
+ */
+class __LOCAL scrubber
+{
+public:
+    scrubber();
+    ~scrubber();
+
+    void scrub(const char *path);
+
+private:
+    unsigned char *memory, *block;
+    randomstream random;
+
+    int fill(fsys_t& fs, fsys::offset_t size, unsigned pass);
+};
+
+/**
+ * A queued path for parallel scrub.
+ */
+class __LOCAL entry : public OrderedObject
+{
+public:
+    string_t path;
+    bool directory;
+
+    entry(OrderedIndex *index, const char *filepath, bool dir);
+};
+
+class __LOCAL worker : public JoinableThread
+{
+public:
+    worker();
+    ~worker();
+
+private:
+    void run(void);
+};
+
+static OrderedIndex worklist;
+static entry *next_entry = NULL;
+static Mutex claiming;
 
 static void report(const char *path, int code)
 {
@@ -77,13 +156,19 @@ static void report(const char *path, int code)
 #endif
     }
 
+    Mutex::autolock lock(&reporting);
+
     if(!code) {
-        if(is(verbose))
+        if(is(verbose) && parallel)
+            shell::printf("%s%s\n", path, _TEXT(" removed"));
+        else if(is(verbose))
             shell::printf("%s\n", _TEXT(" removed"));
         return;
     }
 
-    if(is(verbose))
+    if(is(verbose) && parallel)
+        shell::printf("%s - %s\n", path, err);
+    else if(is(verbose))
         shell::printf(" - %s\n", err);
     else
         shell::errexit(1, "*** %s: %s: %s\n", argv0, path, err);
@@ -91,17 +176,109 @@ static void report(const char *path, int code)
     exit_code = 1;
 }
 
-static void scrub(const char *path)
+randomstream::randomstream()
+{
+    unsigned char seed[32];
+    char text[64];
+
+    key = NULL;
+    if(!Cipher::has("aes256") || Random::key(seed, sizeof(seed)) < sizeof(seed))
+        return;
+
+    String::b64encode(text, seed, sizeof(seed));
+    key = new skey_t("aes256", "sha256", text);
+    zerofill(seed, sizeof(seed));
+    zerofill(text, sizeof(text));
+
+    if(!*key) {
+        delete key;
+        key = NULL;
+        return;
+    }
+    cipher.set(key, Cipher::ENCRYPT, NULL);
+}
+
+randomstream::~randomstream()
+{
+    if(key)
+        delete key;
+}
+
+void randomstream::fill(unsigned char *buffer, size_t size)
+{
+    // io buffers are cipher aligned, so whole buffer is ciphered in place
+    if(!key || size % cipher.align() || cipher.process(buffer, size) != size)
+        Random::fill(buffer, size);
+}
+
+scrubber::scrubber()
+{
+    // over-allocate so the buffer can be aligned for direct i/o
+    memory = new unsigned char[IO_BUFFER + IO_ALIGN];
+    block = memory + (IO_ALIGN - ((uintptr_t)memory % IO_ALIGN)) % IO_ALIGN;
+    memset(block, 0, IO_BUFFER);
+}
+
+scrubber::~scrubber()
+{
+    delete[] memory;
+}
+
+int scrubber::fill(fsys_t& fs, fsys::offset_t size, unsigned pass)
 {
-    fsys_t fs;
-    fsys::fileinfo_t ino;
-    unsigned char block[1024];
-    unsigned long count;
     fsys::offset_t pos = 0l;
     unsigned dots = 0;
-    unsigned pass = 0;
+    Timer::tick_t started = Timer::ticks();
+
+    if(pass < (unsigned)(*passes))
+        random.fill(block, IO_BUFFER);
+    else
+        memset(block, 0, IO_BUFFER);
+
+    fs.seek(0l);
+    if(fs.err())
+        return fs.err();
 
-    if(is(verbose))
+    while(pos < size) {
+        size_t count = IO_BUFFER;
+        if((fsys::offset_t)count > size - pos)
+            count = (size_t)(size - pos);
+
+        if(++dots >= 16 && is(verbose) && !parallel) {
+            dots = 0;
+            shell::printf(".");
+        }
+
+        fs.write(block, count);
+        if(fs.err())
+            return fs.err();
+
+        pos += (fsys::offset_t)count;
+        if(pass < (unsigned)(*passes) && pos < size)
+            random.fill(block, IO_BUFFER);
+    }
+
+    // each pass must reach the media before the next overwrites it...
+    if(!is(direct))
+        fs.sync();
+
+    if(is(throughput)) {
+        Mutex::autolock lock(&reporting);
+        pass_bytes[pass] += (unsigned long long)size;
+        pass_ticks[pass] += Timer::ticks() - started;
+    }
+
+    return fs.err();
+}
+
+void scrubber::scrub(const char *path)
+{
+    fsys_t fs;
+    fsys::fileinfo_t ino;
+    fsys::offset_t size, align;
+    unsigned pass;
+
+    if(is(verbose) && !parallel)
         shell::printf("%s", path);
 
     int err = fsys::info(path, &ino);
@@ -121,64 +298,48 @@ static void scrub(const char *path)
         return;
     }
 
-    count = (ino.st_size + 1023l) / 1024;
-    count /= (fsys::offset_t)(*blocks);
-    count *= (fsys::offset_t)(*blocks);
-
+    // final length is rounded up to whole blocks, so the tail of the file
+    // is overwritten too, and then to direct i/o alignment
+    align = 1024l * (fsys::offset_t)(*blocks);
+    size = ((ino.st_size + align - 1) / align) * align;
+    if(is(direct))
+        size = ((size + IO_ALIGN - 1) / IO_ALIGN) * IO_ALIGN;
+
+#if defined(O_DIRECT) && !defined(_MSWINDOWS_)
+    if(is(direct)) {
+        int fd = ::open(path, O_WRONLY | O_DIRECT);
+        if(fd > -1)
+            fs.assign(fd);
+        else
+            fs.open(path, fsys::REWRITE);
+    }
+    else
+#endif
     fs.open(path, fsys::REWRITE);
+
     if(!is(fs)) {
         report(path, fs.err());
         return;
     }
 
-    while(count--) {
-        while(++dots > 16384) {
-            dots = 0;
-            if(is(verbose))
-                shell::printf(".");
-        }
-        pass = 0;
+    // we followup with a zero fill always as it is friendly for many
+    // virtual machine image formats which can later re-pack unused disk
+    // space, and if no random passes are specified, we at least do this.
 
-repeat:
-        fs.seek(pos);
-        if(fs.err()) {
-            report(path, fs.err());
+    for(pass = 0; pass <= (unsigned)(*passes); ++pass) {
+        err = fill(fs, size, pass);
+        if(err) {
+            report(path, err);
             fs.close();
             return;
         }
-        if(pass < (unsigned)(*passes)) {
-            Random::fill(block, 1024);
-            fs.write(block, 1024);
-            if(fs.err()) {
-                report(path, fs.err());
-                fs.close();
-                return;
-            }
-            if(++pass < (unsigned)(*passes))
-                goto repeat;
-        }
-
-        // we followup with a zero fill always as it is friendly for many
-        // virtual machine image formats which can later re-pack unused disk
-        // space, and if no random passes are specified, we at least do this.
-
-        if(pass)
-            fs.seek(pos);
-
-        memset(block, 0, sizeof(block));
-        fs.write(block, 1024);
-        if(fs.err()) {
-            report(path, fs.err());
-            fs.close();
-            return;
-        }
-
-        pos += 1024l;
     }
 
-    while(is(truncflag) && pos > 0l) {
-        pos -= 1024l * (fsys::offset_t)*blocks;
-        fs.trunc(pos);
+    while(is(truncflag) && size > 0l) {
+        size -= align;
+        if(size < 0l)
+            size = 0l;
+        fs.trunc(size);
         if(fs.err()) {
             report(path, fs.err());
             fs.close();
@@ -189,7 +350,80 @@ repeat:
     report(path, dir::remove(path));
 
     fs.close();
+}
+
+entry::entry(OrderedIndex *index, const char *filepath, bool dir) :
+OrderedObject(index), path(filepath)
+{
+    directory = dir;
+}
+
+worker::worker() : JoinableThread()
+{
+}
+
+worker::~worker()
+{
+    join();
+}
+
+void worker::run(void)
+{
+    scrubber scrub;
+    entry *node;
+
+    for(;;) {
+        claiming.lock();
+        node = next_entry;
+        while(node && node->directory)
+            node = static_cast<entry *>(node->getNext());
+        if(node)
+            next_entry = static_cast<entry *>(node->getNext());
+        else
+            next_entry = NULL;
+        claiming.unlock();
 
+        if(!node)
+            break;
+
+        scrub.scrub(node->path);
+    }
+}
+
+static void scrub(const char *path, bool dir = false)
+{
+    if(parallel) {
+        new entry(&worklist, path, dir);
+        return;
+    }
+
+    static scrubber serial;
+    serial.scrub(path);
+}
+
+// files are scrubbed by workers, then directories removed in scan order
+static void concurrent(unsigned count)
+{
+    worker **workers = new worker*[count];
+    scrubber cleanup;
+    unsigned pos;
+
+    next_entry = static_cast<entry *>(worklist.begin());
+    for(pos = 0; pos < count; ++pos) {
+        workers[pos] = new worker();
+        workers[pos]->start();
+    }
+
+    for(pos = 0; pos < count; ++pos)
+        delete workers[pos];
+    delete[] workers;
+
+    linked_pointer<entry> ep = worklist.begin();
+    while(is(ep)) {
+        if(ep->directory)
+            cleanup.scrub(ep->path);
+        ep.next();
+    }
 }
 
 static void scan(String path, bool top = true)
@@ -211,12 +445,12 @@ static void scan(String path, bool top = true)
                     scan(filepath, false);
             }
             else
-                scrub(filepath);
+                scrub(filepath, true);
         }
         else
             scrub(filepath);
     }
-    scrub(path);
+    scrub(path, true);
 }
 
 PROGRAM_MAIN(argc, argv)
@@ -225,6 +459,8 @@ PROGRAM_MAIN(argc, argv)
     shell args(argc, argv);
     argv0 = args.argv0();
     unsigned count = 0;
+    unsigned pass;
+    Timer::tick_t started;
 
     if(*blocks < 1)
         shell::errexit(2, "*** %s: blocksize: %ld: %s\n",
@@ -234,6 +470,10 @@ PROGRAM_MAIN(argc, argv)
         shell::errexit(2, "*** %s: passes: %ld: %s\n",
             argv0, *passes, _TEXT("negative passes invalid"));
 
+    if(*jobs < 1)
+        shell::errexit(2, "*** %s: jobs: %ld: %s\n",
+            argv0, *jobs, _TEXT("must be at least one"));
+
     argv0 = args.argv0();
 
     if(is(helpflag) || is(althelp)) {
@@ -250,6 +490,16 @@ PROGRAM_MAIN(argc, argv)
 
     secure::init();
 
+    pass_bytes = new unsigned long long[*passes + 1];
+    pass_ticks = new Timer::tick_t[*passes + 1];
+    for(pass = 0; pass <= (unsigned)(*passes); ++pass) {
+        pass_bytes[pass] = 0;
+        pass_ticks[pass] = 0;
+    }
+
+    parallel = (*jobs > 1);
+    started = Timer::ticks();
+
     while(count < args()) {
         if(fsys::is_dir(args[count]))
             scan(str(args[count++]));
@@ -257,6 +507,25 @@ PROGRAM_MAIN(argc, argv)
             scrub(args[count++]);
     }
 
+    if(parallel)
+        concurrent((unsigned)*jobs);
+
+    if(is(throughput)) {
+        double secs, mbytes, total = 0.0;
+
+        for(pass = 0; pass <= (unsigned)(*passes); ++pass) {
+            secs = (double)(pass_ticks[pass] ? pass_ticks[pass] : 1) / 10000000.0;
+            mbytes = (double)pass_bytes[pass] / (1024.0 * 1024.0);
+            total += mbytes;
+            if(pass < (unsigned)(*passes))
+                shell::printf("%s: pass %u: %.1f MB, %.1f MB/s\n", argv0, pass + 1, mbytes, mbytes / secs);
+            else
+                shell::printf("%s: zero fill: %.1f MB, %.1f MB/s\n", argv0, mbytes, mbytes / secs);
+        }
+        secs = (double)(Timer::ticks() - started) / 10000000.0;
+        shell::printf("%s: total: %.1f MB in %.3f sec, %.1f MB/s\n", argv0, total, secs, total / (secs > 0.0 ? secs : 1.0));
+    }
+
     PROGRAM_EXIT(exit_code);
 }
 